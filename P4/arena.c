@@ -0,0 +1,62 @@
+// arena.c - Bump-pointer memory Arena
+
+#include "arena.h"
+
+// ============================================================================
+// Allocate 'size' bytes, zero-filled, from 'arena'.  Requests bigger than the
+// block size get a block of their own.
+// ============================================================================
+void* arenaAlloc(Arena* arena, size_t size) {
+  size = (size + ARENAALIGN - 1) & ~(size_t)(ARENAALIGN - 1);
+
+  ArenaBlk* blk = arena->blk;
+  if (blk == NULL || blk->used + size > blk->size) {
+    size_t blkSize = size > arena->blkSize ? size : arena->blkSize;
+    blk = malloc(sizeof(ArenaBlk) + blkSize);
+    if (!blk) utDie2Str("arenaAlloc", "Out of memory");
+    blk->next = arena->blk;
+    blk->size = blkSize;
+    blk->used = 0;
+    arena->blk = blk;
+    ++arena->numBlk;
+  }
+
+  void* p = blk->mem + blk->used;
+  blk->used += size;
+  ++arena->numAlloc;
+  arena->numBytes += size;
+  return memset(p, 0, size);
+}
+
+// ============================================================================
+// Release every block held by 'arena', and the Arena itself
+// ============================================================================
+void arenaFree(Arena* arena) {
+  ArenaBlk* blk = arena->blk;
+  while (blk) {
+    ArenaBlk* next = blk->next;
+    free(blk);
+    blk = next;
+  }
+  free(arena);
+}
+
+// ============================================================================
+// Create a new, empty Arena that grows in blocks of 'blkSize' bytes
+// ============================================================================
+Arena* arenaNew(size_t blkSize) {
+  Arena* arena = calloc(1, sizeof(Arena));
+  if (!arena) utDie2Str("arenaNew", "Out of memory");
+  arena->blkSize = blkSize ? blkSize : ARENABLKSIZE;
+  return arena;
+}
+
+// ============================================================================
+// Copy the 'len' chars starting at 's' into 'arena', adding a trailing NUL
+// ============================================================================
+char* arenaStrndup(Arena* arena, char* s, size_t len) {
+  char* copy = arenaAlloc(arena, len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
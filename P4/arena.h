@@ -0,0 +1,36 @@
+// arena.h - Bump-pointer memory Arena
+
+#pragma once
+
+#include <stddef.h>     // size_t
+#include <stdlib.h>     // malloc
+#include <string.h>     // memcpy
+
+#include "ut.h"         // utDie2Str
+
+// An Arena hands out memory by bumping a pointer through a large block.  When
+// the current block is full, a fresh block is chained on the front.  Nothing
+// is freed individually: arenaFree releases every block in one call.
+
+#define ARENABLKSIZE (64 * 1024)    // default bytes per block
+#define ARENAALIGN   8              // alignment of every allocation
+
+typedef struct ArenaBlk_ {
+  struct ArenaBlk_* next;           // previous (full) block
+  size_t size;                      // bytes available in mem[]
+  size_t used;                      // bytes handed out so far
+  char   mem[];
+} ArenaBlk;
+
+typedef struct {
+  ArenaBlk* blk;                    // current block (head of chain)
+  size_t    blkSize;                // size for new blocks
+  size_t    numAlloc;               // statistics: number of arenaAlloc calls
+  size_t    numBytes;               // statistics: bytes handed out
+  size_t    numBlk;                 // statistics: blocks malloc'ed
+} Arena;
+
+void* arenaAlloc(Arena* arena, size_t size);
+void  arenaFree(Arena* arena);
+Arena* arenaNew(size_t blkSize);
+char* arenaStrndup(Arena* arena, char* s, size_t len);
@@ -0,0 +1,978 @@
+// asm.c - Assemble 68000 text for the simulator
+
+#include "asm.h"
+
+static char* asmOpNames[ASMNUMOP] = {
+  "NOP",
+  "ADD",    "ADDA",   "ADDI",   "ADDQ",   "ASL",    "BCC",    "BCS",    "BEQ",
+  "BGE",    "BGT",    "BHI",    "BLE",    "BLS",    "BLT",    "BMI",    "BNE",
+  "BPL",    "BRA",    "BSR",    "BVC",    "BVS",    "CLR",    "CMP",    "CMPA",
+  "CMPI",   "EXT",    "JMP",    "JSR",    "LEA",    "LINK",   "LSL",    "MOVE",
+  "MOVEA",  "MOVEM",  "MOVEQ",  "MULS",   "NEG",    "PEA",    "RTS",    "SIMHALT",
+  "SUB",    "SUBA",   "SUBI",   "SUBQ",   "TRAP",   "TST",    "UNLK",
+  "(exit)",
+};
+
+#define ASMMAXUP    4       // parent folders searched for an INCLUDE
+#define ASMMAXDEPTH 8       // INCLUDEs nested within INCLUDEs
+
+// Where an error was found, for asmDie
+
+static char* asmPath = "";
+static int   asmLineNum = 0;
+
+// ============================================================================
+// Report an error on the current line, and stop
+// ============================================================================
+static void asmDie(char* msg, char* text) {
+  char where[ASMMAXPATH + 40];
+  sprintf(where, "at line %d of %.*s", asmLineNum, ASMMAXPATH, asmPath);
+  utDie4Str("asmFile", msg, text, where);
+}
+
+// ============================================================================
+// The name of opcode 'op', eg: "MOVEM"
+// ============================================================================
+char* asmOpName(ASMOP op) { return asmOpNames[op]; }
+
+// ============================================================================
+// Is 'op' a Bcc, BRA or BSR?  A Bcc, BRA, BSR, JMP or JSR?
+// ============================================================================
+static int asmIsBranch(int op) { return op >= ASMBCC && op <= ASMBVS; }
+
+static int asmIsJump(int op) { return asmIsBranch(op) || op == ASMJMP || op == ASMJSR; }
+
+// ============================================================================
+// Is 'o' a memory operand?  A register?
+// ============================================================================
+static int asmIsMem(AsmOpnd* o) { return o->kind >= ASMOPIND && o->kind <= ASMOPABS; }
+
+static int asmIsReg(AsmOpnd* o) { return o->kind == ASMOPDREG || o->kind == ASMOPAREG; }
+
+// ============================================================================
+// Make room in the symbol table for intern ID 'id'
+// ============================================================================
+static void asmGrowSym(Asm* as, int id) {
+  if (id < as->numSym) return;
+  int num = as->numSym ? as->numSym : ASMMINCAP;
+  while (num <= id) num *= 2;
+  as->symKind = realloc(as->symKind, num * sizeof(uint8_t));
+  as->symVal  = realloc(as->symVal,  num * sizeof(int));
+  if (!as->symKind || !as->symVal) utDie2Str("asmGrowSym", "Out of memory");
+  memset(as->symKind + as->numSym, 0, (num - as->numSym) * sizeof(uint8_t));
+  memset(as->symVal  + as->numSym, 0, (num - as->numSym) * sizeof(int));
+  as->numSym = num;
+}
+
+// ============================================================================
+// Intern the label spelled by the 'len' chars at 's'.  A local label, such
+// as ".loop", belongs to the last non-local label: "strlen.loop".
+// ============================================================================
+static int asmLabel(Asm* as, char* s, int len) {
+  if (s[0] != '.' || as->scope == 0) return internN(s, len);
+  char* scope = internStr(as->scope);
+  int   slen  = internLen(as->scope);
+  char* full  = malloc(slen + len + 1);
+  if (!full) utDie2Str("asmLabel", "Out of memory");
+  memcpy(full, scope, slen);
+  memcpy(full + slen, s, len);
+  int id = internN(full, slen + len);
+  free(full);
+  return id;
+}
+
+// ============================================================================
+// Is label 'id' one the compiler makes for a block, such as "L20"?
+// ============================================================================
+static int asmIsBlockLabel(int id) {
+  char* s = internStr(id);
+  if (s[0] != 'L' || s[1] == 0) return 0;
+  for (++s; *s; ++s) if (*s < '0' || *s > '9') return 0;
+  return 1;
+}
+
+// ============================================================================
+// Bind the pending labels to instruction (ASMSYMCODE) or DC.B (ASMSYMDATA)
+// number 'index'.  A label on an instruction that is neither local, nor a
+// block label, starts a new function.
+// ============================================================================
+static void asmBind(Asm* as, ASMSYM kind, int index) {
+  for (int p = 0; p < as->numPend; ++p) {
+    int id = as->pend[p];
+    asmGrowSym(as, id);
+    if (as->symKind[id] != ASMSYMNONE) asmDie("Label defined twice:", internStr(id));
+    as->symKind[id] = kind;
+    as->symVal[id]  = index;
+
+    int isFun = kind == ASMSYMCODE && strchr(internStr(id), '.') == NULL
+      && !asmIsBlockLabel(id);
+    if (isFun && as->fun[as->numFun - 1].entry != index) {
+      if (as->numFun == as->capFun) {
+        as->capFun *= 2;
+        as->fun = realloc(as->fun, as->capFun * sizeof(AsmFun));
+        if (!as->fun) utDie2Str("asmBind", "Out of memory");
+      }
+      as->fun[as->numFun].name  = id;
+      as->fun[as->numFun].entry = index;
+      ++as->numFun;
+    }
+  }
+  as->numPend = 0;
+}
+
+// ============================================================================
+// Append a DC.B of 'len' bytes at 'bytes' (len = 0 => an ORG of 'org')
+// ============================================================================
+static void asmAddData(Asm* as, uint8_t* bytes, int len, uint32_t org) {
+  if (as->numData == as->capData) {
+    as->capData = as->capData ? 2 * as->capData : ASMMINCAP;
+    as->data = realloc(as->data, as->capData * sizeof(AsmData));
+    if (!as->data) utDie2Str("asmAddData", "Out of memory");
+  }
+  if (len) asmBind(as, ASMSYMDATA, as->numData);
+  AsmData* d = &as->data[as->numData++];
+  d->before = as->num;
+  d->len    = len;
+  d->org    = org;
+  d->addr   = 0;
+  d->bytes  = bytes;
+}
+
+// ============================================================================
+// Append an instruction, and return it
+// ============================================================================
+static AsmIns* asmAddIns(Asm* as, ASMOP op, int sz) {
+  if (as->num == as->cap) {
+    as->cap *= 2;
+    as->code = realloc(as->code, as->cap * sizeof(AsmIns));
+    if (!as->code) utDie2Str("asmAddIns", "Out of memory");
+  }
+  asmBind(as, ASMSYMCODE, as->num);
+  AsmIns* ins = &as->code[as->num++];
+  memset(ins, 0, sizeof(AsmIns));
+  ins->op      = op;
+  ins->sz      = (uint8_t) sz;
+  ins->fun     = as->numFun - 1;
+  ins->target  = -1;
+  ins->line    = asmLineNum;
+  ins->isShort = 1;
+  return ins;
+}
+
+// ============================================================================
+// Parse the number spelled by all of 's' - decimal, $hex, %binary or 'c' -
+// into '*val'.  Return 0 if 's' is not a number.
+// ============================================================================
+static int asmNum(char* s, int* val) {
+  int neg = 0;
+  if (*s == '-') { neg = 1; ++s; }
+  if (*s == 0) return 0;
+
+  uint32_t n = 0;
+  if (s[0] == '\'' && s[1] && s[2] == '\'' && s[3] == 0) {
+    n = (uint8_t) s[1];
+  } else if (*s == '$' || *s == '%') {
+    int base = *s == '$' ? 16 : 2;
+    if (*++s == 0) return 0;
+    for (; *s; ++s) {
+      int d = *s >= '0' && *s <= '9' ? *s - '0'
+            : *s >= 'a' && *s <= 'f' ? *s - 'a' + 10
+            : *s >= 'A' && *s <= 'F' ? *s - 'A' + 10 : 99;
+      if (d >= base) return 0;
+      n = n * base + d;
+    }
+  } else {
+    for (; *s; ++s) {
+      if (*s < '0' || *s > '9') return 0;
+      n = n * 10 + (*s - '0');
+    }
+  }
+  *val = (int) (neg ? 0 - n : n);
+  return 1;
+}
+
+// ============================================================================
+// Parse a register name - D0-D7, A0-A7 or SP - from the 'len' chars at 's'.
+// Set '*isA' and '*n'.  Return 0 if it is not a register.
+// ============================================================================
+static int asmReg(char* s, int len, int* isA, int* n) {
+  if (len != 2) return 0;
+  char c0 = s[0] & ~0x20, c1 = s[1];
+  if (c0 == 'S' && (c1 & ~0x20) == 'P') { *isA = 1; *n = 7; return 1; }
+  if ((c0 != 'D' && c0 != 'A') || c1 < '0' || c1 > '7') return 0;
+  *isA = c0 == 'A';
+  *n   = c1 - '0';
+  return 1;
+}
+
+// ============================================================================
+// Parse a MOVEM register list, such as "D2-D4/D7/A2", into a mask: bit n for
+// Dn, bit 8+n for An.  Return -1 if 's' is not a register list.
+// ============================================================================
+static int asmRegList(char* s) {
+  int mask = 0;
+  while (*s) {
+    int isA, lo, hi, isB;
+    if (!asmReg(s, 2, &isA, &lo)) return -1;
+    s += 2;
+    hi = lo;
+    if (*s == '-') {
+      if (!asmReg(s + 1, 2, &isB, &hi) || isB != isA || hi < lo) return -1;
+      s += 3;
+    }
+    for (int r = lo; r <= hi; ++r) mask |= 1 << (r + 8 * isA);
+    if (*s == '/') ++s; else if (*s) return -1;
+  }
+  return mask;
+}
+
+// ============================================================================
+// Parse the operand spelled by 's' (spaces already removed) into 'o'.
+// ============================================================================
+static void asmOpnd(Asm* as, char* s, AsmOpnd* o) {
+  int len = (int) strlen(s), isA, n;
+  memset(o, 0, sizeof(AsmOpnd));
+
+  if (s[0] == '#') {                                      // #42 or #label
+    o->kind = ASMOPIMM;
+    if (!asmNum(s + 1, &o->val)) o->sym = asmLabel(as, s + 1, len - 1);
+    return;
+  }
+
+  if (asmReg(s, len, &isA, &n)) {                         // D3 or A6
+    o->kind = isA ? ASMOPAREG : ASMOPDREG;
+    o->reg  = (uint8_t) n;
+    return;
+  }
+
+  if (len == 4 && s[0] == '(' && s[3] == ')' && asmReg(s + 1, 2, &isA, &n) && isA) {
+    o->kind = ASMOPIND;                                   // (A0)
+    o->reg  = (uint8_t) n;
+    return;
+  }
+
+  if (len == 5 && s[0] == '(' && s[3] == ')' && s[4] == '+' && asmReg(s + 1, 2, &isA, &n) && isA) {
+    o->kind = ASMOPPOSTINC;                               // (A7)+
+    o->reg  = (uint8_t) n;
+    return;
+  }
+
+  if (len == 5 && s[0] == '-' && s[1] == '(' && s[4] == ')' && asmReg(s + 2, 2, &isA, &n) && isA) {
+    o->kind = ASMOPPREDEC;                                // -(A7)
+    o->reg  = (uint8_t) n;
+    return;
+  }
+
+  if (len >= 4 && s[len - 1] == ')' && asmReg(s + len - 3, 2, &isA, &n) && isA) {
+    char disp[32];
+    int  dlen = 0;
+    if (s[0] == '(' && s[len - 4] == ',') {               // (-8,A6)
+      dlen = len - 5;
+      if (dlen < 1 || dlen >= (int) sizeof(disp)) asmDie("Bad operand", s);
+      memcpy(disp, s + 1, dlen);
+    } else if (s[len - 4] == '(') {                       // -8(A6)
+      dlen = len - 4;
+      if (dlen < 1 || dlen >= (int) sizeof(disp)) asmDie("Bad operand", s);
+      memcpy(disp, s, dlen);
+    } else {
+      asmDie("Bad operand", s);
+    }
+    disp[dlen] = 0;
+    if (!asmNum(disp, &o->val) || o->val < -32768 || o->val > 32767) {
+      asmDie("Bad displacement in", s);
+    }
+    o->kind = ASMOPDISP;
+    o->reg  = (uint8_t) n;
+    return;
+  }
+
+  int mask = asmRegList(s);
+  if (mask > 0) {                                         // D2-D4/A2
+    o->kind = ASMOPREGS;
+    o->val  = mask;
+    return;
+  }
+
+  o->kind = ASMOPABS;                                     // $1000 or L50
+  if (asmNum(s, &o->val)) return;
+  if (!(s[0] == '.' || s[0] == '_' || ((s[0] | 0x20) >= 'a' && (s[0] | 0x20) <= 'z'))) {
+    asmDie("Bad operand", s);
+  }
+  o->sym = asmLabel(as, s, len);
+}
+
+// ============================================================================
+// Turn 'ins' into the form the assembler would choose - eg: ADD into An
+// becomes ADDA, and a MOVEM of one register takes a register list
+// ============================================================================
+static void asmForm(AsmIns* ins) {
+  AsmOpnd* src = &ins->src;
+  AsmOpnd* dst = &ins->dst;
+  int op = ins->op;
+
+  switch (op) {
+    case ASMADD: case ASMSUB: case ASMCMP:
+      if (dst->kind == ASMOPAREG) {
+        ins->op = op == ASMADD ? ASMADDA : op == ASMSUB ? ASMSUBA : ASMCMPA;
+      } else if (src->kind == ASMOPIMM) {
+        ins->op = op == ASMADD ? ASMADDI : op == ASMSUB ? ASMSUBI : ASMCMPI;
+      }
+      break;
+    case ASMMOVE:
+      if (dst->kind == ASMOPAREG) ins->op = ASMMOVEA;
+      break;
+    case ASMMOVEM:
+      if (src->kind == ASMOPDREG || src->kind == ASMOPAREG) {
+        src->val = 1 << (src->reg + 8 * (src->kind == ASMOPAREG));
+        src->kind = ASMOPREGS;
+      }
+      if (dst->kind == ASMOPDREG || dst->kind == ASMOPAREG) {
+        dst->val = 1 << (dst->reg + 8 * (dst->kind == ASMOPAREG));
+        dst->kind = ASMOPREGS;
+      }
+      break;
+  }
+}
+
+// ============================================================================
+// Turn 'ins' into the form the assembler would choose, with asmForm, then
+// check its operands against what its opcode allows.  'num' is the number of
+// operands given.  'text' is the line, for errors.
+// ============================================================================
+static void asmCheck(AsmIns* ins, int num, char* text) {
+  AsmOpnd* src = &ins->src;
+  AsmOpnd* dst = &ins->dst;
+  asmForm(ins);
+  int op = ins->op;
+
+  int want = 2;                                           // operands expected
+  int ok   = 1;
+  switch (op) {
+    case ASMNOP: case ASMRTS: case ASMSIMHALT:
+      want = 0;
+      break;
+    case ASMCLR: case ASMNEG:                             // operand is written: dst
+      want = 1;
+      *dst = *src; memset(src, 0, sizeof(AsmOpnd));
+      ok = dst->kind == ASMOPDREG || asmIsMem(dst);
+      break;
+    case ASMEXT:
+      want = 1;
+      *dst = *src; memset(src, 0, sizeof(AsmOpnd));
+      ok = dst->kind == ASMOPDREG && ins->sz != 1;
+      break;
+    case ASMTST:
+      want = 1;
+      ok = src->kind == ASMOPDREG || asmIsMem(src);
+      break;
+    case ASMPEA:
+      want = 1;
+      ok = src->kind == ASMOPIND || src->kind == ASMOPDISP || src->kind == ASMOPABS;
+      break;
+    case ASMUNLK:
+      want = 1;
+      ok = src->kind == ASMOPAREG;
+      break;
+    case ASMTRAP:
+      want = 1;
+      ok = src->kind == ASMOPIMM && src->sym == 0 && src->val >= 0 && src->val <= 15;
+      break;
+    case ASMJMP: case ASMJSR:
+      want = 1;
+      ok = src->kind == ASMOPABS && src->sym;
+      break;
+    case ASMLSL: case ASMASL:
+      if (num == 1) {                                     // LSL <ea>: shift by 1
+        want = 1;
+        *dst = *src; memset(src, 0, sizeof(AsmOpnd));
+        ok = asmIsMem(dst) && ins->sz == 2;
+      } else {
+        ok = dst->kind == ASMOPDREG && (src->kind == ASMOPDREG
+          || (src->kind == ASMOPIMM && src->sym == 0 && src->val >= 1 && src->val <= 8));
+      }
+      break;
+    case ASMLEA:
+      ok = (src->kind == ASMOPIND || src->kind == ASMOPDISP || src->kind == ASMOPABS)
+        && dst->kind == ASMOPAREG;
+      break;
+    case ASMLINK:
+      ok = src->kind == ASMOPAREG && dst->kind == ASMOPIMM && dst->sym == 0
+        && dst->val >= -32768 && dst->val <= 32767;
+      break;
+    case ASMMOVEQ:
+      ok = src->kind == ASMOPIMM && src->sym == 0 && src->val >= -128 && src->val <= 127
+        && dst->kind == ASMOPDREG;
+      break;
+    case ASMADDQ: case ASMSUBQ:
+      ok = src->kind == ASMOPIMM && src->sym == 0 && src->val >= 1 && src->val <= 8
+        && (dst->kind == ASMOPDREG || asmIsMem(dst) || (dst->kind == ASMOPAREG && ins->sz != 1));
+      break;
+    case ASMMOVEM:
+      ok = ins->sz != 1
+        && ((src->kind == ASMOPREGS && (dst->kind == ASMOPIND || dst->kind == ASMOPPREDEC
+             || dst->kind == ASMOPDISP || dst->kind == ASMOPABS))
+         || (dst->kind == ASMOPREGS && (src->kind == ASMOPIND || src->kind == ASMOPPOSTINC
+             || src->kind == ASMOPDISP || src->kind == ASMOPABS)));
+      break;
+    case ASMMULS:
+      ok = src->kind != ASMOPAREG && src->kind != ASMOPREGS && dst->kind == ASMOPDREG;
+      break;
+    case ASMADDA: case ASMSUBA: case ASMCMPA: case ASMMOVEA:
+      ok = src->kind != ASMOPREGS && dst->kind == ASMOPAREG && ins->sz != 1;
+      break;
+    case ASMADDI: case ASMSUBI: case ASMCMPI:
+      ok = dst->kind == ASMOPDREG || asmIsMem(dst);
+      break;
+    case ASMADD: case ASMSUB:
+      ok = src->kind != ASMOPREGS && ((dst->kind == ASMOPDREG && (src->kind != ASMOPAREG || ins->sz != 1))
+        || (src->kind == ASMOPDREG && asmIsMem(dst)));
+      break;
+    case ASMCMP:
+      ok = src->kind != ASMOPREGS && dst->kind == ASMOPDREG;
+      break;
+    case ASMMOVE:
+      ok = src->kind != ASMOPREGS && (dst->kind == ASMOPDREG || asmIsMem(dst))
+        && (src->kind != ASMOPAREG || ins->sz != 1);
+      break;
+    default:                                              // Bcc, BRA, BSR
+      want = 1;
+      ok = src->kind == ASMOPABS && src->sym;
+      break;
+  }
+  if (num != want || !ok) asmDie("Bad operands for", text);
+}
+
+// ============================================================================
+// Split the operand field 's' at each comma outside brackets and quotes,
+// removing spaces outside quotes.  Return the number of operands found (at
+// most 'max') in 'opnd'.  The pieces live in 's' itself.
+// ============================================================================
+static int asmSplit(char* s, char** opnd, int max) {
+  int num = 0, depth = 0, quote = 0;
+  char* out = s;
+  if (*s) opnd[num++] = out;
+  for (; *s; ++s) {
+    if (*s == '\'') quote = !quote;
+    if (!quote && (*s == ' ' || *s == '\t')) continue;
+    if (!quote && *s == '(') ++depth;
+    if (!quote && *s == ')') --depth;
+    if (!quote && depth == 0 && *s == ',') {
+      *out++ = 0;
+      if (num == max) return max + 1;
+      opnd[num++] = out;
+      continue;
+    }
+    *out++ = *s;
+  }
+  *out = 0;
+  return num;
+}
+
+// ============================================================================
+// Assemble a DC.B, whose items - numbers, and strings in single quotes - are
+// spelled by 's'
+// ============================================================================
+static void asmDcb(Asm* as, char* s) {
+  uint8_t* bytes = arenaAlloc(as->arena, strlen(s) + 1);     // enough, and then some
+  int len = 0;
+  while (*s) {
+    while (*s == ' ' || *s == '\t') ++s;
+    if (*s == '\'') {
+      for (++s; *s && *s != '\''; ++s) bytes[len++] = (uint8_t) *s;
+      if (*s != '\'') asmDie("Unterminated string in", "DC.B");
+      ++s;
+    } else {
+      char* start = s;
+      while (*s && *s != ',' && *s != ' ' && *s != '\t') ++s;
+      char save = *s;
+      *s = 0;
+      int val;
+      if (!asmNum(start, &val) || val < -128 || val > 255) asmDie("Bad DC.B item", start);
+      *s = save;
+      bytes[len++] = (uint8_t) val;
+    }
+    while (*s == ' ' || *s == '\t') ++s;
+    if (*s == ',') ++s;
+    else if (*s) asmDie("Bad DC.B item", s);
+  }
+  if (len == 0) asmDie("Empty", "DC.B");
+  asmAddData(as, bytes, len, 0);
+}
+
+static void asmRead(Asm* as, char* path, int depth);
+
+// ============================================================================
+// Find the file named by INCLUDE 'name' in an .X68 file at 'from', and
+// assemble it.  Look first relative to the current folder; then relative to
+// the folder of 'from', and each of its parents; then for just the file name
+// in those same folders.  A "\" in 'name' is taken as a "/".
+// ============================================================================
+static void asmInclude(Asm* as, char* name, char* from, int depth) {
+  char path[ASMMAXPATH];
+  char dir[ASMMAXPATH];
+  if (strlen(name) + strlen(from) + 3 * ASMMAXUP + 4 >= ASMMAXPATH) {
+    asmDie("Path too long:", name);
+  }
+
+  for (char* p = name; *p; ++p) if (*p == '\\') *p = '/';
+  char* base = strrchr(name, '/');
+  base = base ? base + 1 : name;
+
+  FILE* file = fopen(name, "r");
+  if (file) { fclose(file); asmRead(as, name, depth + 1); return; }
+
+  strcpy(dir, from);
+  char* slash = strrchr(dir, '/');
+  char* wack  = strrchr(dir, '\\');
+  if (wack > slash) slash = wack;
+  if (slash) slash[1] = 0; else strcpy(dir, "./");
+
+  for (int pass = 0; pass < 2; ++pass) {
+    char* want = pass == 0 ? name : base;
+    size_t dlen = strlen(dir);
+    for (int up = 0; up <= ASMMAXUP; ++up) {
+      sprintf(path, "%s%s", dir, want);
+      file = fopen(path, "r");
+      if (file) { fclose(file); asmRead(as, path, depth + 1); return; }
+      strcat(dir, "../");
+    }
+    dir[dlen] = 0;
+  }
+  asmDie("Cannot find INCLUDE file", name);
+}
+
+// ============================================================================
+// Assemble one line of text, 's', that has no '\n'
+// ============================================================================
+static void asmLine(Asm* as, char* s, char* path, int depth) {
+  if (*s == '*') return;                                  // comment line
+
+  int quote = 0;                                          // strip any "; comment"
+  for (char* p = s; *p; ++p) {
+    if (*p == '\'') quote = !quote;
+    if (*p == ';' && !quote) { *p = 0; break; }
+  }
+  char* end = s + strlen(s);                              // and trailing blanks
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) *--end = 0;
+
+  if (*s && *s != ' ' && *s != '\t') {                    // label, in column 1
+    char* p = s;
+    while (*p && *p != ':' && *p != ' ' && *p != '\t') ++p;
+    int id = asmLabel(as, s, (int) (p - s));
+    if (s[0] != '.') as->scope = id;
+    if (as->numPend == ASMMAXPEND) asmDie("Too many labels for one address at", internStr(id));
+    as->pend[as->numPend++] = id;
+    s = *p == ':' ? p + 1 : p;
+  }
+
+  while (*s == ' ' || *s == '\t') ++s;
+  if (*s == 0) return;                                    // label only
+
+  char name[16];                                          // opcode, upper-cased
+  int len = 0;
+  for (; *s && *s != ' ' && *s != '\t'; ++s) {
+    if (len == (int) sizeof(name) - 1) asmDie("Unknown opcode at", s);
+    name[len++] = (char) (*s >= 'a' && *s <= 'z' ? *s - 32 : *s);
+  }
+  name[len] = 0;
+  while (*s == ' ' || *s == '\t') ++s;                    // 's' = operand field
+
+  int sz = 0;
+  char* dot = strchr(name, '.');
+  if (dot) {
+    *dot = 0;
+    if      (strcmp(dot + 1, "B") == 0) sz = 1;
+    else if (strcmp(dot + 1, "W") == 0) sz = 2;
+    else if (strcmp(dot + 1, "L") == 0) sz = 4;
+    else if (strcmp(dot + 1, "S") != 0) asmDie("Bad size on", name);
+  }
+
+  if (strcmp(name, "DC") == 0) {
+    if (sz != 1) asmDie("Only DC.B is supported, not", name);
+    asmDcb(as, s);
+    return;
+  }
+  if (strcmp(name, "ORG") == 0) {
+    int org;
+    if (!asmNum(s, &org) || org < 0 || org >= ASMMEMSIZE) asmDie("Bad ORG", s);
+    asmAddData(as, NULL, 0, (uint32_t) org);
+    return;
+  }
+  if (strcmp(name, "INCLUDE") == 0) {
+    if (depth >= ASMMAXDEPTH) asmDie("INCLUDEs nested too deep at", s);
+    int line = asmLineNum;
+    asmInclude(as, s, path, depth);
+    asmPath = path;
+    asmLineNum = line;
+    return;
+  }
+  if (strcmp(name, "END") == 0) {
+    if (*s) as->startSym = asmLabel(as, s, (int) strlen(s));
+    return;
+  }
+
+  int op = 0;
+  while (op < ASMEXIT && strcmp(asmOpNames[op], name) != 0) ++op;
+  if (op == ASMEXIT) asmDie("Unknown opcode", name);
+
+  if (sz == 0) {                                          // the default size
+    sz = op == ASMMOVEQ || op == ASMLEA || op == ASMPEA ? 4 : 2;
+  }
+
+  char* opnd[2];
+  int num = asmSplit(s, opnd, 2);
+  if (num > 2) asmDie("Too many operands for", name);
+
+  AsmIns* ins = asmAddIns(as, op, sz);
+  if (num > 0) asmOpnd(as, opnd[0], &ins->src);
+  if (num > 1) asmOpnd(as, opnd[1], &ins->dst);
+  asmCheck(ins, num, name);
+}
+
+// ============================================================================
+// Assemble the file at 'path'.  'depth' counts the INCLUDEs that led here.
+// ============================================================================
+static void asmRead(Asm* as, char* path, int depth) {
+  size_t size;
+  char* text = utReadFile(path, &size);
+  asmPath = path;
+  asmLineNum = 0;
+
+  char* s = text;
+  while (*s) {
+    char* nl = strchr(s, '\n');
+    if (nl) *nl = 0;
+    ++asmLineNum;
+    asmLine(as, s, path, depth);
+    if (!nl) break;
+    s = nl + 1;
+  }
+  free(text);
+}
+
+// ============================================================================
+// Bytes of extension words that operand 'o' adds to an instruction of size
+// 'sz'.  Labels are taken as absolute long addresses.
+// ============================================================================
+static int asmExt(AsmOpnd* o, int sz) {
+  switch (o->kind) {
+    case ASMOPIMM:  return sz == 4 ? 4 : 2;
+    case ASMOPDISP: return 2;
+    case ASMOPABS:  return 4;
+    default:        return 0;
+  }
+}
+
+// ============================================================================
+// Bytes of machine code for 'ins'
+// ============================================================================
+static int asmLength(AsmIns* ins) {
+  switch (ins->op) {
+    case ASMNOP: case ASMRTS: case ASMUNLK: case ASMEXT: case ASMTRAP:
+    case ASMMOVEQ: case ASMEXIT:
+      return 2;
+    case ASMLSL: case ASMASL:
+      return 2 + asmExt(&ins->dst, 2);
+    case ASMSIMHALT: case ASMLINK:
+      return 4;
+    case ASMADDQ: case ASMSUBQ:
+      return 2 + asmExt(&ins->dst, ins->sz);
+    case ASMMOVEM:
+      return 4 + asmExt(&ins->src, 4) + asmExt(&ins->dst, 4);
+    default:
+      if (asmIsBranch(ins->op)) return ins->isShort ? 2 : 4;
+      return 2 + asmExt(&ins->src, ins->sz) + asmExt(&ins->dst, ins->sz);
+  }
+}
+
+// ============================================================================
+// Give each instruction and DC.B its address.  Return 1 if a short branch
+// then cannot reach its target, and so has grown to a word branch.
+// ============================================================================
+static int asmPlace(Asm* as) {
+  uint32_t loc = 0;
+  int d = 0;
+  for (int i = 0; i < as->num; ++i) {
+    for (; d < as->numData && as->data[d].before == i; ++d) {
+      AsmData* data = &as->data[d];
+      if (data->len == 0) {
+        if (data->org > loc) loc = data->org;
+      } else {
+        data->addr = loc;
+        loc += data->len;
+      }
+    }
+    loc = (loc + 1) & ~1u;                                // code is word-aligned
+    as->code[i].addr = loc;
+    loc += as->code[i].len;
+    if (loc >= ASMMEMSIZE) utDie2Str("asmPlace", "Program too large for 16 MB");
+  }
+  as->hiAddr = loc;
+
+  int grew = 0;
+  for (int i = 0; i < as->num; ++i) {
+    AsmIns* ins = &as->code[i];
+    if (!asmIsBranch(ins->op) || !ins->isShort) continue;
+    int disp = (int) as->code[ins->target].addr - (int) (ins->addr + 2);
+    if (disp == 0 || disp < -128 || disp > 127) {
+      ins->isShort = 0;
+      ins->len = 4;
+      grew = 1;
+    }
+  }
+  return grew;
+}
+
+// ============================================================================
+// Resolve the label in operand 'o' of 'ins', now that every address is known
+// ============================================================================
+static void asmResolve(Asm* as, AsmIns* ins, AsmOpnd* o) {
+  if (o->sym == 0) return;
+  int kind = o->sym < as->numSym ? as->symKind[o->sym] : ASMSYMNONE;
+  if (kind == ASMSYMNONE) {
+    asmLineNum = ins->line;
+    asmDie("Undefined label", internStr(o->sym));
+  }
+  int index = as->symVal[o->sym];
+  o->val = kind == ASMSYMCODE ? (int) as->code[index].addr : (int) as->data[index].addr;
+}
+
+// ============================================================================
+// Cycles to compute the effective address of operand 'o', for size 'sz'
+// ============================================================================
+static int asmEaTime(AsmOpnd* o, int sz) {
+  int isLong = sz == 4;
+  switch (o->kind) {
+    case ASMOPIND:
+    case ASMOPPOSTINC: return isLong ?  8 :  4;
+    case ASMOPPREDEC:  return isLong ? 10 :  6;
+    case ASMOPDISP:    return isLong ? 12 :  8;
+    case ASMOPABS:     return isLong ? 16 : 12;
+    case ASMOPIMM:     return isLong ?  8 :  4;
+    default:           return 0;
+  }
+}
+
+// ============================================================================
+// Number of registers in MOVEM mask 'mask'
+// ============================================================================
+static int asmCount(int mask) {
+  int n = 0;
+  for (; mask; mask &= mask - 1) ++n;
+  return n;
+}
+
+// ============================================================================
+// Set the fixed cost of 'ins', in cycles, from the 68000 timing tables.  The
+// parts that depend on data - a taken branch, the bits of a MULS source, a
+// shift count held in a register - sim.c adds as it runs.
+// ============================================================================
+static void asmTime(AsmIns* ins) {
+  AsmOpnd* src = &ins->src;
+  AsmOpnd* dst = &ins->dst;
+  int sz = ins->sz, isLong = sz == 4, c = 0;
+  int regOrImm = asmIsReg(src) || src->kind == ASMOPIMM;
+
+  switch (ins->op) {
+    case ASMMOVE: case ASMMOVEA:                          // -(An) costs as (An)
+      c = 4 + asmEaTime(src, sz)
+            + (dst->kind == ASMOPPREDEC ? (isLong ? 8 : 4) : asmEaTime(dst, sz));
+      break;
+    case ASMMOVEQ: case ASMEXT: case ASMNOP:
+      c = 4;
+      break;
+    case ASMMOVEM: {
+      int n = asmCount(src->kind == ASMOPREGS ? src->val : dst->val) * (isLong ? 8 : 4);
+      if (src->kind == ASMOPREGS) {                       // registers => memory
+        c = (dst->kind == ASMOPDISP ? 12 : dst->kind == ASMOPABS ? 16 : 8) + n;
+      } else {                                            // memory => registers
+        c = (src->kind == ASMOPDISP ? 16 : src->kind == ASMOPABS ? 20 : 12) + n;
+      }
+      break;
+    }
+    case ASMLEA:
+      c = src->kind == ASMOPIND ? 4 : src->kind == ASMOPDISP ? 8 : 12;
+      break;
+    case ASMPEA:
+      c = src->kind == ASMOPIND ? 12 : src->kind == ASMOPDISP ? 16 : 20;
+      break;
+    case ASMADD: case ASMSUB:
+      if (dst->kind == ASMOPDREG) {
+        c = isLong ? 6 + asmEaTime(src, sz) + 2 * regOrImm : 4 + asmEaTime(src, sz);
+      } else {
+        c = (isLong ? 12 : 8) + asmEaTime(dst, sz);
+      }
+      break;
+    case ASMADDA: case ASMSUBA:
+      c = isLong ? 6 + asmEaTime(src, sz) + 2 * regOrImm : 8 + asmEaTime(src, sz);
+      break;
+    case ASMADDI: case ASMSUBI:
+      c = dst->kind == ASMOPDREG ? (isLong ? 16 : 8) : (isLong ? 20 : 12) + asmEaTime(dst, sz);
+      break;
+    case ASMADDQ: case ASMSUBQ:
+      c = dst->kind == ASMOPDREG ? (isLong ? 8 : 4)
+        : dst->kind == ASMOPAREG ? 8
+        : (isLong ? 12 : 8) + asmEaTime(dst, sz);
+      break;
+    case ASMCMP:
+      c = (isLong ? 6 : 4) + asmEaTime(src, sz);
+      break;
+    case ASMCMPA:
+      c = 6 + asmEaTime(src, sz);
+      break;
+    case ASMCMPI:
+      c = dst->kind == ASMOPDREG ? (isLong ? 14 : 8) : (isLong ? 12 : 8) + asmEaTime(dst, sz);
+      break;
+    case ASMTST:
+      c = 4 + asmEaTime(src, sz);
+      break;
+    case ASMCLR: case ASMNEG:
+      c = dst->kind == ASMOPDREG ? (isLong ? 6 : 4) : (isLong ? 12 : 8) + asmEaTime(dst, sz);
+      break;
+    case ASMLSL: case ASMASL:
+      if (src->kind == ASMOPNONE) {                       // memory, by 1
+        c = 8 + asmEaTime(dst, sz);
+      } else {                                            // + 2 per bit shifted
+        c = (isLong ? 8 : 6) + (src->kind == ASMOPIMM ? 2 * src->val : 0);
+      }
+      break;
+    case ASMMULS:                                         // + 2 per 01 or 10 pair
+      c = 38 + asmEaTime(src, 2);
+      break;
+    case ASMBRA:
+      c = 10;
+      break;
+    case ASMBSR:
+      c = 18;
+      break;
+    case ASMJMP:
+      c = 12;
+      break;
+    case ASMJSR:
+      c = 20;
+      break;
+    case ASMRTS: case ASMLINK:
+      c = 16;
+      break;
+    case ASMUNLK:
+      c = 12;
+      break;
+    case ASMTRAP:
+      c = 34;
+      break;
+    case ASMSIMHALT: case ASMEXIT:
+      c = 0;
+      break;
+    default:                                              // Bcc
+      c = ins->isShort ? 8 : 12;
+      ins->taken = 10;
+      break;
+  }
+  ins->cycles = c;
+}
+
+// ============================================================================
+// The fixed cost of 'ins', in cycles, as for an instruction read by asmFile.
+// 'ins' is put into the assembler's form first, and its 'cycles' and 'taken'
+// set.  Single-operand instructions keep their operand where asmCheck puts
+// it: in 'dst' for CLR, EXT and NEG, and in 'src' otherwise.
+// ============================================================================
+int asmCost(AsmIns* ins) {
+  asmForm(ins);
+  asmTime(ins);
+  return ins->cycles;
+}
+
+// ============================================================================
+// Cycles a MULS takes beyond its fixed cost: 2 for each 01 or 10 pair in the
+// 16-bit source with a 0 appended below it
+// ============================================================================
+int asmMulsExtra(uint32_t src) {
+  uint32_t bits = (src & 0xFFFF) << 1;
+  uint32_t flips = (bits ^ (bits >> 1)) & 0xFFFF;
+  int n = 0;
+  for (; flips; flips &= flips - 1) ++n;
+  return 2 * n;
+}
+
+// ============================================================================
+// Read the .X68 file at 'path', and any file it INCLUDEs, and assemble it
+// ============================================================================
+Asm* asmFile(char* path) {
+  Asm* as = calloc(1, sizeof(Asm));
+  if (!as) utDie2Str("asmFile", "Out of memory");
+  as->arena  = arenaNew(0);
+  as->cap    = ASMMINCAP;
+  as->code   = malloc(as->cap * sizeof(AsmIns));
+  as->capFun = ASMMINCAP;
+  as->fun    = calloc(as->capFun, sizeof(AsmFun));
+  if (!as->code || !as->fun) utDie2Str("asmFile", "Out of memory");
+  as->numFun = 1;                                         // fun[0]: before any label
+  as->fun[0].entry = -1;
+
+  asmRead(as, path, 0);
+  asmPath = path;
+  asmAddIns(as, ASMEXIT, 0);                              // where main returns to
+
+  int startSym = as->startSym ? as->startSym : intern("main");
+  asmGrowSym(as, startSym);
+  if (as->symKind[startSym] != ASMSYMCODE) {
+    utDie3Str("asmFile", "No code at start label", internStr(startSym));
+  }
+  as->start = as->symVal[startSym];
+
+  for (int i = 0; i < as->num; ++i) {                     // branch targets
+    AsmIns* ins = &as->code[i];
+    if (!asmIsJump(ins->op)) continue;
+    int sym = ins->src.sym;
+    if (sym >= as->numSym || as->symKind[sym] != ASMSYMCODE) {
+      asmLineNum = ins->line;
+      asmDie("Not a code label:", internStr(sym));
+    }
+    ins->target = as->symVal[sym];
+  }
+
+  for (int i = 0; i < as->num; ++i) as->code[i].len = (uint8_t) asmLength(&as->code[i]);
+  while (asmPlace(as)) {}                                 // until no branch grows
+
+  for (int i = 0; i < as->num; ++i) {
+    AsmIns* ins = &as->code[i];
+    asmResolve(as, ins, &ins->src);
+    asmResolve(as, ins, &ins->dst);
+    asmTime(ins);
+  }
+
+  as->mem = calloc(ASMMEMSIZE, 1);
+  as->at  = malloc((as->hiAddr / 2 + 1) * sizeof(int));
+  if (!as->mem || !as->at) utDie2Str("asmFile", "Out of memory");
+  for (int d = 0; d < as->numData; ++d) {
+    if (as->data[d].len) memcpy(as->mem + as->data[d].addr, as->data[d].bytes, as->data[d].len);
+  }
+  memset(as->at, -1, (as->hiAddr / 2 + 1) * sizeof(int));
+  for (int i = 0; i < as->num; ++i) as->at[as->code[i].addr / 2] = i;
+
+  return as;
+}
+
+// ============================================================================
+// The index in code[] of the instruction at address 'addr' (-1 => none)
+// ============================================================================
+int asmAt(Asm* as, uint32_t addr) {
+  if ((addr & 1) || addr >= as->hiAddr) return -1;
+  return as->at[addr / 2];
+}
+
+// ============================================================================
+// Free 'as', and all it holds
+// ============================================================================
+void asmFree(Asm* as) {
+  arenaFree(as->arena);
+  free(as->code);
+  free(as->fun);
+  free(as->data);
+  free(as->symKind);
+  free(as->symVal);
+  free(as->mem);
+  free(as->at);
+  free(as);
+}
@@ -0,0 +1,145 @@
+// asm.h - Assemble 68000 text for the simulator
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint8_t, uint32_t
+#include <stdio.h>          // fopen, sprintf
+#include <stdlib.h>         // calloc, malloc, realloc, free
+#include <string.h>         // memcpy, strchr, strcmp, strlen
+
+#include "arena.h"          // Arena
+#include "intern.h"         // internN, internStr
+#include "ut.h"             // ut*
+
+// asmFile reads a .X68 file, as emitted by the compiler - along with any file
+// it INCLUDEs, such as Tests\io.X68 - and assembles it into an Asm, ready for
+// sim.c to run.  It accepts the subset of Easy68K syntax that the compiler
+// and io.X68 use: one instruction, or DC.B, per line; a label in column 1
+// (with or without a colon); local labels, that start with '.', scoped by the
+// label before them; and the directives ORG, INCLUDE and END.
+//
+// Each instruction is decoded once, into an AsmIns: opcode, size, operands,
+// branch target (as an index into code[]) and its fixed cost in cycles, from
+// the 68000 timing tables.  The simulator never looks at text again.
+//
+// Instructions and DC.B data are laid out at the addresses the real assembler
+// would give them.  Each Bcc, BRA and BSR is short (2 bytes) when its target
+// lies within -128..127 bytes, and word (4 bytes) otherwise: layout repeats
+// until no branch need grow.  Only the data is copied into memory: code is
+// run from code[], and a return address is mapped back to its instruction by
+// asmAt.  ORG never moves the location counter backwards, so that the
+// compiler's string literals, which precede io.X68's "ORG $100", are not
+// overlaid by the code or data that follow.
+//
+// Where the assembler would pick a different form of an instruction, so does
+// asmFile: ADD into An is ADDA, ADD of an immediate is ADDI, MOVE into An is
+// MOVEA, and likewise for SUB and CMP.
+
+#define ASMMEMSIZE  0x1000000       // 16 MB: the 68000's 24-bit address space
+#define ASMMINCAP   256             // initial number of slots in each array
+#define ASMMAXPATH  1024            // longest INCLUDE path, once resolved
+#define ASMMAXPEND  16              // labels that may share one address
+
+typedef enum {
+  ASMSYMNONE = 0,                   // not (yet) defined
+  ASMSYMCODE,                       // labels an instruction
+  ASMSYMDATA,                       // labels a DC.B
+} ASMSYM;
+
+typedef enum {
+  ASMNOP = 0,
+  ASMADD, ASMADDA, ASMADDI, ASMADDQ, ASMASL, ASMBCC, ASMBCS, ASMBEQ, ASMBGE,
+  ASMBGT, ASMBHI, ASMBLE, ASMBLS, ASMBLT, ASMBMI, ASMBNE, ASMBPL, ASMBRA,
+  ASMBSR, ASMBVC, ASMBVS, ASMCLR, ASMCMP, ASMCMPA, ASMCMPI, ASMEXT, ASMJMP,
+  ASMJSR, ASMLEA, ASMLINK, ASMLSL, ASMMOVE, ASMMOVEA, ASMMOVEM, ASMMOVEQ,
+  ASMMULS, ASMNEG, ASMPEA, ASMRTS, ASMSIMHALT, ASMSUB, ASMSUBA, ASMSUBI,
+  ASMSUBQ, ASMTRAP, ASMTST, ASMUNLK,
+  ASMEXIT,                          // not in the text: main returned
+  ASMNUMOP
+} ASMOP;
+
+typedef enum {
+  ASMOPNONE = 0,                    // operand absent
+  ASMOPDREG,                        // Dn             reg = n
+  ASMOPAREG,                        // An             reg = n
+  ASMOPIND,                         // (An)
+  ASMOPPOSTINC,                     // (An)+
+  ASMOPPREDEC,                      // -(An)
+  ASMOPDISP,                        // (d,An) or d(An)  val = d
+  ASMOPABS,                         // address        val = address
+  ASMOPIMM,                         // #val
+  ASMOPREGS,                        // MOVEM list     val = mask (bit n => Dn, bit 8+n => An)
+} ASMOPKIND;
+
+typedef struct {
+  uint8_t kind;                     // ASMOPKIND
+  uint8_t reg;                      // register number, for the An and Dn kinds
+  int     sym;                      // intern ID of a label still to resolve (0 => none)
+  int     val;                      // displacement, address, immediate or mask
+} AsmOpnd;
+
+typedef struct {
+  uint8_t  op;                      // ASMOP
+  uint8_t  sz;                      // operand size in bytes: 1, 2 or 4
+  uint8_t  len;                     // bytes of machine code
+  uint8_t  isShort;                 // Bcc, BRA, BSR: 8-bit displacement
+  int      fun;                     // index in Asm.fun of the enclosing function
+  int      cycles;                  // fixed cost; a Bcc's cost if not taken
+  int      taken;                   // Bcc: cost if taken
+  int      target;                  // branch target, as an index in code[] (-1 => none)
+  int      line;                    // line number in its file, for errors
+  uint32_t addr;                    // address
+  AsmOpnd  src;
+  AsmOpnd  dst;
+  void*    go;                      // sim.c: handler, for threaded dispatch
+} AsmIns;
+
+typedef struct {
+  int      name;                    // intern ID
+  int      entry;                   // index in code[] of its first instruction
+} AsmFun;
+
+typedef struct {
+  int      before;                  // number of instructions that precede it
+  int      len;                     // bytes (0 => an ORG)
+  uint32_t org;                     // ORG: lowest address for what follows
+  uint32_t addr;                    // address, once laid out
+  uint8_t* bytes;
+} AsmData;
+
+typedef struct {
+  Arena*   arena;                   // DC.B bytes
+  int      num;                     // instructions in use
+  int      cap;                     // slots in code[]
+  AsmIns*  code;
+
+  int      numFun;                  // functions in use; fun[0] is code before any label
+  int      capFun;                  // slots in fun[]
+  AsmFun*  fun;
+
+  int      numData;                 // DC.B and ORG items in use
+  int      capData;                 // slots in data[]
+  AsmData* data;
+
+  int      numSym;                  // slots in symKind[] and symVal[]
+  uint8_t* symKind;                 // intern ID => ASMSYM*
+  int*     symVal;                  // intern ID => index in code[] or data[]
+
+  int      numPend;                 // labels waiting for the next instruction or DC.B
+  int      pend[ASMMAXPEND];        // their intern IDs
+  int      scope;                   // intern ID of the last non-local label
+
+  uint8_t* mem;                     // ASMMEMSIZE bytes, with the data in place
+  int*     at;                      // address/2 => index in code[] (-1 => none)
+  uint32_t hiAddr;                  // address just past the last instruction
+  int      start;                   // index in code[] of the END label (eg: main)
+  int      startSym;                // intern ID of the END label (0 => "main")
+} Asm;
+
+int   asmAt(Asm* as, uint32_t addr);
+int   asmCost(AsmIns* ins);
+Asm*  asmFile(char* path);
+void  asmFree(Asm* as);
+int   asmMulsExtra(uint32_t src);
+char* asmOpName(ASMOP op);
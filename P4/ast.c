@@ -2,6 +2,8 @@
 
 #include "ast.h"
 
+static Arena* astArena = NULL;    // owner of every AST node (see astUseArena)
+
 // ============================================================================
 // 'astarg' is the head of the list of arguments in the call made to some
 // function.  This function counts how many arguments are in the list.
@@ -66,115 +68,151 @@ AstArg* astFindArg(AstArg* astarg, int argnum) {
 
 // ============================================================================
 // Search the program AST rooted at 'prog' looking for the function
-// called 'nam'.  If not found, return NULL
+// whose name has intern ID 'funid'.  If not found, return NULL
 // ============================================================================
-AstFun* astFindFun(AstProg* prog, char* lex) {
+AstFun* astFindFun(AstProg* prog, int funid) {
   assert(prog->kind == ASTPROG);
   AstFun* fun = prog->funs;
   while (fun) {
-    if (strcmp(fun->nam->lex, lex) == 0) return fun;
+    if (fun->nam->id == funid) return fun;
     fun = (AstFun*) fun->next;
   }
   return NULL;
 }
 
+// ============================================================================
+// Allocate 'size' bytes, zero-filled, for a new AST node, from the Arena of
+// the current compilation
+// ============================================================================
+static void* astAlloc(size_t size) {
+  assert(astArena);
+  return arenaAlloc(astArena, size);
+}
+
+// ============================================================================
+// Allocate all subsequent AST nodes, and the text of string literals, from
+// 'arena'.  The whole tree is then released, in one call, by arenaFree.
+// ============================================================================
+void astUseArena(Arena* arena) { astArena = arena; }
+
 AstArg* astNewArg(Ast* nns) {
-  AstArg* a = calloc(sizeof(AstArg), 1);
+  AstArg* a = astAlloc(sizeof(AstArg));
   a->kind = ASTARG;
   a->nns = nns;     // Nam, Num or Str
   return a;
 }
 
 AstAsg* astNewAsg(AstNam* nam, Ast* eoc) {
-  AstAsg* a = calloc(sizeof(AstAsg), 1);
+  AstAsg* a = astAlloc(sizeof(AstAsg));
   a->kind = ASTASG; a->nam = nam; a->eoc = eoc;
   return a;
 }
 
 AstBlock* astNewBlock(AstStm* stms) {
-  AstBlock* a = calloc(sizeof(AstBlock), 1);
+  AstBlock* a = astAlloc(sizeof(AstBlock));
   a->kind = ASTBLOCK; a->stms = stms;
   return a;
 }
 
 AstBody* astNewBody(AstVar* vars, AstStm* stms) {
-  AstBody* a = calloc(sizeof(AstBody), 1);
+  AstBody* a = astAlloc(sizeof(AstBody));
   a->kind = ASTBODY; a->vars = vars; a->stms = stms;
   return a;
 }
 
 AstCall* astNewCall(AstNam* nam, AstArg* args) {
-  AstCall* a = calloc(sizeof(AstCall), 1);
+  AstCall* a = astAlloc(sizeof(AstCall));
   a->kind = ASTCALL; a->nam = nam; a->args = args;
   return a;
 }
 
 AstExp* astNewExp(Ast* lhs, BOP bop, Ast* rhs) {
-  AstExp* a = calloc(sizeof(AstExp), 1);
+  AstExp* a = astAlloc(sizeof(AstExp));
   a->kind = ASTEXP; a->lhs = lhs; a->bop = bop; a->rhs = rhs;
   return a;
 }
 
 AstFun* astNewFun(AstNam* nam, AstPar* pars, AstBody* body) {
-  AstFun* a = calloc(sizeof(AstFun), 1);
+  AstFun* a = astAlloc(sizeof(AstFun));
   a->kind = ASTFUN; a->nam = nam; a->pars = pars; a->body = body;
   return a;
 }
 
 AstIf* astNewIf(AstExp* exp, AstBlock* block) {
-  AstIf* a = calloc(sizeof(AstIf), 1);
+  AstIf* a = astAlloc(sizeof(AstIf));
   a->kind = ASTIF; a->exp = exp; a->block = block;
   return a;
 }
 
-AstNam* astNewNam(char* lex) {
-  AstNam* a = calloc(sizeof(AstNam), 1);
-  a->kind = ASTNAM; a->lex = lex;
+AstNam* astNewNam(int id) {
+  AstNam* a = astAlloc(sizeof(AstNam));
+  a->kind = ASTNAM; a->id = id; a->lex = internStr(id); a->slot = -1;
   return a;
 }
 
 AstNum* astNewNum(int val) {
-  AstNum* a = calloc(sizeof(AstNum), 1);
+  AstNum* a = astAlloc(sizeof(AstNum));
   a->kind = ASTNUM; a->val = val;
   return a;
 }
 
 AstPar* astNewPar(AstNam* nam) {
-  AstPar* a = calloc(sizeof(AstPar), 1);
+  AstPar* a = astAlloc(sizeof(AstPar));
   a->kind = ASTPAR; a->next = 0; a->nam = nam;
   return a;
 }
 
 AstProg* astNewProg(AstFun* funs) {
-  AstProg* a = calloc(sizeof(AstProg), 1);
+  AstProg* a = astAlloc(sizeof(AstProg));
   a->kind = ASTPROG; a->funs = funs;
   return a;
 }
 
 AstRet* astNewRet(AstExp* exp) {
-  AstRet* a = calloc(sizeof(AstRet), 1);
+  AstRet* a = astAlloc(sizeof(AstRet));
   a->kind = ASTRET; a->exp = exp;
   return a;
 }
 
-AstStr* astNewStr(char* txt) {
-  AstStr* a = calloc(sizeof(AstStr), 1);
-  a->kind = ASTSTR; a->txt = txt;
+AstStr* astNewStr(char* s, int len) {
+  AstStr* a = astAlloc(sizeof(AstStr));
+  a->kind = ASTSTR; a->txt = arenaStrndup(astArena, s, len);
   return a;
 }
 
 AstVar* astNewVar(AstNam* nam) {
-  AstVar* a = calloc(sizeof(AstVar), 1);
+  AstVar* a = astAlloc(sizeof(AstVar));
   a->kind = ASTVAR; a->next = 0; a->nam = nam;
   return a;
 }
 
 AstWhile* astNewWhile(AstExp* exp, AstBlock* block) {
-  AstWhile* a = calloc(sizeof(AstWhile), 1);
+  AstWhile* a = astAlloc(sizeof(AstWhile));
   a->kind = ASTWHILE; a->exp = exp; a->block = block;
   return a;
 }
 
+char* astASTtoStr(AST kind) {
+  switch(kind) {
+    case ASTARG:   return "ASTARG";
+    case ASTASG:   return "ASTASG";
+    case ASTBLOCK: return "ASTBLOCK";
+    case ASTBODY:  return "ASTBODY";
+    case ASTCALL:  return "ASTCALL";
+    case ASTEXP:   return "ASTEXP";
+    case ASTFUN:   return "ASTFUN";
+    case ASTIF:    return "ASTIF";
+    case ASTNAM:   return "ASTNAM";
+    case ASTNUM:   return "ASTNUM";
+    case ASTPAR:   return "ASTPAR";
+    case ASTPROG:  return "ASTPROG";
+    case ASTRET:   return "ASTRET";
+    case ASTSTR:   return "ASTSTR";
+    case ASTVAR:   return "ASTVAR";
+    case ASTWHILE: return "ASTWHILE";
+    default:       return "ASTBAD";
+  }
+}
 
 char* astBOPtoStr(BOP bop) {
   switch(bop) {
@@ -5,9 +5,10 @@
 #include <assert.h>         // assert
 #include <ctype.h>          // isspace, isalpha, isdigit, isalnum
 #include <stdio.h>          // printf
-#include <stdlib.h>         // calloc
 #include <string.h>         // strncpy
 
+#include "arena.h"          // Arena
+#include "intern.h"         // intern
 #include "tok.h"            // TokKind
 #include "toks.h"           // Toks
 #include "ut.h"             // ut*
@@ -36,6 +37,11 @@ typedef enum {
   ASTASG = 1, ASTARG, ASTBLOCK, ASTBODY, ASTCALL, ASTEXP, ASTFUN, ASTIF,
   ASTNAM, ASTNUM, ASTPAR, ASTPROG, ASTRET, ASTSTR, ASTVAR, ASTWHILE
 } AST;
+char* astASTtoStr(AST kind);
+
+// Every AST node, along with the text of every string literal, is allocated
+// from the Arena of the current compilation (see astUseArena), and is never
+// freed individually.
 
 // ============================================================================
 // Common 'super' struct for all ASTs
@@ -150,9 +156,11 @@ AstIf* astNewIf(AstExp* exp, AstBlock* block);
 typedef struct AstNam_ {
   AST   kind;               // ASTNAM
   Ast*  next;
-  char* lex;                // lexeme
+  int   id;                 // intern ID
+  char* lex;                // lexeme (the interned string for 'id')
+  int   slot;               // interp.c: frame slot of a par or var; or index of a callee
 } AstNam;
-AstNam* astNewNam(char* lex);
+AstNam* astNewNam(int id);
 
 // ============================================================================
 // An AST node that represent a simple, literal integer.  Eg: 42
@@ -212,7 +220,7 @@ typedef struct AstStr_ {
   Ast*  next;
   char* txt;
 } AstStr;
-AstStr* astNewStr(char* txt);
+AstStr* astNewStr(char* s, int len);
 
 // ============================================================================
 // Var => "int" Nam ";"
@@ -239,4 +247,5 @@ int astCountArgs(AstArg* astarg);
 int astCountPars(AstPar* astpar);
 int astCountVars(AstVar* astvar);
 AstArg* astFindArg(AstArg* astarg, int argnum);
-AstFun* astFindFunIdx(AstProg* astProg, char* funnam);
+AstFun* astFindFun(AstProg* astProg, int funid);
+void    astUseArena(Arena* arena);
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Parser scaling benchmark
+#
+# Generates SubC programs whose main function holds 10^3, 10^4, 10^5 and
+# 10^6 statements, and times how long subc takes to lex and parse each one.
+# Parse time should grow linearly: about 10x per row.
+#
+# Usage: bash bench.sh          (run from the P4 folder)
+
+. ./build.sh
+build subc-bench || exit 1
+
+for n in 1000 10000 100000 1000000; do
+  f=bench$n.subc
+  awk -v n=$n 'BEGIN {
+    print "int main() {"
+    print "  int x; int y;"
+    print "  x = 0; y = 1;"
+    for (i = 0; i < n; i += 2) {
+      print "  x = x + y;"
+      print "  y = x - 1;"
+    }
+    print "  return x;"
+    print "}"
+  }' > $f
+  printf "%8d statements: " $n
+  ./subc-bench -parse -time $f < /dev/null | grep "Time:"
+  rm -f $f
+done
+
+rm -f subc-bench
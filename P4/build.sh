@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Build step shared by the check and benchmark scripts
+#
+# Sourced, from the P4 folder, by bench.sh, difftest.sh, lexbench.sh,
+# iselcheck.sh and vmtest.sh, so that the compiler and its flags are named
+# here alone.
+#
+#   build <exe>                     subc, from every .c file in P4
+#   build <exe> <main.c>            the same, with <main.c> in place of
+#                                   main.c - eg: check/iselcheck.c
+#   build <exe> <main.c> <dir>      the same, from the .c files in <dir>
+#
+# Set CC or CFLAGS to override the defaults.
+
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2}
+
+build() {
+  local exe=$1 driver=$2 dir=${3:-.}
+  local srcs=$(ls $dir/*.c)
+  if [ -n "$driver" ]; then srcs="$(echo "$srcs" | grep -v '/main\.c$') $driver"; fi
+  $CC $CFLAGS -I$dir $srcs -o $exe -lm
+}
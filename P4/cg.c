@@ -2,6 +2,51 @@
 
 #include "cg.h"
 
+// ============================================================================
+// Args => ( Arg ( "," Arg )* ) ?
+// Arg  => Nam | Num | Str
+//
+// Emit code to push the arguments of the Call at node 'call', right to left,
+// so that argument #1 ends up on top of the stack.  "funid" is the intern ID
+// of the current function, whose pars and vars the arguments may name.
+// ============================================================================
+void cgArgs(Cg* cg, int funid, int call) {
+  Lay* lay = cg->lay;                                     // alias
+  FlatNode* node = cg->flat->node;                        // alias
+  IrOpnd push = irOpPush();
+
+  // Each argument is a leaf, so argument 'argnum' is node call + argnum
+
+  int numarg = node[call].end - call - 1;                 // eg: 2
+
+  for (int argnum = numarg; argnum >= 1; --argnum) {
+    FlatNode* arg = &node[call + argnum];
+    assert(arg->end == (uint32_t) (call + argnum + 1));
+
+    // What kind of argument is this?  Nam, Num or Str?
+
+    if (arg->tag == ASTNAM) {                               // var|par
+      LaySym* sym = layFindVarPar(lay, funid, arg->val);    // eg: "main", "my"
+
+      IrOpnd src = sym->reg
+        ? irOpD(sym->reg)                                   // eg: MOVE.L D3,-(A7)
+        : irOpFrame(sym->off);                              // eg: MOVE.L (-12,A6),-(A7)
+      irAdd(cg->ir, IRMOVE, IRSZL, src, push);
+
+    } else if (arg->tag == ASTNUM) {                        // literal number
+      int val = arg->val;                                   // eg: 42
+      irAdd(cg->ir, IRMOVE, IRSZL, irOpImm(val), push);     // eg: MOVE.L #42,-(A7)
+    } else if (arg->tag == ASTSTR) {                        // literal string
+      int datalabel = cgLabel();
+      char* txt = cg->flat->str[arg->val];
+      emitDataString(cg->emit, datalabel, txt);             // eg: L50: DC.B 'hi',0
+
+      irAdd(cg->ir, IRLEA, IRSZNONE, irOpData(datalabel), irOpA(0));
+      irAdd(cg->ir, IRMOVE, IRSZL, irOpA(0), push);
+    }
+  }
+}
+
 // ============================================================================
 // Asg        => Nam "=" (Exp | Call) ";"
 // NamNum     => Nam | Num
@@ -19,39 +64,19 @@
 // In the above code, "@a" represents the offset, in bytes, of argument "a"
 // from its Frame Pointer (FP = A6)
 //
-// Generate code to copy the value in D0 to the variable called 'varnam'.
-// For example, to compile: "mx = 2" we will have moved #2 into D0.  Then
-// cgAsg will copy the value in D0 into the variable called 'varnam' that is
-// defined in the function called 'funnam'
-// ============================================================================
-void cgAsg(Cg* cg, char* funnam, char* varnam) {
-  char line[LINESIZE];
-
-  int varidx = layFindVarParIdx(cg->lay, funnam, varnam);
-  assert (varidx != 0);
-
-  int varoff = cg->lay->row[varidx].off;
-
-  sprintf(line, "\t %s \t %s%d%s", "MOVE.L", "D0, (", varoff, ",A6)");
-  emitCode(cg->emit, line);
-}
-
-// ============================================================================
-// Block => "{" Stm+ "}"
-// ============================================================================
-void cgBlock(Cg* cg, char* funnam, AstBlock* astblock) {
-  AstStm* aststm = astblock->stms;
-  while(aststm) {
-    cgStm(cg, funnam, aststm);
-    aststm = (AstStm*)aststm->next;
-  }
-}
-
-// ============================================================================
-// Body => "{" Var* Stm+ "}"
-// ============================================================================
-void cgBody(Cg* cg, char* funnam, AstBody* astbody) {
-  cgStms(cg, funnam, astbody->stms);
+// If "first" has been allocated a register, say D3, then the first push
+// becomes "MOVE.L D3, -(A7)" instead.
+//
+// Generate code to copy the value in D0 to the variable whose intern ID is
+// 'varid'.  For example, to compile: "mx = 2" we will have moved #2 into D0.
+// Then cgAsg will copy the value in D0 into the variable 'varid' that is
+// defined in the function whose intern ID is 'funid' - either its register,
+// or its slot in the stack frame
+// ============================================================================
+void cgAsg(Cg* cg, int funid, int varid) {
+  LaySym* var = layFindVarPar(cg->lay, funid, varid);
+  IrOpnd  dst = var->reg ? irOpD(var->reg) : irOpFrame(var->off);
+  irAdd(cg->ir, IRMOVE, IRSZL, irOpD(0), dst);
 }
 
 // ============================================================================
@@ -77,49 +102,33 @@ void cgBody(Cg* cg, char* funnam, AstBody* astbody) {
 //
 // ============================================================================
 void cgBop(Cg* cg, BOP bop) {
-  char line[LINESIZE];
+  IrOpnd d0 = irOpD(0);
+  IrOpnd d1 = irOpD(1);
 
   // First process Arithmetic operators
 
   if (bop == BOPADD) {
-    sprintf(line, "\t %s \t %s", "ADD.L", "D1, D0");
-    emitCode(cg->emit, line);
+    irAdd(cg->ir, IRADD, IRSZL, d1, d0);
     return;
   } else if (bop == BOPMUL) {
-    sprintf(line, "\t %s \t %s", "MULS", "D1, D0");
-    emitCode(cg->emit, line);
+    irAdd(cg->ir, IRMULS, IRSZNONE, d1, d0);
     return;
   } else if (bop == BOPSUB) {
-    sprintf(line, "\t %s \t %s", "SUB.L", "D1, D0");
-    emitCode(cg->emit, line);
+    irAdd(cg->ir, IRSUB, IRSZL, d1, d0);
     return;
   }
 
   // Now process the Boolean operators.
 
-  sprintf(line, "\t %s \t %s", "CMP.L", "D1, D0");
-  emitCode(cg->emit, line);
-
-  if (bop == BOPLT) {
-    cgBranch(cg, "BLT");
-  } else if (bop == BOPLE) {
-    cgBranch(cg, "BLE");
-  } else if (bop == BOPEEQ) {
-    cgBranch(cg, "BEQ");
-  } else if (bop == BOPNE) {
-    cgBranch(cg, "BNE");
-  } else if (bop == BOPGE) {
-    cgBranch(cg, "BGE");
-  } else if (bop == BOPGT) {
-    cgBranch(cg, "BGT");
-  }
+  irAdd(cg->ir, IRCMP, IRSZL, d1, d0);
+  cgBranch(cg, cgBranchOp(bop));
 
 }
 
 // ============================================================================
 // Generate a conditional branch.
 //
-// 'cond' is a conditional branch instruction such as "BNE" or "BGT".
+// 'cond' is a conditional branch instruction such as IRBNE or IRBGT.
 //
 // 'bop' is a comparison operator (< <= == != >= >).  Make D0 hold 1 for
 // TRUE and 0 for FALSE.  For example, "BLE" generates:
@@ -130,28 +139,38 @@ void cgBop(Cg* cg, BOP bop) {
 //  L10:  MOVE.L  #1, D0
 //  L20:
 // ============================================================================
-void cgBranch(Cg* cg, char* cond) {
-  char line[LINESIZE];
+void cgBranch(Cg* cg, IROP cond) {
+  IrOpnd none = irOpNone();
+  IrOpnd d0   = irOpD(0);
 
-  char* truelabel = cgLabel();
-  sprintf(line, "\t %s \t %s", cond, truelabel);      // eg: L10
-  emitCode(cg->emit, line);
+  int truelabel = cgLabel();                              // eg: L10
+  irAdd(cg->ir, cond, IRSZNONE, irOpLab(truelabel), none);
 
-  sprintf(line, "\t %s \t %s", "CLR.L", "D0");        // FALSE
-  emitCode(cg->emit, line);
+  irAdd(cg->ir, IRCLR, IRSZL, none, d0);                  // FALSE
 
-  char* exitlabel = cgLabel();                        // eg: L20
-  sprintf(line, "\t %s \t %s", "BRA", exitlabel);
-  emitCode(cg->emit, line);
+  int exitlabel = cgLabel();                              // eg: L20
+  irAdd(cg->ir, IRBRA, IRSZNONE, irOpLab(exitlabel), none);
 
-  sprintf(line, "%s:", truelabel);                    // eg: L10:
-  emitCode(cg->emit, line);
+  irAddBlock(cg->ir, truelabel);                          // eg: L10:
+  irAdd(cg->ir, IRMOVE, IRSZL, irOpImm(1), d0);           // TRUE
 
-  sprintf(line, "\t %s \t %s", "MOVE.L", "#1, D0");   // TRUE
-  emitCode(cg->emit, line);
+  irAddBlock(cg->ir, exitlabel);                          // eg: L20:
+}
 
-  sprintf(line, "%s:", exitlabel);                    // eg: L20
-  emitCode(cg->emit, line);
+// ============================================================================
+// The conditional branch taken when relational operator 'bop' holds, after
+// "CMP.L D1, D0".  Eg: BOPLT => IRBLT.  Return IRNOP for any other 'bop'.
+// ============================================================================
+IROP cgBranchOp(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return IRBLT;
+    case BOPLE:  return IRBLE;
+    case BOPEEQ: return IRBEQ;
+    case BOPNE:  return IRBNE;
+    case BOPGE:  return IRBGE;
+    case BOPGT:  return IRBGT;
+    default:     return IRNOP;
+  }
 }
 
 // ============================================================================
@@ -176,61 +195,17 @@ void cgBranch(Cg* cg, char* cond) {
 // of function "add2".  This version of the SubC compiler does NOT include
 // any check for this.
 //
-// "funnam" is the name of the current function - the one that emits the BSR.
+// "funid" is the intern ID of the current function - the one that emits the
+// BSR.
 // ============================================================================
-void cgCall(Cg* cg, char* funnam, AstCall* astcall) {
-  char line[LINESIZE];
-  Lay* lay = cg->lay;                                     // alias
-
-  char* callee = astcall->nam->lex;                       // eg: "add2"
-
-  int numarg = astCountArgs(astcall->args);               // eg: 2
-
-  for (int argnum = numarg; argnum >= 1; --argnum) {
-    AstArg* astarg = astFindArg(astcall->args, argnum);
-    assert(astarg);
-
-    // What kind of argument is this?  Nam, Num or Str?
-
-    if (astarg->nns->kind == ASTNAM) {                      // var|par
-      AstNam* astnam = (AstNam*) astarg->nns;
-      char* lex = astnam->lex;                              // eg: "my"
-
-      int argidx = layFindVarParIdx(lay, funnam, lex);      // eg: "main", "my"
-      assert (argidx != 0);
-
-      int argoff = lay->row[argidx].off;
+void cgCall(Cg* cg, int funid, int call) {
+  FlatNode* node = cg->flat->node;                        // alias
 
-      sprintf(line, "\t %s \t %s%d%s%s",
-        "MOVE.L", "(", argoff, ",A6)", ", -(A7)");          // eg: MOVE.L (-12,A6),-(A7)
-      emitCode(cg->emit, line);
+  int numarg = node[call].end - call - 1;                 // eg: 2
 
-    } else if (astarg->nns->kind == ASTNUM) {               // literal number
-      AstNum* num = (AstNum*) astarg->nns;
-      int val = num->val;                                   // eg: 42
-      sprintf(line, "\t %s \t %s%d%s",
-        "MOVE.L", "#", val, ", -(A7)");                     // eg: MOVE.L #42,-(A7)
-      emitCode(cg->emit, line);
-    } else if (astarg->nns->kind == ASTSTR) {               // literal string
-      char* datalabel = cgLabel();
-      sprintf(line, "%s:", datalabel);                      // eg: L50:
-      emitData(cg->emit, line);
+  cgArgs(cg, funid, call);                                // push, right to left
 
-      AstStr* str = (AstStr*) astarg->nns;
-      char*   txt = str->txt;
-      sprintf(line, "\t %s \t '%s',0", "DC.B", txt);
-      emitData(cg->emit, line);
-
-      sprintf(line, "\t %s \t %s%s", "LEA", datalabel, ", A0");
-      emitCode(cg->emit, line);
-
-      sprintf(line, "\t %s \t %s%s", "MOVE.L", "A0, ", "-(A7)");
-      emitCode(cg->emit, line);
-    }
-  }
-
-  sprintf(line, "\t %s \t%s", "BSR", callee);             // eg: "BSR add2"
-  emitCode(cg->emit, line);
+  irAdd(cg->ir, IRBSR, IRSZNONE, irOpFun(node[call].val), irOpNone()); // eg: "BSR add2"
 
   // Remember to remove the arguments previously pushed onto the stack.
   // Because each stack slot in 68000 is a Longword, the number of bytes
@@ -238,43 +213,80 @@ void cgCall(Cg* cg, char* funnam, AstCall* astcall) {
 
   int numb = 4 * numarg;
 
-  sprintf(line, "\t %s \t#%d%s", "ADD.L", numb, ", A7");
-  emitCode(cg->emit, line);
+  irAdd(cg->ir, IRADD, IRSZL, irOpImm(numb), irOpA(7));
 
 }
 
 // ============================================================================
-// Generate the Epilog for the function called 'funnam'
+// Generate code to evaluate the condition 'exp' of an If or While, and to
+// branch to 'label' if its truth matches 'jumpif' (0 => branch if FALSE, 1 =>
+// branch if TRUE).  A comparison, such as "a < b", compiles straight into a
+// compare and a branch.  With 'jumpif' = 0, the branch is the inverse:
+//
+//    MOVE.L  (@a,A6), D0
+//    MOVE.L  (@b,A6), D1
+//    CMP.L   D1, D0
+//    BGE     label
+//
+// so its 0/1 value is never materialized in D0.  A condition that foldProg
+// has reduced to a Num needs no test at all - eg: "while (1)" - just a BRA,
+// or nothing.  Any other expression is evaluated into D0 and tested against
+// 0.
 // ============================================================================
-void cgEpilog(Cg* cg, char* funnam) {
+void cgCond(Cg* cg, int funid, int exp, int label, int jumpif) {
+  FlatNode* node = cg->flat->node;                  // alias
+  IROP cond = cgBranchOp(node[exp].bop);
 
-  Emit* emit = cg->emit;                // alias
+  int lhs = exp + 1;
+  int rhs = lhs < (int) node[exp].end ? (int) node[lhs].end : lhs;
 
-  char line[LINESIZE];
+  if (rhs == (int) node[exp].end && node[lhs].tag == ASTNUM) {
+    if ((node[lhs].val != 0) == jumpif) {
+      irAdd(cg->ir, IRBRA, IRSZNONE, irOpLab(label), irOpNone());
+    }
+    return;
+  }
 
-  // Remove the stack space previously reserved for local variables
+  if (cond == IRNOP || rhs == (int) node[exp].end) {
+    cgExp(cg, funid, exp);                          // result in D0
+    irAdd(cg->ir, IRCMPI, IRSZL, irOpImm(0), irOpD(0));
+    irAdd(cg->ir, jumpif ? IRBNE : IRBEQ, IRSZNONE, irOpLab(label), irOpNone());
+    return;
+  }
+
+  cgNamNum(cg, funid, lhs, irOpD(0));
+  cgNamNum(cg, funid, rhs, irOpD(1));
+  irAdd(cg->ir, IRCMP, IRSZL, irOpD(1), irOpD(0));
+  if (!jumpif) cond = irInverse(cond);
+  irAdd(cg->ir, cond, IRSZNONE, irOpLab(label), irOpNone());
+}
 
-  sprintf(line, "\t %s \t %s", "MOVEA.L", "A6, A7");
-  emitCode(emit, line);
+// ============================================================================
+// Generate the Epilog for the function whose intern ID is 'funid'.  For
+// example, if the function keeps variables in D2, D3 and D5:
+//
+//    MOVEM.L (A7)+, D2-D3/D5     ; restore callee-saved registers
+//    UNLK    A6                  ; SP = FP; pop old FP
+//    RTS
+// ============================================================================
+void cgEpilog(Cg* cg, int funid) {
+  IrOpnd none = irOpNone();
 
-  // Restore the old Frame Pointer (FP = A6)
+  // Restore the registers saved by the Prolog
 
-  sprintf(line, "\t %s \t %s", "MOVEA.L", "(A6), A6");
-  emitCode(emit, line);
+  if (cg->regs) irAdd(cg->ir, IRMOVEM, IRSZL, irOpPop(), irOpRegs(cg->regs));
 
-  // Point SP at return-address
+  // Remove the stack space reserved for local variables, and restore the
+  // caller's Frame Pointer (FP = A6).  SP now points at the return-address
 
-  sprintf(line, "\t %s \t %s", "ADDA.L", "#4, A7");
-  emitCode(emit, line);
+  irAdd(cg->ir, IRUNLK, IRSZNONE, irOpA(6), none);
 
   // Emit the RTS or SIMHALT instruction
 
-  if (strcmp(funnam, "main") == 0) {
-    sprintf(line, "\t %s", "SIMHALT");
-    emitCode(emit, line);
+  if (funid == INTMAIN) {
+    irAdd(cg->ir, IRSIMHALT, IRSZNONE, none, none);
   } else {
-    sprintf(line, "\t %s", "RTS");
-    emitCode(emit, line);
+    irAdd(cg->ir, IRRTS, IRSZNONE, none, none);
   }
 
 }
@@ -288,31 +300,30 @@ void cgEpilog(Cg* cg, char* funnam) {
 //   MOVE.L #7, D1
 //   SUB.L  D1, D0
 //
-// 'funnam' is the name of the function in which this expression occurs.
+// 'funid' is the intern ID of the function in which this expression occurs.
 // ============================================================================
-void cgExp(Cg* cg, char* funnam, AstExp* astexp) {
-
-  if (astexp->lhs == NULL) return;
+void cgExp(Cg* cg, int funid, int exp) {
+  FlatNode* node = cg->flat->node;                  // alias
+  int end = node[exp].end;
 
-  if (astexp->lhs->kind == ASTNAM) {
-    AstNam* astnam = (AstNam*) (astexp->lhs);
-    cgNam(cg, funnam, astnam, "D0");
-  } else if (astexp->lhs->kind == ASTNUM) {
-    AstNum* astnum = (AstNum*) (astexp->lhs);
-    cgNum(cg, astnum, "D0");
-  }
+  int lhs = exp + 1;
+  if (lhs == end) return;
 
-  if (astexp->rhs == NULL) return;
+  // Put a Num on the right of + and *, so that it ends up as the immediate
+  // operand, eg: "ADD.L #1, D0", where iselFun can find it
 
-  if (astexp->rhs->kind == ASTNAM) {
-    AstNam* astnam = (AstNam*) (astexp->rhs);
-    cgNam(cg, funnam, astnam, "D1");
-  } else if (astexp->rhs->kind == ASTNUM) {
-    AstNum* astnum = (AstNum*) (astexp->rhs);
-    cgNum(cg, astnum, "D1");
+  int rhs = node[lhs].end;
+  BOP bop = node[exp].bop;
+  if (rhs != end && (bop == BOPADD || bop == BOPMUL)
+    && node[lhs].tag == ASTNUM && node[rhs].tag != ASTNUM) {
+    int tmp = lhs; lhs = rhs; rhs = tmp;
   }
 
-  cgBop(cg, astexp->bop);
+  cgNamNum(cg, funid, lhs, irOpD(0));
+  if (rhs == end) return;
+  cgNamNum(cg, funid, rhs, irOpD(1));
+
+  cgBop(cg, node[exp].bop);
 
 }
 
@@ -323,47 +334,114 @@ void cgExp(Cg* cg, char* funnam, AstExp* astexp) {
 // Note that we need to devise the frame Layout in order to know where to find
 // each Argument and local Variable in the Stack Frame.
 // ============================================================================
-void cgFun(Cg* cg, AstFun* astfun) {
-  layBuild(cg->lay, astfun);                // build layout (par/var offsets)
-  char* funnam = astfun->nam->lex;  
-  // name of current function
+void cgFun(Cg* cg, int fun) {
+  FlatNode* node = cg->flat->node;          // alias
+  layBuild(cg->lay, cg->flat, fun);         // build layout (par/var offsets)
+  int funid = node[fun].val;                // current function
 
-  // Emit the label that marks the start location of this function.  For
-  // example, if 'funnam' = "add2" then emit the line: "add2: "
+  cg->regs = raFun(cg->lay, cg->flat, fun); // keep hot pars/vars in D2-D7
 
-  char line[LINESIZE];
-  sprintf(line, "%s:", funnam);
-  emitCode(cg->emit, line);
+  // Start the IR for this function.  irPrint will begin its text with the
+  // label that marks its start location - eg: "add2:"
+
+  irBegin(cg->ir, funid);
 
   // Emit the Prolog code
 
-  cgProlog(cg, funnam);
+  cgProlog(cg, fun);
+
+  // The body starts a block of its own, which a self tail call will label and
+  // loop back to (see cgTail)
+
+  irAddBlock(cg->ir, IRNOLABEL);
+  cg->fun      = fun;
+  cg->topblk   = cg->ir->num - 1;
+  cg->toplabel = IRNOLABEL;
 
   // Now generate code for the body of the function
 
-  cgBody(cg, funnam, astfun->body);         // generate code for body
+  int stm = fun + 1;                        // skip over Pars and Vars
+  while (node[stm].tag == ASTPAR || node[stm].tag == ASTVAR) ++stm;
+  cgStms(cg, funid, stm, node[fun].end);    // generate code for body
+
+  peepFun(cg->peep, cg->ir);                // optimize
+  iselFun(cg->isel, cg->peep, cg->ir);      // pick cheaper instructions
+  if (cg->cost) costFun(cg->cost, cg->ir);  // annotate with cycles
+  irPrint(cg->ir, cg->emit);                // then emit, as text
+
+}
+
+// ============================================================================
+// Loop-invariant code motion for the While at node 'n'.  Mark, in
+// cg->hoisted[], each statement of its Block that can run just once, ahead
+// of the loop, rather than on every iteration.  Return how many were marked.
+//
+// A per-loop def-use count drives the choice.  A statement "x = Exp" of the
+// Block (not nested within an If or While) is invariant if:
+//
+//    x is assigned nowhere else in the loop
+//    each operand of Exp is a Num, or a par/var not assigned in the loop
+//    x is not read in the loop before that statement (its condition included)
+//
+// The last rule keeps every read of x seeing the value that the original
+// loop would have given it.  Once a statement is marked, x counts as not
+// assigned in the loop, so statements that use x may follow it out.  A single
+// pass, in order, is enough: a statement can only use the x of a marked
+// statement that precedes it.
+// ============================================================================
+int cgHoist(Cg* cg, int n) {
+  FlatNode* node = cg->flat->node;                          // alias
+  int end   = node[n].end;
+  int exp   = n + 1;
+  int block = node[exp].end;
+
+  for (int m = exp; m < end; ++m) {
+    if (node[m].tag == ASTASG) ++cg->defs[node[m].val];
+    if (node[m].tag == ASTNAM && cg->firstuse[node[m].val] == 0) {
+      cg->firstuse[node[m].val] = m;
+    }
+  }
+
+  int num = 0;
+  for (int s = block; s < end; s = node[s].end) {
+    if (node[s].tag != ASTASG || node[s + 1].tag != ASTEXP) continue;
+    int x = node[s].val;
+    if (cg->defs[x] != 1) continue;
+    if (cg->firstuse[x] && cg->firstuse[x] < s) continue;
+
+    int invariant = 1;
+    for (int c = s + 2; c < (int) node[s].end; c = node[c].end) {
+      if (node[c].tag == ASTNAM && cg->defs[node[c].val]) invariant = 0;
+    }
+    if (!invariant) continue;
 
+    cg->hoisted[s] = 1;
+    cg->defs[x] = 0;
+    ++num;
+  }
+
+  for (int m = exp; m < end; ++m) {
+    if (node[m].tag == ASTASG || node[m].tag == ASTNAM) {
+      cg->defs[node[m].val]     = 0;
+      cg->firstuse[node[m].val] = 0;
+    }
+  }
+  return num;
 }
 
 // ============================================================================
 // If => "if" "(" Exp ")" Block
 // ============================================================================
-void cgIf(Cg* cg, char* funnam, AstIf* astif) {
-   char line[LINESIZE];
-   char* exitlabel = cgLabel();
-
-   cgExp(cg, funnam, astif->exp);                              // result in D0
-   
-   sprintf(line, "\t %s \t %s", "CMPI.L", "#0, D0");
-   emitCode(cg->emit, line);
+void cgIf(Cg* cg, int funid, int n) {
+   FlatNode* node = cg->flat->node;                           // alias
+   int exitlabel = cgLabel();
 
-   sprintf(line, "\t %s \t %s", "BEQ", exitlabel);
-   emitCode(cg->emit, line);
+   int exp = n + 1;
+   cgCond(cg, funid, exp, exitlabel, 0);                      // FALSE => exit
 
-   cgBlock(cg, funnam, astif->block);
+   cgStms(cg, funid, node[exp].end, node[n].end);             // Block
 
-   sprintf(line, "%s%s", exitlabel, ":");            // exit label
-   emitCode(cg->emit, line);
+   irAddBlock(cg->ir, exitlabel);                             // exit label
 }
 
 // Note that cgExp returns its answer in D0 if this is an arithmetic
@@ -371,39 +449,53 @@ void cgIf(Cg* cg, char* funnam, AstIf* astif) {
 // in D0 with TRUE = 1 or FALSE = 0
 
 // ============================================================================
-// Generate a fresh label.  The sequence generated is L10, L20, L30, etc
+// Generate a fresh label number.  The sequence generated is 20, 30, 40, etc,
+// which print as L20, L30, L40, etc
 // ============================================================================
-char* cgLabel() {
+int cgLabel() {
   #define LABELINC 10;
   static int labnum = 10;
 
-  char* line = calloc(LINESIZE, 1);
-  assert(line);
-
   labnum += LABELINC;
-  sprintf(line, "L%d", labnum);
-  return line;
+  return labnum;
 }
 
 // ============================================================================
 // Nam => Alpha AlphaNum*
 //
-// Suppose astnam->nam = "x" and reg = "D1".  Then lookup the offset, from FP,
-// of parameter or local variable "x".  If found, emit code: "MOVE.L x, D1"
-// using "MOVE.L (offset,A6), D1"
+// Suppose node 'nam' names "x" and reg is D1.  If the register allocator
+// put "x" into, say, D4, emit: "MOVE.L D4, D1".  Otherwise lookup the offset,
+// from FP, of parameter or local variable "x".  If found, emit code:
+// "MOVE.L x, D1" using "MOVE.L (offset,A6), D1"
 // ============================================================================
-void cgNam(Cg* cg, char* funnam, AstNam* astnam, char* reg) {
+void cgNam(Cg* cg, int funid, int nam, IrOpnd reg) {
+  int id = cg->flat->node[nam].val;
 
-  char line[LINESIZE];
+  LaySym* sym = layFindVarPar(cg->lay, funid, id);
 
-  int idx = layFindVarParIdx(cg->lay, funnam, astnam->lex);
+  if (sym->reg) {
+    irAdd(cg->ir, IRMOVE, IRSZL, irOpD(sym->reg), reg);
+    return;
+  }
 
-  int off = cg->lay->row[idx].off;
+  int off = sym->off;
   if (off == 0) utDie5Str("cgNam", "cgFind failed, looking for symbol",
-    astnam->lex, "in function", funnam);
+    internStr(id), "in function", internStr(funid));
 
-  sprintf(line, "\t %s \t %s%d%s %s", "MOVE.L", "(", off, ",A6),", reg);
-  emitCode(cg->emit, line);
+  irAdd(cg->ir, IRMOVE, IRSZL, irOpFrame(off), reg);
+}
+
+// ============================================================================
+// NamNum => Nam | Num
+//
+// Load the value of the leaf 'n' into register 'reg'
+// ============================================================================
+void cgNamNum(Cg* cg, int funid, int n, IrOpnd reg) {
+  if (cg->flat->node[n].tag == ASTNAM) {
+    cgNam(cg, funid, n, reg);
+  } else if (cg->flat->node[n].tag == ASTNUM) {
+    cgNum(cg, n, reg);
+  }
 }
 
 // ============================================================================
@@ -411,30 +503,64 @@ void cgNam(Cg* cg, char* funnam, AstNam* astnam, char* reg) {
 // ============================================================================
 Cg* cgNew() {
   Cg* cg = calloc(sizeof(Cg), 1);
-  assert(cg);
+  if (!cg) utDie2Str("cgNew", "Out of memory");
 
-  cg->lay = layNew(LAYMAX);
+  cg->lay = layNew();
   cg->emit = emitNew();
+  cg->peep = peepNew();
+  cg->ir = irNew();
+  cg->isel = iselNew();
 
   return cg;
 }
 
+// ============================================================================
+// Number of pars of the function whose intern ID is 'funid'.  Return -1 if it
+// is not defined in the program - eg: an intrinsic such as "sayn".
+// ============================================================================
+int cgNumPars(Cg* cg, int funid) {
+  FlatNode* node = cg->flat->node;                          // alias
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    if (node[fun].val != funid) continue;
+    int numpar = 0;
+    while (node[fun + 1 + numpar].tag == ASTPAR) ++numpar;
+    return numpar;
+  }
+  return -1;
+}
+
 // ============================================================================
 // Num => [0-9]+
 //
-// Suppose astnum->num = 42, and reg = "D1".  Then emit: "MOVE.L #42, D1"
+// Suppose node 'num' holds 42, and reg is D1.  Then emit: "MOVE.L #42, D1"
 // ============================================================================
-void cgNum(Cg* cg, AstNum* astnum, char* reg) {
-  char line[LINESIZE];
-  sprintf(line, "\t %s \t %s%d%s %s", "MOVE.L", "#", astnum->val, ",", reg);
-  emitCode(cg->emit, line);
+void cgNum(Cg* cg, int num, IrOpnd reg) {
+  int val = cg->flat->node[num].val;
+  irAdd(cg->ir, IRMOVE, IRSZL, irOpImm(val), reg);
 }
 
 // ============================================================================
 // Prog => Fun+
 // ============================================================================
-void cgProg(Cg* cg, AstProg* astprog) {
-  AstFun* astfun = astprog->funs;
+void cgProg(Cg* cg, Flat* flat) {
+  cg->flat = flat;
+  FlatNode* node = flat->node;                              // alias
+
+  // Scratch arrays for cgHoist: one slot per node, and one per par/var ID
+
+  int maxId = 0;
+  for (int n = 0; n < flat->num; ++n) {
+    AST tag = node[n].tag;
+    if (tag == ASTPAR || tag == ASTVAR || tag == ASTASG || tag == ASTNAM) {
+      if (node[n].val > maxId) maxId = node[n].val;
+    }
+  }
+  cg->hoisted  = calloc(flat->num, sizeof(uint8_t));
+  cg->defs     = calloc(maxId + 1, sizeof(int));
+  cg->firstuse = calloc(maxId + 1, sizeof(int));
+  if (!cg->hoisted || !cg->defs || !cg->firstuse) {
+    utDie2Str("cgProg", "Out of memory for loop analysis");
+  }
 
   // Write out "INCLUDE io.X68" to the output assembly buffer
 
@@ -449,9 +575,8 @@ void cgProg(Cg* cg, AstProg* astprog) {
   // Generate code for each function we encounter (in lexical order)
   // in the SubC source file
 
-  while (astfun) {
-    cgFun(cg, astfun);
-    astfun = (AstFun*) (astfun->next);
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    cgFun(cg, fun);
   }
 
   sprintf(line, "\t %s \t %s", "END", "main");
@@ -460,100 +585,225 @@ void cgProg(Cg* cg, AstProg* astprog) {
 }
 
 // ============================================================================
-// Emit Prolog code for a function.  For example:
+// Emit Prolog code for the function at node 'fun'.  For example:
 //
-//    int add2(int a, int b) { ... }
-//    int main() { int mx; int my; int ms; ... ms = add2(mx, my); ... }
+//    int add2(int a, int b) { int s; ... }
+//
+// where the register allocator has put 'a' into D2 and 's' into D3, while 'b'
+// stays in the frame, generates:
 //
-// 'funnam' is the name of the current function
+//    LINK    A6, #0              ; push FP; FP = SP; reserve 0 bytes
+//    MOVEM.L D2-D3, -(A7)        ; save callee-saved registers
+//    MOVE.L  (8,A6), D2          ; load 'a'
 // ============================================================================
-void cgProlog(Cg* cg, char* funnam) {
-   char line[LINESIZE];
-   Emit* emit = cg->emit;                                             // alias
+void cgProlog(Cg* cg, int fun) {
+   FlatNode* node = cg->flat->node;                                   // alias
+   LayScope* scope = layFindFun(cg->lay, node[fun].val)->scope;
+
+   // Push FP, copy SP into FP, and make space for local variables
 
-   // Push FP
-   sprintf(line, "\t %s \t %s", "MOVEA.L", "A7, A6");
-   emitCode(emit, line);
+   irAdd(cg->ir, IRLINK, IRSZNONE, irOpA(6), irOpImm(-layFrameSize(scope)));
 
-   // copy SP into FP
-   sprintf(line, "\t %s \t %s", "MOVEA.L", "(A6), A6");
-   emitCode(emit, line);
+   // Save the callee-saved registers that this function uses
 
-   // make space for local variables
+   if (cg->regs) irAdd(cg->ir, IRMOVEM, IRSZL, irOpRegs(cg->regs), irOpPush());
+
+   // Load parameters that live in registers
+
+   for (int c = fun + 1; c < (int) node[fun].end && node[c].tag == ASTPAR; ++c) {
+     LaySym* par = layFind(scope, node[c].val);
+     if (par->reg == 0) continue;
+     irAdd(cg->ir, IRMOVE, IRSZL, irOpFrame(par->off), irOpD(par->reg));
+   }
 
 }
 
 // ============================================================================
 // Stm => If | Asg | Ret | While
 // ============================================================================
-void cgStm(Cg* cg, char* funnam, AstStm* aststm) {
-  switch(aststm->kind) {
-    case ASTIF:     { AstIf* astif = (AstIf*) aststm;
-                      cgIf(cg, funnam, astif);
+void cgStm(Cg* cg, int funid, int n) {
+  FlatNode* node = cg->flat->node;                                    // alias
+  switch(node[n].tag) {
+    case ASTIF:     { cgIf(cg, funid, n);
                       break;
                     }
-    case ASTASG:    { AstAsg* astasg = (AstAsg*) aststm;
-                      if (astasg->eoc->kind == ASTCALL) {             // Call
-                        AstCall* astcall = (AstCall*) astasg->eoc;
-                        cgCall(cg, funnam, astcall);
+    case ASTASG:    { int eoc = n + 1;                                // Exp or Call
+                      if (node[eoc].tag == ASTCALL) {                 // Call
+                        cgCall(cg, funid, eoc);
                       } else {                                        // Exp
-                        AstExp* astexp = (AstExp*) astasg->eoc;
-                        cgExp(cg, funnam, astexp);
+                        cgExp(cg, funid, eoc);
                       }
-                      cgAsg(cg, funnam, astasg->nam->lex);
+                      cgAsg(cg, funid, node[n].val);
                       break;
                     }
-    case ASTRET:    { AstRet* astret = (AstRet*) aststm;
-                      cgExp(cg, funnam, astret->exp);
-                      cgEpilog(cg, funnam);
+    case ASTRET:    { cgExp(cg, funid, n + 1);
+                      cgEpilog(cg, funid);
                       break;
                     }
-    case ASTWHILE:  { AstWhile* astwhile = (AstWhile*) aststm;
-                      cgWhile(cg, funnam, astwhile);
+    case ASTWHILE:  { cgWhile(cg, funid, n);
                       break;
                     }
-    default:        { utDie2Str("cgStm", "Invalid aststm->kind"); }
+    default:        { utDie2Str("cgStm", "Invalid statement kind"); }
   }
 }
 
 // ============================================================================
 // Stms = Stm+
+//
+// Generate code for each of the statements that lie, side by side, between
+// node 'first' and node 'end' - eg: the body of a function, or of a While
+// ============================================================================
+void cgStms(Cg* cg, int funid, int first, int end) {
+  FlatNode* node = cg->flat->node;                                    // alias
+  for (int n = first; n < end; n = node[n].end) {
+    if (cg->hoisted[n]) continue;                                     // see cgWhile
+    int call = cgTailCall(cg, funid, n, end);
+    if (call) {
+      cgTail(cg, funid, call);
+      n = node[n].end;                                                // skip Ret
+      continue;
+    }
+    cgStm(cg, funid, n);
+  }
+}
+
 // ============================================================================
-void cgStms(Cg* cg, char* funnam, AstStm* aststm) {
-  while (aststm) {
-    cgStm(cg, funnam, aststm);
-    aststm = (AstStm*) aststm->next;
+// Generate a tail call: the Call at node 'call', whose result the current
+// function returns at once (see cgTailCall).  The callee can reuse the frame
+// of the current function, so the stack does not grow.
+//
+// First, the arguments are pushed, just as for an ordinary call, so that
+// each is read before any par is overwritten.  Then, for a direct
+// self-recursion, "x = f(n - 1, a); return x;", they are popped into the
+// pars, and control loops back to the start of the body:
+//
+//    MOVE.L  D0, -(A7)           ; push a
+//    MOVE.L  D1, -(A7)           ; push n - 1
+//    MOVE.L  (A7)+, D2           ; n = n - 1       (D2 holds 'n')
+//    MOVE.L  (A7)+, (12,A6)      ; a = a
+//    BRA     L40                 ; L40 follows the Prolog
+//
+// For a call to another function, "x = g(n - 1); return x;", they are popped
+// into the slots that held our own incoming arguments.  Then the Epilog
+// tears down our frame, but leaves our return address in place, and JMPs to
+// the callee, which returns straight to our caller:
+//
+//    MOVE.L  D1, -(A7)           ; push n - 1
+//    MOVE.L  (A7)+, (8,A6)       ; arg #1 slot
+//    MOVEM.L (A7)+, D2           ; restore callee-saved registers
+//    UNLK    A6
+//    JMP     g
+//
+// The peephole optimizer folds each adjacent push and pop into one MOVE.
+// ============================================================================
+void cgTail(Cg* cg, int funid, int call) {
+  FlatNode* node = cg->flat->node;                          // alias
+  IrOpnd none = irOpNone();
+  IrOpnd pop  = irOpPop();
+
+  int numarg = node[call].end - call - 1;
+  cgArgs(cg, funid, call);                                  // push, right to left
+
+  if (node[call].val == funid) {                            // self-recursion
+    LayScope* scope = layFindFun(cg->lay, funid)->scope;
+    for (int argnum = 1; argnum <= numarg; ++argnum) {
+      LaySym* par = layFind(scope, node[cg->fun + argnum].val);
+      IrOpnd dst = par->reg ? irOpD(par->reg) : irOpFrame(par->off);
+      irAdd(cg->ir, IRMOVE, IRSZL, pop, dst);
+    }
+    if (cg->toplabel == IRNOLABEL) {
+      cg->toplabel = cgLabel();
+      cg->ir->blk[cg->topblk].label = cg->toplabel;
+    }
+    irAdd(cg->ir, IRBRA, IRSZNONE, irOpLab(cg->toplabel), none);
+    return;
   }
+
+  // Incoming arguments sit at (8,A6), (12,A6), etc - see layBuild
+
+  for (int argnum = 1; argnum <= numarg; ++argnum) {
+    irAdd(cg->ir, IRMOVE, IRSZL, pop, irOpFrame(4 + 4 * argnum));
+  }
+  if (cg->regs) irAdd(cg->ir, IRMOVEM, IRSZL, pop, irOpRegs(cg->regs));
+  irAdd(cg->ir, IRUNLK, IRSZNONE, irOpA(6), none);
+  irAdd(cg->ir, IRJMP, IRSZNONE, irOpFun(node[call].val), none);
+}
+
+// ============================================================================
+// Is statement 'n' the first half of a tail call?  That is, an Asg of a Call
+// followed, in the same list of statements, by a Ret of the same var:
+//
+//    x = f(a, b);
+//    return x;
+//
+// 'end' is the end of that list.  Return the node of the Call if so, and if
+// cgTail can compile it: the callee must be defined in this program, with
+// as many pars as the Call has args.  If it is not the current function, it
+// must need no more argument slots than the current function was given,
+// since our caller will pop just that many.  main is excluded, because it
+// must end in SIMHALT.  Otherwise, return 0.
+// ============================================================================
+int cgTailCall(Cg* cg, int funid, int n, int end) {
+  FlatNode* node = cg->flat->node;                          // alias
+  if (funid == INTMAIN) return 0;
+  if (node[n].tag != ASTASG || node[n + 1].tag != ASTCALL) return 0;
+
+  int ret = node[n].end;
+  if (ret >= end || node[ret].tag != ASTRET) return 0;
+  int exp = ret + 1;
+  if (node[exp].end != (uint32_t) exp + 2) return 0;                 // single leaf
+  if (node[exp + 1].tag != ASTNAM || node[exp + 1].val != node[n].val) return 0;
+
+  int call   = n + 1;
+  int numarg = node[call].end - call - 1;
+  if (cgNumPars(cg, node[call].val) != numarg) return 0;
+  if (node[call].val != funid && numarg > cgNumPars(cg, funid)) return 0;
+  return call;
 }
 
 // ============================================================================
 // While => "while" "(" Exp ")" Block
+//
+// The loop is rotated, so that its test sits at the bottom, with one copy of
+// the test ahead of the loop to guard entry.  Each iteration then runs just
+// one branch - the conditional branch back to the top - rather than a test
+// at the top plus a BRA back to it.  Eg: "while (i < n) { ... }" becomes:
+//
+//          MOVE.L  (@i,A6), D0
+//          MOVE.L  (@n,A6), D1
+//          CMP.L   D1, D0
+//          BGE     L30                 ; guard: FALSE => skip the loop
+//          ...                         ; invariant statements (see cgHoist)
+//    L20:  ...                         ; Block
+//          MOVE.L  (@i,A6), D0
+//          MOVE.L  (@n,A6), D1
+//          CMP.L   D1, D0
+//          BLT     L20                 ; TRUE => go round again
+//    L30:
+//
+// The guard also gives a safe home to statements hoisted out of the loop:
+// they run only if the loop will run at least once.
 // ============================================================================
-void cgWhile (Cg* cg, char* funnam, AstWhile* astwhile) {
-  char line[LINESIZE];
+void cgWhile (Cg* cg, int funid, int n) {
+  FlatNode* node = cg->flat->node;                  // alias
 
-  char* startlabel = cgLabel();                     // eg: "L20"
-  sprintf(line, "%s%s", startlabel, ":");           // start label
-  emitCode(cg->emit, line);
-
-  char* exitlabel = cgLabel();                      // eg: "L30"
+  int exitlabel = cgLabel();                        // eg: L30
+  int exp = n + 1;
+  cgCond(cg, funid, exp, exitlabel, 0);             // guard: FALSE => exit
 
-  cgExp(cg, funnam, astwhile->exp);                 // result in D0
+  // Hoisted statements run here, once.  cgStms skips them within the Block
 
-  sprintf(line, "\t %s \t %s", "CMPI.L", "#0, D0");
-  emitCode(cg->emit, line);
-
-  sprintf(line, "\t %s \t %s", "BEQ", exitlabel);
-  emitCode(cg->emit, line);
+  cgHoist(cg, n);
+  for (int s = node[exp].end; s < (int) node[n].end; s = node[s].end) {
+    if (cg->hoisted[s]) cgStm(cg, funid, s);
+  }
 
-  cgBlock(cg, funnam, astwhile->block);
+  int toplabel = cgLabel();                         // eg: L20
+  irAddBlock(cg->ir, toplabel);                     // top label
 
-  sprintf(line, "\t %s \t %s", "BRA", startlabel);  // loop
-  emitCode(cg->emit, line);
+  cgStms(cg, funid, node[exp].end, node[n].end);   // Block
 
-  sprintf(line, "%s:", exitlabel);
-  emitCode(cg->emit, line);
+  cgCond(cg, funid, exp, toplabel, 1);              // TRUE => loop
 
-  sprintf(line, "%s%s", exitlabel, ":");            // exit label
-  emitCode(cg->emit, line);
-}
\ No newline at end of file
+  irAddBlock(cg->ir, exitlabel);                    // exit label
+}
@@ -3,37 +3,60 @@
 #pragma once
 
 #include <assert.h>     // assert
+#include <stdint.h>     // uint8_t
 
 #include "ast.h"        // Ast*
+#include "cost.h"       // Static cycle-cost estimate
 #include "emit.h"       // Emit Buffer
+#include "flat.h"       // Flat
+#include "ir.h"         // Instruction IR
+#include "isel.h"       // Instruction selection
 #include "lay.h"        // Layout of stack frames
+#include "peep.h"       // Peephole optimizer
+#include "ra.h"         // Register allocator
 #include "ut.h"         // ut*
 
-#define LINESIZE 100
+#define LINESIZE 100    // data lines, such as "DC.B 'hello',0"
 
 typedef struct {
-  Lay*  lay;
-  Emit* emit;
+  Lay*     lay;
+  Emit*    emit;
+  Peep*    peep;        // peephole optimizer
+  Flat*    flat;        // program being compiled
+  IrFun*   ir;          // code of the current function, before emitting
+  Isel*    isel;        // instruction selection
+  Cost*    cost;        // -cost: cycle estimate of each function (NULL => none)
+  int      regs;        // D registers allocated in the current function (mask)
+  int      fun;         // node of the current function
+  int      topblk;      // block that starts its body, just after the Prolog
+  int      toplabel;    // label of topblk, once a self tail call needs one
+  uint8_t* hoisted;     // per node: 1 => statement moved ahead of its loop
+  int*     defs;        // per par/var ID: Asgs within the current loop
+  int*     firstuse;    // per par/var ID: first Nam within the current loop
 } Cg;
 
-void  cgAsg   (Cg* cg, char* funnam, char* varnam);
-void  cgAsgExp(Cg* cg, char* funnam, AstExp* astexp);
-void  cgBlock (Cg* cg, char* funnam, AstBlock* astblock);
-void  cgBody  (Cg* cg, char* funnam, AstBody* astbody);
+void  cgArgs  (Cg* cg, int funid, int call);
+void  cgAsg   (Cg* cg, int funid, int varid);
 void  cgBop   (Cg* cg, BOP bop);
-void  cgBranch(Cg* cg, char* cond);
-void  cgCall  (Cg* cg, char* funnam, AstCall* astcall);
-void  cgEpilog(Cg* cg, char* funnam);
-void  cgExp   (Cg* cg, char* funnam, AstExp* astexp);
-void  cgFun   (Cg* cg, AstFun* astfun);
-void  cgIf    (Cg* cg, char* funnam, AstIf* astif);
-char* cgLabel();
-void  cgNam   (Cg* cg, char* funnam, AstNam* astnam, char* reg);
+void  cgBranch(Cg* cg, IROP cond);
+IROP  cgBranchOp(BOP bop);
+void  cgCall  (Cg* cg, int funid, int call);
+void  cgCond  (Cg* cg, int funid, int exp, int label, int jumpif);
+void  cgEpilog(Cg* cg, int funid);
+void  cgExp   (Cg* cg, int funid, int exp);
+void  cgFun   (Cg* cg, int fun);
+int   cgHoist (Cg* cg, int n);
+void  cgIf    (Cg* cg, int funid, int n);
+int   cgLabel();
+void  cgNam   (Cg* cg, int funid, int nam, IrOpnd reg);
+void  cgNamNum(Cg* cg, int funid, int n, IrOpnd reg);
 Cg*   cgNew();
-void  cgNum   (Cg* cg, AstNum* astnum, char* reg);
-void  cgPar   (Cg* cg, AstPar* par);
-void  cgProg  (Cg* cg, AstProg* astprog);
-void  cgProlog(Cg* cg, char* funnam);
-void  cgStm   (Cg* cg, char* funnam, AstStm* aststm);
-void  cgStms  (Cg* cg, char* funnam, AstStm* aststm);
-void  cgWhile (Cg* cg, char* funnam, AstWhile* astwhile);
+int   cgNumPars(Cg* cg, int funid);
+void  cgNum   (Cg* cg, int num, IrOpnd reg);
+void  cgProg  (Cg* cg, Flat* flat);
+void  cgProlog(Cg* cg, int fun);
+void  cgStm   (Cg* cg, int funid, int n);
+void  cgStms  (Cg* cg, int funid, int first, int end);
+void  cgTail  (Cg* cg, int funid, int call);
+int   cgTailCall(Cg* cg, int funid, int n, int end);
+void  cgWhile (Cg* cg, int funid, int n);
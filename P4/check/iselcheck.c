@@ -0,0 +1,242 @@
+// iselcheck.c - Instruction selection checker
+//
+// Built and run by iselcheck.sh, which describes what it checks.  It takes
+// the place of main.c, and drives the compiler's own IR, peephole and isel
+// modules.
+
+#include "ir.h"
+#include "isel.h"
+#include "peep.h"
+
+// The state an IR function may change: data registers, A7, one frame slot
+// (every frame operand aliases it), and the condition codes
+
+typedef struct {
+  int32_t d[8];
+  int32_t a7;
+  int32_t mem;
+  int     n, z, v, c;
+  int     illegal;          // ran an instruction the 68000 cannot encode
+} Mach;
+
+// Can the 68000 encode 'p'?  Only the quick forms limit their immediates.
+
+static int legal(IrIns* p) {
+  int n = p->src.val;
+  switch (p->op) {
+    case IRMOVEQ: return n >= -128 && n <= 127 && p->dst.kind == IROPDREG;
+    case IRADDQ:
+    case IRSUBQ:  return n >= 1 && n <= 8;
+    case IRLSL:   return n >= 1 && n <= 8 && p->dst.kind == IROPDREG;
+    default:      return 1;
+  }
+}
+
+static int32_t* loc(Mach* m, IrOpnd o) {
+  if (o.kind == IROPDREG) return &m->d[o.val];
+  if (o.kind == IROPAREG && o.val == 7) return &m->a7;
+  if (o.kind == IROPFRAME) return &m->mem;
+  printf("Unexpected operand kind %d \n", o.kind);
+  exit(2);
+}
+
+static int32_t val(Mach* m, IrOpnd o) {
+  return o.kind == IROPIMM ? o.val : *loc(m, o);
+}
+
+static void setNZ(Mach* m, int32_t r) { m->n = r < 0; m->z = r == 0; m->v = m->c = 0; }
+
+static void setSub(Mach* m, int32_t s, int32_t d) {     // flags for d - s
+  int32_t r = (int32_t) ((uint32_t) d - (uint32_t) s);
+  m->n = r < 0;
+  m->z = r == 0;
+  m->c = (uint32_t) s > (uint32_t) d;
+  m->v = ((d ^ s) & (d ^ r)) < 0;
+}
+
+static int taken(Mach* m, IROP op) {
+  int lt = m->n ^ m->v;
+  switch (op) {
+    case IRBEQ: return m->z;
+    case IRBNE: return !m->z;
+    case IRBLT: return lt;
+    case IRBLE: return lt || m->z;
+    case IRBGE: return !lt;
+    case IRBGT: return !lt && !m->z;
+    default:    return 1;                               // BRA
+  }
+}
+
+// Run 'fun' from its first block to RTS.  A write to An leaves the flags.
+
+static void run(Mach* m, IrFun* fun) {
+  int b = 0, i = 0;
+  while (b < fun->num) {
+    IrBlock* blk = &fun->blk[b];
+    if (i >= blk->num) { ++b; i = 0; continue; }
+    IrIns* p = &blk->ins[i++];
+    if (!legal(p)) m->illegal = 1;
+    int32_t* d = p->dst.kind == IROPNONE ? NULL : loc(m, p->dst);
+    int32_t  o = d ? *d : 0;
+    int      an = p->dst.kind == IROPAREG;
+    switch (p->op) {
+      case IRNOP:   break;
+      case IRMOVE:
+      case IRMOVEQ: *d = val(m, p->src); setNZ(m, *d); break;
+      case IRCLR:   *d = 0; setNZ(m, 0); break;
+      case IRADD:
+      case IRADDQ: {
+        int32_t s = val(m, p->src);
+        *d = (int32_t) ((uint32_t) o + (uint32_t) s);
+        if (an) break;
+        m->n = *d < 0;
+        m->z = *d == 0;
+        m->c = (uint32_t) *d < (uint32_t) o;
+        m->v = (~(o ^ s) & (o ^ *d)) < 0;
+        break;
+      }
+      case IRSUB:
+      case IRSUBQ: {
+        int32_t s = val(m, p->src);
+        *d = (int32_t) ((uint32_t) o - (uint32_t) s);
+        if (!an) setSub(m, s, o);
+        break;
+      }
+      case IRCMP:
+      case IRCMPI:  setSub(m, val(m, p->src), o); break;
+      case IRTST:   setNZ(m, val(m, p->src)); break;
+      case IREXT:   *d = (int16_t) o; setNZ(m, *d); break;
+      case IRLSL:   *d = (int32_t) ((uint32_t) o << p->src.val); setNZ(m, *d); break;
+      case IRNEG:   *d = (int32_t) (0u - (uint32_t) o); setSub(m, o, 0); break;
+      case IRMULS:  *d = (int32_t) (int16_t) val(m, p->src) * (int16_t) o; setNZ(m, *d); break;
+      case IRBEQ: case IRBNE: case IRBLT: case IRBLE: case IRBGE: case IRBGT:
+      case IRBRA:
+        if (!taken(m, p->op)) break;
+        for (b = 0; fun->blk[b].label != p->src.val; ++b) ;
+        i = 0;
+        break;
+      case IRRTS:   return;
+      default:
+        printf("Unexpected opcode %d \n", p->op);
+        exit(2);
+    }
+  }
+}
+
+static IROP bccs[] = { IRBEQ, IRBNE, IRBLT, IRBLE, IRBGE, IRBGT };
+
+static IrFun*  fun;
+static IrFun*  old;                                     // 'fun', before isel
+static Peep*   peep;
+static Isel*   isel;
+static long    checked, bad;
+static uint32_t rng = 12345;
+
+static int32_t rnd() { rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; return (int32_t) rng; }
+
+// Build "op sz #n, dst" in 'shape', and peephole it, as cgFun would; keep a
+// copy in 'old'; then run iselFun on 'fun'.  'bcc' is the Bcc in shapes 1
+// and 3.  Shapes 2 and 3 read D1 afterwards, into D4.
+//
+//   0:  op            1:  op                 2:  op            3:  op
+//       RTS               Bcc  L100              ADD.L D1, D4      Bcc  L100
+//                         MOVE #1, D3            RTS               MOVE #1, D3
+//                   L100: RTS                                L100: ADD.L D1, D4
+//                                                                  RTS
+
+static void build(IROP op, IRSZ sz, int n, IrOpnd dst, int shape, IROP bcc) {
+  irBegin(fun, 1);
+  irAdd(fun, op, sz, irOpImm(n), dst);
+  if (shape & 1) {
+    irAdd(fun, bcc, IRSZNONE, irOpLab(100), irOpNone());
+    irAdd(fun, IRMOVE, IRSZL, irOpImm(1), irOpD(3));
+    irAddBlock(fun, 100);
+  }
+  if (shape & 2) irAdd(fun, IRADD, IRSZL, irOpD(1), irOpD(4));
+  irAdd(fun, IRRTS, IRSZNONE, irOpNone(), irOpNone());
+  peepFun(peep, fun);
+
+  irBegin(old, 1);
+  for (int b = 0; b < fun->num; ++b) {
+    if (b > 0) irAddBlock(old, IRNOLABEL);
+    IrBlock* blk = &old->blk[b];
+    blk->label = fun->blk[b].label;
+    for (int i = 0; i < fun->blk[b].num; ++i) {
+      IrIns* p = &fun->blk[b].ins[i];
+      irInsert(blk, i, p->op, p->sz, p->src, p->dst);
+    }
+  }
+  iselFun(isel, peep, fun);
+}
+
+// Run 'old' and 'fun' from the same state, 'x' in D0, A7 and the frame slot.
+// D1 must survive only if it is read later.  The flags matter only where
+// a Bcc reads them, or where 'op' is a compare, whose job they are.
+
+static void check(char* what, int n, int32_t x, int shape, int flags) {
+  Mach a = { { 0 } };
+  a.d[0] = a.a7 = a.mem = x;
+  a.d[1] = rnd();
+  a.d[2] = rnd();
+  Mach b = a;
+  run(&a, old);
+  run(&b, fun);
+  ++checked;
+
+  int same = a.a7 == b.a7 && a.mem == b.mem && !b.illegal;
+  for (int r = 0; r < 8; ++r) same = same && (r == 1 && shape < 2 || a.d[r] == b.d[r]);
+  if (flags) {
+    for (int k = 0; k < 6; ++k) same = same && taken(&a, bccs[k]) == taken(&b, bccs[k]);
+  }
+  if (same) return;
+  if (bad++ < 20) printf("FAIL  %s #%d, shape %d, x = %d \n", what, n, shape, x);
+}
+
+int main(int argc, char* argv[]) {
+  int step = argc > 1 ? 97 : 1;                         // "quick"
+  internInit();
+  fun = irNew(); old = irNew(); peep = peepNew(); isel = iselNew();
+
+  // MULS #c, D0.  The low 16 bits of c and of D0 count; so every pair, and
+  // a few c beyond 16 bits.  Shapes 2 and 3 need just a sample of D0.
+
+  int wide[] = { 65536 + 3, 7 * 65536 - 1, 100000, -100000, INT32_MAX, INT32_MIN };
+  for (int k = -6; k < 65536; ++k) {
+    int c = k < 0 ? wide[k + 6] : k - 32768;
+    for (int shape = 0; shape < 4; ++shape) {
+      build(IRMULS, IRSZNONE, c, irOpD(0), shape, bccs[(c & 0xFFFF) % 6]);
+      int by = shape == 0 ? step : 4099;
+      for (int x = -32768; x <= 32767; x += by) {
+        check("MULS", c, (int32_t) ((uint32_t) rnd() & 0xFFFF0000) | (uint16_t) x, shape, 0);
+      }
+    }
+  }
+  printf("MULS:      %ld checked, %ld failed \n", checked, bad);
+
+  // MOVE, ADD, SUB, CMP and CMPI of an immediate
+
+  IROP ops[] = { IRMOVE, IRADD, IRSUB, IRCMP, IRCMPI };
+  char* names[] = { "MOVE.L", "ADD.L", "SUB.L", "CMP.L", "CMPI.L" };
+  for (int k = 0; k < 5; ++k) {
+    int cmp = ops[k] == IRCMP || ops[k] == IRCMPI;
+    for (int m = -70001; m <= 70001; ++m) {
+      int n = m == -70001 ? INT32_MIN : m == 70001 ? INT32_MAX : m;
+      int32_t xs[] = { n, n - 1, n + 1, 0, -1, INT32_MIN, INT32_MAX, rnd() };
+      for (int where = 0; where < 3; ++where) {
+        if (where == 2 && (ops[k] != IRADD && ops[k] != IRSUB)) continue;
+        IrOpnd dst = where == 0 ? irOpD(0) : where == 1 ? irOpFrame(-4) : irOpA(7);
+        for (int shape = 0; shape < 4; ++shape) {
+          int nbcc = (shape & 1) && m >= -200 && m <= 200 ? 6 : 1;
+          for (int j = 0; j < nbcc; ++j) {
+            IROP bcc = bccs[nbcc == 6 ? j : (m & 0xFFFF) % 6];
+            build(ops[k], IRSZL, n, dst, shape, bcc);
+            for (int t = 0; t < 8; ++t) check(names[k], n, xs[t], shape, cmp);
+          }
+        }
+      }
+    }
+  }
+  printf("All:       %ld checked, %ld failed \n", checked, bad);
+  iselReport(isel);
+  return bad != 0;
+}
@@ -0,0 +1,53 @@
+// lexold.c - Driver for the hand-written lexer that the DFA lexer replaced
+//
+// Built by lexbench.sh, against the lex.c, tok.c and ut.c in check/lexold:
+// copies of those files as they stood before the DFA lexer, so that both
+// lexers can be timed on the same input.  It takes the place of their toks.c,
+// whose fixed array holds just 1000 tokens: here, each token is counted, and
+// released, as soon as it is lexed.
+//
+// Usage: lexold <file.subc>
+//
+// Prints a "Time:" line in the form "subc -parse -time" uses.
+
+#include <time.h>       // clock_gettime
+
+#include "lex.h"
+
+static Toks toks;
+
+Toks* toksNew() {
+  toks.tokNum = toks.hiTokNum = -1;
+  return &toks;
+}
+
+// ============================================================================
+// Count 'tok', then free it, and its lexeme - unless that is a literal, as
+// lexPun returns for punctuation
+// ============================================================================
+void toksAdd(Toks* toks, Tok* tok) {
+  ++toks->hiTokNum;
+  if (tok->kind == TOKSTR || isalnum((unsigned char) tok->lex[0])) free(tok->lex);
+  free(tok);
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) { printf("Usage: lexold <file.subc> \n"); exit(-1); }
+
+  double t0 = now();
+  char* text = utReadFile(argv[1]);
+  Lex* lex = lexNew(text);
+  Toks* toks = lexAll(lex);
+  double t1 = now();
+
+  printf("Time: lex %.3f s (%d tokens) \n", t1 - t0, toks->hiTokNum + 1);
+  free(lex);
+  free(text);
+  return 0;
+}
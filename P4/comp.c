@@ -0,0 +1,31 @@
+// comp.c - Compilation context
+
+#include "comp.h"
+
+// ============================================================================
+// Release the source text, the tokens, the AST and the flat AST held by
+// 'comp', along with 'comp' itself.  Nothing that outlives 'comp' points into
+// the text: names are interned, and strings copied into the Arena.
+// ============================================================================
+void compFree(Comp* comp) {
+  if (comp->text) utUnmapFile(comp->text, comp->size);
+  if (comp->toks) toksFree(comp->toks);
+  if (comp->flat) flatFree(comp->flat);
+  astUseArena(NULL);
+  arenaFree(comp->arena);
+  free(comp);
+}
+
+// ============================================================================
+// Start the compilation of the source file at 'path': map its text, and make
+// a fresh Arena the home of every AST node built from now on
+// ============================================================================
+Comp* compNew(char* path) {
+  Comp* comp = calloc(1, sizeof(Comp));
+  if (!comp) utDie2Str("compNew", "Out of memory");
+  comp->path  = path;
+  comp->text  = utMapFile(path, &comp->size);
+  comp->arena = arenaNew(0);
+  astUseArena(comp->arena);
+  return comp;
+}
@@ -0,0 +1,30 @@
+// comp.h - Compilation context
+
+#pragma once
+
+#include <stddef.h>     // size_t
+#include <stdlib.h>     // calloc, free
+
+#include "arena.h"      // Arena
+#include "ast.h"        // AstProg, astUseArena
+#include "flat.h"       // Flat
+#include "toks.h"       // Toks
+#include "ut.h"         // utMapFile, utUnmapFile
+
+// A Comp holds everything that lives exactly as long as the compilation of
+// one source file.  It owns the Arena from which the AST is allocated, so
+// compFree releases the entire tree with a single arenaFree, rather than
+// node by node.
+
+typedef struct {
+  char*    path;        // path of the source file
+  char*    text;        // source text (see utMapFile)
+  size_t   size;        // number of chars in 'text'
+  Arena*   arena;       // AST nodes and string literals
+  Toks*    toks;        // tokens lexed from 'text'
+  AstProg* prog;        // AST parsed from 'toks'
+  Flat*    flat;        // 'prog', flattened for codegen
+} Comp;
+
+void  compFree(Comp* comp);
+Comp* compNew(char* path);
@@ -0,0 +1,307 @@
+// cost.c - Static cycle-cost estimate of the 68000 code
+
+#include "cost.h"
+
+static uint8_t costOps[IRNUMOP] = {
+  ASMNOP,
+  ASMADD, ASMADDQ, ASMBEQ, ASMBGE, ASMBGT, ASMBLE, ASMBLT, ASMBNE, ASMBRA, ASMBSR,
+  ASMCLR, ASMCMP, ASMCMPI, ASMEXT, ASMJMP, ASMLEA, ASMLINK, ASMLSL, ASMMOVE,
+  ASMMOVEM, ASMMOVEQ, ASMMULS, ASMNEG, ASMPEA, ASMRTS, ASMSIMHALT, ASMSUB, ASMSUBQ,
+  ASMTST, ASMUNLK
+};
+
+// ============================================================================
+// Grow 'arr', of '*num' ints, to hold at least 'need'
+// ============================================================================
+static int* costGrow(int* arr, int* num, int need) {
+  if (need <= *num) return arr;
+  int n = *num ? *num : IRMINCAP;
+  while (n < need) n *= 2;
+  arr = realloc(arr, n * sizeof(int));
+  if (!arr) utDie2Str("costGrow", "Out of memory");
+  *num = n;
+  return arr;
+}
+
+// ============================================================================
+// Convert IR operand 'o' into the assembler's operand, in 'a'
+// ============================================================================
+static void costOpnd(IrOpnd o, AsmOpnd* a) {
+  memset(a, 0, sizeof(AsmOpnd));
+  a->val = o.val;
+  switch (o.kind) {
+    case IROPDREG:  a->kind = ASMOPDREG;   a->reg = (uint8_t) o.val; break;
+    case IROPAREG:  a->kind = ASMOPAREG;   a->reg = (uint8_t) o.val; break;
+    case IROPIMM:   a->kind = ASMOPIMM;    break;
+    case IROPFRAME: a->kind = ASMOPDISP;   a->reg = 6; break;
+    case IROPPUSH:  a->kind = ASMOPPREDEC; a->reg = 7; break;
+    case IROPPOP:   a->kind = ASMOPPOSTINC; a->reg = 7; break;
+    case IROPLAB:
+    case IROPDATA:
+    case IROPFUN:   a->kind = ASMOPABS;    a->val = 0; break;
+    case IROPREGS:  a->kind = ASMOPREGS;   break;
+    default:        a->kind = ASMOPNONE;   break;
+  }
+}
+
+// ============================================================================
+// Estimated cycles for 'ins'.  'back' is 1 if it branches back, to close a
+// loop.
+// ============================================================================
+static int costIns(IrIns* ins, int back) {
+  AsmIns a;
+  memset(&a, 0, sizeof(AsmIns));
+  a.op = costOps[ins->op];
+  a.sz = ins->sz == IRSZB ? 1 : ins->sz == IRSZW ? 2 : ins->sz == IRSZL ? 4
+       : (ins->op == IRMOVEQ || ins->op == IRLEA || ins->op == IRPEA) ? 4 : 2;
+  a.isShort = 1;
+  costOpnd(ins->src, &a.src);
+  costOpnd(ins->dst, &a.dst);
+
+  int c = asmCost(&a);
+  if (irIsCond(ins->op) && back) c = a.taken;
+  if (ins->op == IRMULS) {
+    c += ins->src.kind == IROPIMM ? asmMulsExtra((uint32_t) ins->src.val) : COSTMULSREG;
+  }
+  return c;
+}
+
+// ============================================================================
+// Index of the block that branch 'ins' jumps to, in the function costLoops
+// last looked at (-1 => not a branch to a label)
+// ============================================================================
+static int costTarget(Cost* cost, IrIns* ins) {
+  if (!irIsBranch(ins->op) || ins->src.kind != IROPLAB) return -1;
+  int label = ins->src.val;
+  if (label < cost->lo || label > cost->hi) return -1;
+  return cost->at[label - cost->lo];
+}
+
+// ============================================================================
+// Count, into cost->depth, the loops around each block of 'fun'.  A branch
+// to the label of an earlier block (or its own) closes a loop over the blocks
+// between.
+// ============================================================================
+static void costLoops(Cost* cost, IrFun* fun) {
+  int lo = 0, hi = -1;
+  for (int b = 0; b < fun->num; ++b) {
+    int label = fun->blk[b].label;
+    if (label == IRNOLABEL) continue;
+    if (hi < lo) { lo = hi = label; continue; }
+    if (label < lo) lo = label;
+    if (label > hi) hi = label;
+  }
+
+  cost->depth = costGrow(cost->depth, &cost->numDepth, fun->num);
+  memset(cost->depth, 0, fun->num * sizeof(int));
+  cost->lo = lo;
+  cost->hi = hi;
+  if (hi < lo) return;                                  // no labels: no loops
+
+  cost->at = costGrow(cost->at, &cost->numAt, hi - lo + 1);
+  memset(cost->at, -1, (hi - lo + 1) * sizeof(int));
+  for (int b = 0; b < fun->num; ++b) {
+    int label = fun->blk[b].label;
+    if (label != IRNOLABEL) cost->at[label - lo] = b;
+  }
+
+  for (int b = 0; b < fun->num; ++b) {
+    IrBlock* blk = &fun->blk[b];
+    for (int i = 0; i < blk->num; ++i) {
+      int top = costTarget(cost, &blk->ins[i]);
+      if (top < 0 || top > b) continue;                 // forward, or none
+      for (int k = top; k <= b; ++k) ++cost->depth[k];
+    }
+  }
+}
+
+// ============================================================================
+// 'trip' raised to 'depth', up to COSTMAXWEIGHT
+// ============================================================================
+static uint64_t costWeight(int trip, int depth) {
+  uint64_t w = 1;
+  for (int d = 0; d < depth && w < COSTMAXWEIGHT; ++d) w *= (uint64_t) trip;
+  return w < COSTMAXWEIGHT ? w : COSTMAXWEIGHT;
+}
+
+// ============================================================================
+// Format the totals in 'cf' as a row of the summary table
+// ============================================================================
+static void costRow(char* line, char* name, CostFun* cf) {
+  sprintf(line, "%-20.64s %6d %7d %5d %10llu %14llu", name, cf->blocks, cf->instrs,
+    cf->depth, (unsigned long long) cf->cycles, (unsigned long long) cf->weighted);
+}
+
+// ============================================================================
+// Sum the rows of the summary table into 'total'
+// ============================================================================
+static void costTotal(Cost* cost, CostFun* total) {
+  memset(total, 0, sizeof(CostFun));
+  for (int f = 0; f < cost->num; ++f) {
+    CostFun* cf = &cost->fun[f];
+    total->blocks   += cf->blocks;
+    total->instrs   += cf->instrs;
+    total->cycles   += cf->cycles;
+    total->weighted += cf->weighted;
+    if (cf->depth > total->depth) total->depth = cf->depth;
+  }
+}
+
+static char* costHead =
+  "function             blocks  instrs depth     cycles       weighted";
+
+// ============================================================================
+// Estimate the cycles of each instruction and block in 'fun', and append
+// them, as an annotated listing, to cost->list.  For example:
+//
+//                 fac:
+//     16          	 LINK 	 A6, #0
+//                 L31:
+//      4  x10     	 MOVE.L 	 D3, D0
+//     10  x10     	 BGT 	 L31
+//                 ; L31: 2 instructions, 14 cycles x10 = 140
+// ============================================================================
+void costFun(Cost* cost, IrFun* fun) {
+  char line[IRMAXLINE + 64];
+  char text[IRMAXLINE];
+  char tag[32];
+
+  if (cost->num == cost->cap) {
+    cost->cap = cost->cap ? 2 * cost->cap : IRMINCAP;
+    cost->fun = realloc(cost->fun, cost->cap * sizeof(CostFun));
+    if (!cost->fun) utDie2Str("costFun", "Out of memory");
+  }
+  CostFun* cf = &cost->fun[cost->num++];
+  memset(cf, 0, sizeof(CostFun));
+  cf->name = fun->funid;
+
+  costLoops(cost, fun);
+
+  char* name = internStr(fun->funid);
+  sprintf(line, "%16s%.*s:", "", IRMAXNAME, name);
+  emitCode(cost->list, line);
+
+  for (int b = 0; b < fun->num; ++b) {
+    IrBlock* blk = &fun->blk[b];
+    int depth = cost->depth[b];
+    uint64_t weight = costWeight(cost->trip, depth);
+    tag[0] = '\0';
+    if (depth) sprintf(tag, "x%llu", (unsigned long long) weight);
+
+    if (blk->label != IRNOLABEL) {
+      sprintf(line, "%16sL%d:", "", blk->label);
+      emitCode(cost->list, line);
+    }
+
+    int instrs = 0, cycles = 0;
+    for (int i = 0; i < blk->num; ++i) {
+      IrIns* ins = &blk->ins[i];
+      if (ins->op == IRNOP) continue;
+
+      int top = costTarget(cost, ins);
+      int c = costIns(ins, top >= 0 && top <= b);       // back: closes a loop
+      ++instrs;
+      cycles += c;
+
+      irFormat(ins, text);
+      sprintf(line, "%6d  %-8s%s", c, tag, text);
+      emitCode(cost->list, line);
+    }
+    if (instrs == 0) continue;
+
+    ++cf->blocks;
+    cf->instrs += instrs;
+    cf->cycles += (uint64_t) cycles;
+    cf->weighted += (uint64_t) cycles * weight;
+    if (depth > cf->depth) cf->depth = depth;
+
+    char where[32];
+    if (blk->label != IRNOLABEL) sprintf(where, "L%d", blk->label);
+    else sprintf(where, "block %d", b);
+    if (depth) {
+      sprintf(line, "%16s; %s: %d instructions, %d cycles %s = %llu", "", where,
+        instrs, cycles, tag, (unsigned long long) cycles * weight);
+    } else {
+      sprintf(line, "%16s; %s: %d instructions, %d cycles", "", where, instrs, cycles);
+    }
+    emitCode(cost->list, line);
+  }
+
+  sprintf(line, "%16s; %.*s: %d blocks, %d instructions, %llu cycles, %llu weighted",
+    "", IRMAXNAME, name, cf->blocks, cf->instrs, (unsigned long long) cf->cycles,
+    (unsigned long long) cf->weighted);
+  emitCode(cost->list, line);
+  emitCode(cost->list, "");
+}
+
+// ============================================================================
+// Build a new Cost, that weights each loop by 'trip' (0 => COSTTRIP)
+// ============================================================================
+Cost* costNew(int trip) {
+  Cost* cost = calloc(1, sizeof(Cost));
+  if (!cost) utDie2Str("costNew", "Out of memory");
+  cost->trip = trip > 0 ? trip : COSTTRIP;
+  cost->list = emitNew();
+  return cost;
+}
+
+// ============================================================================
+// Print the summary table: one row per function, then the totals
+// ============================================================================
+void costReport(Cost* cost) {
+  char line[IRMAXLINE + 64];
+  CostFun total;
+  costTotal(cost, &total);
+
+  printf("\nCost: %s \n", costHead);
+  for (int f = 0; f < cost->num; ++f) {
+    costRow(line, internStr(cost->fun[f].name), &cost->fun[f]);
+    printf("Cost: %s \n", line);
+  }
+  costRow(line, "total", &total);
+  printf("Cost: %s \n", line);
+  printf("Cost: loops weighted by trip %d \n", cost->trip);
+}
+
+// ============================================================================
+// Write the listing, then the summary table as comments, to the .LST file
+// beside 'x68Path' - eg: "test01.X68" => "test01.LST".  The listing is freed
+// as it goes.
+// ============================================================================
+void costSave(Cost* cost, char* x68Path) {
+  char line[IRMAXLINE + 64];
+  CostFun total;
+  costTotal(cost, &total);
+
+  sprintf(line, "; %s", costHead);
+  emitCode(cost->list, line);
+  for (int f = 0; f < cost->num; ++f) {
+    line[0] = ';'; line[1] = ' ';
+    costRow(line + 2, internStr(cost->fun[f].name), &cost->fun[f]);
+    emitCode(cost->list, line);
+  }
+  line[0] = ';'; line[1] = ' ';
+  costRow(line + 2, "total", &total);
+  emitCode(cost->list, line);
+  sprintf(line, "; loops weighted by trip %d", cost->trip);
+  emitCode(cost->list, line);
+
+  char* path = malloc(strlen(x68Path) + 5);
+  if (!path) utDie2Str("costSave", "Out of memory");
+  strcpy(path, x68Path);
+  char* dot = strrchr(path, '.');
+  if (dot) strcpy(dot, ".LST"); else strcat(path, ".LST");
+  emitSave(cost->list, path);
+  free(path);
+}
+
+// ============================================================================
+// Free 'cost', and all it holds
+// ============================================================================
+void costFree(Cost* cost) {
+  free(cost->list);
+  free(cost->fun);
+  free(cost->depth);
+  free(cost->at);
+  free(cost);
+}
@@ -0,0 +1,74 @@
+// cost.h - Static cycle-cost estimate of the 68000 code
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint64_t
+#include <stdio.h>          // printf, sprintf
+#include <stdlib.h>         // calloc, realloc, free
+#include <string.h>         // memset, strcpy, strrchr
+
+#include "asm.h"            // AsmIns, asmCost, asmMulsExtra
+#include "emit.h"           // Emit, for the listing
+#include "intern.h"         // internStr
+#include "ir.h"             // IrFun, IrBlock, IrIns, irFormat
+#include "ut.h"             // ut*
+
+// With -cost, costFun looks at each function just before irPrint emits it,
+// and estimates what each instruction costs, in 68000 clock cycles, without
+// running anything.  The fixed part of each cost comes from the same timing
+// table the simulator uses (asmCost, in asm.c).  Where the cost depends on
+// data, costFun guesses:
+//
+//    Bcc that jumps back (a loop)    taken           10
+//    Bcc that jumps forward          not taken        8
+//    MULS #n, Dx                     exact, from the bits of n
+//    MULS Dy, Dx                     38 + 16: half the bit pairs differ
+//    BSR                             18, plus nothing for the callee
+//
+// Every branch is taken to be short.  A block's cost is the sum of its
+// instructions; a function's is the sum of its blocks.
+//
+// A branch to a label at or before it closes a loop over the blocks from the
+// label down to the branch.  Loops may nest.  Each block is weighted by trip
+// raised to the number of loops that enclose it - trip being the number of
+// times a loop is taken to run (-trip n, COSTTRIP by default) - so that the
+// weighted cost of a function shows where its time will be spent.
+//
+// costFun writes an annotated listing, one line per instruction: its cycles,
+// the weight of its block, then the instruction as irPrint will emit it.
+// Each block ends with a line that sums it up, and each function with a line
+// for its totals.  costSave writes the listing, with the table that
+// costReport prints, to the .LST file that sits beside the .X68 file.
+
+#define COSTTRIP      10    // times a loop runs, if not given by -trip
+#define COSTMULSREG   16    // MULS Dy, Dx: cycles beyond the fixed part
+#define COSTMAXWEIGHT 1000000000000ULL  // weights stop growing here
+
+typedef struct {
+  int      name;            // intern ID
+  int      blocks;          // blocks holding an instruction
+  int      instrs;          // instructions
+  int      depth;           // deepest loop nest
+  uint64_t cycles;          // sum over instructions, unweighted
+  uint64_t weighted;        // sum over blocks, of cycles * weight
+} CostFun;
+
+typedef struct {
+  int      trip;            // times a loop is taken to run
+  Emit*    list;            // the annotated listing
+  int      num;             // functions in use
+  int      cap;             // slots in fun[]
+  CostFun* fun;             // per function, in the order compiled
+  int      numDepth;        // slots in depth[]
+  int*     depth;           // per block of the current function: loops around it
+  int      lo, hi;          // lowest and highest label in the current function
+  int      numAt;           // slots in at[]
+  int*     at;              // label - lo => index of the block it heads (-1 => none)
+} Cost;
+
+void  costFree(Cost* cost);
+void  costFun(Cost* cost, IrFun* fun);
+Cost* costNew(int trip);
+void  costReport(Cost* cost);
+void  costSave(Cost* cost, char* x68Path);
@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# Differential checks
+#
+# Runs "subc -diff" on each program in ../Tests: it must exit 0, as the
+# interpreter, the simulator and the VM agree.  Then the same with "-ssa",
+# and with "-target x64", where the native program stands in for the
+# simulator.  test17 recurses a million calls deep, through tail calls, so
+# it fails on any route that lets the stack grow.
+#
+# Then runs test01 once more, against a doctored runtime whose sayn prints
+# n + 1, and checks that the mismatch makes it exit 1 - so a script can rely
+# on the exit status.  A program that does not compile must exit 2.
+#
+# Works on a copy of the Tests folder, so the real runtime is never touched.
+#
+# Usage: bash difftest.sh          (run from the P4 folder)
+
+. ./build.sh
+build subc-difftest || exit 1
+exe=$PWD/subc-difftest
+dir=$(mktemp -d)
+mkdir $dir/P4 $dir/Tests
+cp ../Tests/*.subc ../Tests/io.X68 ../Tests/io.s $dir/Tests
+fail=0
+
+# Expect "subc -diff ../Tests/<name>.subc", with any further options, to
+# exit with status 'want'
+
+expect() {
+  local want=$1 name=$2
+  shift 2
+  (cd $dir/P4 && $exe "$@" -diff ../Tests/$name.subc < /dev/null > $name.out 2>&1)
+  local rc=$?
+  if [ $rc = $want ]; then
+    echo "ok    $name${*:+ $*} (exit $rc)"
+  else
+    echo "FAIL  $name${*:+ $*}: exit $rc, not $want"; grep "Diff:\|ERROR" $dir/P4/$name.out; fail=1
+  fi
+}
+
+for src in ../Tests/test*.subc; do
+  b=$(basename $src .subc)
+  [ "$b" = testr ] && continue                    # no main
+  expect 0 $b
+  expect 0 $b -ssa
+  expect 0 $b -target x64
+done
+
+# A syntax error stops the compile, before any run
+
+echo 'int main() { return 0 }' > $dir/Tests/bad.subc
+expect 2 bad
+expect 2 bad -target x64
+
+# The simulator, and the native program, now print each number one too high
+
+sed -i 's/^\(.*MOVE.L  (8,A7), D1 .*\)$/\1\n        ADDQ.L  #1, D1              ; doctored: n + 1/' $dir/Tests/io.X68
+sed -i 's/^\(sayn: .*\)$/\1\n        incl    %edi                # doctored: n + 1/' $dir/Tests/io.s
+expect 1 test01
+expect 1 test01 -target x64
+
+rm -rf $dir subc-difftest
+exit $fail
@@ -2,31 +2,166 @@
 
 #include "emit.h"
 
+// ============================================================================
+// Append the 'len' chars at 's' onto 'rope', starting a new chunk if the tail
+// has no room
+// ============================================================================
+static void emitAppend(EmitRope* rope, char* s, size_t len) {
+  EmitChunk* tail = rope->tail;
+  if (tail == NULL || tail->used + len > tail->size) {
+    size_t size = len > EMITCHUNK ? len : EMITCHUNK;
+    EmitChunk* chunk = malloc(sizeof(EmitChunk) + size);
+    if (!chunk) utDie2Str("emitAppend", "Out of memory for output text");
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    if (tail) tail->next = chunk; else rope->head = chunk;
+    rope->tail = chunk;
+    ++rope->num;
+  }
+  memcpy(rope->tail->text + rope->tail->used, s, len);
+  rope->tail->used += len;
+  rope->bytes += len;
+}
+
+// ============================================================================
+// Append 'line', and the " \n" that ends each line, onto 'rope'
+// ============================================================================
+static void emitLine(EmitRope* rope, char* line) {
+  emitAppend(rope, line, strlen(line));
+  emitAppend(rope, " \n", 2);
+}
+
+// ============================================================================
+// Stream every full chunk of code out to the spill file, and free it
+// ============================================================================
+static void emitSpill(Emit* emit) {
+  EmitRope* code = &emit->code;
+  if (emit->spill == NULL) {
+    emit->spill = tmpfile();
+    if (!emit->spill) utDie2Str("emitSpill", "Cannot create spill file");
+  }
+  while (code->head != code->tail) {
+    EmitChunk* chunk = code->head;
+    if (fwrite(chunk->text, 1, chunk->used, emit->spill) != chunk->used) {
+      utDie2Str("emitSpill", "Cannot write spill file");
+    }
+    emit->spilled += chunk->used;
+    code->bytes   -= chunk->used;
+    code->head     = chunk->next;
+    --code->num;
+    free(chunk);
+  }
+}
+
+// ============================================================================
+// Free every chunk of 'rope', leaving it empty
+// ============================================================================
+static void emitFreeRope(EmitRope* rope) {
+  EmitChunk* chunk = rope->head;
+  while (chunk) {
+    EmitChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  rope->head  = rope->tail = NULL;
+  rope->num   = 0;
+  rope->bytes = 0;
+}
+
+// ============================================================================
+// Write the 'len' chars at 'buf' to 'file'.  Abort if that fails.
+// ============================================================================
+static void emitWrite(FILE* file, char* buf, size_t len) {
+#ifdef _WIN32
+  if (fwrite(buf, 1, len, file) != len) utDie2Str("emitWrite", "Cannot write output file");
+#else
+  int fd = fileno(file);
+  while (len) {
+    ssize_t w = write(fd, buf, len);
+    if (w < 0) utDie2Str("emitWrite", "Cannot write output file");
+    buf += w;
+    len -= (size_t) w;
+  }
+#endif
+}
+
+// ============================================================================
+// Write every chunk of 'rope' to 'file'.  With writev, a batch of chunks
+// goes in a single call, straight from where they lie.
+// ============================================================================
+static void emitWriteRope(FILE* file, EmitRope* rope) {
+#ifdef _WIN32
+  for (EmitChunk* c = rope->head; c; c = c->next) emitWrite(file, c->text, c->used);
+#else
+  enum { MAXIOV = IOV_MAX < 64 ? IOV_MAX : 64 };
+  struct iovec iov[MAXIOV];
+  int fd = fileno(file);
+
+  EmitChunk* c = rope->head;
+  while (c) {
+    int num = 0;
+    for (; c && num < MAXIOV; c = c->next) {
+      iov[num].iov_base = c->text;
+      iov[num].iov_len  = c->used;
+      ++num;
+    }
+
+    int k = 0;                                  // first iov not fully written
+    while (k < num) {
+      ssize_t w = writev(fd, &iov[k], num - k);
+      if (w < 0) utDie2Str("emitWriteRope", "Cannot write output file");
+      while (k < num && (size_t) w >= iov[k].iov_len) w -= iov[k++].iov_len;
+      if (k < num) {
+        iov[k].iov_base = (char*) iov[k].iov_base + w;
+        iov[k].iov_len -= w;
+      }
+    }
+  }
+#endif
+}
+
 // ============================================================================
 // Emit the text in 'line' into the code section of the emit buffer
 // called 'emit'
 // ============================================================================
 void emitCode(Emit* emit, char* line) {
-  int offset = emit->codeSize;
-  emit->codeSize += sprintf(emit->codeBuf + offset, "%s \n", line);
+  emitLine(&emit->code, line);
+  if (emit->code.num > EMITMAXCHUNKS) emitSpill(emit);
 }
 
 // ============================================================================
 // Emit the text in 'line' into the data section of the emit buffer called 'eb'
 // ============================================================================
 void emitData(Emit* emit, char* line) {
-  int offset = emit->dataSize;
-  emit->dataSize += sprintf(emit->dataBuf + offset, "%s \n", line);
+  emitLine(&emit->data, line);
+}
+
+// ============================================================================
+// Emit the string literal 'txt', under the data label 'label'.  Eg:
+//
+//    L50:
+//       DC.B    'hello',0
+// ============================================================================
+void emitDataString(Emit* emit, int label, char* txt) {
+  char line[32];
+  sprintf(line, "L%d:", label);
+  emitData(emit, line);
+
+  emitAppend(&emit->data, "\t DC.B \t '", 10);
+  emitAppend(&emit->data, txt, strlen(txt));
+  emitAppend(&emit->data, "',0 \n", 5);
 }
 
 // ============================================================================
-// Dump the text (codeBuf and dataBuf) currently held in 'emit'
+// Dump the text (code and data) currently held in 'emit'
 // ============================================================================
 void emitDump(Emit* emit) {
   printf("\n\n");
-  printf("%s", emit->codeBuf);
+  if (emit->spilled) printf("(%zu bytes of code already spilled) \n", emit->spilled);
+  for (EmitChunk* c = emit->code.head; c; c = c->next) fwrite(c->text, 1, c->used, stdout);
   printf("\n");
-  printf("%s", emit->dataBuf);
+  for (EmitChunk* c = emit->data.head; c; c = c->next) fwrite(c->text, 1, c->used, stdout);
 }
 
 // ============================================================================
@@ -34,14 +169,7 @@ void emitDump(Emit* emit) {
 // ============================================================================
 Emit* emitNew() {
   Emit* emit = calloc(sizeof(Emit), 1);
-  assert(emit);
-
-  emit->codeBuf  = calloc(CODESIZE, 1);
-  emit->codeSize = 0;
-
-  emit->dataBuf  = calloc(DATASIZE, 1);
-  emit->dataSize = 0;
-
+  if (!emit) utDie2Str("emitNew", "Out of memory");
   return emit;
 }
 
@@ -58,11 +186,13 @@ Emit* emitNew() {
 char* emitNewName(char* sourcePath) {
 
   char* path = calloc(100, 1);              // buffer for output file name
-  assert(path);
+  if (!path) utDie2Str("emitNewName", "Out of memory");
 
   char* wack = strrchr(sourcePath, '\\');   // find last wack ("\")
+  char* slash = strrchr(sourcePath, '/');   // or slash, on Linux
+  if (!wack || (slash && slash > wack)) wack = slash;
 
-  strcpy(path, wack + 1);                   // eg: "test01.subc"
+  strcpy(path, wack ? wack + 1 : sourcePath); // eg: "test01.subc"
   char* dot = strrchr(path, '.');           // find last dot (".")
   strncpy(dot + 1, "X68\0", 4);             // eg: "test01.X68"
 
@@ -71,30 +201,33 @@ char* emitNewName(char* sourcePath) {
 
 // ============================================================================
 // Save the current Emit buffer - data and assembler code, generated by the
-// SubC Compiler - to a file on disk, specified by 'filePath'
+// SubC Compiler - to a file on disk, specified by 'filePath': the data, then
+// any code spilled so far, then the code still held.  The ropes are freed as
+// they go.
 // ============================================================================
 void emitSave(Emit* emit, char* filePath) {
   FILE* file = fopen(filePath, "w");
 
   if (!file) utDie2Str("emitCreateFile: Cannot create output assembly file: ", filePath);
 
-  // Combine the Code and Data sections of the Emit struct into a contiguous
-  // block of memory
-
-  int totalSize = emit->dataSize + emit->codeSize;
-
-  char* totalBuf = calloc(totalSize, 1);
-  assert(totalBuf);
-
-  memcpy(totalBuf, emit->dataBuf, emit->dataSize);
-
-  char* codeStart = totalBuf + emit->dataSize;
-  memcpy(codeStart, emit->codeBuf, emit->codeSize);
-
-  // Write 'totalBuf' to disk
-
-  int written = fwrite(totalBuf, 1, totalSize, file);
-  assert(written = totalSize);
+  emitWriteRope(file, &emit->data);
+  emitFreeRope(&emit->data);
+
+  if (emit->spill) {
+    char* buf = malloc(EMITCHUNK);
+    if (!buf) utDie2Str("emitSave", "Out of memory for copy buffer");
+    fflush(emit->spill);
+    rewind(emit->spill);
+    size_t got;
+    while ((got = fread(buf, 1, EMITCHUNK, emit->spill)) > 0) emitWrite(file, buf, got);
+    free(buf);
+    fclose(emit->spill);
+    emit->spill   = NULL;
+    emit->spilled = 0;
+  }
+
+  emitWriteRope(file, &emit->code);
+  emitFreeRope(&emit->code);
 
   fclose(file);
 
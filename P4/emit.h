@@ -3,23 +3,63 @@
 #pragma once
 
 #include <assert.h>     // assert
-#include <stdio.h>      // sprintf
+#include <stdio.h>      // FILE, fopen, fwrite, tmpfile
+#include <stdlib.h>     // malloc, free
+#include <string.h>     // memcpy, strlen
+
+#ifndef _WIN32
+#include <limits.h>     // IOV_MAX
+#include <sys/uio.h>    // writev
+#include <unistd.h>     // write
+#ifndef IOV_MAX
+#define IOV_MAX 16      // least that POSIX allows
+#endif
+#endif
 
 #include "ut.h"         // ut*
 
+// The output file holds the data section (string literals), then the code.
+// Each is kept as a rope: a chain of chunks, each EMITCHUNK bytes (or more,
+// for a longer line), appended to at the tail.  Neither has a size limit.
+//
+// The code grows with the program, so it is not all kept in memory: once
+// more than EMITMAXCHUNKS chunks of code are full, they are streamed out to
+// a spill file, and freed.  Since the data must come first in the output,
+// and a later function may still add to it, the spill file is a temporary,
+// copied into place by emitSave.  So memory for code stays bounded, however
+// large the program.
+//
+// emitSave writes the data rope, the spill file, and the rest of the code
+// rope, a chunk at a time - with writev, where there is one.
+
+#define EMITCHUNK     (64 * 1024)   // bytes per chunk
+#define EMITMAXCHUNKS 16            // full code chunks held before spilling
+
+typedef struct EmitChunk_ {
+  struct EmitChunk_* next;
+  size_t size;                      // bytes available in text[]
+  size_t used;                      // bytes filled so far
+  char   text[];
+} EmitChunk;
+
 typedef struct {
-  #define CODESIZE 5000
-  char* codeBuf;
-  int   codeSize;
+  EmitChunk* head;                  // first chunk (NULL => empty)
+  EmitChunk* tail;                  // chunk being filled
+  int        num;                   // chunks in the chain
+  size_t     bytes;                 // text held in the chain
+} EmitRope;
 
-  #define DATASIZE 5000
-  char* dataBuf;
-  int   dataSize;
+typedef struct {
+  EmitRope code;
+  EmitRope data;
+  FILE*    spill;                   // code streamed out ahead of 'code' (NULL => none)
+  size_t   spilled;                 // bytes in 'spill'
 } Emit;
 
 void  emitCode(Emit* emit, char* line);
 void  emitData(Emit* emit, char* line);
+void  emitDataString(Emit* emit, int label, char* txt);
 void  emitDump(Emit* emit);
 Emit* emitNew();
 char* emitNewName(char* sourcePath);
-void  emitSave(Emit* emit, char* filePath);
\ No newline at end of file
+void  emitSave(Emit* emit, char* filePath);
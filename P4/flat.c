@@ -0,0 +1,210 @@
+// flat.c - Flat, index-based encoding of the AST
+
+#include "flat.h"
+
+static void flatExp(Flat* flat, AstExp* astexp);
+static void flatStms(Flat* flat, AstStm* aststm);
+
+// ============================================================================
+// Finish node 'n': its subtree ends just before the next free node
+// ============================================================================
+void flatClose(Flat* flat, int n) {
+  flat->node[n].end = (uint32_t) flat->num;
+}
+
+// ============================================================================
+// Append a new node onto 'flat', growing the array if it is full.  Return its
+// index.  Its subtree is, so far, just the node itself.
+// ============================================================================
+int flatOpen(Flat* flat, AST tag, int val) {
+  if (flat->num == flat->cap) {
+    flat->cap *= 2;
+    flat->node = realloc(flat->node, flat->cap * sizeof(FlatNode));
+    if (!flat->node) utDie2Str("flatOpen", "Out of memory for nodes");
+  }
+  int n = flat->num++;
+  FlatNode* node = &flat->node[n];
+  node->tag = (uint8_t) tag;
+  node->bop = 0;
+  node->end = (uint32_t) flat->num;
+  node->val = val;
+  return n;
+}
+
+// ============================================================================
+// Append a leaf node for the Nam, Num or Str 'nns'
+// ============================================================================
+static void flatNNS(Flat* flat, Ast* nns) {
+  if (nns->kind == ASTNAM) {
+    flatOpen(flat, ASTNAM, ((AstNam*) nns)->id);
+  } else if (nns->kind == ASTNUM) {
+    flatOpen(flat, ASTNUM, ((AstNum*) nns)->val);
+  } else if (nns->kind == ASTSTR) {
+    if (flat->numStr == flat->capStr) {
+      flat->capStr *= 2;
+      flat->str = realloc(flat->str, flat->capStr * sizeof(char*));
+      if (!flat->str) utDie2Str("flatNNS", "Out of memory for strings");
+    }
+    flat->str[flat->numStr] = ((AstStr*) nns)->txt;
+    flatOpen(flat, ASTSTR, flat->numStr++);
+  } else {
+    utDie2Str("flatNNS", "Invalid argument kind");
+  }
+}
+
+// ============================================================================
+// Call => Nam "(" Args ")"
+// ============================================================================
+static void flatCall(Flat* flat, AstCall* astcall) {
+  int n = flatOpen(flat, ASTCALL, astcall->nam->id);
+  for (AstArg* arg = astcall->args; arg; arg = (AstArg*) arg->next) {
+    flatNNS(flat, arg->nns);
+  }
+  flatClose(flat, n);
+}
+
+// ============================================================================
+// Exp => NamNum | NamNum Bop NamNum
+// ============================================================================
+static void flatExp(Flat* flat, AstExp* astexp) {
+  int n = flatOpen(flat, ASTEXP, 0);
+  flat->node[n].bop = (uint8_t) astexp->bop;
+  if (astexp->lhs) flatNNS(flat, astexp->lhs);
+  if (astexp->rhs) flatNNS(flat, astexp->rhs);
+  flatClose(flat, n);
+}
+
+// ============================================================================
+// Fun => "int" Nam "(" Pars ")" Body
+// ============================================================================
+static void flatFun(Flat* flat, AstFun* astfun) {
+  int n = flatOpen(flat, ASTFUN, astfun->nam->id);
+  for (AstPar* par = astfun->pars; par; par = (AstPar*) par->next) {
+    flatOpen(flat, ASTPAR, par->nam->id);
+  }
+  if (astfun->body) {
+    for (AstVar* var = astfun->body->vars; var; var = (AstVar*) var->next) {
+      flatOpen(flat, ASTVAR, var->nam->id);
+    }
+    flatStms(flat, astfun->body->stms);
+  }
+  flatClose(flat, n);
+}
+
+// ============================================================================
+// Stm => If | Asg | Ret | While
+// ============================================================================
+static void flatStm(Flat* flat, AstStm* aststm) {
+  int n;
+  switch (aststm->kind) {
+    case ASTASG:   { AstAsg* astasg = (AstAsg*) aststm;
+                     n = flatOpen(flat, ASTASG, astasg->nam->id);
+                     if (astasg->eoc->kind == ASTCALL) {
+                       flatCall(flat, (AstCall*) astasg->eoc);
+                     } else {
+                       flatExp(flat, (AstExp*) astasg->eoc);
+                     }
+                     break;
+                   }
+    case ASTIF:    { AstIf* astif = (AstIf*) aststm;
+                     n = flatOpen(flat, ASTIF, 0);
+                     flatExp(flat, astif->exp);
+                     flatStms(flat, astif->block->stms);
+                     break;
+                   }
+    case ASTRET:   { AstRet* astret = (AstRet*) aststm;
+                     n = flatOpen(flat, ASTRET, 0);
+                     flatExp(flat, astret->exp);
+                     break;
+                   }
+    case ASTWHILE: { AstWhile* astwhile = (AstWhile*) aststm;
+                     n = flatOpen(flat, ASTWHILE, 0);
+                     flatExp(flat, astwhile->exp);
+                     flatStms(flat, astwhile->block->stms);
+                     break;
+                   }
+    default:       { utDie2Str("flatStm", "Invalid aststm->kind"); return; }
+  }
+  flatClose(flat, n);
+}
+
+// ============================================================================
+// Stms => Stm+
+// ============================================================================
+static void flatStms(Flat* flat, AstStm* aststm) {
+  for (; aststm; aststm = (AstStm*) aststm->next) flatStm(flat, aststm);
+}
+
+// ============================================================================
+// Count the children of node 'n'
+// ============================================================================
+int flatCountKids(Flat* flat, int n) {
+  int num = 0;
+  for (int c = n + 1; c < (int) flat->node[n].end; c = flat->node[c].end) {
+    ++num;
+  }
+  return num;
+}
+
+// ============================================================================
+// Dump every node in 'flat' to the console, for debugging.  The depth of each
+// node is recovered from the 'end' of its enclosing nodes.
+// ============================================================================
+void flatDump(Flat* flat) {
+  uint32_t stack[64];                           // ends of enclosing nodes
+  int depth = 0;
+  printf("\n\nFlat: num = %d \n", flat->num);
+  for (int n = 0; n < flat->num; ++n) {
+    while (depth > 0 && stack[depth - 1] <= (uint32_t) n) --depth;
+    FlatNode* node = &flat->node[n];
+    printf("  [%4d] %*s%s", n, 2 * depth, "", astASTtoStr(node->tag));
+    if (node->tag == ASTSTR) {
+      printf(" \"%s\"", flat->str[node->val]);
+    } else if (node->tag == ASTNUM) {
+      printf(" %d", node->val);
+    } else if (node->tag == ASTEXP) {
+      printf(" %s", astBOPtoStr(node->bop));
+    } else if (node->val) {
+      printf(" %s", internStr(node->val));
+    }
+    printf(" \t end = %u \n", node->end);
+    if (node->end > (uint32_t) n + 1 && depth < 64) stack[depth++] = node->end;
+  }
+}
+
+// ============================================================================
+// Release 'flat', along with its arrays
+// ============================================================================
+void flatFree(Flat* flat) {
+  free(flat->node);
+  free(flat->str);
+  free(flat);
+}
+
+// ============================================================================
+// Build a new, empty Flat
+// ============================================================================
+Flat* flatNew() {
+  Flat* flat = calloc(1, sizeof(Flat));
+  if (!flat) utDie2Str("flatNew", "Out of memory");
+  flat->cap    = FLATMINCAP;
+  flat->node   = malloc(FLATMINCAP * sizeof(FlatNode));
+  flat->capStr = FLATMINCAP;
+  flat->str    = malloc(FLATMINCAP * sizeof(char*));
+  if (!flat->node || !flat->str) utDie2Str("flatNew", "Out of memory");
+  return flat;
+}
+
+// ============================================================================
+// Encode the program 'astprog' as a Flat
+// ============================================================================
+Flat* flatProg(AstProg* astprog) {
+  Flat* flat = flatNew();
+
+  int n = flatOpen(flat, ASTPROG, 0);
+  for (AstFun* fun = astprog->funs; fun; fun = (AstFun*) fun->next) {
+    flatFun(flat, fun);
+  }
+  flatClose(flat, n);
+  return flat;
+}
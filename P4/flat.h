@@ -0,0 +1,66 @@
+// flat.h - Flat, index-based encoding of the AST
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint8_t, uint32_t
+#include <stdio.h>          // printf
+#include <stdlib.h>         // malloc, realloc
+
+#include "ast.h"            // AstProg, AST, BOP
+#include "intern.h"         // internStr
+#include "ut.h"             // ut*
+
+// A Flat holds the whole program as one array of small FlatNodes, laid out
+// in pre-order.  So the first child of node 'n' (if any) is node n + 1, and
+// a subtree occupies the contiguous run of nodes [n, node[n].end).  To step
+// over every child of node 'n':
+//
+//    for (int c = n + 1; c < flat->node[n].end; c = flat->node[c].end) ...
+//
+// Passes that do not care about the tree shape simply scan the array from
+// start to end.
+//
+// The wrapper nodes of the pointer AST (Body, Block, Stm, Arg) do not appear:
+// their contents are spliced into the parent.  The tag is the AST kind of the
+// node; 'val' depends upon that kind:
+//
+//    ASTPROG  : 0           children: Fun+
+//    ASTFUN   : fun ID      children: Par* Var* Stm+
+//    ASTPAR   : par ID
+//    ASTVAR   : var ID
+//    ASTASG   : var ID      children: Exp | Call
+//    ASTIF    : 0           children: Exp Stm+
+//    ASTWHILE : 0           children: Exp Stm+
+//    ASTRET   : 0           children: Exp
+//    ASTCALL  : fun ID      children: (Nam | Num | Str)*
+//    ASTEXP   : 0           children: NamNum NamNum?  ('bop' is the operator)
+//    ASTNAM   : name ID
+//    ASTNUM   : the number
+//    ASTSTR   : index into flat->str[]
+
+#define FLATMINCAP 256      // initial number of nodes
+
+typedef struct {
+  uint8_t  tag;             // AST kind - eg: ASTWHILE
+  uint8_t  bop;             // for ASTEXP, the BOP (else 0)
+  uint32_t end;             // index of the first node beyond this subtree
+  int      val;             // ID, number or string index (see above)
+} FlatNode;
+
+typedef struct {
+  int       num;            // number of nodes in use
+  int       cap;            // number of slots in node[]
+  FlatNode* node;           // the nodes, in pre-order
+  int       numStr;         // number of string literals
+  int       capStr;         // number of slots in str[]
+  char**    str;            // text of each string literal
+} Flat;
+
+void  flatClose(Flat* flat, int n);
+int   flatCountKids(Flat* flat, int n);
+void  flatDump(Flat* flat);
+void  flatFree(Flat* flat);
+Flat* flatNew();
+int   flatOpen(Flat* flat, AST tag, int val);
+Flat* flatProg(AstProg* astprog);
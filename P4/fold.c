@@ -0,0 +1,281 @@
+// fold.c - Constant folding and propagation
+
+#include "fold.h"
+
+static int foldStms(Fold* fold, int first, int end);
+
+// ============================================================================
+// Apply 'bop' to 'a' and 'b', just as the code generated by cgBop would
+// ============================================================================
+int foldBop(BOP bop, int a, int b) {
+  switch (bop) {
+    case BOPADD: return (int) ((uint32_t) a + (uint32_t) b);
+    case BOPSUB: return (int) ((uint32_t) a - (uint32_t) b);
+    case BOPMUL: return (int) (int16_t) a * (int) (int16_t) b;    // MULS
+    case BOPLT:  return a <  b;
+    case BOPLE:  return a <= b;
+    case BOPNE:  return a != b;
+    case BOPEEQ: return a == b;
+    case BOPGE:  return a >= b;
+    case BOPGT:  return a >  b;
+    default:     utDie2Str("foldBop", "Invalid operator"); return 0;
+  }
+}
+
+// ============================================================================
+// Record what is known about the par or var 'id'
+// ============================================================================
+static void foldSet(Fold* fold, int id, int known, int val) {
+  if (id <= 0 || id >= fold->numId) return;
+  fold->known[id] = (uint8_t) known;
+  fold->val[id]   = val;
+}
+
+// ============================================================================
+// Forget the value of every var assigned within nodes [first, end)
+// ============================================================================
+static void foldKill(Fold* fold, int first, int end) {
+  FlatNode* node = fold->in->node;                      // alias
+  for (int n = first; n < end; ++n) {
+    if (node[n].tag == ASTASG) foldSet(fold, node[n].val, 0, 0);
+  }
+}
+
+// ============================================================================
+// Is the value of leaf 'n' (a Nam, Num or Str) known?  If so, set '*val'
+// ============================================================================
+static int foldLeaf(Fold* fold, int n, int* val) {
+  FlatNode* node = &fold->in->node[n];
+  if (node->tag == ASTNUM) {
+    *val = node->val;
+    return 1;
+  }
+  if (node->tag == ASTNAM && node->val > 0 && node->val < fold->numId
+    && fold->known[node->val]) {
+    *val = fold->val[node->val];
+    return 1;
+  }
+  return 0;
+}
+
+// ============================================================================
+// Is the value of Exp 'exp' known?  If so, set '*val'
+// ============================================================================
+static int foldEval(Fold* fold, int exp, int* val) {
+  FlatNode* node = fold->in->node;                      // alias
+  int end = node[exp].end;
+
+  int lhs = exp + 1;
+  if (lhs == end) return 0;
+  int a;
+  if (!foldLeaf(fold, lhs, &a)) return 0;
+
+  int rhs = node[lhs].end;
+  if (rhs == end) { *val = a; return 1; }
+  int b;
+  if (!foldLeaf(fold, rhs, &b)) return 0;
+
+  *val = foldBop(node[exp].bop, a, b);
+  return 1;
+}
+
+// ============================================================================
+// Copy leaf 'n' into the output.  A Nam whose value is known becomes a Num.
+// ============================================================================
+static void foldCopyLeaf(Fold* fold, int n) {
+  FlatNode* node = &fold->in->node[n];
+  int val;
+  if (node->tag == ASTNAM && foldLeaf(fold, n, &val)) {
+    flatOpen(fold->out, ASTNUM, val);
+    ++fold->replaced;
+  } else {
+    flatOpen(fold->out, node->tag, node->val);
+  }
+}
+
+// ============================================================================
+// Copy Exp 'exp' into the output, folded to a single Num if its value is
+// known.  Return 1 if so, setting '*val'.
+// ============================================================================
+static int foldExp(Fold* fold, int exp, int* val) {
+  FlatNode* node = fold->in->node;                      // alias
+  Flat*     out  = fold->out;                           // alias
+
+  int e = flatOpen(out, ASTEXP, 0);
+  int known = foldEval(fold, exp, val);
+  if (known) {
+    out->node[e].bop = BOPNONE;
+    flatOpen(out, ASTNUM, *val);
+    if (node[exp + 1].tag != ASTNUM || node[exp].end != (uint32_t) exp + 2) {
+      ++fold->folded;
+    }
+  } else {
+    out->node[e].bop = node[exp].bop;
+    for (int c = exp + 1; c < (int) node[exp].end; c = node[c].end) {
+      foldCopyLeaf(fold, c);
+    }
+  }
+  flatClose(out, e);
+  return known;
+}
+
+// ============================================================================
+// Copy statement 'n' into the output, rewritten.  Return 1 if it is a Ret,
+// so that any statements after it are dead.
+// ============================================================================
+static int foldStm(Fold* fold, int n) {
+  FlatNode* node = fold->in->node;                      // alias
+  Flat*     out  = fold->out;                           // alias
+  int val;
+
+  switch (node[n].tag) {
+    case ASTASG:   { int s = flatOpen(out, ASTASG, node[n].val);
+                     int eoc = n + 1;                                 // Exp or Call
+                     if (node[eoc].tag == ASTCALL) {
+                       int c = flatOpen(out, ASTCALL, node[eoc].val);
+                       for (int a = eoc + 1; a < (int) node[eoc].end; a = node[a].end) {
+                         foldCopyLeaf(fold, a);
+                       }
+                       flatClose(out, c);
+                       foldSet(fold, node[n].val, 0, 0);
+                     } else {
+                       int known = foldExp(fold, eoc, &val);
+                       foldSet(fold, node[n].val, known, val);
+                     }
+                     flatClose(out, s);
+                     return 0;
+                   }
+    case ASTRET:   { int s = flatOpen(out, ASTRET, 0);
+                     foldExp(fold, n + 1, &val);
+                     flatClose(out, s);
+                     return 1;
+                   }
+    case ASTIF:    { int exp = n + 1;
+                     int block = node[exp].end;
+                     if (foldEval(fold, exp, &val)) {                 // decided
+                       ++fold->deleted;
+                       if (val == 0) return 0;
+                       return foldStms(fold, block, node[n].end);
+                     }
+                     int s = flatOpen(out, ASTIF, 0);
+                     foldExp(fold, exp, &val);
+                     foldStms(fold, block, node[n].end);
+                     flatClose(out, s);
+                     foldKill(fold, block, node[n].end);              // merge
+                     return 0;
+                   }
+    case ASTWHILE: { int exp = n + 1;
+                     int block = node[exp].end;
+                     if (foldEval(fold, exp, &val) && val == 0) {     // never runs
+                       ++fold->deleted;
+                       return 0;
+                     }
+                     foldKill(fold, block, node[n].end);              // loop head
+                     int s = flatOpen(out, ASTWHILE, 0);
+                     foldExp(fold, exp, &val);
+                     foldStms(fold, block, node[n].end);
+                     flatClose(out, s);
+                     foldKill(fold, block, node[n].end);              // loop exit
+                     return 0;
+                   }
+    default:       { utDie2Str("foldStm", "Invalid statement kind"); return 0; }
+  }
+}
+
+// ============================================================================
+// Copy the statements that lie between node 'first' and node 'end' into the
+// output.  Return 1 if they end with a Ret.
+// ============================================================================
+static int foldStms(Fold* fold, int first, int end) {
+  FlatNode* node = fold->in->node;                      // alias
+  for (int n = first; n < end; n = node[n].end) {
+    if (foldStm(fold, n)) {
+      for (n = node[n].end; n < end; n = node[n].end) ++fold->deleted;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// ============================================================================
+// Fun => "int" Nam "(" Pars ")" Body
+//
+// Nothing is known about pars on entry, nor about vars, which SubC does not
+// initialize.
+// ============================================================================
+static void foldFun(Fold* fold, int fun) {
+  FlatNode* node = fold->in->node;                      // alias
+  int f = flatOpen(fold->out, ASTFUN, node[fun].val);
+
+  int stm = fun + 1;
+  for (; node[stm].tag == ASTPAR || node[stm].tag == ASTVAR; ++stm) {
+    flatOpen(fold->out, node[stm].tag, node[stm].val);
+    foldSet(fold, node[stm].val, 0, 0);
+  }
+  foldStms(fold, stm, node[fun].end);
+  foldKill(fold, stm, node[fun].end);                   // eg: undeclared names
+
+  flatClose(fold->out, f);
+}
+
+// ============================================================================
+// Build a new Fold
+// ============================================================================
+Fold* foldNew() {
+  Fold* fold = calloc(1, sizeof(Fold));
+  if (!fold) utDie2Str("foldNew", "Out of memory");
+  return fold;
+}
+
+// ============================================================================
+// Rewrite the program 'flat', returning the result as a new Flat.  'flat' is
+// freed, but its string literals move across to the new Flat.
+// ============================================================================
+Flat* foldProg(Fold* fold, Flat* flat) {
+  FlatNode* node = flat->node;                          // alias
+
+  int maxId = 0;
+  for (int n = 0; n < flat->num; ++n) {
+    AST tag = node[n].tag;
+    if (tag == ASTPAR || tag == ASTVAR || tag == ASTASG || tag == ASTNAM) {
+      if (node[n].val > maxId) maxId = node[n].val;
+    }
+  }
+
+  fold->in    = flat;
+  fold->out   = flatNew();
+  fold->numId = maxId + 1;
+  fold->known = calloc(fold->numId, sizeof(uint8_t));
+  fold->val   = calloc(fold->numId, sizeof(int));
+  if (!fold->known || !fold->val) utDie2Str("foldProg", "Out of memory");
+
+  int p = flatOpen(fold->out, ASTPROG, 0);
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    foldFun(fold, fun);
+  }
+  flatClose(fold->out, p);
+
+  Flat* out = fold->out;
+  free(out->str);
+  out->str    = flat->str;
+  out->numStr = flat->numStr;
+  out->capStr = flat->capStr;
+  flat->str   = NULL;
+  flatFree(flat);
+
+  free(fold->known);
+  free(fold->val);
+  fold->known = NULL;
+  fold->val   = NULL;
+  fold->in    = NULL;
+  fold->out   = NULL;
+  return out;
+}
+
+// ============================================================================
+// Print what folding achieved during this compile
+// ============================================================================
+void foldReport(Fold* fold) {
+  printf("\nFold: folded %d, replaced %d, deleted %d \n",
+    fold->folded, fold->replaced, fold->deleted);
+}
@@ -0,0 +1,52 @@
+// fold.h - Constant folding and propagation
+
+#pragma once
+
+#include <stdint.h>         // uint8_t, int16_t, uint32_t
+#include <stdio.h>          // printf
+#include <stdlib.h>         // calloc, realloc, free
+#include <string.h>         // memset
+
+#include "ast.h"            // AST, BOP
+#include "flat.h"           // Flat, FlatNode
+#include "ut.h"             // ut*
+
+// foldProg copies the Flat of a program into a new Flat, rewriting it on the
+// way.  Within each function it tracks which pars and vars hold a value known
+// at compile time, walking the statements in order:
+//
+//    r = 3;            r is 3
+//    r = r + 4;        becomes "r = 7", and r is 7
+//    x = f(r);         becomes "x = f(7)", and x is unknown
+//
+// An Exp whose operands are all known is folded to a single Num, evaluated
+// just as the 68000 would: ADD.L and SUB.L wrap at 32 bits, and MULS
+// multiplies the low 16 bits of each operand.  A relational Exp folds to 0 or
+// 1, and so an If or While whose condition folds is resolved at compile time:
+//
+//    if (0) { ... }          deleted
+//    if (1) { ... }          replaced by its Block
+//    while (0) { ... }       deleted
+//
+// Statements that follow a Ret in the same list are deleted too.
+//
+// Control flow merges are handled conservatively.  After an If whose
+// condition is not known, every var assigned within its Block becomes
+// unknown.  Every var assigned within a While is unknown throughout the loop
+// (its condition included) and after it.
+
+typedef struct {
+  Flat*    in;              // program, as parsed
+  Flat*    out;             // program, rewritten
+  int      numId;           // slots in known[] and val[]
+  uint8_t* known;           // known[id] = 1 => val[id] holds the value of id
+  int*     val;
+  int      folded;          // Exps folded to a Num, whole compile
+  int      replaced;        // Nams replaced by a Num, whole compile
+  int      deleted;         // Stms deleted, whole compile
+} Fold;
+
+int   foldBop(BOP bop, int a, int b);
+Fold* foldNew();
+Flat* foldProg(Fold* fold, Flat* flat);
+void  foldReport(Fold* fold);
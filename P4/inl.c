@@ -0,0 +1,399 @@
+// inl.c - Inliner
+
+#include "inl.h"
+
+static void inlStms(Inl* inl, int first, int end, InlSub* sub, int numSub);
+
+static char* inlWhyNames[INLNUMWHY] = {
+  "inlined", "recursive", "too big", "too deep", "caller too big",
+  "early return", "foreign name", "arity", "string argument",
+};
+
+// ============================================================================
+// Node of the function whose intern ID is 'funid' (-1 => not defined in this
+// program - eg: an intrinsic such as "sayn")
+// ============================================================================
+static int inlFindFun(Flat* flat, int funid) {
+  FlatNode* node = flat->node;                          // alias
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    if (node[fun].val == funid) return fun;
+  }
+  return -1;
+}
+
+// ============================================================================
+// First statement of the function at node 'fun', just beyond its Pars and
+// Vars
+// ============================================================================
+static int inlFirstStm(Flat* flat, int fun) {
+  FlatNode* node = flat->node;                          // alias
+  int stm = fun + 1;
+  while (node[stm].tag == ASTPAR || node[stm].tag == ASTVAR) ++stm;
+  return stm;
+}
+
+// ============================================================================
+// Is 'id' assigned anywhere within nodes [first, end)?
+// ============================================================================
+static int inlAssigns(Flat* flat, int first, int end, int id) {
+  for (int n = first; n < end; ++n) {
+    if (flat->node[n].tag == ASTASG && flat->node[n].val == id) return 1;
+  }
+  return 0;
+}
+
+// ============================================================================
+// Is the body of the function at node 'fun' a run of statements, with no
+// Ret except the last statement, which must be a Ret?  Set '*ret' to it.
+// ============================================================================
+static int inlHasOneRet(Flat* flat, int fun, int* ret) {
+  FlatNode* node = flat->node;                          // alias
+  int first = inlFirstStm(flat, fun);
+  int end   = node[fun].end;
+
+  int last = first;
+  for (int s = first; s < end; s = node[s].end) last = s;
+  if (last >= end || node[last].tag != ASTRET) return 0;
+
+  for (int n = first; n < last; ++n) {
+    if (node[n].tag == ASTRET) return 0;
+  }
+  *ret = last;
+  return 1;
+}
+
+// ============================================================================
+// Does the body of the function at node 'fun' name only its own pars and
+// vars?
+// ============================================================================
+static int inlNamesOwn(Flat* flat, int fun) {
+  FlatNode* node = flat->node;                          // alias
+  int first = inlFirstStm(flat, fun);
+  for (int n = first; n < (int) node[fun].end; ++n) {
+    if (node[n].tag != ASTNAM && node[n].tag != ASTASG) continue;
+    int found = 0;
+    for (int d = fun + 1; d < first && !found; ++d) {
+      found = node[d].val == node[n].val;
+    }
+    if (!found) return 0;
+  }
+  return 1;
+}
+
+// ============================================================================
+// Decide whether the Call at node 'call' of the input, to the function at
+// node 'fun', should be inlined
+// ============================================================================
+static INLWHY inlCheck(Inl* inl, int call, int fun) {
+  FlatNode* node = inl->in->node;                       // alias
+  int first  = inlFirstStm(inl->in, fun);
+  int size   = node[fun].end - first;
+  int numpar = 0;
+  while (node[fun + 1 + numpar].tag == ASTPAR) ++numpar;
+
+  for (int d = 0; d < inl->depth; ++d) {
+    if (inl->stack[d] == node[fun].val) return INLRECURSIVE;
+  }
+  if (node[call].end - call - 1 != (uint32_t) numpar) return INLARITY;
+  for (int a = call + 1; a < (int) node[call].end; ++a) {
+    if (node[a].tag == ASTSTR) return INLSTRARG;
+  }
+  if (inl->depth > INLMAXDEPTH)               return INLTOODEEP;
+  if (size > INLBUDGET)                       return INLTOOBIG;
+  if (inl->grown + size > INLMAXGROWTH)       return INLGROWTH;
+
+  int ret;
+  if (!inlHasOneRet(inl->in, fun, &ret))      return INLEARLYRET;
+  if (!inlNamesOwn(inl->in, fun))             return INLFOREIGN;
+  return INLOK;
+}
+
+// ============================================================================
+// Record a decision in the log
+// ============================================================================
+static void inlLog(Inl* inl, int callee, int size, INLWHY why) {
+  if (inl->numLog == inl->capLog) {
+    inl->capLog = inl->capLog ? 2 * inl->capLog : INLMINCAP;
+    inl->log = realloc(inl->log, inl->capLog * sizeof(InlLog));
+    if (!inl->log) utDie2Str("inlLog", "Out of memory for log");
+  }
+  inl->log[inl->numLog++] = (InlLog) { inl->caller, callee, inl->depth, size, why };
+}
+
+// ============================================================================
+// Make a fresh var, in the current caller, to stand for 'id' of 'callee'.
+// Eg: "x.add.3".  Return its intern ID.
+// ============================================================================
+static int inlFresh(Inl* inl, int callee, int id) {
+  int len = internLen(id) + internLen(callee) + 16;
+  char* name = malloc(len);
+  if (!name) utDie2Str("inlFresh", "Out of memory for name");
+  snprintf(name, len, "%s.%s.%d", internStr(id), internStr(callee), ++inl->fresh);
+  int fresh = intern(name);
+  free(name);
+
+  if (inl->numVar == inl->capVar) {
+    inl->capVar = inl->capVar ? 2 * inl->capVar : INLMINCAP;
+    inl->var = realloc(inl->var, inl->capVar * sizeof(int));
+    if (!inl->var) utDie2Str("inlFresh", "Out of memory for vars");
+  }
+  inl->var[inl->numVar++] = fresh;
+  return fresh;
+}
+
+// ============================================================================
+// What stands, in the output, for leaf 'n' of the input?  Set '*tag' and
+// '*val'.  A name listed in 'sub' is replaced; anything else is unchanged.
+// ============================================================================
+static void inlResolve(Inl* inl, int n, InlSub* sub, int numSub,
+  uint8_t* tag, int* val) {
+  FlatNode* node = &inl->in->node[n];
+  *tag = node->tag;
+  *val = node->val;
+  if (node->tag != ASTNAM && node->tag != ASTASG) return;
+  for (int s = 0; s < numSub; ++s) {
+    if (sub[s].id == node->val) {
+      *tag = node->tag == ASTASG ? ASTASG : sub[s].tag;
+      *val = sub[s].val;
+      return;
+    }
+  }
+}
+
+// ============================================================================
+// Copy leaf 'n' into the output, with names replaced as per 'sub'
+// ============================================================================
+static void inlLeaf(Inl* inl, int n, InlSub* sub, int numSub) {
+  uint8_t tag;
+  int val;
+  inlResolve(inl, n, sub, numSub, &tag, &val);
+  flatOpen(inl->body, tag, val);
+}
+
+// ============================================================================
+// Copy Exp 'exp' into the output, with names replaced as per 'sub'
+// ============================================================================
+static void inlExp(Inl* inl, int exp, InlSub* sub, int numSub) {
+  FlatNode* node = inl->in->node;                       // alias
+  int e = flatOpen(inl->body, ASTEXP, 0);
+  inl->body->node[e].bop = node[exp].bop;
+  for (int c = exp + 1; c < (int) node[exp].end; c = node[c].end) {
+    inlLeaf(inl, c, sub, numSub);
+  }
+  flatClose(inl->body, e);
+}
+
+// ============================================================================
+// Try to inline the Call at node 'call', whose result is assigned to the var
+// 'target' of the output.  'sub' holds the replacements in force where the
+// Call appears.  Return 1 if inlined; otherwise, emit nothing and return 0.
+// ============================================================================
+static int inlCall(Inl* inl, int target, int call, InlSub* sub, int numSub) {
+  FlatNode* node = inl->in->node;                       // alias
+  Flat*     body = inl->body;                           // alias
+  int callee = node[call].val;
+  int fun    = inlFindFun(inl->in, callee);
+  if (fun < 0) return 0;                                // eg: sayn
+
+  int first = inlFirstStm(inl->in, fun);
+  int end   = node[fun].end;
+  INLWHY why = inlCheck(inl, call, fun);
+  inlLog(inl, callee, end - first, why);
+  if (why != INLOK) return 0;
+
+  // Each Par takes the matching argument, or a fresh var that is first
+  // assigned the argument.  Each Var becomes a fresh var.
+
+  int numInner = first - fun - 1;
+  InlSub* inner = calloc(numInner ? numInner : 1, sizeof(InlSub));
+  if (!inner) utDie2Str("inlCall", "Out of memory");
+  for (int k = 0; k < numInner; ++k) {
+    int id = node[fun + 1 + k].val;
+    inner[k].id = id;
+    if (node[fun + 1 + k].tag == ASTPAR) {
+      uint8_t tag;
+      int val;
+      inlResolve(inl, call + 1 + k, sub, numSub, &tag, &val);
+      if (!inlAssigns(inl->in, first, end, id)) {
+        inner[k].tag = tag;
+        inner[k].val = val;
+        continue;
+      }
+      int a = flatOpen(body, ASTASG, inlFresh(inl, callee, id));
+      int e = flatOpen(body, ASTEXP, 0);
+      flatOpen(body, tag, val);
+      flatClose(body, e);
+      flatClose(body, a);
+      inner[k].tag = ASTNAM;
+      inner[k].val = body->node[a].val;
+    } else {
+      inner[k].tag = ASTNAM;
+      inner[k].val = inlFresh(inl, callee, id);
+    }
+  }
+
+  // The body, less its final Ret, then "target = <Exp of the Ret>"
+
+  int ret;
+  inlHasOneRet(inl->in, fun, &ret);
+  inl->stack[inl->depth++] = callee;
+  inl->grown += end - first;
+  inlStms(inl, first, ret, inner, numInner);
+  --inl->depth;
+
+  int a = flatOpen(body, ASTASG, target);
+  inlExp(inl, ret + 1, inner, numInner);
+  flatClose(body, a);
+
+  free(inner);
+  return 1;
+}
+
+// ============================================================================
+// Copy statement 'n' into the output, with names replaced as per 'sub', and
+// with each Call inlined if it can be
+// ============================================================================
+static void inlStm(Inl* inl, int n, InlSub* sub, int numSub) {
+  FlatNode* node = inl->in->node;                       // alias
+  Flat*     body = inl->body;                           // alias
+
+  switch (node[n].tag) {
+    case ASTASG:   { uint8_t tag;
+                     int target;
+                     inlResolve(inl, n, sub, numSub, &tag, &target);
+                     int eoc = n + 1;                                 // Exp or Call
+                     if (node[eoc].tag == ASTCALL) {
+                       if (inlCall(inl, target, eoc, sub, numSub)) return;
+                       int s = flatOpen(body, ASTASG, target);
+                       int c = flatOpen(body, ASTCALL, node[eoc].val);
+                       for (int a = eoc + 1; a < (int) node[eoc].end; a = node[a].end) {
+                         inlLeaf(inl, a, sub, numSub);
+                       }
+                       flatClose(body, c);
+                       flatClose(body, s);
+                     } else {
+                       int s = flatOpen(body, ASTASG, target);
+                       inlExp(inl, eoc, sub, numSub);
+                       flatClose(body, s);
+                     }
+                     return;
+                   }
+    case ASTRET:   { int s = flatOpen(body, ASTRET, 0);
+                     inlExp(inl, n + 1, sub, numSub);
+                     flatClose(body, s);
+                     return;
+                   }
+    case ASTIF:
+    case ASTWHILE: { int s = flatOpen(body, node[n].tag, 0);
+                     int exp = n + 1;
+                     inlExp(inl, exp, sub, numSub);
+                     inlStms(inl, node[exp].end, node[n].end, sub, numSub);
+                     flatClose(body, s);
+                     return;
+                   }
+    default:       { utDie2Str("inlStm", "Invalid statement kind"); }
+  }
+}
+
+// ============================================================================
+// Copy the statements that lie between node 'first' and node 'end' into the
+// output
+// ============================================================================
+static void inlStms(Inl* inl, int first, int end, InlSub* sub, int numSub) {
+  FlatNode* node = inl->in->node;                       // alias
+  for (int n = first; n < end; n = node[n].end) {
+    inlStm(inl, n, sub, numSub);
+  }
+}
+
+// ============================================================================
+// Fun => "int" Nam "(" Pars ")" Body
+//
+// The statements are rewritten into inl->body first, since the fresh vars
+// they need must be declared ahead of them.
+// ============================================================================
+static void inlFun(Inl* inl, int fun) {
+  FlatNode* node = inl->in->node;                       // alias
+  Flat*     out  = inl->out;                            // alias
+
+  inl->caller   = node[fun].val;
+  inl->stack[0] = inl->caller;
+  inl->depth    = 1;
+  inl->grown    = 0;
+  inl->numVar   = 0;
+  inl->body->num = 0;
+
+  int first = inlFirstStm(inl->in, fun);
+  inlStms(inl, first, node[fun].end, NULL, 0);
+
+  int f = flatOpen(out, ASTFUN, node[fun].val);
+  for (int d = fun + 1; d < first; ++d) flatOpen(out, node[d].tag, node[d].val);
+  for (int v = 0; v < inl->numVar; ++v) flatOpen(out, ASTVAR, inl->var[v]);
+
+  uint32_t base = (uint32_t) out->num;
+  for (int n = 0; n < inl->body->num; ++n) {
+    FlatNode* from = &inl->body->node[n];
+    int m = flatOpen(out, from->tag, from->val);
+    out->node[m].bop = from->bop;
+    out->node[m].end = from->end + base;
+  }
+  flatClose(out, f);
+}
+
+// ============================================================================
+// Build a new Inl
+// ============================================================================
+Inl* inlNew() {
+  Inl* inl = calloc(1, sizeof(Inl));
+  if (!inl) utDie2Str("inlNew", "Out of memory");
+  return inl;
+}
+
+// ============================================================================
+// Rewrite the program 'flat', returning the result as a new Flat.  'flat' is
+// freed, but its string literals move across to the new Flat.
+// ============================================================================
+Flat* inlProg(Inl* inl, Flat* flat) {
+  FlatNode* node = flat->node;                          // alias
+
+  inl->in   = flat;
+  inl->out  = flatNew();
+  inl->body = flatNew();
+
+  int p = flatOpen(inl->out, ASTPROG, 0);
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    inlFun(inl, fun);
+  }
+  flatClose(inl->out, p);
+
+  Flat* out = inl->out;
+  free(out->str);
+  out->str    = flat->str;
+  out->numStr = flat->numStr;
+  out->capStr = flat->capStr;
+  flat->str   = NULL;
+  flatFree(flat);
+  flatFree(inl->body);
+
+  inl->in   = NULL;
+  inl->out  = NULL;
+  inl->body = NULL;
+  return out;
+}
+
+// ============================================================================
+// Print each decision made during this compile, and how many calls were
+// inlined
+// ============================================================================
+void inlReport(Inl* inl) {
+  int inlined = 0;
+  printf("\n");
+  for (int k = 0; k < inl->numLog; ++k) {
+    InlLog* log = &inl->log[k];
+    printf("Inline: %s into %s, depth %d, size %d: %s \n",
+      internStr(log->callee), internStr(log->caller), log->depth, log->size,
+      inlWhyNames[log->why]);
+    if (log->why == INLOK) ++inlined;
+  }
+  printf("Inline: inlined %d of %d calls \n", inlined, inl->numLog);
+}
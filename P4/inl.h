@@ -0,0 +1,99 @@
+// inl.h - Inliner
+
+#pragma once
+
+#include <stdint.h>         // uint8_t, uint32_t
+#include <stdio.h>          // printf, snprintf
+#include <stdlib.h>         // calloc, realloc, free
+
+#include "ast.h"            // AST
+#include "flat.h"           // Flat, FlatNode
+#include "intern.h"         // intern, internStr
+#include "ut.h"             // ut*
+
+// inlProg copies the Flat of a program into a new Flat, replacing calls of
+// small functions by the body of the callee.  For example:
+//
+//    int add(int a, int b) { int x; x = a + b; return x; }
+//    ...
+//    y = add(m, 5);
+//
+// becomes, in the caller:
+//
+//    y = add(m, 5);    =>    x.add.1 = m + 5;
+//                            y = x.add.1;
+//
+// Each par or var of the callee gets a fresh var in the caller, and so its
+// own slot in the caller's frame.  The '.' in its name keeps it apart from
+// any name in the source program.  A par that the callee never assigns
+// needs no var at all: each use of it is replaced by the argument itself,
+// which is always a Nam or Num.  The Exp of the callee's Ret becomes the
+// Exp assigned to the target of the call.
+//
+// A call is inlined only if the callee:
+//
+//    is defined in this program (so not an intrinsic such as "sayn")
+//    is not already being inlined at this point (no recursion)
+//    has no Ret, except as its very last statement
+//    names only its own pars and vars
+//    has at most INLBUDGET nodes in its body
+//
+// and if the call has no Str arguments, lies at most INLMAXDEPTH inlines
+// deep, and keeps the caller within INLMAXGROWTH inlined nodes.  Calls
+// within an inlined body are themselves candidates for inlining.
+//
+// Each decision, for a call of a function defined in this program, is kept
+// in a log that inlReport prints.
+
+#define INLBUDGET    32     // max nodes in the body of a callee
+#define INLMAXDEPTH  4      // max nesting of inlined bodies
+#define INLMAXGROWTH 256    // max nodes inlined into one function
+#define INLMINCAP    16     // initial number of slots in each array
+
+typedef enum {
+  INLOK = 0,                // inlined
+  INLRECURSIVE,             // callee is being inlined already
+  INLTOOBIG,                // callee exceeds INLBUDGET
+  INLTOODEEP,               // nested more than INLMAXDEPTH
+  INLGROWTH,                // caller would exceed INLMAXGROWTH
+  INLEARLYRET,              // callee has a Ret before its end
+  INLFOREIGN,               // callee names a par or var it does not declare
+  INLARITY,                 // number of args differs from number of pars
+  INLSTRARG,                // a Str argument
+  INLNUMWHY
+} INLWHY;
+
+typedef struct {
+  int    caller;            // intern ID of the function being compiled
+  int    callee;            // intern ID of the function called
+  int    depth;             // 1 => a call written in 'caller'
+  int    size;              // nodes in the callee's body
+  INLWHY why;
+} InlLog;
+
+typedef struct {
+  int     id;               // par or var of the callee
+  uint8_t tag;              // ASTNAM or ASTNUM, to be used in its place
+  int     val;              // ... with this ID or number
+} InlSub;
+
+typedef struct {
+  Flat*   in;               // program, as parsed
+  Flat*   out;              // program, rewritten
+  Flat*   body;             // statements of the current caller, rewritten
+  int     caller;           // intern ID of the current caller
+  int     stack[INLMAXDEPTH + 1]; // caller, then each callee being inlined
+  int     depth;            // entries in use in stack[]
+  int     grown;            // nodes inlined into the current caller
+  int     numVar;           // fresh vars for the current caller
+  int     capVar;
+  int*    var;
+  int     numLog;           // decisions, whole compile
+  int     capLog;
+  InlLog* log;
+  int     fresh;            // fresh names made, whole compile
+} Inl;
+
+Inl*  inlNew();
+Flat* inlProg(Inl* inl, Flat* flat);
+void  inlReport(Inl* inl);
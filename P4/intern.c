@@ -0,0 +1,121 @@
+// intern.c - Interned identifiers
+
+#include "intern.h"
+
+static Intern* g_intern = NULL;       // the one, global, interner
+
+// ============================================================================
+// Double the number of slots in the interner's hash table, re-inserting
+// every ID it holds
+// ============================================================================
+static void internGrow(Intern* in) {
+  free(in->slot);
+  in->cap *= 2;
+  in->slot = calloc(in->cap, sizeof(int));
+  if (!in->slot) utDie2Str("internGrow", "Out of memory");
+
+  uint32_t mask = in->cap - 1;
+  for (int id = 1; id <= in->num; ++id) {
+    uint32_t s = in->hash[id] & mask;
+    while (in->slot[s]) s = (s + 1) & mask;
+    in->slot[s] = id;
+  }
+}
+
+// ============================================================================
+// Intern the NUL-terminated string 's'
+// ============================================================================
+int intern(char* s) { return internN(s, (int) strlen(s)); }
+
+// ============================================================================
+// Hash the 'len' chars starting at 's' (FNV-1a)
+// ============================================================================
+uint32_t internHash(char* s, int len) {
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < len; ++i) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// ============================================================================
+// Create the global interner, and pre-intern the keywords, so they are given
+// the fixed IDs INTIF thru INTMAIN
+// ============================================================================
+void internInit() {
+  if (g_intern) return;
+
+  Intern* in = calloc(1, sizeof(Intern));
+  if (!in) utDie2Str("internInit", "Out of memory");
+  in->arena = arenaNew(0);
+  in->max   = 256;
+  in->str   = calloc(in->max, sizeof(char*));
+  in->len   = calloc(in->max, sizeof(int));
+  in->hash  = calloc(in->max, sizeof(uint32_t));
+  in->cap   = 512;
+  in->slot  = calloc(in->cap, sizeof(int));
+  if (!in->str || !in->len || !in->hash || !in->slot) utDie2Str("internInit", "Out of memory");
+  g_intern = in;
+
+  int id;
+  id = intern("if");      assert(id == INTIF);
+  id = intern("int");     assert(id == INTINT);
+  id = intern("return");  assert(id == INTRET);
+  id = intern("while");   assert(id == INTWHILE);
+  id = intern("main");    assert(id == INTMAIN);
+}
+
+// ============================================================================
+// Return the length of the name whose ID is 'id'
+// ============================================================================
+int internLen(int id) {
+  assert(id > 0 && id <= g_intern->num);
+  return g_intern->len[id];
+}
+
+// ============================================================================
+// Intern the 'len' chars starting at 's' (which need not be NUL-terminated).
+// If this name has been seen before, return its existing ID.  Otherwise,
+// copy it into the arena and allocate it the next ID.
+// ============================================================================
+int internN(char* s, int len) {
+  Intern* in = g_intern;
+  assert(in);
+
+  uint32_t h = internHash(s, len);
+  uint32_t mask = in->cap - 1;
+  uint32_t slot = h & mask;
+
+  for (int id = in->slot[slot]; id; id = in->slot[slot]) {
+    if (in->hash[id] == h && in->len[id] == len &&
+        memcmp(in->str[id], s, len) == 0) return id;
+    slot = (slot + 1) & mask;
+  }
+
+  // Not found: add a new name
+
+  int id = ++in->num;
+  if (id >= in->max) {
+    in->max *= 2;
+    in->str  = realloc(in->str,  in->max * sizeof(char*));
+    in->len  = realloc(in->len,  in->max * sizeof(int));
+    in->hash = realloc(in->hash, in->max * sizeof(uint32_t));
+    if (!in->str || !in->len || !in->hash) utDie2Str("internN", "Out of memory");
+  }
+  in->str[id]  = arenaStrndup(in->arena, s, len);
+  in->len[id]  = len;
+  in->hash[id] = h;
+  in->slot[slot] = id;
+
+  if (2 * in->num > in->cap) internGrow(in);
+  return id;
+}
+
+// ============================================================================
+// Return the NUL-terminated name whose ID is 'id'
+// ============================================================================
+char* internStr(int id) {
+  assert(id > 0 && id <= g_intern->num);
+  return g_intern->str[id];
+}
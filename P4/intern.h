@@ -0,0 +1,43 @@
+// intern.h - Interned identifiers
+
+#pragma once
+
+#include <assert.h>     // assert
+#include <stdint.h>     // uint32_t
+#include <stdlib.h>     // calloc
+#include <string.h>     // memcmp
+
+#include "arena.h"      // Arena
+
+// Every distinct identifier in the program is stored exactly once, in an
+// Arena, and is known thereafter by a small integer ID.  Two names are equal
+// exactly when their IDs are equal.  ID 0 means "no name".
+//
+// internInit pre-interns the keywords, and a few names the compiler itself
+// needs to recognize, so that they get the fixed IDs below.
+
+#define INTNONE       0
+#define INTIF         1         // "if"
+#define INTINT        2         // "int"
+#define INTRET        3         // "return"
+#define INTWHILE      4         // "while"
+#define INTMAXKEY     4         // highest ID that is a keyword
+#define INTMAIN       5         // "main"
+
+typedef struct {
+  Arena*    arena;              // holds the chars of every name
+  int       num;                // number of names; IDs run 1 thru num
+  int       max;                // capacity of str[], len[] and hash[]
+  char**    str;                // str[id]  = NUL-terminated name
+  int*      len;                // len[id]  = strlen(str[id])
+  uint32_t* hash;               // hash[id] = internHash of the name
+  int       cap;                // number of slots in slot[] (a power of 2)
+  int*      slot;               // open-addressed table of IDs (0 => empty)
+} Intern;
+
+int      intern(char* s);
+uint32_t internHash(char* s, int len);
+void     internInit();
+int      internLen(int id);
+int      internN(char* s, int len);
+char*    internStr(int id);
@@ -0,0 +1,364 @@
+// interp.c - Interpret the AST of a SubC program
+
+#include "interp.h"
+
+// ============================================================================
+// Grow funOf[] and slotOf[] to hold intern ID 'id'
+// ============================================================================
+static void interpGrowId(Interp* in, int id) {
+  if (id < in->numId) return;
+  int num = in->numId ? in->numId : INTERPMINCAP;
+  while (num <= id) num *= 2;
+  in->funOf  = realloc(in->funOf,  num * sizeof(int));
+  in->slotOf = realloc(in->slotOf, num * sizeof(int));
+  if (!in->funOf || !in->slotOf) utDie2Str("interpGrowId", "Out of memory");
+  for (int i = in->numId; i < num; ++i) { in->funOf[i] = 0; in->slotOf[i] = -1; }
+  in->numId = num;
+}
+
+// ============================================================================
+// Add the function 'id' to fun[] - an intrinsic if 'ast' is NULL
+// ============================================================================
+static void interpAddFun(Interp* in, int id, AstFun* ast) {
+  if (in->numFun == in->capFun) {
+    in->capFun = in->capFun ? 2 * in->capFun : INTERPMINCAP;
+    in->fun = realloc(in->fun, in->capFun * sizeof(InterpFun));
+    if (!in->fun) utDie2Str("interpAddFun", "Out of memory");
+  }
+  InterpFun* f = &in->fun[in->numFun];
+  memset(f, 0, sizeof(InterpFun));
+  f->id  = id;
+  f->ast = ast;
+  if (id) {
+    interpGrowId(in, id);
+    in->funOf[id] = in->numFun;
+  }
+  ++in->numFun;
+}
+
+// ============================================================================
+// Resolve 'nns', a Nam, Num or Str, in the function 'funid'
+// ============================================================================
+static void interpResolveNns(Interp* in, Ast* nns, int funid) {
+  if (nns == NULL || nns->kind != ASTNAM) return;
+  AstNam* nam = (AstNam*) nns;
+  interpGrowId(in, nam->id);
+  nam->slot = in->slotOf[nam->id];
+  if (nam->slot < 0) {
+    utDie5Str("interpNew", "Cannot find varpar", internStr(nam->id),
+      "in function", internStr(funid));
+  }
+}
+
+// ============================================================================
+// Resolve the names in the statement list 'stm', in the function 'funid'
+// ============================================================================
+static void interpResolveStms(Interp* in, AstStm* stm, int funid) {
+  for (; stm; stm = (AstStm*) stm->next) {
+    switch (stm->kind) {
+      case ASTASG:   { AstAsg* asg = (AstAsg*) stm;
+                       interpResolveNns(in, (Ast*) asg->nam, funid);
+                       if (asg->eoc->kind == ASTEXP) {
+                         AstExp* exp = (AstExp*) asg->eoc;
+                         interpResolveNns(in, exp->lhs, funid);
+                         interpResolveNns(in, exp->rhs, funid);
+                         break;
+                       }
+                       AstCall* call = (AstCall*) asg->eoc;
+                       interpGrowId(in, call->nam->id);
+                       call->nam->slot = in->funOf[call->nam->id];
+                       if (call->nam->slot == 0) {
+                         utDie5Str("interpNew", "Cannot find function", call->nam->lex,
+                           "called in function", internStr(funid));
+                       }
+                       for (AstArg* arg = call->args; arg; arg = (AstArg*) arg->next) {
+                         interpResolveNns(in, arg->nns, funid);
+                       }
+                       break;
+                     }
+      case ASTIF:    { AstIf* astif = (AstIf*) stm;
+                       interpResolveNns(in, astif->exp->lhs, funid);
+                       interpResolveNns(in, astif->exp->rhs, funid);
+                       interpResolveStms(in, astif->block->stms, funid);
+                       break;
+                     }
+      case ASTRET:   { AstRet* ret = (AstRet*) stm;
+                       interpResolveNns(in, ret->exp->lhs, funid);
+                       interpResolveNns(in, ret->exp->rhs, funid);
+                       break;
+                     }
+      case ASTWHILE: { AstWhile* w = (AstWhile*) stm;
+                       interpResolveNns(in, w->exp->lhs, funid);
+                       interpResolveNns(in, w->exp->rhs, funid);
+                       interpResolveStms(in, w->block->stms, funid);
+                       break;
+                     }
+      default:       utDie2Str("interpResolveStms", "Invalid statement kind");
+    }
+  }
+}
+
+// ============================================================================
+// Give each par and var of the function fun[f] its slot, then resolve every
+// name in its body
+// ============================================================================
+static void interpResolveFun(Interp* in, int f) {
+  InterpFun* fun = &in->fun[f];
+  AstFun* ast = fun->ast;
+  int slot = 0;
+  for (AstPar* par = ast->pars; par; par = (AstPar*) par->next) {
+    interpGrowId(in, par->nam->id);
+    in->slotOf[par->nam->id] = slot++;
+  }
+  fun->numPars = slot;
+  if (ast->body) {
+    for (AstVar* var = ast->body->vars; var; var = (AstVar*) var->next) {
+      interpGrowId(in, var->nam->id);
+      in->slotOf[var->nam->id] = slot++;
+    }
+  }
+  fun->numSlots = slot;
+
+  if (ast->body) interpResolveStms(in, ast->body->stms, fun->id);
+
+  for (AstPar* par = ast->pars; par; par = (AstPar*) par->next) {
+    in->slotOf[par->nam->id] = -1;
+  }
+  if (ast->body) {
+    for (AstVar* var = ast->body->vars; var; var = (AstVar*) var->next) {
+      in->slotOf[var->nam->id] = -1;
+    }
+  }
+}
+
+// ============================================================================
+// Build an Interp for 'prog', whose intrinsics write to 'out'.  Every name
+// is resolved here, before the program runs.
+// ============================================================================
+Interp* interpNew(AstProg* prog, FILE* out) {
+  Interp* in = calloc(1, sizeof(Interp));
+  if (!in) utDie2Str("interpNew", "Out of memory");
+  in->prog = prog;
+  in->out  = out;
+
+  interpAddFun(in, 0, NULL);                            // fun[0]: unused
+  interpAddFun(in, intern("says"), NULL);               // INTERPSAYS
+  interpAddFun(in, intern("sayn"), NULL);               // INTERPSAYN
+  interpAddFun(in, intern("sayl"), NULL);               // INTERPSAYL
+  for (AstFun* f = prog->funs; f; f = (AstFun*) f->next) {
+    interpAddFun(in, f->nam->id, f);
+  }
+  for (int f = INTERPNUMINTR; f < in->numFun; ++f) interpResolveFun(in, f);
+  return in;
+}
+
+// ============================================================================
+// Value of 'nns', a Nam, Num or Str, in 'frame'.  A Str is 0.
+// ============================================================================
+static int interpNns(Ast* nns, int* frame) {
+  if (nns->kind == ASTNUM) return ((AstNum*) nns)->val;
+  if (nns->kind == ASTNAM) return frame[((AstNam*) nns)->slot];
+  return 0;
+}
+
+// ============================================================================
+// Value of 'exp', in 'frame'
+// ============================================================================
+static int interpExp(AstExp* exp, int* frame) {
+  int lhs = interpNns(exp->lhs, frame);
+  if (exp->bop == BOPNONE) return lhs;
+  return foldBop(exp->bop, lhs, interpNns(exp->rhs, frame));
+}
+
+// ============================================================================
+// Call the intrinsic fun[f], with 'args' valued in 'frame'.  Return 0, as
+// io.X68 does.
+// ============================================================================
+static int interpIntrinsic(Interp* in, int f, AstArg* args, int* frame) {
+  ++in->fun[f].calls;
+  Ast* arg = args ? args->nns : NULL;
+  switch (f) {
+    case INTERPSAYS:
+      if (arg == NULL || arg->kind != ASTSTR) utDie2Str("interpRun", "says needs a string");
+      fputs(((AstStr*) arg)->txt, in->out);
+      break;
+    case INTERPSAYN:
+      fprintf(in->out, "%d", arg ? interpNns(arg, frame) : 0);
+      break;
+    case INTERPSAYL:
+      fputs("\r\n", in->out);
+      break;
+  }
+  return 0;
+}
+
+// ============================================================================
+// Push a new statement list, starting at 'stm'.  'loop' is the While whose
+// Block it is (NULL => none).
+// ============================================================================
+static void interpPushList(Interp* in, AstStm* stm, AstWhile* loop) {
+  if (in->numList == in->capList) {
+    in->capList = in->capList ? 2 * in->capList : INTERPMINCAP;
+    in->list = realloc(in->list, in->capList * sizeof(InterpList));
+    if (!in->list) utDie2Str("interpPushList", "Out of memory");
+  }
+  in->list[in->numList].next = stm;
+  in->list[in->numList].loop = loop;
+  ++in->numList;
+}
+
+// ============================================================================
+// Enter the function fun[f], passing 'args' valued in the frame of the
+// current call.  Its result goes to slot 'dst' of that frame (-1 => none).
+// ============================================================================
+static void interpEnter(Interp* in, int f, AstArg* args, int dst) {
+  InterpFun* fun = &in->fun[f];
+  ++fun->calls;
+
+  if (in->numCall == in->capCall) {
+    in->capCall = in->capCall ? 2 * in->capCall : INTERPMINCAP;
+    in->call = realloc(in->call, in->capCall * sizeof(InterpCall));
+    if (!in->call) utDie2Str("interpEnter", "Out of memory");
+  }
+  int need = in->numSlot + fun->numSlots;
+  if (need > in->capSlot) {
+    int cap = in->capSlot ? in->capSlot : INTERPMINCAP;
+    while (cap < need) cap *= 2;
+    in->slot = realloc(in->slot, cap * sizeof(int));
+    if (!in->slot) utDie2Str("interpEnter", "Out of memory");
+    in->capSlot = cap;
+  }
+
+  int* frame = in->slot + in->numSlot;
+  memset(frame, 0, fun->numSlots * sizeof(int));
+  if (in->numCall) {
+    int* caller = in->slot + in->call[in->numCall - 1].base;
+    AstArg* arg = args;
+    for (int p = 0; p < fun->numPars && arg; ++p, arg = (AstArg*) arg->next) {
+      frame[p] = arg->nns ? interpNns(arg->nns, caller) : 0;
+    }
+  }
+
+  InterpCall* call = &in->call[in->numCall++];
+  call->fun   = f;
+  call->base  = in->numSlot;
+  call->lists = in->numList;
+  call->dst   = dst;
+  in->numSlot = need;
+
+  interpPushList(in, fun->ast->body ? fun->ast->body->stms : NULL, NULL);
+}
+
+// ============================================================================
+// Return 'val' from the current call.  Return 1 if that was main.
+// ============================================================================
+static int interpLeave(Interp* in, int val) {
+  InterpCall* call = &in->call[--in->numCall];
+  in->numList = call->lists;
+  in->numSlot = call->base;
+  if (in->numCall == 0) {
+    in->result = val;
+    return 1;
+  }
+  if (call->dst >= 0) in->slot[in->call[in->numCall - 1].base + call->dst] = val;
+  return 0;
+}
+
+// ============================================================================
+// Run the program, from main, until main returns.  Return its result.
+// ============================================================================
+int interpRun(Interp* in) {
+  int f = INTMAIN < in->numId ? in->funOf[INTMAIN] : 0;
+  if (f < INTERPNUMINTR) utDie2Str("interpRun", "No function main");
+  interpEnter(in, f, NULL, -1);
+
+  for (;;) {
+    InterpCall* call = &in->call[in->numCall - 1];
+    InterpList* list = &in->list[in->numList - 1];
+    int* frame = in->slot + call->base;
+    AstStm* stm = list->next;
+
+    if (stm == NULL) {                                  // end of a list
+      if (list->loop && interpExp(list->loop->exp, frame)) {
+        list->next = list->loop->block->stms;           // round again
+        continue;
+      }
+      if (--in->numList > call->lists) continue;
+      if (interpLeave(in, 0)) break;                    // fell off the end
+      continue;
+    }
+
+    list->next = (AstStm*) stm->next;
+    ++in->fun[call->fun].steps;
+
+    switch (stm->kind) {
+      case ASTASG: {
+        AstAsg* asg = (AstAsg*) stm;
+        if (asg->eoc->kind == ASTEXP) {
+          frame[asg->nam->slot] = interpExp((AstExp*) asg->eoc, frame);
+          break;
+        }
+        AstCall* c = (AstCall*) asg->eoc;
+        if (c->nam->slot < INTERPNUMINTR) {
+          frame[asg->nam->slot] = interpIntrinsic(in, c->nam->slot, c->args, frame);
+        } else {
+          interpEnter(in, c->nam->slot, c->args, asg->nam->slot);
+        }
+        break;
+      }
+      case ASTIF: {
+        AstIf* astif = (AstIf*) stm;
+        if (interpExp(astif->exp, frame)) interpPushList(in, astif->block->stms, NULL);
+        break;
+      }
+      case ASTWHILE: {
+        AstWhile* w = (AstWhile*) stm;
+        if (interpExp(w->exp, frame)) interpPushList(in, w->block->stms, w);
+        break;
+      }
+      case ASTRET:
+        if (interpLeave(in, interpExp(((AstRet*) stm)->exp, frame))) goto done;
+        break;
+      default:
+        utDie2Str("interpRun", "Invalid statement kind");
+    }
+  }
+
+done:
+  in->steps = 0;
+  for (int g = 0; g < in->numFun; ++g) in->steps += in->fun[g].steps;
+  fflush(in->out);
+  return in->result;
+}
+
+// ============================================================================
+// Print the calls made and statements executed, in total and by function
+// ============================================================================
+void interpReport(Interp* in) {
+  printf("\n");
+  for (int f = 1; f < in->numFun; ++f) {
+    InterpFun* fun = &in->fun[f];
+    if (fun->calls == 0) continue;
+    if (fun->ast == NULL) {                             // intrinsic
+      printf("Interp: %s %llu calls \n", internStr(fun->id), (unsigned long long) fun->calls);
+      continue;
+    }
+    printf("Interp: %s %llu calls, %llu statements \n", internStr(fun->id),
+      (unsigned long long) fun->calls, (unsigned long long) fun->steps);
+  }
+  printf("Interp: total %llu statements, main = %d \n",
+    (unsigned long long) in->steps, in->result);
+}
+
+// ============================================================================
+// Free 'in', and all it holds.  The AST is left to the caller.
+// ============================================================================
+void interpFree(Interp* in) {
+  free(in->fun);
+  free(in->funOf);
+  free(in->slotOf);
+  free(in->slot);
+  free(in->call);
+  free(in->list);
+  free(in);
+}
@@ -0,0 +1,100 @@
+// interp.h - Interpret the AST of a SubC program
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint64_t
+#include <stdio.h>          // FILE, fprintf, fputs, printf
+#include <stdlib.h>         // calloc, realloc, free
+#include <string.h>         // memset
+
+#include "ast.h"            // AstProg, AstFun, AstStm, ...
+#include "fold.h"           // foldBop
+#include "intern.h"         // intern, internStr
+#include "ut.h"             // ut*
+
+// interpRun executes a program straight from its AST, with no code generated
+// and no simulator: "subc -interp prog.subc".  With -diff, the compiled
+// program is run on the simulator too, and its output and result checked
+// against the interpreter's, so that the interpreter is an oracle for the
+// optimizing backend.
+//
+// interpNew resolves every name once, before anything runs.  Each function
+// gets a frame of slots - its pars, then its vars - and each Nam that reads
+// or writes a par or var records its slot in AstNam.slot.  The Nam of each
+// Call records, in the same field, the index in fun[] of the function it
+// calls.  A name that is neither is an error, reported just as layFindVarPar
+// would.
+//
+// Values behave just as in the code cg.c generates: + and - wrap at 32 bits,
+// and * is MULS, which multiplies the low 16 bits of each operand (foldBop).
+// A var starts at 0.  A Str passed to a function other than says is 0.  A
+// function that ends without a Ret returns 0.
+//
+// The intrinsics are native, and write to 'out' just as io.X68 would:
+//
+//    says(s)       the chars of 's'
+//    sayn(n)       'n', in decimal
+//    sayl()        CR, LF
+//
+// Each returns 0.
+//
+// Calls do not recurse in C.  interpRun keeps its own stacks - of frame slots,
+// of calls, and of the statement lists being walked - that grow as needed,
+// so a program may recurse as deeply as memory allows.
+
+#define INTERPSAYS    1     // fun[] index of each intrinsic
+#define INTERPSAYN    2
+#define INTERPSAYL    3
+#define INTERPNUMINTR 4     // fun[0] is unused; user functions follow the intrinsics
+#define INTERPMINCAP  256   // initial number of slots in each stack
+
+typedef struct {
+  int      id;              // intern ID
+  AstFun*  ast;             // NULL => intrinsic
+  int      numPars;         // pars occupy slots 0 thru numPars - 1
+  int      numSlots;        // pars and vars
+  uint64_t calls;           // times called
+  uint64_t steps;           // statements executed
+} InterpFun;
+
+typedef struct {
+  AstStm*   next;           // next statement to execute (NULL => list done)
+  AstWhile* loop;           // While whose Block this is (NULL => none)
+} InterpList;
+
+typedef struct {
+  int       fun;            // index in fun[]
+  int       base;           // first slot of its frame, in slots[]
+  int       lists;          // number of entries in list[] below its own
+  int       dst;            // caller's slot for the result (-1 => none)
+} InterpCall;
+
+typedef struct {
+  AstProg*    prog;
+  FILE*       out;          // where says, sayn and sayl write
+  int         numFun;       // functions in use
+  int         capFun;       // slots in fun[]
+  InterpFun*  fun;
+  int         numId;        // slots in funOf[] and slotOf[]
+  int*        funOf;        // intern ID => index in fun[] (0 => none)
+  int*        slotOf;       // intern ID => slot, in the function being resolved (-1 => none)
+
+  int         numSlot;      // slots in use on the stack of frames
+  int         capSlot;
+  int*        slot;
+  int         numCall;      // calls active
+  int         capCall;
+  InterpCall* call;
+  int         numList;      // statement lists being walked
+  int         capList;
+  InterpList* list;
+
+  uint64_t    steps;        // statements executed
+  int         result;       // value returned by main
+} Interp;
+
+void    interpFree(Interp* in);
+Interp* interpNew(AstProg* prog, FILE* out);
+void    interpReport(Interp* in);
+int     interpRun(Interp* in);
@@ -0,0 +1,265 @@
+// ir.c - Instruction IR for 68000 code
+
+#include "ir.h"
+
+static char* irMnemonic[IRNUMOP] = {
+  "NOP",    "ADD",    "ADDQ",   "BEQ",    "BGE",    "BGT",    "BLE",    "BLT",
+  "BNE",    "BRA",    "BSR",    "CLR",    "CMP",    "CMPI",   "EXT",    "JMP",
+  "LEA",    "LINK",   "LSL",    "MOVE",   "MOVEM",  "MOVEQ",  "MULS",   "NEG",
+  "PEA",    "RTS",    "SIMHALT", "SUB",    "SUBQ",   "TST",    "UNLK",
+};
+
+static char* irSuffix[] = { "", ".B", ".W", ".L" };
+
+// ============================================================================
+// Append the decimal form of 'n' at 'p'.  Return the new end.
+// ============================================================================
+static char* irPutInt(char* p, int n) {
+  char digits[12];
+  int  k = 0;
+  unsigned int u = n < 0 ? 0u - (unsigned int) n : (unsigned int) n;
+  do { digits[k++] = (char) ('0' + u % 10); u /= 10; } while (u);
+  if (n < 0) *p++ = '-';
+  while (k) *p++ = digits[--k];
+  return p;
+}
+
+// ============================================================================
+// Append the string 's' at 'p'.  Return the new end.
+// ============================================================================
+static char* irPutStr(char* p, char* s) {
+  while (*s) *p++ = *s++;
+  return p;
+}
+
+// ============================================================================
+// Append the name of the function 'funid' at 'p'
+// ============================================================================
+static char* irPutName(char* p, int funid) {
+  char* name = internStr(funid);
+  if (strlen(name) > IRMAXNAME) utDie3Str("irPrint", "Name too long:", name);
+  return irPutStr(p, name);
+}
+
+// ============================================================================
+// Append the register list 'mask' (bit n => Dn), eg: "D2-D4/D6", at 'p'
+// ============================================================================
+static char* irPutRegs(char* p, int mask) {
+  char* start = p;
+  for (int r = 0; r < 8; ++r) {
+    if ((mask & (1 << r)) == 0) continue;
+    int last = r;
+    while (last < 7 && (mask & (1 << (last + 1)))) ++last;
+    if (p != start) *p++ = '/';
+    *p++ = 'D'; *p++ = (char) ('0' + r);
+    if (last != r) { *p++ = '-'; *p++ = 'D'; *p++ = (char) ('0' + last); }
+    r = last;
+  }
+  return p;
+}
+
+// ============================================================================
+// Append the operand 'o' at 'p'.  Return the new end.
+// ============================================================================
+static char* irPutOpnd(char* p, IrOpnd o) {
+  switch (o.kind) {
+    case IROPDREG:  *p++ = 'D'; *p++ = (char) ('0' + o.val);        break;
+    case IROPAREG:  *p++ = 'A'; *p++ = (char) ('0' + o.val);        break;
+    case IROPIMM:   *p++ = '#'; p = irPutInt(p, o.val);             break;
+    case IROPFRAME: *p++ = '('; p = irPutInt(p, o.val);
+                    p = irPutStr(p, ",A6)");                        break;
+    case IROPPUSH:  p = irPutStr(p, "-(A7)");                       break;
+    case IROPPOP:   p = irPutStr(p, "(A7)+");                       break;
+    case IROPLAB:
+    case IROPDATA:  *p++ = 'L'; p = irPutInt(p, o.val);             break;
+    case IROPFUN:   p = irPutName(p, o.val);                        break;
+    case IROPREGS:  p = irPutRegs(p, o.val);                        break;
+    default:        break;
+  }
+  return p;
+}
+
+// ============================================================================
+// Append instruction 'op' onto the last block of 'fun'.  If that block
+// already ends with a branch, RTS or SIMHALT, the instruction starts a new
+// (unlabeled) block.
+// ============================================================================
+void irAdd(IrFun* fun, IROP op, IRSZ sz, IrOpnd src, IrOpnd dst) {
+  IrBlock* blk = &fun->blk[fun->num - 1];
+  if (blk->num && irEndsBlock(blk->ins[blk->num - 1].op)) {
+    irAddBlock(fun, IRNOLABEL);
+    blk = &fun->blk[fun->num - 1];
+  }
+
+  if (blk->num == blk->cap) {
+    blk->cap = blk->cap ? 2 * blk->cap : IRMINCAP;
+    blk->ins = realloc(blk->ins, blk->cap * sizeof(IrIns));
+    if (!blk->ins) utDie2Str("irAdd", "Out of memory for instructions");
+  }
+  IrIns* ins = &blk->ins[blk->num++];
+  ins->op  = (uint8_t) op;
+  ins->sz  = (uint8_t) sz;
+  ins->src = src;
+  ins->dst = dst;
+}
+
+// ============================================================================
+// Start a new block, headed by 'label' (or IRNOLABEL).  Blocks beyond the
+// last one in use keep their ins[] arrays, for re-use by the next function.
+// ============================================================================
+void irAddBlock(IrFun* fun, int label) {
+  if (fun->num == fun->cap) {
+    int oldcap = fun->cap;
+    fun->cap = 2 * oldcap;
+    fun->blk = realloc(fun->blk, fun->cap * sizeof(IrBlock));
+    if (!fun->blk) utDie2Str("irAddBlock", "Out of memory for blocks");
+    memset(&fun->blk[oldcap], 0, (fun->cap - oldcap) * sizeof(IrBlock));
+  }
+  IrBlock* blk = &fun->blk[fun->num++];
+  blk->label = label;
+  blk->num   = 0;
+}
+
+// ============================================================================
+// Insert an instruction into 'blk', just before its instruction 'at'
+// ============================================================================
+void irInsert(IrBlock* blk, int at, IROP op, IRSZ sz, IrOpnd src, IrOpnd dst) {
+  assert(at >= 0 && at <= blk->num);
+  if (blk->num == blk->cap) {
+    blk->cap = blk->cap ? 2 * blk->cap : IRMINCAP;
+    blk->ins = realloc(blk->ins, blk->cap * sizeof(IrIns));
+    if (!blk->ins) utDie2Str("irInsert", "Out of memory for instructions");
+  }
+  memmove(&blk->ins[at + 1], &blk->ins[at], (blk->num - at) * sizeof(IrIns));
+  ++blk->num;
+  IrIns* ins = &blk->ins[at];
+  ins->op  = (uint8_t) op;
+  ins->sz  = (uint8_t) sz;
+  ins->src = src;
+  ins->dst = dst;
+}
+
+// ============================================================================
+// Empty 'fun', ready to receive the code of the function 'funid'
+// ============================================================================
+void irBegin(IrFun* fun, int funid) {
+  fun->funid = funid;
+  fun->num   = 0;
+  irAddBlock(fun, IRNOLABEL);
+}
+
+// ============================================================================
+// The branch that tests the opposite condition to 'op'.  Eg: IRBLT => IRBGE.
+// Return IRNOP if 'op' is not a conditional branch.
+// ============================================================================
+IROP irInverse(IROP op) {
+  switch (op) {
+    case IRBEQ: return IRBNE;
+    case IRBNE: return IRBEQ;
+    case IRBLT: return IRBGE;
+    case IRBGE: return IRBLT;
+    case IRBLE: return IRBGT;
+    case IRBGT: return IRBLE;
+    default:    return IRNOP;
+  }
+}
+
+// ============================================================================
+// Predicates on opcodes.  A "branch" names a label; a "jump" never falls
+// through; each of them ends its block.
+// ============================================================================
+int irIsBranch(IROP op) { return op >= IRBEQ && op <= IRBRA; }
+
+int irIsCond(IROP op) { return op >= IRBEQ && op <= IRBNE; }
+
+int irIsJump(IROP op) {
+  return op == IRBRA || op == IRJMP || op == IRRTS || op == IRSIMHALT;
+}
+
+int irEndsBlock(IROP op) { return irIsBranch(op) || irIsJump(op); }
+
+// ============================================================================
+// Build a new, empty IrFun
+// ============================================================================
+IrFun* irNew() {
+  IrFun* fun = calloc(1, sizeof(IrFun));
+  if (!fun) utDie2Str("irNew", "Out of memory");
+  fun->cap = IRMINCAP;
+  fun->blk = calloc(IRMINCAP, sizeof(IrBlock));
+  if (!fun->blk) utDie2Str("irNew", "Out of memory");
+  return fun;
+}
+
+// ============================================================================
+// Operand constructors
+// ============================================================================
+IrOpnd irOpA(int n)         { IrOpnd o = { IROPAREG,  n      }; return o; }
+IrOpnd irOpD(int n)         { IrOpnd o = { IROPDREG,  n      }; return o; }
+IrOpnd irOpData(int label)  { IrOpnd o = { IROPDATA,  label  }; return o; }
+IrOpnd irOpFrame(int off)   { IrOpnd o = { IROPFRAME, off    }; return o; }
+IrOpnd irOpFun(int funid)   { IrOpnd o = { IROPFUN,   funid  }; return o; }
+IrOpnd irOpImm(int val)     { IrOpnd o = { IROPIMM,   val    }; return o; }
+IrOpnd irOpLab(int label)   { IrOpnd o = { IROPLAB,   label  }; return o; }
+IrOpnd irOpNone()           { IrOpnd o = { IROPNONE,  0      }; return o; }
+IrOpnd irOpPop()            { IrOpnd o = { IROPPOP,   0      }; return o; }
+IrOpnd irOpPush()           { IrOpnd o = { IROPPUSH,  0      }; return o; }
+IrOpnd irOpRegs(int mask)   { IrOpnd o = { IROPREGS,  mask   }; return o; }
+
+// ============================================================================
+// Are operands 'a' and 'b' the same?
+// ============================================================================
+int irOpEq(IrOpnd a, IrOpnd b) {
+  if (a.kind != b.kind) return 0;
+  return a.kind == IROPPUSH || a.kind == IROPPOP || a.kind == IROPNONE
+      || a.val == b.val;
+}
+
+// ============================================================================
+// Format 'ins' as a line of assembler text, eg: "\t MOVE.L \t D0, (-8,A6)",
+// into 'line', which must hold IRMAXLINE chars
+// ============================================================================
+void irFormat(IrIns* ins, char* line) {
+  char* p = irPutStr(line, "\t ");
+  p = irPutStr(p, irMnemonic[ins->op]);
+  p = irPutStr(p, irSuffix[ins->sz]);
+  if (ins->src.kind != IROPNONE || ins->dst.kind != IROPNONE) {
+    p = irPutStr(p, " \t ");
+  }
+  if (ins->src.kind != IROPNONE) p = irPutOpnd(p, ins->src);
+  if (ins->src.kind != IROPNONE && ins->dst.kind != IROPNONE) {
+    *p++ = ','; *p++ = ' ';
+  }
+  if (ins->dst.kind != IROPNONE) p = irPutOpnd(p, ins->dst);
+  *p = '\0';
+}
+
+// ============================================================================
+// Format every block of 'fun' as assembler text, into 'emit'.  For example:
+//
+//    fac:
+//         LINK    A6, #0
+//    L20:
+//         CMP.L   D2, D4
+// ============================================================================
+void irPrint(IrFun* fun, Emit* emit) {
+  char line[IRMAXLINE];
+  char* p = irPutName(line, fun->funid);
+  *p++ = ':'; *p = '\0';
+  emitCode(emit, line);
+
+  for (int b = 0; b < fun->num; ++b) {
+    IrBlock* blk = &fun->blk[b];
+    if (blk->label != IRNOLABEL) {
+      p = line;
+      *p++ = 'L'; p = irPutInt(p, blk->label); *p++ = ':'; *p = '\0';
+      emitCode(emit, line);
+    }
+
+    for (int i = 0; i < blk->num; ++i) {
+      IrIns* ins = &blk->ins[i];
+      if (ins->op == IRNOP) continue;
+      irFormat(ins, line);
+      emitCode(emit, line);
+    }
+  }
+}
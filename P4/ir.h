@@ -0,0 +1,109 @@
+// ir.h - Instruction IR for 68000 code
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint8_t
+#include <stdlib.h>         // calloc, realloc
+#include <string.h>         // memcpy, memmove, strlen
+
+#include "emit.h"           // Emit
+#include "intern.h"         // internStr
+#include "ut.h"             // ut*
+
+// The code generator no longer formats text.  It appends IrIns instructions,
+// each an opcode, a size suffix and up to two typed operands, onto an IrFun.
+// An IrFun is a list of basic blocks: a block starts at a label, or just
+// after a branch, and control leaves it only at its end.  Passes such as the
+// peephole optimizer (peep.c) rewrite the IrFun in place.  When a function is
+// complete, irPrint formats it, once, into the Emit buffer.
+//
+// Single-operand instructions keep their operand in 'src' if they only read
+// it (BSR, Bcc, JMP, PEA, TST, UNLK) and in 'dst' if they write it (CLR,
+// EXT, NEG).  A deleted instruction becomes an IRNOP, which irPrint skips.
+
+typedef enum {
+  IRNOP = 0,
+  IRADD, IRADDQ, IRBEQ, IRBGE, IRBGT, IRBLE, IRBLT, IRBNE, IRBRA, IRBSR,
+  IRCLR, IRCMP, IRCMPI, IREXT, IRJMP, IRLEA, IRLINK, IRLSL, IRMOVE,
+  IRMOVEM, IRMOVEQ, IRMULS, IRNEG, IRPEA, IRRTS, IRSIMHALT, IRSUB, IRSUBQ,
+  IRTST, IRUNLK,
+  IRNUMOP
+} IROP;
+
+typedef enum {
+  IRSZNONE = 0,             // eg: LEA, BSR, MULS, MOVEQ
+  IRSZB,                    // .B
+  IRSZW,                    // .W
+  IRSZL,                    // .L
+} IRSZ;
+
+typedef enum {
+  IROPNONE = 0,             // operand absent
+  IROPDREG,                 // Dn              val = n
+  IROPAREG,                 // An              val = n
+  IROPIMM,                  // #val
+  IROPFRAME,                // (val,A6)
+  IROPPUSH,                 // -(A7)
+  IROPPOP,                  // (A7)+
+  IROPLAB,                  // code label      val = label number (20 => L20)
+  IROPDATA,                 // data label      val = label number
+  IROPFUN,                  // function        val = intern ID
+  IROPREGS,                 // MOVEM list      val = mask (bit n => Dn)
+} IROPKIND;
+
+typedef struct {
+  uint8_t kind;             // IROPKIND
+  int     val;              // register, number, offset, label or intern ID
+} IrOpnd;
+
+typedef struct {
+  uint8_t op;               // IROP
+  uint8_t sz;               // IRSZ
+  IrOpnd  src;
+  IrOpnd  dst;
+} IrIns;
+
+#define IRNOLABEL  (-1)     // block not headed by a label
+#define IRMINCAP   8        // initial number of slots in a block, or blocks
+#define IRMAXNAME  256      // longest function name irPrint will format
+#define IRMAXLINE  (IRMAXNAME + 64) // longest line irFormat will format
+
+typedef struct {
+  int    label;             // label number (IRNOLABEL => none)
+  int    num;               // instructions in use
+  int    cap;               // slots in ins[]
+  IrIns* ins;
+} IrBlock;
+
+typedef struct {
+  int      funid;           // intern ID of the function
+  int      num;             // blocks in use
+  int      cap;             // slots in blk[]
+  IrBlock* blk;
+} IrFun;
+
+void    irAdd(IrFun* fun, IROP op, IRSZ sz, IrOpnd src, IrOpnd dst);
+void    irAddBlock(IrFun* fun, int label);
+void    irBegin(IrFun* fun, int funid);
+void    irInsert(IrBlock* blk, int at, IROP op, IRSZ sz, IrOpnd src, IrOpnd dst);
+int     irEndsBlock(IROP op);
+void    irFormat(IrIns* ins, char* line);
+IROP    irInverse(IROP op);
+int     irIsBranch(IROP op);
+int     irIsCond(IROP op);
+int     irIsJump(IROP op);
+IrFun*  irNew();
+IrOpnd  irOpA(int n);
+IrOpnd  irOpD(int n);
+IrOpnd  irOpData(int label);
+int     irOpEq(IrOpnd a, IrOpnd b);
+IrOpnd  irOpFrame(int off);
+IrOpnd  irOpFun(int funid);
+IrOpnd  irOpImm(int val);
+IrOpnd  irOpLab(int label);
+IrOpnd  irOpNone();
+IrOpnd  irOpPop();
+IrOpnd  irOpPush();
+IrOpnd  irOpRegs(int mask);
+void    irPrint(IrFun* fun, Emit* emit);
@@ -0,0 +1,247 @@
+// isel.c - Instruction Selection
+
+#include "isel.h"
+
+static char* iselRuleNames[ISELNUMRULE] = {
+  "moveq", "clr", "addq", "tst", "cmp-moveq", "mul-shift",
+};
+
+// A multiply by a constant, as a shift sequence (see iselMulPlan)
+
+typedef struct {
+  int  zero;                // result is 0 => MOVEQ #0, Dx
+  int  lo;                  // first shift count
+  int  hi;                  // total shift count, for the second term
+  IROP join;                // IRADD, IRSUB, or IRNOP if just one term
+  int  neg;                 // finish with NEG.L
+} IselMul;
+
+// ============================================================================
+// Is 'n' an immediate that fits MOVEQ?  That fits ADDQ or SUBQ?
+// ============================================================================
+static int iselIsByte(int n)  { return n >= -128 && n <= 127; }
+
+static int iselIsQuick(int n) { return n >= 1 && n <= 8; }
+
+// ============================================================================
+// Cycles taken by "MULS #n, Dx".  38 + 2p, where p is the number of 01 or 10
+// pairs in the 16-bit multiplier with a 0 appended below it; plus 4 to fetch
+// the immediate.
+// ============================================================================
+static int iselMulsCycles(int n) {
+  unsigned int bits = (unsigned int) (uint16_t) n << 1;
+  unsigned int flips = (bits ^ (bits >> 1)) & 0xFFFF;
+  int p = 0;
+  for (; flips; flips &= flips - 1) ++p;
+  return 38 + 2 * p + 4;
+}
+
+// ============================================================================
+// Cycles taken to shift a data register left by 'k', 8 bits at a time
+// ============================================================================
+static int iselShiftCycles(int k) {
+  int cycles = 0;
+  for (; k > 0; k -= ISELMAXSHIFT) {
+    int step = k < ISELMAXSHIFT ? k : ISELMAXSHIFT;
+    cycles += 8 + 2 * step;
+  }
+  return cycles;
+}
+
+// ============================================================================
+// If 'n' is a power of 2, return its log2.  Otherwise return -1.
+// ============================================================================
+static int iselLog2(int n) {
+  if (n <= 0 || (n & (n - 1))) return -1;
+  int k = 0;
+  while ((1 << k) != n) ++k;
+  return k;
+}
+
+// ============================================================================
+// Plan a shift sequence for "MULS #n, Dx", and return its cycle count.  With
+// m = (int16_t) n, and |m| = 2^hi + 2^lo, or 2^hi - 2^lo, or just 2^lo:
+//
+//    EXT.L   Dx                ; Dx = low word of Dx, sign-extended
+//    LSL.L   #lo, Dx
+//    MOVE.L  Dx, D1            ; } only for two terms
+//    LSL.L   #hi-lo, Dx        ; }
+//    ADD.L   D1, Dx            ; } (or SUB.L)
+//    NEG.L   Dx                ; only if m < 0
+//
+// Return -1 if 'n' has no such form.
+// ============================================================================
+static int iselMulPlan(int n, IselMul* plan) {
+  int m = (int16_t) n;
+  memset(plan, 0, sizeof(IselMul));
+  plan->join = IRNOP;
+  if (m == 0) {
+    plan->zero = 1;
+    return 4;
+  }
+
+  plan->neg = m < 0;
+  int mag = plan->neg ? -m : m;                   // 1 thru 32768
+  plan->lo = 0;
+  while ((mag & (1 << plan->lo)) == 0) ++plan->lo;
+  int rest = mag - (1 << plan->lo);
+
+  int cycles = 4 + iselShiftCycles(plan->lo) + (plan->neg ? 6 : 0);
+  if (rest == 0) return cycles;
+
+  if ((plan->hi = iselLog2(rest)) >= 0) {
+    plan->join = IRADD;
+  } else if ((plan->hi = iselLog2(mag + (1 << plan->lo))) >= 0) {
+    plan->join = IRSUB;
+  } else {
+    return -1;
+  }
+  return cycles + 4 + iselShiftCycles(plan->hi - plan->lo) + 8;
+}
+
+// ============================================================================
+// Insert "LSL.L #k, dst" into 'blk' at 'at', 8 bits at a time.  Return the
+// number of instructions inserted.
+// ============================================================================
+static int iselShift(IrBlock* blk, int at, int k, IrOpnd dst) {
+  int num = 0;
+  for (; k > 0; k -= ISELMAXSHIFT) {
+    int step = k < ISELMAXSHIFT ? k : ISELMAXSHIFT;
+    irInsert(blk, at + num++, IRLSL, IRSZL, irOpImm(step), dst);
+  }
+  return num;
+}
+
+// ============================================================================
+// Replace "MULS #n, Dx", at instruction 'i' of 'blk', by the sequence in
+// 'plan'.  Return the number of instructions added.
+// ============================================================================
+static int iselMul(IrBlock* blk, int i, IselMul* plan) {
+  IrOpnd dst = blk->ins[i].dst;
+  IrOpnd none = irOpNone();
+
+  if (plan->zero) {
+    blk->ins[i] = (IrIns) { IRMOVEQ, IRSZNONE, irOpImm(0), dst };
+    return 0;
+  }
+
+  blk->ins[i] = (IrIns) { IREXT, IRSZL, none, dst };
+  int at = i + 1;
+  at += iselShift(blk, at, plan->lo, dst);
+  if (plan->join != IRNOP) {
+    irInsert(blk, at++, IRMOVE, IRSZL, dst, irOpD(1));
+    at += iselShift(blk, at, plan->hi - plan->lo, dst);
+    irInsert(blk, at++, plan->join, IRSZL, irOpD(1), dst);
+  }
+  if (plan->neg) irInsert(blk, at++, IRNEG, IRSZL, none, dst);
+  return at - i - 1;
+}
+
+// ============================================================================
+// Try each rule on instruction 'i' of block 'b'.  Return the number of
+// instructions added after it.
+// ============================================================================
+static int iselIns(Isel* isel, Peep* peep, IrFun* fun, int b, int i) {
+  IrBlock* blk = &fun->blk[b];
+  IrIns*   p   = &blk->ins[i];
+  IrOpnd   d1  = irOpD(1);
+  int      condNext = i + 1 < blk->num && irIsCond(blk->ins[i + 1].op);
+
+  if (p->op == IRMOVE && p->sz == IRSZL && p->src.kind == IROPIMM) {
+    if (p->dst.kind == IROPDREG && iselIsByte(p->src.val)) {
+      p->op = IRMOVEQ;
+      p->sz = IRSZNONE;
+      ++isel->fired[ISELMOVEQ];
+    } else if (p->dst.kind == IROPFRAME && p->src.val == 0) {
+      p->op  = IRCLR;
+      p->src = irOpNone();
+      ++isel->fired[ISELCLR];
+    }
+    return 0;
+  }
+
+  if (p->op == IRCLR && p->sz == IRSZL && p->dst.kind == IROPDREG) {
+    *p = (IrIns) { IRMOVEQ, IRSZNONE, irOpImm(0), p->dst };
+    ++isel->fired[ISELMOVEQ];
+    return 0;
+  }
+
+  if ((p->op == IRADD || p->op == IRSUB) && p->sz == IRSZL
+    && p->src.kind == IROPIMM) {
+    int n = p->src.val;
+    if (iselIsQuick(n)) {
+      p->op = p->op == IRADD ? IRADDQ : IRSUBQ;
+    } else if (n != INT32_MIN && iselIsQuick(-n)) {
+      p->op = p->op == IRADD ? IRSUBQ : IRADDQ;
+      p->src = irOpImm(-n);
+    } else {
+      return 0;
+    }
+    ++isel->fired[ISELADDQ];
+    return 0;
+  }
+
+  if ((p->op == IRCMP || p->op == IRCMPI) && p->src.kind == IROPIMM) {
+    int n = p->src.val;
+    if (n == 0) {
+      *p = (IrIns) { IRTST, p->sz, p->dst, irOpNone() };
+      ++isel->fired[ISELTST];
+    } else if (iselIsByte(n) && p->dst.kind == IROPDREG
+      && !irOpEq(p->dst, d1) && !peepIsLive(peep, fun, b, i, d1)) {
+      IrOpnd dst = p->dst;
+      *p = (IrIns) { IRMOVEQ, IRSZNONE, irOpImm(n), d1 };
+      irInsert(blk, i + 1, IRCMP, IRSZL, d1, dst);
+      ++isel->fired[ISELCMPQ];
+      return 1;
+    }
+    return 0;
+  }
+
+  if (p->op == IRMULS && p->src.kind == IROPIMM && p->dst.kind == IROPDREG
+    && !condNext) {
+    IselMul plan;
+    int cycles = iselMulPlan(p->src.val, &plan);
+    if (cycles < 0 || cycles >= iselMulsCycles(p->src.val)) return 0;
+    if (plan.join != IRNOP
+      && (irOpEq(p->dst, d1) || peepIsLive(peep, fun, b, i, d1))) return 0;
+    ++isel->fired[ISELMUL];
+    return iselMul(blk, i, &plan);
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// Select cheaper instructions throughout 'fun'.  Run just after peepFun, so
+// that 'peep' can still answer liveness queries.
+// ============================================================================
+void iselFun(Isel* isel, Peep* peep, IrFun* fun) {
+  for (int b = 0; b < fun->num; ++b) {
+    for (int i = 0; i < fun->blk[b].num; ++i) {
+      i += iselIns(isel, peep, fun, b, i);
+    }
+  }
+}
+
+// ============================================================================
+// Build a new Isel
+// ============================================================================
+Isel* iselNew() {
+  Isel* isel = calloc(1, sizeof(Isel));
+  if (!isel) utDie2Str("iselNew", "Out of memory");
+  return isel;
+}
+
+// ============================================================================
+// Print how many times each rule fired during this compile
+// ============================================================================
+void iselReport(Isel* isel) {
+  int total = 0;
+  printf("\nIsel:");
+  for (int r = 0; r < ISELNUMRULE; ++r) {
+    printf(" %s %d%s", iselRuleNames[r], isel->fired[r],
+      r < ISELNUMRULE - 1 ? "," : "");
+    total += isel->fired[r];
+  }
+  printf(" (total %d) \n", total);
+}
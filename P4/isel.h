@@ -0,0 +1,51 @@
+// isel.h - Instruction Selection
+
+#pragma once
+
+#include <stdint.h>         // int16_t
+#include <stdio.h>          // printf
+#include <stdlib.h>         // calloc
+
+#include "ir.h"             // IrFun, IrBlock, IrIns
+#include "peep.h"           // peepIsLive
+#include "ut.h"             // ut*
+
+// cg.c generates one general form for each operation - eg: MOVE.L #n, Dx or
+// MULS #n, D0 - and the peephole pass keeps to those forms.  iselFun runs
+// last, and swaps in the cheaper 68000 instructions that suit particular
+// operands.  Cycle counts are for a 68000:
+//
+//    MOVE.L  #n, Dx      =>  MOVEQ   #n, Dx          12 =>  4   -128 <= n <= 127
+//    CLR.L   Dx          =>  MOVEQ   #0, Dx           6 =>  4
+//    MOVE.L  #0, (d,A6)  =>  CLR.L   (d,A6)          same cycles, 4 bytes shorter
+//    ADD.L   #n, R       =>  ADDQ.L  #n, R           16 =>  8   1 <= n <= 8
+//    SUB.L   #n, R       =>  SUBQ.L  #n, R           16 =>  8   (or -n, swapped)
+//    CMP.L   #0, X       =>  TST.L   X               14 =>  4
+//    CMP.L   #n, Dx      =>  MOVEQ   #n, D1          14 => 10   D1 dead
+//                            CMP.L   D1, Dx
+//    MULS    #n, Dx      =>  EXT.L, LSL.L, ADD.L ... 42+ => less, see iselMul
+//
+// MULS multiplies the low 16 bits of each operand, so a shift sequence first
+// sign-extends the low word of Dx with EXT.L.  Then the result matches MULS
+// for every value of Dx.  A rewrite that changes the condition codes is
+// skipped if a Bcc follows.
+
+typedef enum {
+  ISELMOVEQ = 0,            // MOVE.L #n, Dx and CLR.L Dx  => MOVEQ
+  ISELCLR,                  // MOVE.L #0, (d,A6)           => CLR.L
+  ISELADDQ,                 // ADD.L/SUB.L #n              => ADDQ/SUBQ
+  ISELTST,                  // CMP.L #0                    => TST.L
+  ISELCMPQ,                 // CMP.L #n                    => MOVEQ + CMP.L
+  ISELMUL,                  // MULS #n                     => shifts and adds
+  ISELNUMRULE
+} ISELRULE;
+
+#define ISELMAXSHIFT 8      // largest count in LSL #n, Dx
+
+typedef struct {
+  int fired[ISELNUMRULE];   // times each rule fired, whole compile
+} Isel;
+
+void  iselFun(Isel* isel, Peep* peep, IrFun* fun);
+Isel* iselNew();
+void  iselReport(Isel* isel);
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Instruction selection checker
+#
+# Builds and runs check/iselcheck.c, which checks each isel rule (see
+# isel.c) by running small IR functions, before and after iselFun, on a model
+# of the 68000 registers, memory and condition codes, and comparing the
+# results.  Run it after changing iselMulPlan, iselIns or peepIsLive.
+#
+#   MULS #c, D0         every 16-bit c, and a few wider, times every 16-bit
+#                       value in D0, with random high words
+#   MOVE ADD SUB CMP    every immediate in -70000 .. 70000, plus INT32_MIN and
+#   CMPI #n, <ea>       INT32_MAX, into D0, a frame slot and (for ADD and SUB)
+#                       A7, against 8 values each
+#
+# Each runs in 4 shapes: alone; followed by a Bcc (each of the 6, for
+# small n); and both of those with D1 read afterwards, so a rule that
+# needs D1 as a scratch must see, via peepIsLive, that it is live.  A quick
+# form (MOVEQ, ADDQ, SUBQ, LSL) with an immediate it cannot encode fails.
+#
+# Usage: bash iselcheck.sh [quick]    (run from the P4 folder)
+#
+# A full run takes about 5 minutes.  "quick" tries just 1 in 97 of the D0
+# values for MULS, and takes about 15 seconds.
+
+. ./build.sh
+dir=$(mktemp -d)
+build $dir/iselcheck check/iselcheck.c || exit 1
+$dir/iselcheck $1
+fail=$?
+rm -rf $dir
+exit $fail
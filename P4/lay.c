@@ -3,207 +3,268 @@
 #include "lay.h"
 
 // ============================================================================
-// Add a row to the Layout call 'lay'
-//
-// nam  : name of the par/var
-// typ  : type of the par/var (TYPINT|TYPSTR|TYPFUN)
-// role : ROLEPAR|ROLEVAR|ROLEFUN|ROLEEND
-// off  : byte offset from FP, in the runtime stack frame, for this par/var
+// Grow 'scope' to twice its current number of slots, re-inserting every
+// symbol it holds.
 // ============================================================================
-void layAdd(Lay* lay, char* nam, TYP typ, ROLE role, int off) {
-  lay->hiIdx++;
-  assert(lay->hiIdx < LAYMAX);
-  lay->row[lay->hiIdx].nam  = nam;
-  lay->row[lay->hiIdx].typ  = typ;
-  lay->row[lay->hiIdx].role = role;
-  lay->row[lay->hiIdx].off  = off;
-}
+static void layGrow(LayScope* scope) {
+  int     oldcap = scope->cap;
+  LaySym* oldsym = scope->sym;
 
-// ============================================================================
-// Build a Layout for the function defined by 'astfun'
-// ============================================================================
-void layBuild(Lay* lay, AstFun* astfun) {
-  layFun(lay, astfun);                          // ROLEFUN row
-  if (astfun->pars) {
-    layBuildPars(lay, astfun->pars);            // parameter rows
-  }
-  if (astfun->body && astfun->body->vars) {
-    layBuildVars(lay, astfun->body->vars);      // variable rows
+  scope->cap = 2 * oldcap;
+  scope->sym = calloc(scope->cap, sizeof(LaySym));
+  if (!scope->sym) utDie2Str("layGrow", "Out of memory");
+
+  uint32_t mask = scope->cap - 1;
+  for (int i = 0; i < oldcap; ++i) {
+    if (oldsym[i].id == 0) continue;
+    uint32_t slot = layHash(oldsym[i].id) & mask;
+    while (scope->sym[slot].id) slot = (slot + 1) & mask;
+    scope->sym[slot] = oldsym[i];
   }
-  layEnd(lay, astfun);                          // ROLEND row
-  layDump(lay);                              // debug
+  free(oldsym);
 }
 
 // ============================================================================
-// Build the Layout for the intrinsic functions says, sayn and sayl
+// Add a symbol into the current scope of the Layout called 'lay'.  Return a
+// pointer to its slot (valid until the next layAdd into that same scope).
+//
+// id   : intern ID of the name of the fun/par/var
+// typ  : type of the fun/par/var (TYPINT|TYPSTR|TYPFUN)
+// role : ROLEFUN|ROLEPAR|ROLEVAR
+// off  : byte offset from FP, in the runtime stack frame, for this par/var
 // ============================================================================
-void layBuildIntrinsics(Lay* lay) {
-  AstNam* funnam = NULL;                        // says, sayn, sayl
-  AstNam* parnam = NULL;                        // parameter name
-  AstPar* par    = NULL;                        // parameter
-  AstFun* fun    = NULL;                        // function
+LaySym* layAdd(Lay* lay, int id, TYP typ, ROLE role, int off) {
+  LayScope* scope = lay->cur;
+  if (2 * (scope->num + 1) > scope->cap) layGrow(scope);
 
-  funnam = astNewNam("says");
-  parnam = astNewNam("x");
-  par    = astNewPar(parnam);
-  fun    = astNewFun(funnam, par, NULL);
-  layBuild(lay, fun);
-
-  funnam = astNewNam("sayn");
-  parnam = astNewNam("x");
-  par    = astNewPar(parnam);
-  fun    = astNewFun(funnam, par, NULL);
-  layBuild(lay, fun);
+  uint32_t mask = scope->cap - 1;
+  uint32_t slot = layHash(id) & mask;
+  while (scope->sym[slot].id) {
+    if (scope->sym[slot].id == id) {
+      utDie3Str("layAdd", "Duplicate definition of", internStr(id));
+    }
+    slot = (slot + 1) & mask;
+  }
 
-  funnam = astNewNam("sayl");
-  fun = astNewFun(funnam, NULL, NULL);
-  layBuild(lay, fun);
+  LaySym* sym = &scope->sym[slot];
+  sym->id    = id;
+  sym->typ   = typ;
+  sym->role  = role;
+  sym->off   = off;
+  sym->reg   = 0;
+  sym->scope = NULL;
+  ++scope->num;
+  return sym;
 }
 
 // ============================================================================
-// Add rows into 'lay' for the list of params defined by 'astpar'
+// Build a Layout for the function at node 'fun' of 'flat'.  Its Par and Var
+// children each get a slot in the stack frame.  After LINK A6, the frame
+// looks like:
+//
+//          |----------------|
+//          |   last param   |
+//          |      ...       |
+//          |  first param   |<= (8,A6)
+//          | return-address |<= (4,A6)
+//          |    old A6      |<= A6
+//          |   first var    |<= (-4,A6)
+//          |      ...       |
+//          |----------------|
+//
+// The register allocator (raFun) may later move some pars/vars into
+// registers, and re-pack the frame.
 // ============================================================================
-void layBuildPars(Lay* lay, AstPar* astpar) {
-
-   if (astpar == NULL) return;       // function has no local variables
-
-   int off = -4;                     // offset from FP of first param
-
-   while (astpar) {
-      layAdd(lay, astpar->nam->lex, TYPINT, ROLEVAR, off);
-      off -= 4;
-      astpar = (AstVar*)astpar->next;
-   }
+void layBuild(Lay* lay, Flat* flat, int fun) {
+  FlatNode* node = flat->node;                  // alias
+  layFun(lay, node[fun].val);                   // ROLEFUN symbol + new scope
 
+  int paroff = 8;                               // offset from FP of first param
+  int varoff = -4;                              // offset from FP of first var
+  for (int c = fun + 1; c < (int) node[fun].end; c = node[c].end) {
+    if (node[c].tag == ASTPAR) {
+      layAdd(lay, node[c].val, TYPINT, ROLEPAR, paroff);
+      paroff += 4;
+    } else if (node[c].tag == ASTVAR) {
+      layAdd(lay, node[c].val, TYPINT, ROLEVAR, varoff);
+      varoff -= 4;
+    }
+  }
+  layEnd(lay);                                  // back to global scope
 }
 
 // ============================================================================
-// Add rows into 'lay' for the list of (local) variables defined by 'astvar'
+// Build the Layout for the intrinsic functions says, sayn and sayl
 // ============================================================================
-void layBuildVars(Lay* lay, AstVar* astvar) {
-
-  if (astvar == NULL) return;       // function has no local variables
+void layBuildIntrinsics(Lay* lay) {
+  layFun(lay, intern("says"));
+  layAdd(lay, intern("x"), TYPINT, ROLEPAR, 8);
+  layEnd(lay);
 
-  int off = -4;                     // offset from FP of first variable
+  layFun(lay, intern("sayn"));
+  layAdd(lay, intern("x"), TYPINT, ROLEPAR, 8);
+  layEnd(lay);
 
-  while (astvar) {
-    layAdd(lay, astvar->nam->lex, TYPINT, ROLEVAR, off);
-    off -= 4;
-    astvar = (AstVar*) astvar->next;
-  }
+  layFun(lay, intern("sayl"));
+  layEnd(lay);
 }
 
 // ============================================================================
-// Count the number of local variables.  'rownum' gives the index, within
-// the row[] array, of the ROLEFUN row for the function of interest.
+// Count the number of local variables held in the function scope 'scope'
 // ============================================================================
-int layCountVars(Lay* lay, int rownum) {
+int layCountVars(LayScope* scope) {
    int count = 0;
 
-   while (lay->row[rownum].role == ROLEVAR) {
-      count++;
-      rownum++;
+   for (int i = 0; i < scope->cap; ++i) {
+      if (scope->sym[i].id && scope->sym[i].role == ROLEVAR) count++;
    }
 
    return count;
 }
 
 // ============================================================================
-// Dump the contents of 'lay' to the console, for debugging
+// Dump the contents of 'scope' to the console, for debugging
 // ============================================================================
-void layDump(Lay* lay) {
+void layDump(LayScope* scope) {
   printf("\n\n");
-  printf("Lay: hiIdx = %d \n", lay->hiIdx);
-
-  int rownum = 0;
-  while (lay->row[rownum].typ != 0) {
-    char* nam = lay->row[rownum].nam;
-    char* typ = astTYPtoStr(lay->row[rownum].typ);
-    char* role = layROLEtoStr(lay->row[rownum].role);
-    int   off = lay->row[rownum].off;
-    printf("  [%d] %s \t %s \t %s \t %d \n", rownum, nam, typ, role, off);
-    ++rownum;
+  printf("Lay: num = %d, cap = %d \n", scope->num, scope->cap);
+
+  for (int slot = 0; slot < scope->cap; ++slot) {
+    LaySym* sym = &scope->sym[slot];
+    if (sym->id == 0) continue;
+    char* nam  = internStr(sym->id);
+    char* typ  = astTYPtoStr(sym->typ);
+    char* role = layROLEtoStr(sym->role);
+    printf("  [%d] %s \t %s \t %s \t %d", slot, nam, typ, role, sym->off);
+    if (sym->reg) printf(" \t D%d", sym->reg);
+    printf(" \n");
   }
 }
 
 // ============================================================================
-// End the current new function layout
+// End the current function layout: subsequent symbols go into the global
+// scope again
 // ============================================================================
-void layEnd(Lay* lay, AstFun* astfun) {
-  layAdd(lay, astfun->nam->lex, TYPEND, ROLEEND, 0);
+void layEnd(Lay* lay) {
+  assert(lay->cur->up == lay->glo);
+  lay->cur = lay->glo;
 }
 
 // ============================================================================
-// Search the rows of 'lay' for the function called 'funnam'.  Return the
-// index of the TYPFUN row that matches 'funnam'.  We use a simple, slow,
-// linear search.  Abort if not found.
+// Search 'scope', and then each enclosing scope in turn, for the symbol
+// whose name has intern ID 'id'.  Return NULL if not found.
 // ============================================================================
-int layFindFunIdx(Lay* lay, char* funnam) {
-  int rownum = 0;
-  while (lay->row[rownum].typ != 0) {                   // end of row[] array
-    if (lay->row[rownum].role == ROLEFUN) {             // start of function
-      if (strcmp(funnam, lay->row[rownum].nam) == 0) {
-        return rownum;
-      }
+LaySym* layFind(LayScope* scope, int id) {
+  uint32_t h = layHash(id);
+  for (; scope; scope = scope->up) {
+    uint32_t mask = scope->cap - 1;
+    uint32_t slot = h & mask;
+    while (scope->sym[slot].id) {
+      if (scope->sym[slot].id == id) return &scope->sym[slot];
+      slot = (slot + 1) & mask;
     }
-    ++rownum;
   }
-  utDie3Str("layFindFunIdx", "Cannot find function ", funnam);
-  return 0;                                             // pacify compiler
+  return NULL;
 }
 
 // ============================================================================
-// Search the rows of 'lay' for the variable or parameter ("varpar") called
-// 'nam', in the function called 'funnam'.  Return the index, within the
-// row[] array, of that entry.  Note that variables and parameters must be
-// unique in a valid SubC program (although the SubC compiler does not enforce
-// this condition).  We use a simple, slow, linear search.  Abort if not found
+// Look up the function whose name has intern ID 'funid' in the global scope
+// of 'lay'.  Abort if not found.
 // ============================================================================
-int layFindVarParIdx(Lay* lay, char* funnam, char* nam) {
-  int rownum = layFindFunIdx(lay, funnam);            // index of TYPFUN row
+LaySym* layFindFun(Lay* lay, int funid) {
+  LaySym* sym = layFind(lay->glo, funid);
+  if (sym == NULL || sym->role != ROLEFUN) {
+    utDie3Str("layFindFun", "Cannot find function ", internStr(funid));
+  }
+  return sym;
+}
 
-  rownum++;                                           // first parvar
+// ============================================================================
+// Look up the variable or parameter ("varpar") with intern ID 'id', in the
+// function with intern ID 'funid'.  Both lookups are hash probes on an integer
+// key, so the cost does not depend on the number of functions, nor on the
+// number of pars/vars, nor on the length of the names.  Note that
+// variables and parameters must be unique in a valid SubC program - layAdd
+// enforces this.  Abort if not found
+// ============================================================================
+LaySym* layFindVarPar(Lay* lay, int funid, int id) {
+  LaySym* fun = layFindFun(lay, funid);
+  LaySym* sym = layFind(fun->scope, id);
+  if (sym == NULL || sym->role == ROLEFUN) {
+    utDie5Str("layFindVarPar", "Cannot find varpar", internStr(id),
+      "in function", internStr(funid));
+  }
+  return sym;
+}
 
-  while (lay->row[rownum].typ != 0) {                 // end of row[]
-    while (lay->row[rownum].typ != TYPEND) {          // end of function
-      char* thisnam = lay->row[rownum].nam;
-      if (strcmp(nam, thisnam) == 0) {                // match!
-        return rownum;
-      }
-      ++rownum;
-    }
+// ============================================================================
+// Number of bytes of stack frame needed below FP for the variables of
+// 'scope' that are not held in registers
+// ============================================================================
+int layFrameSize(LayScope* scope) {
+  int size = 0;
+  for (int i = 0; i < scope->cap; ++i) {
+    LaySym* sym = &scope->sym[i];
+    if (sym->id && sym->role == ROLEVAR && -sym->off > size) size = -sym->off;
   }
-  utDie5Str("layFindVarParIdx", "Cannot find varpar", nam, "in function", funnam);
-  return 0;                                           // pacify compiler
+  return size;
 }
 
 // ============================================================================
-// Start a new function layout
+// Start a new function layout for the function whose intern ID is 'funid':
+// add the ROLEFUN symbol into the global scope, and make a fresh function
+// scope, nested within it, the current scope
 // ============================================================================
-void layFun(Lay* lay, AstFun* astfun) {
-  layAdd(lay, astfun->nam->lex, TYPFUN, ROLEFUN, 0);
+void layFun(Lay* lay, int funid) {
+  assert(lay->cur == lay->glo);
+  LaySym* fun = layAdd(lay, funid, TYPFUN, ROLEFUN, 0);
+  fun->scope = layNewScope(lay->glo);
+  lay->cur = fun->scope;
 }
 
 // ============================================================================
-// Build a new, empty Layout ('nrep' repeats of a Lay struct)
+// Hash the intern ID 'id' (Fibonacci hashing, folded so the low bits, which
+// select the slot, depend on every bit of 'id')
 // ============================================================================
+uint32_t layHash(int id) {
+  uint32_t h = (uint32_t) id * 2654435769u;
+  return h ^ (h >> 16);
+}
 
-Lay* layNew(int nrep) {
-  Lay* lay = calloc(nrep * sizeof(Lay), 1);
-  lay->hiIdx = -1;                      // no rows
+// ============================================================================
+// Build a new, empty Layout, comprising just an empty global scope
+// ============================================================================
+Lay* layNew() {
+  Lay* lay = calloc(1, sizeof(Lay));
+  if (!lay) utDie2Str("layNew", "Out of memory");
+  lay->glo = layNewScope(NULL);
+  lay->cur = lay->glo;
   return lay;
 }
 
+// ============================================================================
+// Build a new, empty scope, nested within 'up'
+// ============================================================================
+LayScope* layNewScope(LayScope* up) {
+  LayScope* scope = calloc(1, sizeof(LayScope));
+  if (!scope) utDie2Str("layNewScope", "Out of memory");
+  scope->up  = up;
+  scope->num = 0;
+  scope->cap = LAYMINCAP;
+  scope->sym = calloc(LAYMINCAP, sizeof(LaySym));
+  if (!scope->sym) utDie2Str("layNewScope", "Out of memory");
+  return scope;
+}
+
 // ============================================================================
 // Convert a member of the ROLE enum into its display string
 // ============================================================================
 char* layROLEtoStr(ROLE role) {
   switch(role) {
     case ROLENA:  return "ROLENA";
-    case ROLEEND: return "ROLEEND";
     case ROLEFUN: return "ROLEFUN";
     case ROLEPAR: return "ROLEPAR";
     case ROLEVAR: return "ROLEVAR";
     default:      return "ROLENA";
   }
-}
\ No newline at end of file
+}
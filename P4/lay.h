@@ -3,44 +3,69 @@
 #pragma once
 
 #include <assert.h>         // assert
+#include <stdint.h>         // uint32_t
 
 #include "ast.h"            // TYP
-#include "string.h"         // strcmp
+#include "flat.h"           // Flat
+#include "intern.h"         // internStr
 
 // The ROLE enum comprises constants for the role, played by different
-// identifiers in the Lay table (made up of individual rows)
+// identifiers in the Lay table
 
 typedef enum {
-  ROLENA  = 0,  // where row.role does not apply
-  ROLEEND,      // last row for a function
-  ROLEFUN,      // first row for a function
+  ROLENA  = 0,  // where sym.role does not apply
+  ROLEFUN,      // identifier is a function
   ROLEPAR,      // identifier is a parameter (not a variable or function)
   ROLEVAR,      // identifier is a variable  (not a parameter or function)
 } ROLE;
 char* layROLEtoStr(ROLE role);
 
-#define LAYMAX 100
+// The Lay table is a tree of scopes.  The global scope holds one ROLEFUN
+// symbol per function.  Each of those points to its own function scope, which
+// holds the ROLEPAR and ROLEVAR symbols for that function, and whose 'up'
+// pointer leads back to the global scope.
+//
+// Each scope is an open-addressed hash table (linear probing), keyed on the
+// intern ID of the symbol name.  The table doubles in size whenever it becomes
+// half full, so there is no limit on the number of functions, or of pars/vars
+// per function.
+
+#define LAYMINCAP 8         // initial number of slots in a LayScope
+
+struct LayScope_;
+
+typedef struct {
+  int   id;                 // intern ID of fun/par/var (0 => empty slot)
+  TYP   typ;                // type of fun/par/var - eg: TYPINT
+  ROLE  role;               // ROLEFUN | ROLEPAR | ROLEVAR
+  int   off;                // offset from FP of par/var
+  int   reg;                // Dn holding par/var (0 => lives in the frame)
+  struct LayScope_* scope;  // for ROLEFUN: the function's own scope
+} LaySym;
+
+typedef struct LayScope_ {
+  struct LayScope_* up;     // enclosing scope (NULL for the global scope)
+  int     num;              // number of symbols held
+  int     cap;              // number of slots in sym[] (a power of 2)
+  LaySym* sym;              // hash slots
+} LayScope;
 
 typedef struct {
-  int hiIdx;                // index in row[] of last entry so far
-  struct {
-    char* nam;              // name of parvar
-    TYP   typ;              // type of parvar - eg: TYPINT
-    ROLE  role;             // ROLEPAR | ROLEVAR | ROLEFUN | ROLEEND
-    int   off;              // offset from FP of parvar
-  } row[LAYMAX];
+  LayScope* glo;            // global scope: functions
+  LayScope* cur;            // scope currently being built
 } Lay;
 
-void layAdd(Lay* lay, char* nam, TYP typ, ROLE role, int off);
-void layBuild(Lay* lay, AstFun* astfun);
-void layBuildIntrinsics(Lay* lay);
-void layBuildPars(Lay* lay, AstPar* astpar);
-void layBuildVars(Lay* lay, AstVar* astvar);
-int  layCountVars(Lay* lay, int rownum);
-void layDump(Lay* lay);
-void layEnd(Lay* lay, AstFun* astfun);
-int  layFindFunIdx(Lay* lay, char* funnam);
-int  layFindVarParIdx(Lay* lay, char* funnam, char* nam);
-void layFun(Lay* lay, AstFun* astfun);
-Lay* layNew(int nrep);
-void layRem(Lay* lay);
+LaySym*   layAdd(Lay* lay, int id, TYP typ, ROLE role, int off);
+void      layBuild(Lay* lay, Flat* flat, int fun);
+void      layBuildIntrinsics(Lay* lay);
+int       layCountVars(LayScope* scope);
+void      layDump(LayScope* scope);
+void      layEnd(Lay* lay);
+LaySym*   layFind(LayScope* scope, int id);
+LaySym*   layFindFun(Lay* lay, int funid);
+LaySym*   layFindVarPar(Lay* lay, int funid, int id);
+int       layFrameSize(LayScope* scope);
+void      layFun(Lay* lay, int funid);
+uint32_t  layHash(int id);
+Lay*      layNew();
+LayScope* layNewScope(LayScope* up);
@@ -3,185 +3,251 @@
 #include "lex.h"
 
 // ============================================================================
-// Extract all tokens in lex->text, starting at position lex->pos
-// (invariably 0).  As each token is constructed, insert it into the 'toks'
-// array
-// ============================================================================
-Toks* lexAll(Lex* lex) {
-  Toks* toks = toksNew();
-
-  char c = lexSkip(lex);
-  Tok* tok;
-
-  while (c) {                     // scan every char
-    if (isdigit(c)) {             // [0-9]
-      tok = lexNum(lex);
-    } else if (isalpha(c)) {      // [a-zA-Z]
-      tok = lexNam(lex);
-      lexKeyword(&tok);           // check if keyword (if, then, while, etc)
-    } else if (c == '"') {
-      tok = lexStr(lex);
-    } else {
-      tok = lexPun(lex);          // ( ) = < <= == >= > + - * / "
+// The fixed-spelling tokens of SubC: punctuation and keywords.  lexInit
+// builds the DFA from these two lists.
+// ============================================================================
+typedef struct {
+  char*   s;                  // spelling - eg: "<="
+  TokKind kind;               // eg: TOKLE
+} LexFix;
+
+static LexFix lexPuns[] = {
+  { "<=", TOKLE     }, { "==", TOKEEQ    }, { "!=", TOKNE     },
+  { ">=", TOKGE     }, { "+",  TOKADD    }, { "-",  TOKSUB    },
+  { "*",  TOKMUL    }, { "=",  TOKEQ     }, { "<",  TOKLT     },
+  { ">",  TOKGT     }, { "(",  TOKLPAREN }, { ")",  TOKRPAREN },
+  { "{",  TOKLBRACE }, { "}",  TOKRBRACE }, { ";",  TOKSEMI   },
+  { ",",  TOKCOMMA  },
+};
+
+static LexFix lexKeys[] = {
+  { "if",     TOKIF  }, { "int",   TOKINT   },
+  { "return", TOKRET }, { "while", TOKWHILE },
+};
+
+#define LEXNUMPUN ((int) (sizeof(lexPuns) / sizeof(lexPuns[0])))
+#define LEXNUMKEY ((int) (sizeof(lexKeys) / sizeof(lexKeys[0])))
+
+static unsigned char lexClass[256];                     // char => class
+static unsigned char lexNext[LEXMAXSTATE][LEXMAXCLASS]; // transition table
+static TokKind       lexAccept[LEXMAXSTATE];            // 0 => not accepting
+static int           lexNumClass = 0;                   // classes in use
+static int           lexNumState = 0;                   // states in use
+
+// ============================================================================
+// Add the chars of 's' as a path through the DFA, starting from LSSTART,
+// creating new states as required.  Mark the final state as accepting 'kind'.
+// If 'isNam' is non-NULL, also mark, in isNam[], each state along the path
+// that is reached by letters and digits alone - that is, each state that is
+// a prefix of a keyword, and so may yet turn out to be a name.
+// ============================================================================
+static void lexAddPath(char* s, TokKind kind, int* isNam) {
+  int state = LSSTART;
+  int alnum = 1;
+  for (; *s; ++s) {
+    int cls = lexClass[(unsigned char) *s];
+    if (lexNext[state][cls] == LSDEAD) {
+      assert(lexNumState < LEXMAXSTATE);
+      lexNext[state][cls] = (unsigned char) lexNumState++;
     }
-    toksAdd(toks, tok);
-
-    c = lexSkip(lex);
+    state = lexNext[state][cls];
+    alnum = alnum && isalnum((unsigned char) *s);
+    if (isNam && alnum) isNam[state] = 1;
   }
-  return toks;
+  lexAccept[state] = kind;
 }
 
 // ============================================================================
-// Check whether the current Tok (of kind TOKNAM) is any of the keywords in
-// the SubC language.  If yes, adjust the Token kind accordingly
+// Give the char 'c' a character class of its own, unless it already has one
 // ============================================================================
-void lexKeyword(Tok** tok) {
-  Tok* p = *tok;                  // alias
-  char* s = p->lex;
-  if (strcmp(s, "char*")    == 0) { p->kind = TOKCHARSTAR; return; }
-  if (strcmp(s, "if")       == 0) { p->kind = TOKIF;       return; }
-  if (strcmp(s, "int")      == 0) { p->kind = TOKINT;      return; }
-  if (strcmp(s, "return")   == 0) { p->kind = TOKRET;      return; }
-  if (strcmp(s, "while")    == 0) { p->kind = TOKWHILE;    return; }
-}
-
-// ============================================================================
-// Move the cursor (lex->pos) forward by 1.  Return the char it then points at.
-// ============================================================================
-char lexMove1(Lex* lex) {
-  ++lex->colNum;
-  ++lex->pos;
-  return lex->text[lex->pos];
+static void lexAddClass(char c) {
+  unsigned char* p = &lexClass[(unsigned char) c];
+  if (*p == CCBAD || *p == CCLET) {
+    assert(lexNumClass < LEXMAXCLASS);
+    *p = (unsigned char) lexNumClass++;
+  }
 }
 
 // ============================================================================
-// Extract the name (a string of alphanumeric chars), starting at
-// lex->text[lex->pos].  Eg: lex->text = " TotalSum = ", lex->pos = 1, will
-// return "TotalSum", and leave lex->pos = 9.  On entry, lex->pos is pointing
-// at the first (alphabetic char of the identifier's lexeme (eg: 'T').  On
-// exit, lex->pos is pointing at the char that is NOT part of the name
+// Extract all tokens in lex->text, starting at position lex->pos
+// (invariably 0).  As each token is constructed, append it onto the 'toks'
+// container.  Finish with the TOKEOF sentinel.
 // ============================================================================
-Tok* lexNam(Lex* lex) {
-  int start = lex->pos;                               // eg: 1
-  char c = lexMove1(lex);
-  while (isalnum(c)) c = lexMove1(lex);
-  int len = lex->pos - start;                         // eg: 8
-  char* nam = utStrndup(&lex->text[start], len);
-  return tokNew(TOKNAM, nam, 0, NULL, lex->linNum, lex->colNum);
-}
+Toks* lexAll(Lex* lex) {
+  Toks* toks = toksNew(lex->text);
 
-// ============================================================================
-// Create a new Lex object
-// ============================================================================
-Lex* lexNew(char* text) {
-  Lex* lex = malloc(sizeof(Lex));
-  lex->text = text;
-  lex->pos = 0;
-  lex->linNum = lex->colNum = 1;
-  return lex;
+  char c = lexSkip(lex);
+  while (c) {                     // scan every token
+    lexTok(lex, toks);
+    c = lexSkip(lex);
+  }
+  toksAdd(toks, TOKEOF, lex->pos, 0);
+  return toks;
 }
 
 // ============================================================================
-// Extract the number (a string of digits), starting at lex->text[lex->pos].
-// Eg: lex->text = "x = 1234; ", lex->pos = 4, will return 1234, and leave
-// lex->pos = 8.  (Note: on entry, lex->pos points to the first digit in
-// the number)
+// Generate the character-class table and the DFA transition table.  Only the
+// first call does any work.
 // ============================================================================
-Tok* lexNum(Lex* lex) {
-  int start = lex->pos;
-  int sum = lexPeek0(lex) - '0';                      // eg: 1
-  char c = lexMove1(lex);
-  while (isdigit(c)) {
-    sum = 10 * sum + (c - '0');                       // eg: 10 * 1 + 2
-    c = lexMove1(lex);
-  }
+void lexInit() {
+  if (lexNumState) return;
 
-  int len = lex->pos - start;
-  char* lexeme = utStrndup(&lex->text[start], len);
-  Tok* tok = tokNew(TOKNUM, lexeme, sum, NULL, lex->linNum, lex->colNum);
-  return tok;
-}
+  // Fixed character classes
 
-// ============================================================================
-// Return the current char in lex->text, located at position lex->pos.
-// This is a "peek" function that does not change the cursor (ie, lex->pos).
-// We name it as lexPeek0, because we are looking at offset 0 from lex->pos
-// ============================================================================
-char lexPeek0(Lex* lex) { return lex->text[lex->pos]; }
+  lexClass[0] = CCEND;
+  for (int c = 0x01; c <= 0x20; ++c) lexClass[c] = CCWS;
+  lexClass['\n'] = CCNL;
+  for (int c = '0'; c <= '9'; ++c) lexClass[c] = CCDIG;
+  for (int c = 'a'; c <= 'z'; ++c) lexClass[c] = CCLET;
+  for (int c = 'A'; c <= 'Z'; ++c) lexClass[c] = CCLET;
+  lexClass['"'] = CCQUOTE;
+  lexNumClass = CCPUN;
 
-// ============================================================================
-// Return the next char in lex->text: the one located at position
-// lex->pos + 1.  This is a "peek" function that does not change the cursor
-// (ie, lex->pos).  We name it as lexPeek1, because we are looking at offset
-// 1 from lex->pos
-// ============================================================================
-char lexPeek1(Lex* lex) { return lex->text[lex->pos + 1]; }
+  // Every char used in punctuation or a keyword gets a class of its own
 
-// ============================================================================
-// Scan punctuation
-// ============================================================================
-Tok* lexPun(Lex* lex) {
-  char c0 = lexPeek0(lex);
-  char c1 = lexPeek1(lex);
+  for (int i = 0; i < LEXNUMPUN; ++i) {
+    for (char* s = lexPuns[i].s; *s; ++s) lexAddClass(*s);
+  }
+  for (int i = 0; i < LEXNUMKEY; ++i) {
+    for (char* s = lexKeys[i].s; *s; ++s) lexAddClass(*s);
+  }
 
-  // First check for two-letter tokens
+  // Which classes may continue a name?
 
-  if (c0 == '<' && c1 == '=') { lex->pos += 2; return tokNew(TOKLE,  "<=", 0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '=' && c1 == '=') { lex->pos += 2; return tokNew(TOKEEQ, "==", 0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '!' && c1 == '=') { lex->pos += 2; return tokNew(TOKNE,  "!=", 0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '>' && c1 == '=') { lex->pos += 2; return tokNew(TOKGE,  ">=", 0, NULL, lex->linNum, lex->colNum); }
+  int isAlnum[LEXMAXCLASS] = { 0 };
+  for (int c = 0; c < 256; ++c) {
+    if (isalnum(c)) isAlnum[lexClass[c]] = 1;
+  }
 
-  // Next, check for single-letter tokens
+  // Punctuation and keywords become paths from LSSTART
 
-  if (c0 == '+')  { ++lex->pos;   return tokNew(TOKADD,    "+",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '-')  { ++lex->pos;   return tokNew(TOKSUB,    "-",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '*')  { ++lex->pos;   return tokNew(TOKMUL,    "*",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '=')  { ++lex->pos;   return tokNew(TOKEQ,     "=",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '<')  { ++lex->pos;   return tokNew(TOKLT,     "<",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '>')  { ++lex->pos;   return tokNew(TOKGT,     ">",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '(')  { ++lex->pos;   return tokNew(TOKLPAREN, "(",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == ')')  { ++lex->pos;   return tokNew(TOKRPAREN, ")",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '{')  { ++lex->pos;   return tokNew(TOKLBRACE, "{",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == '}')  { ++lex->pos;   return tokNew(TOKRBRACE, "}",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == ';')  { ++lex->pos;   return tokNew(TOKSEMI,   ";",  0, NULL, lex->linNum, lex->colNum); }
-  if (c0 == ',')  { ++lex->pos;   return tokNew(TOKCOMMA,  ",",  0, NULL, lex->linNum, lex->colNum); }
+  int isNam[LEXMAXSTATE] = { 0 };
+  lexNumState = LSFIRST;
+  for (int i = 0; i < LEXNUMPUN; ++i) {
+    lexAddPath(lexPuns[i].s, lexPuns[i].kind, NULL);
+  }
+  for (int i = 0; i < LEXNUMKEY; ++i) {
+    lexAddPath(lexKeys[i].s, lexKeys[i].kind, isNam);
+  }
 
-  utDie2StrCharLC("lexPun", "unrecognized punctuation. c = ", c0, lex->linNum, lex->colNum);
+  // Names, numbers and strings
 
-  return NULL;    // pacify the compiler
+  for (int cls = 0; cls < lexNumClass; ++cls) {
+    if (isAlnum[cls] && cls != CCDIG && lexNext[LSSTART][cls] == LSDEAD) {
+      lexNext[LSSTART][cls] = LSNAM;
+    }
+    if (isAlnum[cls]) lexNext[LSNAM][cls] = LSNAM;
+    if (cls != CCEND && cls != CCQUOTE) lexNext[LSSTR][cls] = LSSTR;
+  }
+  lexNext[LSSTART][CCDIG]   = LSNUM;
+  lexNext[LSNUM][CCDIG]     = LSNUM;
+  lexNext[LSSTART][CCQUOTE] = LSSTR;
+  lexNext[LSSTR][CCQUOTE]   = LSSTREND;
+  lexAccept[LSNAM]    = TOKNAM;
+  lexAccept[LSNUM]    = TOKNUM;
+  lexAccept[LSSTREND] = TOKSTR;
+
+  // A prefix of a keyword (eg: "whi") is a name, and continues as a name
+  // on any letter or digit that does not lead further along the keyword
+
+  for (int state = LSFIRST; state < lexNumState; ++state) {
+    if (!isNam[state]) continue;
+    if (lexAccept[state] == 0) lexAccept[state] = TOKNAM;
+    for (int cls = 0; cls < lexNumClass; ++cls) {
+      if (isAlnum[cls] && lexNext[state][cls] == LSDEAD) {
+        lexNext[state][cls] = LSNAM;
+      }
+    }
+  }
+}
 
+// ============================================================================
+// Create a new Lex object
+// ============================================================================
+Lex* lexNew(char* text, size_t size) {
+  assert(text[size] == '\0');
+  lexInit();
+  Lex* lex = malloc(sizeof(Lex));
+  lex->text = text;
+  lex->size = size;
+  lex->pos = 0;
+  lex->linNum = 1;
+  lex->linPos = 0;
+  return lex;
 }
 
 // ============================================================================
 // Skip over whitespace: any ASCII control char from 0x01 (SOH) thru 0x1F (US),
 // as well as 0x20 (space).  This includes all those chars normally described
 // as "whitespace", such as tab and carriage-return.  If the char is a newline,
-// we additionally bump Lex's line number, and reset the column number
+// we additionally bump Lex's line number, and note where the line starts
 // ============================================================================
 char lexSkip(Lex* lex) {
-  char c = lexPeek0(lex);
+  char*  text = lex->text;
+  size_t pos  = lex->pos;
+  int    cls  = lexClass[(unsigned char) text[pos]];
 
-  while (c >= 0x01 && c <= 0x20) {
-    if (c == '\n') {                // 0x0A
+  while (cls == CCWS || cls == CCNL) {
+    ++pos;
+    if (cls == CCNL) {
       ++lex->linNum;
-      lex->colNum = 1;
+      lex->linPos = pos;
     }
-    c = lexMove1(lex);
+    cls = lexClass[(unsigned char) text[pos]];
   }
-  return c;
+  lex->pos = pos;
+  return text[pos];
 }
 
 // ============================================================================
-// Scan a string.  On entry, lex->pos points at the opening ' char.
-// Eg: 'hello' will create a Token of kind TOKSTR, stripping out
-// the leading and trailing tick (')
-// ============================================================================
-Tok* lexStr(Lex* lex) {
-  char c = lexMove1(lex);                             // eg: h
-  int start = lex->pos;                               // eg: 60 => h
-  while (c != '"') c = lexMove1(lex);                 // scan to trailing "
-  int len = lex->pos - start;                         // eg: 65 - 60 = 5
-  char* str = utStrndup(&lex->text[start], len);      // eg: hello
-  c = lexMove1(lex);                                  // skip closing '
-  return tokNew(TOKSTR, str, 0, NULL, lex->linNum, lex->colNum);
-}
\ No newline at end of file
+// Scan the token that starts at lex->text[lex->pos].  Run the DFA until it
+// dies, remembering the last accepting state passed through (longest match).
+// On exit, lex->pos points at the char just beyond the token, which has been
+// appended onto 'toks' - no chars are copied.
+//
+// Eg: lex->text = "x <= 42", lex->pos = 2, will append a TOKLE, and leave
+// lex->pos = 4
+// ============================================================================
+void lexTok(Lex* lex, Toks* toks) {
+  char*   text  = lex->text;
+  size_t  start = lex->pos;
+  size_t  pos   = start;
+  size_t  end   = start;
+  TokKind kind  = 0;
+  int     state = LSSTART;
+
+  while ((state = lexNext[state][lexClass[(unsigned char) text[pos]]])) {
+    ++pos;
+    if (lexAccept[state]) {
+      kind = lexAccept[state];
+      end  = pos;
+    }
+  }
+
+  int colNum = (int) (start - lex->linPos + 1);
+  if (kind == 0) {
+    utDie2StrCharLC("lexTok", "unrecognized input. c = ", text[start],
+      lex->linNum, colNum);
+  }
+  lex->pos = end;
+  int len = (int) (end - start);
+
+  if (kind == TOKNAM) {                               // eg: TotalSum
+    toksAdd(toks, TOKNAM, start, internN(&text[start], len));
+  } else if (kind == TOKNUM) {                        // eg: 1234
+    int sum = 0;
+    for (size_t i = start; i < end; ++i) {
+      int dig = text[i] - '0';
+      if (sum > (INT_MAX - dig) / 10) {               // a SubC int is 32 bits
+        utDie2StrCharLC("lexTok", "number too large, from", text[start],
+          lex->linNum, colNum);
+      }
+      sum = 10 * sum + dig;
+    }
+    toksAdd(toks, TOKNUM, start, sum);
+  } else if (kind == TOKSTR) {                        // eg: "hello"
+    toksAdd(toks, TOKSTR, start + 1, len - 2);
+  } else {                                            // eg: <=  or  while
+    toksAdd(toks, kind, start, 0);
+  }
+}
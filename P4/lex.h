@@ -2,31 +2,66 @@
 
 #pragma once
 
-#include <ctype.h>      // isdigit
+#include <assert.h>     // assert
+#include <ctype.h>      // isalnum
 #include <limits.h>     // INT_MAX
 #include <stdio.h>      // printf
 #include <stdlib.h>     // exit
 #include <string.h>     // strncpy
 
+#include "intern.h"     // intern
 #include "tok.h"        // Tok
 #include "toks.h"       // Toks
 #include "ut.h"         // ut*
 
+// The lexer is a table-driven DFA.  Every input char is first mapped, via
+// the 256-entry lexClass table, onto a small character class.  The DFA then
+// steps from state to state through lexNext[state][class] until it reaches
+// the dead state (0).  The token is the longest prefix that ended in an
+// accepting state: lexAccept[state] gives its kind.
+//
+// lexInit generates both tables from the lists of punctuation and keywords,
+// so one pass over the chars recognizes punctuation, numbers, names,
+// keywords and strings alike.  Each char that occurs in a keyword gets a
+// class of its own, so that keywords are just more states in the DFA.
+
+#define LEXMAXCLASS 40      // max number of character classes
+#define LEXMAXSTATE 64      // max number of DFA states
+
+typedef enum {              // fixed character classes (keyword chars follow)
+  CCBAD = 0,                // not legal in a SubC program
+  CCEND,                    // NUL: end of text
+  CCWS,                     // whitespace, other than newline
+  CCNL,                     // newline
+  CCDIG,                    // [0-9]
+  CCLET,                    // [a-zA-Z] not used in any keyword
+  CCQUOTE,                  // "
+  CCPUN,                    // first class for punctuation chars
+} CC;
+
+typedef enum {              // fixed DFA states (trie states follow)
+  LSDEAD = 0,               // no transition: the token has ended
+  LSSTART,                  // start of a token
+  LSNAM,                    // inside a name that cannot be a keyword
+  LSNUM,                    // inside a number
+  LSSTR,                    // inside a string
+  LSSTREND,                 // just after the closing quote of a string
+  LSFIRST,                  // first state allocated for punctuation/keywords
+} LS;
+
+// The text need not be a C string, but the char at text[size] must be
+// readable, and must be NUL: it stops the DFA (see utMapFile)
+
 typedef struct {
-  char* text;         // entire program text to be scanned
-  int   pos;          // current char offset into 'text'
-  int   linNum;       // current line number (starts at 1)
-  int   colNum;       // current column number (starts at 1)
+  char*  text;        // entire program text to be scanned
+  size_t size;        // number of chars in 'text'
+  size_t pos;         // current char offset into 'text'
+  int    linNum;      // current line number (starts at 1)
+  size_t linPos;      // offset into 'text' of the start of the current line
 } Lex;
 
 Toks* lexAll(Lex* lex);
-void  lexKeyword(Tok** tok);
-char  lexMove1(Lex* lex);
-Tok*  lexNam(Lex* lex);
-Lex*  lexNew(char* text);
-Tok*  lexNum(Lex* lex);
-char  lexPeek0(Lex* lex);
-char  lexPeek1(Lex* lex);
-Tok*  lexPun(Lex* lex);
+void  lexInit();
+Lex*  lexNew(char* text, size_t size);
 char  lexSkip(Lex* lex);
-Tok*  lexStr(Lex* lex);
\ No newline at end of file
+void  lexTok(Lex* lex, Toks* toks);
@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# Lexer throughput benchmark
+#
+# Generates a corpus of SubC functions that uses every kind of token - each
+# keyword and punctuator, names that start like keywords ("whiles", "i2"),
+# numbers and strings - then times how long subc takes to lex it, and reports
+# the rate in MB/s.  Each size is lexed 3 times; the best time counts.
+#
+# Then does the same for the hand-written lexer that the DFA lexer replaced:
+# its lex.c, tok.c and ut.c, kept as they stood in the first commit in
+# check/lexold, built with the driver check/lexold.c, lex the same corpus.  The last column is the
+# speedup: old time / new time.
+#
+# Usage: bash lexbench.sh [funs]    (run from the P4 folder)
+#
+# 'funs' is the number of functions per corpus (default 100000: about 40 MB).
+
+. ./build.sh
+build subc-bench || exit 1
+funs=${1:-100000}
+
+for f in lex.c lex.h tok.c tok.h toks.h ut.c ut.h; do
+  if [ ! -f check/lexold/$f ]; then
+    echo "lexbench: check/lexold/$f is missing - the old lexer cannot be built"
+    rm -f subc-bench; exit 1
+  fi
+done
+old=$(mktemp -d)
+build $old/lexold check/lexold.c check/lexold || exit 1
+
+# Lex file $2 3 times with command $1; set 'best' to the least time taken,
+# and 'toks' to the number of tokens
+
+timelex() {
+  best=
+  for run in 1 2 3; do
+    line=$($1 $2 < /dev/null | grep "Time:")
+    t=$(echo "$line" | awk '{ print $3 }')
+    toks=$(echo "$line" | awk '{ print substr($5, 2) }')
+    if [ -z "$best" ] || awk -v t=$t -v b=$best 'BEGIN { exit !(t < b) }'; then best=$t; fi
+  done
+}
+
+for n in $((funs / 100)) $((funs / 10)) $funs; do
+  f=lexbench$n.subc
+  awk -v n=$n 'BEGIN {
+    for (i = 0; i < n; ++i) {
+      print "int f" i "(int a, int b, int c) {"
+      print "  int whiles; int i2; int returns;"
+      print "  whiles = a + 12345; i2 = b - 678; returns = c * 9;"
+      print "  if (whiles <= i2) { whiles = i2 - 1; }"
+      print "  if (i2 == returns) { i2 = returns + 2; }"
+      print "  if (returns != a) { returns = a * 3; }"
+      print "  if (a >= b) { a = b + 1; }"
+      print "  while (a < c) { a = a + 1; }"
+      print "  if (b > c) { i2 = says(\"int while return if\"); }"
+      print "  return whiles + i2;"
+      print "}"
+    }
+    print "int main() {"
+    print "  int x;"
+    print "  x = f0(1, 2, 3);"
+    print "  return x;"
+    print "}"
+  }' > $f
+  bytes=$(wc -c < $f)
+
+  timelex "./subc-bench -parse -time" $f
+  new=$best
+  newtoks=$toks
+  timelex $old/lexold $f
+  if [ "$toks" != "$newtoks" ]; then
+    echo "FAIL  $f: DFA lexer found $newtoks tokens, old lexer $toks"
+    rm -rf $f subc-bench $old; exit 1
+  fi
+
+  awk -v n=$n -v bytes=$bytes -v toks=$toks -v t=$new -v o=$best 'BEGIN {
+    mb = bytes / 1e6
+    rate = t > 0 ? sprintf("%7.1f MB/s", mb / t) : "      - MB/s"
+    orate = o > 0 ? sprintf("%7.1f MB/s", mb / o) : "      - MB/s"
+    ratio = t > 0 ? sprintf("%5.1fx", o / t) : "    -"
+    printf "%7d funs, %6.1f MB, %9d tokens: DFA %.3f s, %s; old %.3f s, %s; %s \n",
+      n, mb, toks, t, rate, o, orate, ratio
+  }'
+  rm -f $f
+done
+
+rm -rf subc-bench $old
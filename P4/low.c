@@ -0,0 +1,654 @@
+// low.c - Lower the SSA IR to 68000 code
+
+#include "low.h"
+
+#define LOWMAXDEPTH 5       // deeper loops weigh no more than this
+
+// ============================================================================
+// Does value 'v' need a register or frame slot?  Not if it is rematerialized
+// at each use, nor if it is deleted.
+// ============================================================================
+static int lowNeedsLoc(SsaFun* fun, int v) {
+  SSAOP op = fun->ins[v].op;
+  return op != SSANOP && op != SSACONST && op != SSASTR && op != SSAUNDEF;
+}
+
+// ============================================================================
+// Split each CFG edge from a block with two successors into a block with
+// phis.  The copies for that edge go into the new block, which just jumps on.
+// ============================================================================
+static void lowSplit(Low* low) {
+  SsaFun* fun = low->fun;
+  int numBlk = fun->numBlk;
+  for (int b = 0; b < numBlk; ++b) {
+    if (fun->blk[b].numSucc != 2) continue;
+    for (int k = 0; k < 2; ++k) {
+      int s = fun->blk[b].succ[k];
+      SsaBlock* succ = &fun->blk[s];
+      if (succ->numPred < 2 || succ->numIns == 0) continue;
+      if (fun->ins[succ->ins[0]].op != SSAPHI) continue;
+
+      int n = ssaAddBlock(fun, fun->blk[b].depth);
+      SsaBlock* mid = &fun->blk[n];
+      mid->pred    = arenaAlloc(fun->arena, sizeof(int));
+      mid->pred[0] = b;
+      mid->numPred = mid->capPred = 1;
+      mid->numSucc = 1;
+      mid->succ[0] = s;
+      mid->term    = SSAJMP;
+      fun->blk[s].pred[ssaPredIndex(fun, s, b)] = n;
+      fun->blk[b].succ[k] = n;
+    }
+  }
+}
+
+// ============================================================================
+// Widen the live interval of value 'v' to cover position 'pos'
+// ============================================================================
+static void lowExtend(Low* low, int v, int pos) {
+  if (pos < low->start[v]) low->start[v] = pos;
+  if (pos > low->end[v])   low->end[v]   = pos;
+}
+
+// ============================================================================
+// Value 'v' is live on entry to block 'b'.  Walk back over its predecessors,
+// up to the block that defines 'v', widening its interval over each.
+// ============================================================================
+static void lowLiveIn(Low* low, int v, int b, int* work) {
+  SsaFun* fun = low->fun;
+  int def = fun->ins[v].blk;
+  if (low->stamp[b] == v) return;
+  low->stamp[b] = v;
+
+  int num = 0;
+  work[num++] = b;
+  while (num) {
+    int at = work[--num];
+    SsaBlock* blk = &fun->blk[at];
+    lowExtend(low, v, low->first[at]);
+    for (int p = 0; p < blk->numPred; ++p) {
+      int pred = blk->pred[p];
+      lowExtend(low, v, low->last[pred]);
+      if (pred == def || low->stamp[pred] == v) continue;
+      low->stamp[pred] = v;
+      work[num++] = pred;
+    }
+  }
+}
+
+// ============================================================================
+// Value 'v' is used at position 'pos' of block 'b'
+// ============================================================================
+static void lowUse(Low* low, int v, int b, int pos, int* work) {
+  SsaFun* fun = low->fun;
+  ++low->uses[v];
+  if (!lowNeedsLoc(fun, v)) return;
+  int depth = fun->blk[b].depth < LOWMAXDEPTH ? fun->blk[b].depth : LOWMAXDEPTH;
+  low->weight[v] += 1 << (3 * depth);
+  lowExtend(low, v, pos);
+  if (fun->ins[v].blk != b) lowLiveIn(low, v, b, work);
+}
+
+// ============================================================================
+// Number the blocks and instructions in layout order, and find the live
+// interval of each value that needs a location.  Instruction i of a block
+// reads its operands at position first + 1 + 2i, and writes its result just
+// after, so that the result may take the register of an operand that dies
+// there.  Phis are written at the start of their block.  Their arguments are
+// read at the end of each predecessor, where the copies go.
+//
+// A phi need not be live at the end of a predecessor, even though its copy
+// writes it there: that predecessor has just the one successor (see
+// lowSplit), so any other value still live there is live into the phi's
+// block too, and so is kept out of the phi's register.
+// ============================================================================
+static void lowLive(Low* low) {
+  SsaFun* fun = low->fun;
+  int* work = malloc((fun->numBlk + 1) * sizeof(int));
+  if (!work) utDie2Str("lowLive", "Out of memory");
+
+  int pos = 0;
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    low->first[b] = pos;
+    pos += 2 * fun->blk[b].numIns + 1;
+    low->last[b] = pos++;
+  }
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    int depth = blk->depth < LOWMAXDEPTH ? blk->depth : LOWMAXDEPTH;
+
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      SsaIns* ins = &fun->ins[v];
+      int at = low->first[b] + 1 + 2 * i;
+      if (ins->op == SSAPHI) {
+        lowExtend(low, v, low->first[b]);
+        low->weight[v] += 1 << (3 * depth);
+        for (int a = 0; a < ins->numArg; ++a) {
+          int p = blk->pred[a];
+          lowUse(low, ins->arg[a], p, low->last[p], work);
+          if (!low->hint[ins->arg[a]]) low->hint[ins->arg[a]] = v;
+        }
+        if (ins->numArg) low->hint[v] = ins->arg[0];
+        continue;
+      }
+      for (int a = 0; a < ins->numArg; ++a) lowUse(low, ins->arg[a], b, at, work);
+      if (lowNeedsLoc(fun, v)) {
+        lowExtend(low, v, at + 1);
+        low->weight[v] += 1 << (3 * depth);
+        if (ins->op == SSABIN || ins->op == SSACOPY) low->hint[v] = ins->arg[0];
+      }
+    }
+
+    if (blk->term == SSABR || blk->term == SSARET) lowUse(low, blk->a, b, low->last[b], work);
+    if (blk->term == SSABR) lowUse(low, blk->b, b, low->last[b], work);
+  }
+
+  free(work);
+}
+
+// ============================================================================
+// Give value 'v' a home in the frame
+// ============================================================================
+static void lowSpill(Low* low, int v) {
+  SsaIns* ins = &low->fun->ins[v];
+  low->reg[v] = 0;
+  ++low->spills;
+  if (ins->op == SSAPAR) {
+    low->off[v] = 8 + BYTESPERINT * ins->val;     // where the caller put it
+  } else {
+    low->frame += BYTESPERINT;
+    low->off[v] = -low->frame;
+  }
+}
+
+// ============================================================================
+// Compare two sort keys, for qsort
+// ============================================================================
+static int lowCmpKey(const void* x, const void* y) {
+  int64_t a = *(const int64_t*) x;
+  int64_t b = *(const int64_t*) y;
+  return a < b ? -1 : a > b;
+}
+
+// ============================================================================
+// Linear scan register allocation over D2-D7 (Poletto & Sarkar).  Visit the
+// intervals in order of their start.  Free the registers of the intervals
+// that have ended.  Give the new interval a free register if there is one;
+// otherwise, spill whichever of it, and the intervals holding registers,
+// weighs least.  Return the mask of registers used.
+// ============================================================================
+static int lowAlloc(Low* low) {
+  SsaFun* fun = low->fun;
+  int64_t* key = malloc(fun->numIns * sizeof(int64_t));
+  if (!key) utDie2Str("lowAlloc", "Out of memory");
+
+  int num = 0;
+  for (int v = 1; v < fun->numIns; ++v) {
+    if (low->end[v] < 0 || low->uses[v] == 0) continue;
+    key[num++] = ((int64_t) low->start[v] << 32) | v;
+  }
+  qsort(key, num, sizeof(int64_t), lowCmpKey);
+
+  int active[8] = { 0 };                          // Dn => value holding it
+  int mask = 0;
+  for (int k = 0; k < num; ++k) {
+    int v = (int) (key[k] & 0xFFFFFFFF);
+
+    int avail = 0;
+    for (int r = 2; r <= 7; ++r) {
+      if (active[r] && low->end[active[r]] < low->start[v]) active[r] = 0;
+      if (!active[r] && !avail) avail = r;
+    }
+    int want = low->reg[low->hint[v]];
+    if (want && !active[want]) avail = want;
+
+    if (!avail) {
+      int victim = 0;
+      for (int r = 2; r <= 7; ++r) {
+        if (!victim || low->weight[active[r]] < low->weight[active[victim]]) victim = r;
+      }
+      if (low->weight[active[victim]] >= low->weight[v]) {
+        lowSpill(low, v);
+        continue;
+      }
+      lowSpill(low, active[victim]);
+      avail = victim;
+    }
+
+    active[avail] = v;
+    low->reg[v]   = avail;
+    mask |= 1 << avail;
+  }
+
+  free(key);
+  return mask;
+}
+
+// ============================================================================
+// The operand through which to read value 'v'.  A string gets its data label
+// on first use.
+// ============================================================================
+static IrOpnd lowOpnd(Low* low, int v) {
+  SsaIns* ins = &low->fun->ins[v];
+
+  switch (ins->op) {
+    case SSACONST: return irOpImm(ins->val);
+    case SSAUNDEF: return irOpImm(0);
+    case SSASTR:
+      if (low->off[v] == 0) {
+        low->off[v] = cgLabel();
+        emitDataString(low->cg->emit, low->off[v], low->fun->flat->str[ins->val]);
+      }
+      return irOpData(low->off[v]);
+    default:
+      return low->reg[v] ? irOpD(low->reg[v]) : irOpFrame(low->off[v]);
+  }
+}
+
+// ============================================================================
+// Emit "MOVE.L src, dst" - or, for a string, load its address
+// ============================================================================
+static void lowMove(Low* low, IrOpnd src, IrOpnd dst) {
+  IrFun* ir = low->cg->ir;
+  if (irOpEq(src, dst)) return;
+  if (src.kind == IROPDATA) {
+    irAdd(ir, IRLEA, IRSZNONE, src, irOpA(0));
+    irAdd(ir, IRMOVE, IRSZL, irOpA(0), dst);
+  } else {
+    irAdd(ir, IRMOVE, IRSZL, src, dst);
+  }
+}
+
+// ============================================================================
+// Emit an SSABIN, 'v'.  Arithmetic goes straight into the register of 'v',
+// if it has one, else into D0.  A comparison yields 0 or 1 in D0, via
+// cgBranch.
+// ============================================================================
+static void lowBin(Low* low, int v) {
+  SsaIns* ins = &low->fun->ins[v];
+  IrFun*  ir  = low->cg->ir;
+  IrOpnd  d0  = irOpD(0);
+  IrOpnd  d1  = irOpD(1);
+  IrOpnd  dst = lowOpnd(low, v);
+  BOP     bop = ins->bop;
+  int     a   = ins->arg[0];
+  int     b   = ins->arg[1];
+
+  // Put a constant on the right of + and *, where iselFun can find it
+
+  if ((bop == BOPADD || bop == BOPMUL) && low->fun->ins[a].op == SSACONST
+    && low->fun->ins[b].op != SSACONST) {
+    int t = a; a = b; b = t;
+  }
+
+  // Work in the register of 'v', unless that holds 'b' (which dies here)
+
+  IrOpnd acc = dst.kind == IROPDREG && bop < BOPLT ? dst : d0;
+  if (a != b && irOpEq(acc, lowOpnd(low, b))) acc = d0;
+  lowMove(low, lowOpnd(low, a), acc);
+  lowMove(low, lowOpnd(low, b), d1);
+  switch (bop) {
+    case BOPADD: irAdd(ir, IRADD,  IRSZL,    d1, acc); break;
+    case BOPSUB: irAdd(ir, IRSUB,  IRSZL,    d1, acc); break;
+    case BOPMUL: irAdd(ir, IRMULS, IRSZNONE, d1, acc); break;
+    default:
+      irAdd(ir, IRCMP, IRSZL, d1, acc);
+      cgBranch(low->cg, cgBranchOp(bop));
+  }
+  lowMove(low, acc, dst);
+}
+
+// ============================================================================
+// Emit an SSACALL, 'v': push its args, right to left, and BSR
+// ============================================================================
+static void lowCall(Low* low, int v) {
+  SsaIns* ins = &low->fun->ins[v];
+  IrFun*  ir  = low->cg->ir;
+
+  for (int a = ins->numArg - 1; a >= 0; --a) {
+    lowMove(low, lowOpnd(low, ins->arg[a]), irOpPush());
+  }
+  irAdd(ir, IRBSR, IRSZNONE, irOpFun(ins->val), irOpNone());
+  if (ins->numArg) irAdd(ir, IRADD, IRSZL, irOpImm(BYTESPERINT * ins->numArg), irOpA(7));
+  if (low->uses[v]) lowMove(low, irOpD(0), lowOpnd(low, v));
+}
+
+// ============================================================================
+// Emit instruction 'v'
+// ============================================================================
+static void lowIns(Low* low, int v) {
+  SsaIns* ins = &low->fun->ins[v];
+  if (low->uses[v] == 0 && ins->op != SSACALL) return;      // dead
+
+  switch (ins->op) {
+    case SSAPAR:
+      if (low->reg[v]) {
+        lowMove(low, irOpFrame(8 + BYTESPERINT * ins->val), irOpD(low->reg[v]));
+      }
+      break;
+    case SSACOPY: lowMove(low, lowOpnd(low, ins->arg[0]), lowOpnd(low, v)); break;
+    case SSABIN:  lowBin(low, v);  break;
+    case SSACALL: lowCall(low, v); break;
+    default:      break;      // CONST, STR, UNDEF: at each use.  PHI: lowPhis
+  }
+}
+
+// ============================================================================
+// Emit the 'n' copies src[k] => dst[k], in parallel: each reads its source
+// before any writes its destination.  So emit a copy only once no other
+// pending copy reads its destination; if every pending copy is so blocked,
+// they form a cycle - save one destination in D0, and read it from there
+// instead.  Leaves src[] and dst[] scrambled.
+// ============================================================================
+static void lowParallel(Low* low, IrOpnd* src, IrOpnd* dst, int n) {
+  while (n) {
+    int ready = -1;
+    for (int i = 0; i < n && ready < 0; ++i) {
+      int blocked = 0;
+      for (int k = 0; k < n; ++k) if (k != i && irOpEq(src[k], dst[i])) blocked = 1;
+      if (!blocked) ready = i;
+    }
+
+    if (ready < 0) {                            // a cycle: save dst[0] in D0
+      lowMove(low, dst[0], irOpD(0));
+      for (int k = 0; k < n; ++k) if (irOpEq(src[k], dst[0])) src[k] = irOpD(0);
+      ready = 0;
+    }
+
+    lowMove(low, src[ready], dst[ready]);
+    src[ready] = src[n - 1];
+    dst[ready] = dst[n - 1];
+    --n;
+  }
+}
+
+// ============================================================================
+// Emit the copies for the phis of block 's', along the edge from block 'b'
+// ============================================================================
+static void lowPhis(Low* low, int b, int s) {
+  SsaFun*   fun  = low->fun;
+  SsaBlock* succ = &fun->blk[s];
+  int j = ssaPredIndex(fun, s, b);
+
+  int num = 0;
+  while (num < succ->numIns && fun->ins[succ->ins[num]].op == SSAPHI) ++num;
+  if (num == 0) return;
+
+  IrOpnd* src = malloc(num * sizeof(IrOpnd));
+  IrOpnd* dst = malloc(num * sizeof(IrOpnd));
+  if (!src || !dst) utDie2Str("lowPhis", "Out of memory");
+
+  int n = 0;
+  for (int i = 0; i < num; ++i) {
+    int phi = succ->ins[i];
+    if (low->uses[phi] == 0) continue;
+    src[n] = lowOpnd(low, fun->ins[phi].arg[j]);
+    dst[n] = lowOpnd(low, phi);
+    if (!irOpEq(src[n], dst[n])) ++n;
+  }
+
+  low->moves += n;
+  lowParallel(low, src, dst, n);
+  free(src); free(dst);
+}
+
+// ============================================================================
+// Is block 'b' a tail call - does it return the result of its last call?  If
+// so, return that SSACALL; else 0.  Any pure op that follows the call is
+// dead.  As for cgTailCall, the callee must be defined in this program, with
+// as many pars as the call has args.  If it is not the current function, it
+// must need no more argument slots than the current function was given,
+// since our caller will pop just that many.  main is excluded, because it
+// must end in SIMHALT.
+// ============================================================================
+static int lowTailCall(Low* low, int b) {
+  SsaFun*   fun = low->fun;
+  SsaBlock* blk = &fun->blk[b];
+  if (fun->funid == INTMAIN || blk->term != SSARET) return 0;
+
+  int v = blk->a;
+  SsaIns* ins = &fun->ins[v];
+  if (ins->op != SSACALL || ins->blk != b) return 0;
+  for (int i = blk->numIns - 1; blk->ins[i] != v; --i) {
+    if (fun->ins[blk->ins[i]].op == SSACALL) return 0;
+  }
+
+  int numarg = ins->numArg;
+  if (cgNumPars(low->cg, ins->val) != numarg) return 0;
+  if (ins->val != fun->funid && numarg > cgNumPars(low->cg, fun->funid)) return 0;
+  return v;
+}
+
+// ============================================================================
+// Emit the tail call 'v' (see lowTailCall), which ends its block.  Its args
+// are copied, in parallel, into the slots of our own incoming args, at
+// (8+4k,A6), so that the stack does not grow.  A call to the current
+// function then jumps back to the entry block, whose pars reload from those
+// slots.  A call to another function tears down our frame, but leaves our
+// return address in place, and JMPs to the callee, which returns straight to
+// our caller - as cgTail does.
+// ============================================================================
+static void lowTail(Low* low, int v) {
+  SsaIns* ins  = &low->fun->ins[v];
+  Cg*     cg   = low->cg;
+  IrOpnd  none = irOpNone();
+
+  int num = ins->numArg;
+  IrOpnd* src = malloc((num + 1) * sizeof(IrOpnd));
+  IrOpnd* dst = malloc((num + 1) * sizeof(IrOpnd));
+  if (!src || !dst) utDie2Str("lowTail", "Out of memory");
+
+  int n = 0;
+  for (int a = 0; a < num; ++a) {
+    src[n] = lowOpnd(low, ins->arg[a]);
+    dst[n] = irOpFrame(8 + BYTESPERINT * a);
+    if (!irOpEq(src[n], dst[n])) ++n;
+  }
+  lowParallel(low, src, dst, n);
+  free(src); free(dst);
+
+  if (ins->val == low->fun->funid) {                        // self-recursion
+    irAdd(cg->ir, IRBRA, IRSZNONE, irOpLab(low->label[0]), none);
+    return;
+  }
+  if (cg->regs) irAdd(cg->ir, IRMOVEM, IRSZL, irOpPop(), irOpRegs(cg->regs));
+  irAdd(cg->ir, IRUNLK, IRSZNONE, irOpA(6), none);
+  irAdd(cg->ir, IRJMP, IRSZNONE, irOpFun(ins->val), none);
+}
+
+// ============================================================================
+// Emit the SSABR that ends block 'b'.  'next' is the block laid out next
+// (-1 => none), which needs no branch to reach it.
+// ============================================================================
+static void lowBranch(Low* low, int b, int next) {
+  SsaFun*   fun  = low->fun;
+  SsaBlock* blk  = &fun->blk[b];
+  IrFun*    ir   = low->cg->ir;
+  IrOpnd    none = irOpNone();
+
+  // A branch on two constants always goes the same way
+
+  SsaIns* a = &fun->ins[blk->a];
+  SsaIns* c = &fun->ins[blk->b];
+  int t = blk->succ[0];
+  int f = blk->succ[1];
+  if (a->op == SSACONST && c->op == SSACONST) {
+    int to = foldBop(blk->bop, a->val, c->val) ? t : f;
+    if (to != next) irAdd(ir, IRBRA, IRSZNONE, irOpLab(low->label[to]), none);
+    return;
+  }
+
+  // Compare in a data register: the one holding 'a', else D0
+
+  IrOpnd lhs = lowOpnd(low, blk->a);
+  IrOpnd rhs = lowOpnd(low, blk->b);
+  IROP cond = cgBranchOp(blk->bop);
+  if (lhs.kind != IROPDREG) {
+    lowMove(low, lhs, irOpD(0));
+    lhs = irOpD(0);
+  }
+  irAdd(ir, rhs.kind == IROPIMM ? IRCMPI : IRCMP, IRSZL, rhs, lhs);
+
+  if (t == next) {
+    irAdd(ir, irInverse(cond), IRSZNONE, irOpLab(low->label[f]), none);
+  } else {
+    irAdd(ir, cond, IRSZNONE, irOpLab(low->label[t]), none);
+    if (f != next) irAdd(ir, IRBRA, IRSZNONE, irOpLab(low->label[f]), none);
+  }
+}
+
+// ============================================================================
+// Does block 's' hold nothing but phis, and end in a branch?
+// ============================================================================
+static int lowIsTest(Low* low, int s) {
+  SsaBlock* blk = &low->fun->blk[s];
+  if (blk->term != SSABR) return 0;
+  for (int i = 0; i < blk->numIns; ++i) {
+    if (low->fun->ins[blk->ins[i]].op != SSAPHI) return 0;
+  }
+  return 1;
+}
+
+// ============================================================================
+// Emit the terminator of block 'b'.  'next' is the block laid out after it
+// (-1 => none), which needs no branch to reach it.  A jump to a test block,
+// other than 'next', becomes a copy of its branch: the phi copies have just
+// put every value that the test reads where it expects to find it.
+// ============================================================================
+static void lowTerm(Low* low, int b, int next) {
+  SsaFun*   fun = low->fun;
+  SsaBlock* blk = &fun->blk[b];
+
+  if (blk->term == SSARET) {
+    lowMove(low, lowOpnd(low, blk->a), irOpD(0));
+    cgEpilog(low->cg, fun->funid);
+  } else if (blk->term == SSABR) {
+    lowBranch(low, b, next);
+  } else if (blk->succ[0] == next) {
+    return;
+  } else if (lowIsTest(low, blk->succ[0])) {
+    lowBranch(low, blk->succ[0], next);
+  } else {
+    irAdd(low->cg->ir, IRBRA, IRSZNONE, irOpLab(low->label[blk->succ[0]]), irOpNone());
+  }
+}
+
+// ============================================================================
+// Lower the function at node 'fn' of the Flat
+// ============================================================================
+static void lowFun(Low* low, int fn) {
+  Cg* cg = low->cg;
+  layBuild(cg->lay, cg->flat, fn);                  // par/var lookups
+
+  SsaFun* fun = ssaBuild(cg->lay, cg->flat, fn);
+  passRun(low->pm, fun);                            // optimize
+  ///ssaDump(fun);                                  // DEBUG: dump SSA to console
+  low->fun = fun;
+  lowSplit(low);
+  ssaDomTree(fun);                                  // layout order
+
+  int nv = fun->numIns;
+  int nb = fun->numBlk;
+  low->uses   = calloc(nv, sizeof(int));
+  low->reg    = calloc(nv, sizeof(int));
+  low->off    = calloc(nv, sizeof(int));
+  low->start  = malloc(nv * sizeof(int));
+  low->end    = malloc(nv * sizeof(int));
+  low->weight = calloc(nv, sizeof(int));
+  low->hint   = calloc(nv, sizeof(int));
+  low->stamp  = calloc(nb, sizeof(int));
+  low->first  = calloc(nb, sizeof(int));
+  low->last   = calloc(nb, sizeof(int));
+  low->label  = calloc(nb, sizeof(int));
+  if (!low->uses || !low->reg || !low->off || !low->start || !low->end
+    || !low->weight || !low->hint || !low->stamp || !low->first || !low->last || !low->label) {
+    utDie2Str("lowFun", "Out of memory");
+  }
+  for (int v = 0; v < nv; ++v) { low->start[v] = INT_MAX; low->end[v] = -1; }
+  low->frame = 0;
+
+  lowLive(low);
+  cg->regs = lowAlloc(low);
+
+  // Prolog, as cgProlog: frame for spilled values; save registers used
+
+  irBegin(cg->ir, fun->funid);
+  irAdd(cg->ir, IRLINK, IRSZNONE, irOpA(6), irOpImm(-low->frame));
+  if (cg->regs) irAdd(cg->ir, IRMOVEM, IRSZL, irOpRegs(cg->regs), irOpPush());
+
+  for (int k = 0; k < fun->numRpo; ++k) low->label[fun->rpo[k]] = cgLabel();
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    int tail = lowTailCall(low, b);
+    irAddBlock(cg->ir, low->label[b]);
+    for (int i = 0; i < blk->numIns; ++i) {
+      if (blk->ins[i] == tail) break;
+      lowIns(low, blk->ins[i]);
+    }
+    if (tail) {
+      lowTail(low, tail);
+      continue;
+    }
+    if (blk->term == SSAJMP) lowPhis(low, b, blk->succ[0]);
+    lowTerm(low, b, k + 1 < fun->numRpo ? fun->rpo[k + 1] : -1);
+  }
+
+  peepFun(cg->peep, cg->ir);                        // optimize
+  iselFun(cg->isel, cg->peep, cg->ir);              // pick cheaper instructions
+  if (cg->cost) costFun(cg->cost, cg->ir);          // annotate with cycles
+  irPrint(cg->ir, cg->emit);                        // then emit, as text
+
+  free(low->uses); free(low->reg); free(low->off); free(low->start);
+  free(low->end); free(low->weight); free(low->hint); free(low->stamp); free(low->first);
+  free(low->last); free(low->label);
+  ssaFree(fun);
+  low->fun = NULL;
+  ++low->funs;
+}
+
+// ============================================================================
+// Build a new Low, that lowers through the backend of 'cg', after running
+// the passes of 'pm'
+// ============================================================================
+Low* lowNew(Cg* cg, PassMgr* pm) {
+  Low* low = calloc(1, sizeof(Low));
+  if (!low) utDie2Str("lowNew", "Out of memory");
+  low->cg = cg;
+  low->pm = pm;
+  return low;
+}
+
+// ============================================================================
+// Prog => Fun+.  As cgProg, but through the SSA IR.
+// ============================================================================
+void lowProg(Low* low, Flat* flat) {
+  Cg* cg = low->cg;
+  cg->flat = flat;
+  FlatNode* node = flat->node;                              // alias
+
+  char line[LINESIZE];
+  sprintf(line, "\t %s \t %s", "INCLUDE", "Tests\\io.X68");
+  emitCode(cg->emit, line);
+
+  layBuildIntrinsics(cg->lay);
+
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    lowFun(low, fun);
+  }
+
+  sprintf(line, "\t %s \t %s", "END", "main");
+  emitCode(cg->emit, line);
+}
+
+// ============================================================================
+// Print totals over the compile
+// ============================================================================
+void lowReport(Low* low) {
+  printf("\nLow: %d functions, %d values spilled, %d phi copies \n",
+    low->funs, low->spills, low->moves);
+}
@@ -0,0 +1,70 @@
+// low.h - Lower the SSA IR to 68000 code
+
+#pragma once
+
+#include <limits.h>         // INT_MAX
+#include <stdint.h>         // int64_t
+#include <stdio.h>          // printf, sprintf
+#include <stdlib.h>         // calloc, malloc, qsort, free
+
+#include "cg.h"             // Cg, cgBranch, cgEpilog, cgLabel, cgNumPars
+#include "fold.h"           // foldBop
+#include "ir.h"             // IrFun, IrOpnd
+#include "pass.h"           // PassMgr
+#include "ssa.h"            // SsaFun
+#include "ut.h"             // ut*
+
+// lowProg is the -ssa route from the Flat to 68000 code.  It takes the place
+// of cgProg, and shares its backend: the same IrFun, peephole optimizer,
+// instruction selection and Emit buffer.  For each function it:
+//
+//    1. builds the SSA form (ssaBuild), and runs the passes (passRun)
+//    2. splits each CFG edge from a branch into a block with phis, so that
+//       there is a place to put the copies for that edge alone
+//    3. finds the live range of each value, as an interval over the blocks
+//       in layout order (reverse postorder), and allocates D2-D7 to them by
+//       linear scan.  A value that gets no register lives in a frame slot -
+//       or, for a par, in its incoming slot at (8+4k,A6).  When registers
+//       run out, the value used least (weighting each use by 8 per enclosing
+//       While) is the one spilled.  A phi, its arguments, and the result of
+//       an op and its first operand, each ask for the same register, so that
+//       the copy between them vanishes.  Constants and strings need no
+//       location: they are rematerialized as immediates at each use.
+//    4. emits code, block by block.  Each phi becomes a set of parallel
+//       copies at the end of each predecessor, ordered so that no source is
+//       overwritten before it is read, with D0 breaking any cycle.  D0, D1
+//       and A0 are scratch, just as for cgProg.  A jump to a block that
+//       holds nothing but phis and a branch - the test at the top of a While
+//       - takes a copy of that branch, so that each trip around a loop costs
+//       one branch, not two.  A block that returns the result of its last
+//       call is a tail call, as for cgTail: the args are copied, in
+//       parallel, into our own incoming arg slots; a call to the function
+//       itself then jumps back to its entry block, and any other call
+//       tears down our frame and JMPs to the callee.
+//
+// lowReport prints totals over the compile.
+
+typedef struct {
+  Cg*      cg;              // backend: Lay, Emit, IrFun, Peep, Isel
+  PassMgr* pm;              // passes run on each function
+  SsaFun*  fun;             // function being lowered
+  int*     uses;            // per value: uses, phis included
+  int*     reg;             // per value: Dn holding it (0 => none)
+  int*     off;             // per value: frame offset, if no reg; for a STR, its label
+  int*     start;           // per value: first position at which it is live
+  int*     end;             // per value: last position (-1 => needs no location)
+  int*     weight;          // per value: uses and def, weighted by loop depth
+  int*     hint;            // per value: value whose register it would share
+  int*     stamp;           // per block: last value whose live range reached it
+  int*     first;           // per block: position of its start
+  int*     last;            // per block: position of its end
+  int*     label;           // per block: label number
+  int      frame;           // bytes of spill slots below FP
+  int      funs;            // functions lowered, whole compile
+  int      spills;          // values spilled to the frame, whole compile
+  int      moves;           // phi copies emitted, whole compile
+} Low;
+
+Low* lowNew(Cg* cg, PassMgr* pm);
+void lowProg(Low* low, Flat* flat);
+void lowReport(Low* low);
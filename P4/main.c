@@ -34,34 +34,372 @@
 
 #include "main.h"
 
-void usage() { printf("\n\nUsage: subc <file.subc> \n\n"); }
+void usage() {
+  printf("\n\nUsage: subc [-parse] [-time] [-ssa [-passes a,b,c]] [-cost [-trip n]] [-sim | -diff] <file.subc> \n");
+  printf("       subc -target x64 [-run | -diff] <file.subc> \n");
+  printf("       subc -interp <file.subc> \n");
+  printf("       subc -vm <file.subc | file.SBC> \n");
+  printf("       subc -sim <file.X68> \n\n");
+}
+
+// ============================================================================
+// Assemble the .X68 file at 'path', and run it on the 68000 simulator.
+// Report the cycles taken, by function.
+// ============================================================================
+void simulate(char* path) {
+  Asm* as = asmFile(path);
+  Sim* sim = simNew(as);
+  printf("\n");
+  simRun(sim);
+  simReport(sim);
+  simFree(sim);
+  asmFree(as);
+}
+
+// ============================================================================
+// Copy 's' into 'buf', of 'size' bytes, quoted for the shell: within '...',
+// where nothing is special, but ' itself - written as '\''.  So a path may
+// hold spaces, $, ; and the like.  Die if 's' does not fit.
+// ============================================================================
+void quote(char* buf, size_t size, char* s) {
+  size_t n = 0;
+  buf[n++] = '\'';
+  for (; *s; ++s) {
+    if (n + 5 >= size) utDie3Str("quote", "Path too long:", s);
+    if (*s == '\'') { strcpy(buf + n, "'\\''"); n += 4; }
+    else buf[n++] = *s;
+  }
+  buf[n++] = '\'';
+  buf[n] = '\0';
+}
+
+// ============================================================================
+// Assemble and link the x86-64 assembler file at 'path' (eg: "test01.s")
+// into a program of the same name, less its extension (eg: "test01"), and
+// run it natively.  If 'out' is NULL, it writes to our stdout, and its time
+// is reported; otherwise its output is copied to 'out'.  Return its exit
+// status: the low 8 bits of the result of main.
+// ============================================================================
+int native(char* path, FILE* out) {
+#ifdef _WIN32
+  utDie2Str("native", "x86-64 programs run only on Linux");
+  return 0;
+#else
+  char exe[X64MAXNAME];
+  char qpath[4 * X64MAXNAME];           // quoted: each char may become 4
+  char qexe[4 * X64MAXNAME];
+  char cmd[16 * X64MAXNAME];
+
+  char* dot = strrchr(path, '.');
+  if (!dot || dot - path >= X64MAXNAME) utDie3Str("native", "Bad path:", path);
+  memcpy(exe, path, dot - path);
+  exe[dot - path] = '\0';
+
+  quote(qpath, sizeof qpath, path);
+  quote(qexe, sizeof qexe, exe);
+  int n = snprintf(cmd, sizeof cmd, "as --64 -o %s.o %s && ld -o %s %s.o",
+    qexe, qpath, qexe, qexe);
+  if (n < 0 || n >= (int) sizeof cmd) utDie3Str("native", "Path too long:", path);
+  if (system(cmd) != 0) utDie2Str("native: Cannot assemble and link:", path);
+
+  n = snprintf(cmd, sizeof cmd, "exec ./%s", qexe); // no shell left to hide a crash
+  if (n < 0 || n >= (int) sizeof cmd) utDie3Str("native", "Path too long:", path);
+  fflush(stdout);
+  double t0 = utTime();
+  int status;
+  if (out) {
+    FILE* pipe = popen(cmd, "r");
+    if (!pipe) utDie2Str("native: Cannot run:", exe);
+    int c;
+    while ((c = getc(pipe)) != EOF) putc(c, out);
+    status = pclose(pipe);
+  } else {
+    status = system(cmd);
+  }
+  double t1 = utTime();
+
+  if (status == -1 || !WIFEXITED(status)) utDie2Str("native: Program failed:", exe);
+  if (!out) printf("\nNative: %s ran in %.3f s, main = %d \n", exe, t1 - t0, WEXITSTATUS(status));
+  return WEXITSTATUS(status);
+#endif
+}
+
+// ============================================================================
+// Compare the output, in 'want' and 'got', that the interpreter and 'name'
+// each wrote, and the results they each returned.  Return the bytes of
+// output that agree, or -1 (having said why) if they differ.
+// ============================================================================
+long agree(FILE* want, int expect, FILE* got, int actual, char* name) {
+  rewind(want);
+  rewind(got);
+  long at = 0;                            // bytes that agree
+  int w, g;
+  while ((w = getc(want)) == (g = getc(got)) && w != EOF) ++at;
+
+  if (w != g) {
+    printf("Diff: output differs at byte %ld: interp %d, %s %d \n", at, w, name, g);
+    return -1;
+  }
+  if (expect != actual) {
+    printf("Diff: main returns %d on interp, %d on %s \n", expect, actual, name);
+    return -1;
+  }
+  return at;
+}
+
+// ============================================================================
+// Run 'prog' on the interpreter, the compiled program, at 'path', on the
+// simulator - or natively, for 'target' TARGETX64 - and the bytecode lowered
+// from 'flat' on the VM, each writing to a temporary file.  Compare their
+// output and results.  Return 0 if they agree, 1 if not.
+//
+// A native program reports only the low 8 bits of main's result, as its
+// exit status, so only those are compared.
+// ============================================================================
+int differ(AstProg* prog, Flat* flat, char* path, TARGET target) {
+  FILE* want = tmpfile();
+  FILE* got  = tmpfile();
+  FILE* ran  = tmpfile();
+  if (!want || !got || !ran) utDie2Str("differ", "Cannot create temporary files");
+
+  Interp* in = interpNew(prog, want);
+  int expect = interpRun(in);
+  interpFree(in);
+
+  char* name = "sim";
+  int actual, mask = -1;                  // bits of main's result to compare
+  if (target == TARGETX64) {
+    name = "x64";
+    actual = native(path, got);
+    mask = 0xFF;
+  } else {
+    Asm* as = asmFile(path);
+    Sim* sim = simNew(as);
+    sim->out = got;
+    actual = (int) (int32_t) simRun(sim);
+    simFree(sim);
+    asmFree(as);
+  }
+
+  Vm* vm = vmLower(flat);
+  vm->out = ran;
+  int result = vmRun(vm);
+  vmFree(vm);
+
+  printf("\n");
+  long at = agree(want, expect & mask, got, actual, name);
+  if (at >= 0) at = agree(want, expect, ran, result, "vm");
+  fclose(want);
+  fclose(got);
+  fclose(ran);
+  if (at < 0) return 1;
+
+  printf("Diff: interp, %s and vm agree: %ld bytes of output, main = %d \n", name, at, expect);
+  return 0;
+}
+
+// ============================================================================
+// End the run.  After a -diff check ('diff' non-zero), exit with its verdict:
+// 1 if 'rc', the result of differ, says the runs differed, else 0 - so that
+// a script can tell.  (An error on the way - in the compiler, or in any of
+// the runs - exits with 2: see utSetDieStatus.)  Otherwise wait for a key, as
+// every other run does.
+// ============================================================================
+void finish(int diff, int rc) {
+  if (diff) exit(rc ? 1 : 0);
+  utPause();
+}
+
+// ============================================================================
+// Run the bytecode 'vm' on the VM.  Report the calls to each function.
+// ============================================================================
+void vmExec(Vm* vm) {
+  printf("\n");
+  vmRun(vm);
+  vmReport(vm);
+  vmFree(vm);
+}
 
 int main(int argc, char* argv[]) {
-  if (argc < 2) { usage(); exit(-1); }
+  int   optParse = 0;                     // -parse: stop after parsing
+  int   optTime  = 0;                     // -time : report time per phase
+  int   optSsa   = 0;                     // -ssa  : codegen through the SSA IR
+  char* optPasses = NULL;                 // -passes: SSA passes to run, in order
+  int   optSim   = 0;                     // -sim  : run the output on the simulator
+  int   optInterp = 0;                    // -interp: run the AST; generate no code
+  int   optDiff  = 0;                     // -diff : check the simulator and VM against -interp
+  int   optVm    = 0;                     // -vm   : lower to bytecode, save a .SBC, and run it
+  int   optRun   = 0;                     // -run  : build the x86-64 output, and run it natively
+  TARGET target  = TARGET68000;           // -target: 68000 or x64
+  int   optCost  = 0;                     // -cost : estimate cycles, write a .LST listing
+  int   optTrip  = 0;                     // -trip : times each loop runs, for -cost
+  char* srcPath  = NULL;                  // eg: "Tests\test01.subc"
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-parse") == 0) {
+      optParse = 1;
+    } else if (strcmp(argv[i], "-time") == 0) {
+      optTime = 1;
+    } else if (strcmp(argv[i], "-ssa") == 0) {
+      optSsa = 1;
+    } else if (strcmp(argv[i], "-sim") == 0) {
+      optSim = 1;
+    } else if (strcmp(argv[i], "-interp") == 0) {
+      optInterp = 1;
+    } else if (strcmp(argv[i], "-run") == 0) {
+      optRun = 1;
+    } else if (strcmp(argv[i], "-target") == 0 && i + 1 < argc) {
+      ++i;
+      if (strcmp(argv[i], "x64") == 0) target = TARGETX64;
+      else if (strcmp(argv[i], "68000") == 0) target = TARGET68000;
+      else { usage(); exit(-1); }
+    } else if (strcmp(argv[i], "-vm") == 0) {
+      optVm = 1;
+    } else if (strcmp(argv[i], "-diff") == 0) {
+      optDiff = 1;
+    } else if (strcmp(argv[i], "-cost") == 0) {
+      optCost = 1;
+    } else if (strcmp(argv[i], "-passes") == 0 && i + 1 < argc) {
+      optPasses = argv[++i];
+    } else if (strcmp(argv[i], "-trip") == 0 && i + 1 < argc) {
+      optTrip = atoi(argv[++i]);
+      if (optTrip <= 0) { usage(); exit(-1); }
+    } else if (argv[i][0] == '-' || srcPath) {
+      usage(); exit(-1);
+    } else {
+      srcPath = argv[i];
+    }
+  }
+  if (srcPath == NULL) { usage(); exit(-1); }
+  if (target == TARGETX64 && (optSsa || optSim || optCost)) { usage(); exit(-1); }  // 68000 only
+  if (target == TARGET68000 && optRun) { usage(); exit(-1); }                      // x64 only
+  if (optDiff) utSetDieStatus(2);                   // so a script sees any error
+
+  char* ext = strrchr(srcPath, '.');
+  if (optSim && ext && strcmp(ext, ".X68") == 0) {  // run assembler code as it is
+    internInit();
+    simulate(srcPath);
+    utPause();
+    return 0;
+  }
+  if (optVm && ext && strcmp(ext, ".SBC") == 0) {   // run saved bytecode as it is
+    vmExec(vmLoad(srcPath));
+    utPause();
+    return 0;
+  }
 
-  char* prog = utReadFile(argv[1]);       // raw chars
+  double t0 = utTime();
+  internInit();                           // pre-intern the keywords
+  Comp* comp = compNew(srcPath);          // raw chars, mapped read-only
 
-  Lex* lex = lexNew(prog);
-  Toks* toks = lexAll(lex);
-  ///toksDump(toks);                      // DEBUG: dump Tokens to TokenDump.txt
-  toksRewind(toks);
-  AstProg* astProg = pseProg(toks);       // parse tokens, build AST
-  visitProg(astProg);                  // DEBUG: dump AST to console
+  Lex* lex = lexNew(comp->text, comp->size);
+  comp->toks = lexAll(lex);
+  free(lex);
+  ///toksDump(comp->toks);                // DEBUG: dump Tokens to TokenDump.txt
+  double t1 = utTime();
+  toksRewind(comp->toks);
+  comp->prog = pseProg(comp->toks);       // parse tokens, build AST
+  double t2 = utTime();
+
+  if (optTime) {
+    printf("Time: lex %.3f s (%d tokens), parse %.3f s \n",
+      t1 - t0, comp->toks->hiTokNum, t2 - t1);
+  }
+  if (optParse) {                         // syntax check only
+    compFree(comp);
+    return 0;
+  }
+
+  if (optInterp) {                        // run the AST as it is
+    Interp* in = interpNew(comp->prog, stdout);
+    printf("\n");
+    interpRun(in);
+    interpReport(in);
+    interpFree(in);
+    compFree(comp);
+    utPause();
+    return 0;
+  }
+
+  visitProg(comp->prog);                  // DEBUG: dump AST to console
+  comp->flat = flatProg(comp->prog);      // flatten AST for codegen
+  Inl* inl = inlNew();
+  comp->flat = inlProg(inl, comp->flat);  // inline small functions
+  inlReport(inl);
+  Fold* fold = foldNew();
+  comp->flat = foldProg(fold, comp->flat);  // fold and propagate constants
+  foldReport(fold);
+  ///flatDump(comp->flat);                // DEBUG: dump flat AST to console
+
+  if (optVm) {                            // bytecode, rather than 68000 code
+    Vm* vm = vmLower(comp->flat);
+    char* sbcPath = emitNewName(srcPath); // eg: "test01.X68" => "test01.SBC"
+    strcpy(strrchr(sbcPath, '.') + 1, "SBC");
+    vmSave(vm, sbcPath);
+    free(sbcPath);
+    vmExec(vm);
+    compFree(comp);
+    utPause();
+    return 0;
+  }
+
+  if (target == TARGETX64) {              // x86-64, rather than 68000
+    X64* x64 = x64New();
+    char* runtime = x64FindRuntime(srcPath); // eg: "../Tests/io.s"
+    x64Prog(x64, comp->flat, runtime);
+    free(runtime);
+    char* path = x64NewName(srcPath);     // eg: "test01.s"
+    emitSave(x64->emit, path);
+    x64Free(x64);
+
+    int rc = 0;
+    if (optDiff) rc = differ(comp->prog, comp->flat, path, target);
+    compFree(comp);
+    if (optRun) native(path, NULL);       // build it, and run it
+    free(path);
+    finish(optDiff, rc);
+    return rc;
+  }
 
   Cg* cg = cgNew();
-  cgProg(cg, astProg);                    // codegen the program
+  if (optCost) cg->cost = costNew(optTrip);
+  if (optSsa) {                           // codegen via the SSA IR
+    PassMgr* pm = passNew();
+    optRegister(pm);
+    if (optPasses) passSchedule(pm, optPasses);
+    Low* low = lowNew(cg, pm);
+    lowProg(low, comp->flat);
+    passReport(pm);                       // runs, changes and time per pass
+    lowReport(low);
+  } else {
+    cgProg(cg, comp->flat);               // codegen the program
+  }
+  peepReport(cg->peep);                   // how often each peephole rule fired
+  iselReport(cg->isel);                   // how often each isel rule fired
   //cgProg(cgNew(), astProg);                    // codegen the program
 
   // Decide what to call the output assembler file.  So, if input source
   // file is "c:\Users\jimhh\OneDrive\UW\CSS-448-Hogg-Wi21\Tests\test01.subc"
   // then name the output file "test01.X68"
 
-  char* path = emitNewName(argv[1]);
+  char* path = emitNewName(srcPath);
 
   // Save the generated assembler data and code to the output file
 
   emitSave(cg->emit, path);
+  if (cg->cost) {                         // annotated listing, and summary
+    costSave(cg->cost, path);
+    costReport(cg->cost);
+    costFree(cg->cost);
+    cg->cost = NULL;
+  }
 
-  utPause();
-  return 0;
+  int rc = 0;
+  if (optDiff) rc = differ(comp->prog, comp->flat, path, target);  // interp vs simulator and VM
+  compFree(comp);                         // release tokens and AST
+
+  if (optSim) simulate(path);             // run it; cycles per function
+
+  finish(optDiff, rc);
+  return rc;
 }
@@ -2,16 +2,44 @@
 
 #pragma once
 
-#include <stdio.h>      // printf, FILE
-#include <stdlib.h>     // exit
+#include <stdio.h>      // printf, FILE, getc, tmpfile, popen
+#include <stdlib.h>     // exit, system
+#include <string.h>     // strcmp, strcpy, strrchr
 
+#ifndef _WIN32
+#include <sys/wait.h>   // WIFEXITED, WEXITSTATUS
+#endif
+
+#include "asm.h"        // assemble 68000 text
 #include "ast.h"        // AstProg
 #include "cg.h"         // CodeGen
+#include "comp.h"       // Comp
 #include "emit.h"       // code emission
+#include "fold.h"       // constant folding
+#include "inl.h"        // inliner
+#include "intern.h"     // internInit
+#include "interp.h"     // AST interpreter
 #include "lex.h"        // Lex
+#include "low.h"        // lower SSA IR to 68000
+#include "opt.h"        // SSA optimization passes
+#include "pass.h"       // pass manager
 #include "pse.h"        // parProg
+#include "sim.h"        // 68000 simulator
 #include "ut.h"         // ut* utility functions
 #include "visit.h"      // visit* functions
+#include "vm.h"         // bytecode VM
+#include "x64.h"        // x86-64 code generator
+
+// The machine that code is generated for: the 68000 (cg.c or low.c, run on
+// the simulator), or x86-64 Linux (x64.c, run natively)
+
+typedef enum { TARGET68000 = 0, TARGETX64 } TARGET;
 
+long agree(FILE* want, int expect, FILE* got, int actual, char* name);
+int differ(AstProg* prog, Flat* flat, char* path, TARGET target);
+void finish(int diff, int rc);
 int main(int argc, char* argv[]);
-void usage();
\ No newline at end of file
+int native(char* path, FILE* out);
+void simulate(char* path);
+void usage();
+void vmExec(Vm* vm);
\ No newline at end of file
@@ -0,0 +1,311 @@
+// opt.c - Optimization passes over the SSA IR
+
+#include "opt.h"
+
+// ============================================================================
+// Turn instruction 'v' into a copy of value 'src'
+// ============================================================================
+static void optMakeCopy(SsaFun* fun, int v, int src) {
+  SsaIns* ins = &fun->ins[v];
+  if (ins->numArg < 1) ins->arg = arenaAlloc(fun->arena, sizeof(int));
+  ins->op     = SSACOPY;
+  ins->bop    = 0;
+  ins->val    = 0;
+  ins->numArg = 1;
+  ins->arg[0] = src;
+}
+
+// ============================================================================
+// Turn instruction 'v' into the constant 'val'
+// ============================================================================
+static void optMakeConst(SsaFun* fun, int v, int val) {
+  SsaIns* ins = &fun->ins[v];
+  ins->op     = SSACONST;
+  ins->bop    = 0;
+  ins->val    = val;
+  ins->numArg = 0;
+}
+
+// ============================================================================
+// Is value 'v' the constant 'n'?
+// ============================================================================
+static int optIsConst(SsaFun* fun, int v, int n) {
+  return fun->ins[v].op == SSACONST && fun->ins[v].val == n;
+}
+
+// ============================================================================
+// Fold each SSABIN whose operands are constants, and simplify the identities
+// listed in opt.h.  Return the number of instructions changed.
+// ============================================================================
+int optConst(SsaFun* fun) {
+  int changes = 0;
+  for (int k = 0; k < fun->numRpo; ++k) {
+    SsaBlock* blk = &fun->blk[fun->rpo[k]];
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      SsaIns* ins = &fun->ins[v];
+      if (ins->op != SSABIN) continue;
+
+      BOP bop = ins->bop;
+      int a = ins->arg[0];
+      int b = ins->arg[1];
+      SsaIns* x = &fun->ins[a];
+      SsaIns* y = &fun->ins[b];
+
+      if (x->op == SSACONST && y->op == SSACONST) {
+        optMakeConst(fun, v, foldBop(bop, x->val, y->val));
+      } else if (bop == BOPADD && optIsConst(fun, b, 0)) {
+        optMakeCopy(fun, v, a);
+      } else if (bop == BOPADD && optIsConst(fun, a, 0)) {
+        optMakeCopy(fun, v, b);
+      } else if (bop == BOPSUB && optIsConst(fun, b, 0)) {
+        optMakeCopy(fun, v, a);
+      } else if (bop == BOPSUB && a == b) {
+        optMakeConst(fun, v, 0);
+      } else if (bop == BOPMUL && (optIsConst(fun, a, 0) || optIsConst(fun, b, 0))) {
+        optMakeConst(fun, v, 0);
+      } else if (bop >= BOPLT && a == b) {
+        optMakeConst(fun, v, bop == BOPLE || bop == BOPEEQ || bop == BOPGE);
+      } else {
+        continue;
+      }
+      ++changes;
+    }
+  }
+  return changes;
+}
+
+// ============================================================================
+// Follow 'to' from value 'v' to the value that replaces it
+// ============================================================================
+static int optChase(int* to, int v) {
+  while (to[v]) v = to[v];
+  return v;
+}
+
+// ============================================================================
+// Remove copies, and phis that merge just one value.  Return the number of
+// instructions removed.
+// ============================================================================
+int optCopy(SsaFun* fun) {
+  int* to = calloc(fun->numIns, sizeof(int));     // value => replacement
+  if (!to) utDie2Str("optCopy", "Out of memory");
+  int changes = 0;
+
+  for (int found = 1; found; ) {
+    found = 0;
+
+    // Copies first, so that no phi is replaced by a copy of itself
+
+    for (int k = 0; k < fun->numRpo; ++k) {
+      SsaBlock* blk = &fun->blk[fun->rpo[k]];
+      for (int i = 0; i < blk->numIns; ++i) {
+        int v = blk->ins[i];
+        if (fun->ins[v].op == SSACOPY && !to[v]) {
+          to[v] = optChase(to, fun->ins[v].arg[0]);
+          ++found;
+        }
+      }
+    }
+
+    for (int k = 0; k < fun->numRpo; ++k) {
+      SsaBlock* blk = &fun->blk[fun->rpo[k]];
+      for (int i = 0; i < blk->numIns; ++i) {
+        int v = blk->ins[i];
+        SsaIns* ins = &fun->ins[v];
+        if (ins->op != SSAPHI || to[v]) continue;
+        int w = 0, trivial = 1;
+        for (int a = 0; a < ins->numArg && trivial; ++a) {
+          int x = optChase(to, ins->arg[a]);
+          if (x == v) continue;
+          if (w == 0) w = x; else if (x != w) trivial = 0;
+        }
+        if (trivial && w) { to[v] = w; ++found; }
+      }
+    }
+
+    // Rewrite every use, then delete what was replaced
+
+    for (int k = 0; k < fun->numRpo; ++k) {
+      SsaBlock* blk = &fun->blk[fun->rpo[k]];
+      for (int i = 0; i < blk->numIns; ++i) {
+        SsaIns* ins = &fun->ins[blk->ins[i]];
+        for (int a = 0; a < ins->numArg; ++a) ins->arg[a] = optChase(to, ins->arg[a]);
+      }
+      blk->a = optChase(to, blk->a);
+      blk->b = optChase(to, blk->b);
+    }
+    for (int k = 0; k < fun->numRpo; ++k) {
+      SsaBlock* blk = &fun->blk[fun->rpo[k]];
+      for (int i = 0; i < blk->numIns; ++i) {
+        int v = blk->ins[i];
+        if (to[v] && fun->ins[v].op != SSANOP) {
+          fun->ins[v].op = SSANOP;
+          ++changes;
+        }
+      }
+    }
+  }
+
+  free(to);
+  return changes;
+}
+
+// ============================================================================
+// Delete instructions whose values are never used.  Return the number
+// deleted.
+// ============================================================================
+int optDce(SsaFun* fun) {
+  uint8_t* live = calloc(fun->numIns, sizeof(uint8_t));
+  int*     work = malloc(fun->numIns * sizeof(int));
+  if (!live || !work) utDie2Str("optDce", "Out of memory");
+  int num = 0;
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    SsaBlock* blk = &fun->blk[fun->rpo[k]];
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      if (fun->ins[v].op == SSACALL && !live[v]) { live[v] = 1; work[num++] = v; }
+    }
+    int roots[2] = { blk->term == SSAJMP ? 0 : blk->a,
+                     blk->term == SSABR  ? blk->b : 0 };
+    for (int r = 0; r < 2; ++r) {
+      int v = roots[r];
+      if (v && !live[v]) { live[v] = 1; work[num++] = v; }
+    }
+  }
+
+  while (num) {
+    SsaIns* ins = &fun->ins[work[--num]];
+    for (int a = 0; a < ins->numArg; ++a) {
+      int v = ins->arg[a];
+      if (!live[v]) { live[v] = 1; work[num++] = v; }
+    }
+  }
+
+  int changes = 0;
+  for (int k = 0; k < fun->numRpo; ++k) {
+    SsaBlock* blk = &fun->blk[fun->rpo[k]];
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      if (!live[v] && fun->ins[v].op != SSANOP) {
+        fun->ins[v].op = SSANOP;
+        ++changes;
+      }
+    }
+  }
+
+  free(live); free(work);
+  return changes;
+}
+
+// ============================================================================
+// The operands of instruction 'v', for value numbering: a commutative op has
+// the smaller value number first
+// ============================================================================
+static void optGvnArgs(SsaFun* fun, int v, int* a, int* b) {
+  SsaIns* ins = &fun->ins[v];
+  *a = ins->numArg > 0 ? ins->arg[0] : 0;
+  *b = ins->numArg > 1 ? ins->arg[1] : 0;
+  if (ins->op == SSABIN && ssaIsCommutative(ins->bop) && *a > *b) {
+    int t = *a; *a = *b; *b = t;
+  }
+}
+
+// ============================================================================
+// Hash instruction 'v' on its op and operands
+// ============================================================================
+static uint32_t optGvnHash(SsaFun* fun, int v) {
+  SsaIns* ins = &fun->ins[v];
+  int a, b;
+  optGvnArgs(fun, v, &a, &b);
+  uint32_t h = ins->op;
+  h = h * 31 + ins->bop;
+  h = h * 31 + (uint32_t) ins->val;
+  h = h * 31 + (uint32_t) a;
+  h = h * 31 + (uint32_t) b;
+  return h * 2654435769u;
+}
+
+// ============================================================================
+// Do instructions 'v' and 'w' compute the same value?
+// ============================================================================
+static int optGvnSame(SsaFun* fun, int v, int w) {
+  SsaIns* x = &fun->ins[v];
+  SsaIns* y = &fun->ins[w];
+  if (x->op != y->op || x->bop != y->bop || x->val != y->val) return 0;
+  int xa, xb, ya, yb;
+  optGvnArgs(fun, v, &xa, &xb);
+  optGvnArgs(fun, w, &ya, &yb);
+  return xa == ya && xb == yb;
+}
+
+// ============================================================================
+// Global value numbering, over the dominator tree.  The hash table holds the
+// CONST, STR and BIN instructions of the blocks that dominate the current
+// one: each chain is a stack, so leaving a block pops what it pushed.
+// Return the number of instructions turned into copies.
+// ============================================================================
+int optGvn(SsaFun* fun) {
+  int nb = fun->numBlk;
+  uint32_t cap = 16;
+  while (cap < 2 * (uint32_t) fun->numIns) cap *= 2;
+
+  int*      head  = calloc(cap, sizeof(int));             // bucket => top value
+  int*      below = calloc(fun->numIns, sizeof(int));     // value => next in chain
+  uint32_t* log   = malloc(fun->numIns * sizeof(uint32_t)); // buckets pushed
+  int*      mark  = malloc(nb * sizeof(int));
+  int*      stack = malloc(2 * nb * sizeof(int));
+  if (!head || !below || !log || !mark || !stack) utDie2Str("optGvn", "Out of memory");
+
+  int changes = 0, num = 0, sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    int b = stack[--sp];
+    if (b < 0) {                                // leave block -b-1: pop
+      for (; num > mark[-b - 1]; --num) head[log[num - 1]] = below[head[log[num - 1]]];
+      continue;
+    }
+
+    mark[b] = num;
+    SsaBlock* blk = &fun->blk[b];
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      SsaIns* ins = &fun->ins[v];
+      if (ins->op != SSACONST && ins->op != SSASTR && ins->op != SSABIN) continue;
+
+      for (int a = 0; a < ins->numArg; ++a) {       // see through earlier matches
+        if (fun->ins[ins->arg[a]].op == SSACOPY) ins->arg[a] = fun->ins[ins->arg[a]].arg[0];
+      }
+
+      uint32_t h = optGvnHash(fun, v) & (cap - 1);
+      int w = head[h];
+      while (w && !optGvnSame(fun, v, w)) w = below[w];
+      if (w) {
+        optMakeCopy(fun, v, w);
+        ++changes;
+        continue;
+      }
+      below[v] = head[h];
+      head[h]  = v;
+      log[num++] = h;
+    }
+
+    stack[sp++] = -b - 1;
+    for (int c = blk->domKid; c >= 0; c = fun->blk[c].domSib) stack[sp++] = c;
+  }
+
+  free(head); free(below); free(log); free(mark); free(stack);
+  return changes;
+}
+
+// ============================================================================
+// Register every pass with 'pm', and schedule them as OPTSCHEDULE
+// ============================================================================
+void optRegister(PassMgr* pm) {
+  passRegister(pm, "copy",  optCopy);
+  passRegister(pm, "const", optConst);
+  passRegister(pm, "gvn",   optGvn);
+  passRegister(pm, "dce",   optDce);
+  passSchedule(pm, OPTSCHEDULE);
+}
@@ -0,0 +1,40 @@
+// opt.h - Optimization passes over the SSA IR
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint8_t, uint32_t
+#include <stdlib.h>         // calloc, free
+
+#include "fold.h"           // foldBop
+#include "pass.h"           // PassMgr
+#include "ssa.h"            // SsaFun
+#include "ut.h"             // ut*
+
+// Each pass rewrites an SsaFun in place, and returns the number of changes
+// it made.  None changes the CFG.
+//
+//    copy  : replace each use of a copy by its source, and each phi whose
+//            arguments are all the same value (or the phi itself) by that
+//            value
+//    const : evaluate an arithmetic or relational op on constants, just as
+//            the 68000 would (see foldBop), and simplify x + 0, x - 0, x - x,
+//            x * 0 and relationals of x with itself.  x * 1 stays: MULS
+//            keeps only the low 16 bits of x.
+//    gvn   : global value numbering.  Walk the dominator tree; an op that
+//            repeats one that dominates it, on the same operands, becomes a
+//            copy of it.  Operands of a commutative op are put in order
+//            first, so that a + b matches b + a.
+//    dce   : delete each op whose value is never used.  Calls, and the
+//            operands of branches and returns, are always used.
+//
+// OPTSCHEDULE is the order that optRegister sets up; the -passes option of
+// main replaces it.
+
+#define OPTSCHEDULE "copy,const,copy,gvn,copy,dce"
+
+int  optConst(SsaFun* fun);
+int  optCopy(SsaFun* fun);
+int  optDce(SsaFun* fun);
+int  optGvn(SsaFun* fun);
+void optRegister(PassMgr* pm);
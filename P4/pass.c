@@ -0,0 +1,110 @@
+// pass.c - Pass manager for the SSA IR
+
+#include "pass.h"
+
+// ============================================================================
+// Append pass number 'p' onto the schedule
+// ============================================================================
+static void passAppend(PassMgr* pm, int p) {
+  if (pm->numSched == pm->capSched) {
+    pm->capSched = pm->capSched ? 2 * pm->capSched : PASSMINCAP;
+    pm->sched = realloc(pm->sched, pm->capSched * sizeof(int));
+    if (!pm->sched) utDie2Str("passAppend", "Out of memory for schedule");
+  }
+  pm->sched[pm->numSched++] = p;
+}
+
+// ============================================================================
+// Build a new PassMgr, with no passes registered
+// ============================================================================
+PassMgr* passNew() {
+  PassMgr* pm = calloc(1, sizeof(PassMgr));
+  if (!pm) utDie2Str("passNew", "Out of memory");
+  return pm;
+}
+
+// ============================================================================
+// Register the pass 'fn' under 'name'.  Unless passSchedule says otherwise,
+// it runs after every pass registered before it.
+// ============================================================================
+void passRegister(PassMgr* pm, char* name, PassFn fn) {
+  if (strlen(name) >= PASSMAXNAME) utDie3Str("passRegister", "Name too long:", name);
+  for (int p = 0; p < pm->numPass; ++p) {
+    if (strcmp(pm->pass[p].name, name) == 0) {
+      utDie3Str("passRegister", "Pass registered twice:", name);
+    }
+  }
+
+  if (pm->numPass == pm->capPass) {
+    pm->capPass = pm->capPass ? 2 * pm->capPass : PASSMINCAP;
+    pm->pass = realloc(pm->pass, pm->capPass * sizeof(PassEntry));
+    if (!pm->pass) utDie2Str("passRegister", "Out of memory for passes");
+  }
+  PassEntry* e = &pm->pass[pm->numPass];
+  memset(e, 0, sizeof(PassEntry));
+  strcpy(e->name, name);
+  e->fn = fn;
+  if (!pm->custom) passAppend(pm, pm->numPass);
+  ++pm->numPass;
+}
+
+// ============================================================================
+// Print, for each pass, how often it ran, the changes it made, and the time
+// it took, over the whole compile
+// ============================================================================
+void passReport(PassMgr* pm) {
+  printf("\nPass:");
+  for (int p = 0; p < pm->numPass; ++p) {
+    PassEntry* e = &pm->pass[p];
+    printf(" %s %d runs, %d changes, %.3f s%s", e->name, e->runs, e->changes,
+      e->secs, p < pm->numPass - 1 ? ";" : "");
+  }
+  printf(" \n");
+}
+
+// ============================================================================
+// Run the schedule over 'fun'.  Return the total number of changes made.
+// ============================================================================
+int passRun(PassMgr* pm, SsaFun* fun) {
+  int total = 0;
+  for (int k = 0; k < pm->numSched; ++k) {
+    PassEntry* e = &pm->pass[pm->sched[k]];
+    double t0 = utTime();
+    int changes = e->fn(fun);
+    ssaCompact(fun);
+    e->secs += utTime() - t0;
+    ++e->runs;
+    e->changes += changes;
+    total += changes;
+    ssaVerify(fun, e->name);
+  }
+  return total;
+}
+
+// ============================================================================
+// Replace the schedule by the comma-separated list of pass 'names' - eg:
+// "copy,const,gvn,dce".  An empty list, or just ",", runs no passes.  Abort
+// on a name that is not registered.
+// ============================================================================
+void passSchedule(PassMgr* pm, char* names) {
+  pm->numSched = 0;
+  pm->custom   = 1;
+
+  char* s = names;
+  while (*s) {
+    int len = 0;
+    while (s[len] && s[len] != ',') ++len;
+    if (len == 0) { ++s; continue; }                // eg: "," => no passes
+
+    int found = -1;
+    for (int p = 0; p < pm->numPass; ++p) {
+      if ((int) strlen(pm->pass[p].name) == len
+        && strncmp(pm->pass[p].name, s, len) == 0) found = p;
+    }
+    if (found < 0) utDie3Str("passSchedule", "Unknown pass in", names);
+    passAppend(pm, found);
+
+    s += len;
+    if (*s == ',') ++s;
+  }
+}
@@ -0,0 +1,50 @@
+// pass.h - Pass manager for the SSA IR
+
+#pragma once
+
+#include <stdio.h>          // printf
+#include <stdlib.h>         // calloc, realloc, free
+#include <string.h>         // strcmp, strlen
+
+#include "ssa.h"            // SsaFun
+#include "ut.h"             // ut*
+
+// A pass is a function that rewrites one SsaFun in place, and returns how
+// many changes it made.  Passes are registered by name (see optRegister),
+// and then scheduled: passSchedule takes a list of names, such as
+// "copy,const,gvn,dce", which may name a pass more than once.  Until then,
+// the schedule is every pass, once each, in the order registered.
+//
+// passRun runs the schedule over one function.  It times each pass, and
+// checks the SSA form after each one (see ssaVerify), so that a broken pass
+// is caught by name.  passReport prints, for each pass, how often it ran,
+// how many changes it made, and how long it took, over the whole compile.
+
+#define PASSMAXNAME 32      // longest pass name
+#define PASSMINCAP  8       // initial number of slots in each array
+
+typedef int (*PassFn)(SsaFun* fun);
+
+typedef struct {
+  char   name[PASSMAXNAME];
+  PassFn fn;
+  int    runs;              // times run, whole compile
+  int    changes;           // changes made, whole compile
+  double secs;              // time taken, whole compile
+} PassEntry;
+
+typedef struct {
+  int        numPass;       // registered passes
+  int        capPass;
+  PassEntry* pass;
+  int        numSched;      // schedule: indexes into pass[]
+  int        capSched;
+  int*       sched;
+  int        custom;        // 1 => passSchedule has set the schedule
+} PassMgr;
+
+PassMgr* passNew();
+void     passRegister(PassMgr* pm, char* name, PassFn fn);
+void     passReport(PassMgr* pm);
+int      passRun(PassMgr* pm, SsaFun* fun);
+void     passSchedule(PassMgr* pm, char* names);
@@ -0,0 +1,564 @@
+// peep.c - Peephole Optimizer
+
+#include "peep.h"
+
+static char* peepRuleNames[PEEPNUMRULE] = {
+  "store-load", "dead-move", "copy", "operand", "bool-branch",
+  "branch-next", "unreachable", "label-merge", "unused-label", "pea",
+  "push-pop",
+};
+
+// ============================================================================
+// Small predicates on operands and instructions
+// ============================================================================
+static int peepIsScratch(IrOpnd o) {            // D0, D1 or A0
+  return (o.kind == IROPDREG && (o.val == 0 || o.val == 1))
+      || (o.kind == IROPAREG && o.val == 0);
+}
+
+static int peepIsSaved(IrOpnd o) {              // D2 thru D7, callee-saved
+  return o.kind == IROPDREG && o.val >= RAFIRSTREG && o.val <= RALASTREG;
+}
+
+static int peepIsReg(IrOpnd o) {                // Dn or An
+  return o.kind == IROPDREG || o.kind == IROPAREG;
+}
+
+static int peepHasSideEffect(IrOpnd o) {        // -(A7) or (A7)+
+  return o.kind == IROPPUSH || o.kind == IROPPOP;
+}
+
+static int peepIsMove(IrIns* p) {               // writes, but never reads, dst
+  return p->op == IRMOVE || p->op == IRMOVEQ || p->op == IRLEA
+      || p->op == IRCLR;
+}
+
+static int peepIsMoveL(IrIns* p) { return p->op == IRMOVE && p->sz == IRSZL; }
+
+// ============================================================================
+// Does operand 'o' name register 'reg' - either as itself, or within a
+// MOVEM register list?
+// ============================================================================
+static int peepMentions(IrOpnd o, IrOpnd reg) {
+  if (irOpEq(o, reg)) return 1;
+  if (o.kind == IROPREGS && reg.kind == IROPDREG) return (o.val >> reg.val) & 1;
+  return 0;
+}
+
+// ============================================================================
+// Does instruction 'p' read register 'reg'?
+// ============================================================================
+static int peepReads(IrIns* p, IrOpnd reg) {
+  if (peepMentions(p->src, reg)) return 1;
+  if (!peepMentions(p->dst, reg)) return 0;
+  return !(peepIsMove(p) && irOpEq(p->dst, reg));   // eg: ADD.L reads dst too
+}
+
+// ============================================================================
+// Does instruction 'p' overwrite register 'reg' without reading it?  The
+// MOVEM that restores callee-saved registers overwrites each in its list.
+// ============================================================================
+static int peepWrites(IrIns* p, IrOpnd reg) {
+  if (p->op == IRMOVEM && p->src.kind == IROPPOP) return peepMentions(p->dst, reg);
+  return peepIsMove(p) && irOpEq(p->dst, reg);
+}
+
+// ============================================================================
+// Slot, in peep->labAt[] and peep->labRefs[], for label number 'label'.
+// Return -1 if it is not a label of the current function.
+// ============================================================================
+static int peepLabSlot(Peep* peep, int label) {
+  if (label < peep->labLo || label >= peep->labLo + peep->labNum) return -1;
+  return label - peep->labLo;
+}
+
+// ============================================================================
+// Index of the block headed by 'label' (-1 => not found)
+// ============================================================================
+static int peepFind(Peep* peep, int label) {
+  int slot = peepLabSlot(peep, label);
+  return slot < 0 ? -1 : peep->labAt[slot];
+}
+
+// ============================================================================
+// Build peep->labAt[] and peep->labRefs[] for 'fun'
+// ============================================================================
+static void peepIndex(Peep* peep, IrFun* fun) {
+  int lo = -1, hi = -1;
+  for (int b = 0; b < fun->num; ++b) {
+    int label = fun->blk[b].label;
+    if (label == IRNOLABEL) continue;
+    if (lo < 0 || label < lo) lo = label;
+    if (label > hi) hi = label;
+  }
+
+  free(peep->labAt);
+  free(peep->labRefs);
+  peep->labLo   = lo;
+  peep->labNum  = lo < 0 ? 0 : hi - lo + 1;
+  peep->labAt   = calloc(peep->labNum + 1, sizeof(int));
+  peep->labRefs = calloc(peep->labNum + 1, sizeof(int));
+  if (!peep->labAt || !peep->labRefs) utDie2Str("peepIndex", "Out of memory");
+
+  for (int s = 0; s < peep->labNum; ++s) peep->labAt[s] = -1;
+  for (int b = 0; b < fun->num; ++b) {
+    IrBlock* blk = &fun->blk[b];
+    int slot = peepLabSlot(peep, blk->label);
+    if (slot >= 0) peep->labAt[slot] = b;
+    for (int i = 0; i < blk->num; ++i) {
+      IrIns* p = &blk->ins[i];
+      if (!irIsBranch(p->op)) continue;
+      slot = peepLabSlot(peep, p->src.val);
+      if (slot >= 0) ++peep->labRefs[slot];
+    }
+  }
+}
+
+// ============================================================================
+// Delete instruction 'p', keeping the label counts up to date
+// ============================================================================
+static void peepKill(Peep* peep, IrIns* p) {
+  assert(p->op != IRNOP);
+  if (irIsBranch(p->op)) {
+    int slot = peepLabSlot(peep, p->src.val);
+    if (slot >= 0) --peep->labRefs[slot];
+  }
+  p->op = IRNOP;
+}
+
+// ============================================================================
+// Make branch 'p' into "op label"
+// ============================================================================
+static void peepRetarget(Peep* peep, IrIns* p, IROP op, int label) {
+  int slot = peepLabSlot(peep, p->src.val);
+  if (slot >= 0) --peep->labRefs[slot];
+  p->op  = (uint8_t) op;
+  p->src = irOpLab(label);
+  slot = peepLabSlot(peep, label);
+  if (slot >= 0) ++peep->labRefs[slot];
+}
+
+// ============================================================================
+// Remove the label that heads block 'b'
+// ============================================================================
+static void peepUnlabel(Peep* peep, IrFun* fun, int b) {
+  int slot = peepLabSlot(peep, fun->blk[b].label);
+  if (slot >= 0 && peep->labAt[slot] == b) peep->labAt[slot] = -1;
+  fun->blk[b].label = IRNOLABEL;
+}
+
+// ============================================================================
+// Index of the first instruction after 'i' in 'blk' that has not been
+// deleted (blk->num => none)
+// ============================================================================
+static int peepNext(IrBlock* blk, int i) {
+  for (++i; i < blk->num && blk->ins[i].op == IRNOP; ++i) ;
+  return i;
+}
+
+// ============================================================================
+// The last instruction in 'blk' that has not been deleted (NULL => none)
+// ============================================================================
+static IrIns* peepLast(IrBlock* blk) {
+  for (int i = blk->num - 1; i >= 0; --i) {
+    if (blk->ins[i].op != IRNOP) return &blk->ins[i];
+  }
+  return NULL;
+}
+
+// ============================================================================
+// Might the scratch or callee-saved register 'reg' be read, along some path,
+// starting at instruction 'i' of block 'b'?  See peep.h.  '*budget' bounds the number of
+// instructions visited.
+// ============================================================================
+static int peepLive(Peep* peep, IrFun* fun, int b, int i, IrOpnd reg,
+  int* budget) {
+  while (b < fun->num) {
+    IrBlock* blk = &fun->blk[b];
+    int next = b + 1;                           // fall through, by default
+
+    for (; i < blk->num; ++i) {
+      IrIns* p = &blk->ins[i];
+      if (p->op == IRNOP) continue;
+      if (--*budget < 0) return 1;
+
+      if (p->op == IRBSR && peepIsSaved(reg)) continue; // callee preserves it
+      if (p->op == IRBSR || p->op == IRJMP) return 0;   // args are on the stack
+      if (p->op == IRRTS || p->op == IRSIMHALT) {
+        return irOpEq(reg, irOpD(0));           // the return value
+      }
+      if (peepReads(p, reg))  return 1;
+      if (peepWrites(p, reg)) return 0;
+
+      if (irIsBranch(p->op)) {
+        int target = peepFind(peep, p->src.val);
+        if (target < 0) return 1;
+        if (p->op == IRBRA) {
+          next = target;
+        } else if (peepLive(peep, fun, target, 0, reg, budget)) {
+          return 1;
+        }
+      }
+    }
+    b = next;
+    i = 0;
+  }
+  return 1;
+}
+
+static int peepLiveAfter(Peep* peep, IrFun* fun, int b, int i, IrOpnd reg) {
+  int budget = PEEPBUDGET;
+  return peepLive(peep, fun, b, i + 1, reg, &budget);
+}
+
+// ============================================================================
+// Might scratch register 'reg' be read after instruction 'i' of block 'b'?
+// For passes that run after peepFun, which leaves its label index current.
+// ============================================================================
+int peepIsLive(Peep* peep, IrFun* fun, int b, int i, IrOpnd reg) {
+  return peepLiveAfter(peep, fun, b, i, reg);
+}
+
+// ============================================================================
+// Append the instructions of 'from' onto 'to', leaving 'from' empty
+// ============================================================================
+static void peepJoin(IrBlock* to, IrBlock* from) {
+  if (to->num + from->num > to->cap) {
+    while (to->num + from->num > to->cap) to->cap = to->cap ? 2 * to->cap : IRMINCAP;
+    to->ins = realloc(to->ins, to->cap * sizeof(IrIns));
+    if (!to->ins) utDie2Str("peepJoin", "Out of memory for instructions");
+  }
+  memcpy(&to->ins[to->num], from->ins, from->num * sizeof(IrIns));
+  to->num  += from->num;
+  from->num = 0;
+}
+
+// ============================================================================
+// Drop deleted instructions, and empty unlabeled blocks.  Join each
+// unlabeled block onto a predecessor that falls through into it.  Blocks are
+// swapped, rather than overwritten, so that no ins[] array is lost.
+// ============================================================================
+static void peepTidy(IrFun* fun) {
+  int out = 0;
+  for (int b = 0; b < fun->num; ++b) {
+    IrBlock* blk = &fun->blk[b];
+
+    int n = 0;
+    for (int i = 0; i < blk->num; ++i) {
+      if (blk->ins[i].op != IRNOP) blk->ins[n++] = blk->ins[i];
+    }
+    blk->num = n;
+
+    if (blk->label == IRNOLABEL && out > 0) {
+      IrBlock* prev = &fun->blk[out - 1];
+      if (blk->num == 0) continue;
+      if (prev->num == 0 || !irEndsBlock(prev->ins[prev->num - 1].op)) {
+        peepJoin(prev, blk);
+        continue;
+      }
+    }
+
+    if (b != out) {
+      IrBlock tmp   = fun->blk[out];
+      fun->blk[out] = *blk;
+      *blk          = tmp;
+    }
+    ++out;
+  }
+  fun->num = out;
+}
+
+// ============================================================================
+// PEEPBOOL.  cgBranch materializes a comparison as 0 or 1 in D0.  Code that
+// then tests D0 against 0 can branch on the comparison directly.  (cgCond
+// already does this for the conditions of If and While.)
+//
+//         Bcc     Lt                    =>        B!cc    Lx
+//         CLR.L   D0
+//         BRA     Le
+//   Lt:   MOVE.L  #1, D0
+//   Le:   CMPI.L  #0, D0
+//         BEQ     Lx
+//
+// Valid if nothing else branches to Lt or Le, and the boolean in D0 is not
+// used after the BEQ.  Block 'b' ends with the Bcc; the pattern fills the
+// three blocks that follow it.
+// ============================================================================
+static int peepBool(Peep* peep, IrFun* fun, int b) {
+  if (b + 4 >= fun->num) return 0;
+  IrIns* bcc = peepLast(&fun->blk[b]);
+  IROP   inv = irInverse(bcc->op);
+  if (inv == IRNOP) return 0;
+
+  IrBlock* b1 = &fun->blk[b + 1];               // CLR.L D0 ; BRA Le
+  IrBlock* b2 = &fun->blk[b + 2];               // Lt: MOVE.L #1, D0
+  IrBlock* b3 = &fun->blk[b + 3];               // Le: CMPI.L #0, D0 ; BEQ Lx
+  if (b1->label != IRNOLABEL || b1->num != 2) return 0;
+  if (b2->label != bcc->src.val || b2->num != 1) return 0;
+  if (b3->num != 2) return 0;
+
+  IrOpnd d0  = irOpD(0);
+  IrIns* clr = &b1->ins[0]; IrIns* bra = &b1->ins[1];
+  IrIns* one = &b2->ins[0];
+  IrIns* cmp = &b3->ins[0]; IrIns* beq = &b3->ins[1];
+
+  if (clr->op != IRCLR || !irOpEq(clr->dst, d0)) return 0;
+  if (bra->op != IRBRA || b3->label != bra->src.val) return 0;
+  if (!peepIsMoveL(one) || !irOpEq(one->src, irOpImm(1))
+    || !irOpEq(one->dst, d0)) return 0;
+  if (cmp->op != IRCMPI || !irOpEq(cmp->src, irOpImm(0))
+    || !irOpEq(cmp->dst, d0)) return 0;
+  if (beq->op != IRBEQ) return 0;
+
+  int slotLt = peepLabSlot(peep, b2->label);
+  int slotLe = peepLabSlot(peep, b3->label);
+  if (slotLt < 0 || slotLe < 0) return 0;
+  if (peep->labRefs[slotLt] != 1 || peep->labRefs[slotLe] != 1) return 0;
+
+  int target = peepFind(peep, beq->src.val);
+  if (target < 0) return 0;
+  int budget = PEEPBUDGET;
+  if (peepLive(peep, fun, b + 4, 0, d0, &budget)) return 0;
+  if (peepLive(peep, fun, target, 0, d0, &budget)) return 0;
+
+  int lx = beq->src.val;
+  peepKill(peep, clr); peepKill(peep, bra);
+  peepKill(peep, one);
+  peepKill(peep, cmp); peepKill(peep, beq);
+  peepUnlabel(peep, fun, b + 2);
+  peepUnlabel(peep, fun, b + 3);
+  peepRetarget(peep, bcc, inv, lx);
+  return 1;
+}
+
+// ============================================================================
+// PEEPLABEL.  Block 'b' is labeled, but empty, so its label marks the same
+// point as the start of block b + 1.  Move the label onto b + 1 or, if b + 1
+// has a label of its own, redirect every branch onto that one.
+// ============================================================================
+static void peepMergeLabel(Peep* peep, IrFun* fun, int b) {
+  IrBlock* next = &fun->blk[b + 1];
+  int      from = fun->blk[b].label;
+
+  peepUnlabel(peep, fun, b);
+  if (next->label == IRNOLABEL || next->label == from) {   // eg: "L30: L30:"
+    next->label = from;
+    int slot = peepLabSlot(peep, from);
+    if (slot >= 0) peep->labAt[slot] = b + 1;
+    return;
+  }
+
+  for (int k = 0; k < fun->num; ++k) {
+    IrBlock* blk = &fun->blk[k];
+    for (int i = 0; i < blk->num; ++i) {
+      IrIns* p = &blk->ins[i];
+      if (irIsBranch(p->op) && p->src.val == from) {
+        peepRetarget(peep, p, p->op, next->label);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// Try the rules that look at whole blocks, on block 'b'.  Return the rule
+// that fired, or PEEPNUMRULE if none did.
+// ============================================================================
+static PEEPRULE peepBlockRules(Peep* peep, IrFun* fun, int b) {
+  IrBlock* blk  = &fun->blk[b];
+  IrIns*   last = peepLast(blk);
+
+  if (blk->label != IRNOLABEL) {
+    int slot = peepLabSlot(peep, blk->label);
+    if (slot >= 0 && peep->labRefs[slot] == 0) {
+      peepUnlabel(peep, fun, b);
+      return PEEPUNUSEDLABEL;
+    }
+    if (last == NULL && b + 1 < fun->num) {
+      peepMergeLabel(peep, fun, b);
+      return PEEPLABEL;
+    }
+  }
+
+  if (last == NULL) return PEEPNUMRULE;
+
+  // A block that follows BRA, RTS or SIMHALT, and has no label, cannot be
+  // reached
+
+  IrIns* prev = b > 0 ? peepLast(&fun->blk[b - 1]) : NULL;
+  if (blk->label == IRNOLABEL && prev && irIsJump(prev->op)) {
+    for (int i = 0; i < blk->num; ++i) {
+      if (blk->ins[i].op != IRNOP) peepKill(peep, &blk->ins[i]);
+    }
+    return PEEPUNREACH;
+  }
+
+  // A branch to the block that immediately follows
+
+  if (irIsBranch(last->op) && b + 1 < fun->num
+    && fun->blk[b + 1].label == last->src.val) {
+    peepKill(peep, last);
+    return PEEPBRANCHNEXT;
+  }
+
+  if (irIsCond(last->op) && peepBool(peep, fun, b)) return PEEPBOOL;
+
+  return PEEPNUMRULE;
+}
+
+// ============================================================================
+// Try the rules that look at a short window of instructions, on instruction
+// 'i' of block 'b'.  Return the rule that fired, or PEEPNUMRULE if none did.
+// ============================================================================
+static PEEPRULE peepInsRules(Peep* peep, IrFun* fun, int b, int i) {
+  IrBlock* blk = &fun->blk[b];
+  IrIns*   p   = &blk->ins[i];
+  int      j   = peepNext(blk, i);
+  IrIns*   q   = j < blk->num ? &blk->ins[j] : NULL;
+
+  // MOVE.L R, R
+
+  if (peepIsMoveL(p) && irOpEq(p->src, p->dst) && !peepHasSideEffect(p->src)) {
+    peepKill(peep, p);
+    return PEEPDEADMOVE;
+  }
+
+  // A write to a scratch or callee-saved register that is never read - eg:
+  // "MOVEQ #100, D4" straight before "MOVEQ #5, D4".  Keep it if a Bcc
+  // follows, which might test the condition codes it set.
+
+  if (peepIsMove(p) && (peepIsScratch(p->dst) || peepIsSaved(p->dst)) && !peepHasSideEffect(p->src)
+    && !(q && irIsCond(q->op)) && !peepLiveAfter(peep, fun, b, i, p->dst)) {
+    peepKill(peep, p);
+    return PEEPDEADMOVE;
+  }
+
+  if (q == NULL) return PEEPNUMRULE;
+
+  // LEA X, A0 ; MOVE.L A0, -(A7)  =>  PEA X
+
+  IrOpnd a0 = irOpA(0);
+  if (p->op == IRLEA && irOpEq(p->dst, a0) && peepIsMoveL(q)
+    && irOpEq(q->src, a0) && q->dst.kind == IROPPUSH
+    && !peepLiveAfter(peep, fun, b, j, a0)) {
+    q->op  = IRPEA;
+    q->sz  = IRSZNONE;
+    q->src = p->src;
+    q->dst = irOpNone();
+    peepKill(peep, p);
+    return PEEPPEA;
+  }
+
+  if (!peepIsMoveL(p)) return PEEPNUMRULE;
+
+  // MOVE.L X, -(A7) ; MOVE.L (A7)+, Y  =>  MOVE.L X, Y
+
+  if (p->dst.kind == IROPPUSH && !peepHasSideEffect(p->src) && peepIsMoveL(q)
+    && q->src.kind == IROPPOP && !peepHasSideEffect(q->dst)) {
+    q->src = p->src;
+    peepKill(peep, p);
+    return PEEPPUSHPOP;
+  }
+
+  // MOVE.L R, X ; MOVE.L X, Y  =>  MOVE.L R, X ; MOVE.L R, Y   (or drop the
+  // second if Y == R)
+
+  if (peepIsReg(p->src) && !peepHasSideEffect(p->dst) && peepIsMoveL(q)
+    && irOpEq(q->src, p->dst)) {
+    if (irOpEq(q->dst, p->src)) {
+      peepKill(peep, q);
+    } else {
+      q->src = p->src;
+    }
+    return PEEPSTORELOAD;
+  }
+
+  // MOVE.L X, S ; MOVE.L S, Y  =>  MOVE.L X, Y   (S a dead scratch register)
+
+  if (peepIsScratch(p->dst) && peepIsMoveL(q) && irOpEq(q->src, p->dst)
+    && !peepMentions(q->dst, p->dst)
+    && !peepLiveAfter(peep, fun, b, j, p->dst)) {
+    q->src = p->src;
+    peepKill(peep, p);
+    return PEEPCOPY;
+  }
+
+  // MOVE.L X, D1 ; ADD.L D1, D0  =>  ADD.L X, D0   (also SUB, CMP, MULS).
+  // MULS reads just a word, so only a register or immediate X will do.
+
+  int isArith = q->op == IRADD || q->op == IRSUB || q->op == IRCMP
+             || q->op == IRMULS;
+  if (isArith && peepIsScratch(p->dst) && irOpEq(q->src, p->dst)
+    && !irOpEq(q->dst, p->dst) && !peepHasSideEffect(p->src)
+    && !peepLiveAfter(peep, fun, b, j, p->dst)
+    && (q->op != IRMULS || peepIsReg(p->src) || p->src.kind == IROPIMM)) {
+    q->src = p->src;
+    peepKill(peep, p);
+    return PEEPOPERAND;
+  }
+
+  // MOVE.L Dn, S ; CMP.L X, S  =>  CMP.L X, Dn   (S a dead scratch register)
+
+  if (q->op == IRCMP && peepIsScratch(p->dst) && p->src.kind == IROPDREG
+    && irOpEq(q->dst, p->dst) && !peepMentions(q->src, p->dst)
+    && !peepLiveAfter(peep, fun, b, j, p->dst)) {
+    q->dst = p->src;
+    peepKill(peep, p);
+    return PEEPOPERAND;
+  }
+
+  return PEEPNUMRULE;
+}
+
+// ============================================================================
+// Optimize 'fun', in place
+// ============================================================================
+void peepFun(Peep* peep, IrFun* fun) {
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    peepTidy(fun);
+    peepIndex(peep, fun);
+
+    for (int b = 0; b < fun->num; ++b) {
+      PEEPRULE rule = peepBlockRules(peep, fun, b);
+      if (rule != PEEPNUMRULE) {
+        ++peep->fired[rule];
+        changed = 1;
+      }
+
+      IrBlock* blk = &fun->blk[b];
+      for (int i = 0; i < blk->num; ++i) {
+        if (blk->ins[i].op == IRNOP) continue;
+        rule = peepInsRules(peep, fun, b, i);
+        if (rule == PEEPNUMRULE) continue;
+        ++peep->fired[rule];
+        changed = 1;
+      }
+    }
+  }
+  peepTidy(fun);
+  peepIndex(peep, fun);
+}
+
+// ============================================================================
+// Build a new Peep
+// ============================================================================
+Peep* peepNew() {
+  Peep* peep = calloc(1, sizeof(Peep));
+  if (!peep) utDie2Str("peepNew", "Out of memory");
+  return peep;
+}
+
+// ============================================================================
+// Print how many times each rule fired during this compile
+// ============================================================================
+void peepReport(Peep* peep) {
+  int total = 0;
+  printf("\nPeep:");
+  for (int r = 0; r < PEEPNUMRULE; ++r) {
+    printf(" %s %d%s", peepRuleNames[r], peep->fired[r],
+      r < PEEPNUMRULE - 1 ? "," : "");
+    total += peep->fired[r];
+  }
+  printf(" (total %d) \n", total);
+}
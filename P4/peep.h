@@ -0,0 +1,57 @@
+// peep.h - Peephole Optimizer
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdio.h>          // printf
+#include <stdlib.h>         // calloc, free
+
+#include "ir.h"             // IrFun, IrBlock, IrIns
+#include "ra.h"             // RAFIRSTREG, RALASTREG
+#include "ut.h"             // ut*
+
+// peepFun rewrites the IR of one function with the rules below, over and
+// over, until none fires.  Each rule looks at a short window of
+// instructions within one block, or at a few neighbouring blocks.
+//
+// Rules may ask whether a scratch register (D0, D1 or A0), or one of the
+// callee-saved registers D2-D7 that ra allocates, is live at some point.
+// peepLive answers by scanning forward from that point, following BRA and
+// both arms of each Bcc, until it finds a read (live) or a write (dead).
+// BSR and JMP kill all scratch registers; BSR preserves D2-D7, which the
+// epilog's MOVEM restores before RTS or JMP.  RTS/SIMHALT read D0 only.  If
+// the scan runs too long, the register is assumed live.
+//
+// Before each sweep, peepTidy drops deleted instructions and empty
+// unlabeled blocks, and joins each unlabeled block onto a predecessor that
+// falls into it, so that windows can grow.
+
+#define PEEPBUDGET 64       // max instructions visited by one peepLive query
+
+typedef enum {
+  PEEPSTORELOAD = 0,        // MOVE R,X ; MOVE X,R     => MOVE R,X
+  PEEPDEADMOVE,             // MOVE X,Dn (Dn dead)     => -
+  PEEPCOPY,                 // MOVE X,D0 ; MOVE D0,Y   => MOVE X,Y
+  PEEPOPERAND,              // MOVE X,D1 ; ADD D1,D0   => ADD X,D0
+  PEEPBOOL,                 // Bcc/CLR/MOVE #1 ; BEQ   => B!cc
+  PEEPBRANCHNEXT,           // BRA L ; L:              => L:
+  PEEPUNREACH,              // RTS ; <code>            => RTS
+  PEEPLABEL,                // L1: L2: (or L1: L1:)    => L1:
+  PEEPUNUSEDLABEL,          // label never referenced  => -
+  PEEPPEA,                  // LEA X,A0 ; MOVE A0,-(A7) => PEA X
+  PEEPPUSHPOP,              // MOVE X,-(A7) ; MOVE (A7)+,Y => MOVE X,Y
+  PEEPNUMRULE
+} PEEPRULE;
+
+typedef struct {
+  int  labLo;               // lowest label number in the current function
+  int  labNum;              // slots in labAt[] and labRefs[]
+  int* labAt;               // label - labLo => block it heads (-1 => none)
+  int* labRefs;             // label - labLo => number of branches to it
+  int  fired[PEEPNUMRULE];  // times each rule fired, whole compile
+} Peep;
+
+void  peepFun(Peep* peep, IrFun* fun);
+int   peepIsLive(Peep* peep, IrFun* fun, int b, int i, IrOpnd reg);
+Peep* peepNew();
+void  peepReport(Peep* peep);
@@ -3,13 +3,112 @@
 #include "pse.h"
 
 // ============================================================================
-// Append Ast 'a' onto the chain of Asts 'as', linked via the 'next'
-// pointer in the Ast struct
+// The SubC grammar, in a form from which pseInit derives the FIRST and FOLLOW
+// sets of every nonterminal.  Each rule is a row: the
+// nonterminal on the left, then the symbols on the right, ending with 0.  A
+// row with nothing on the right is an empty (epsilon) alternative.  Symbols
+// below NTPROG are TokKinds; the rest are nonterminals.
+// ============================================================================
+static int pseRules[][PSEMAXRULE] = {
+  { NTPROG,    NTFUN, NTFUNS, 0 },
+  { NTFUNS,    NTFUN, NTFUNS, 0 },
+  { NTFUNS,    0 },
+  { NTFUN,     TOKINT, TOKNAM, TOKLPAREN, NTPARS, TOKRPAREN, NTBODY, 0 },
+  { NTPARS,    NTPAR, NTPARST, 0 },
+  { NTPARS,    0 },
+  { NTPARST,   TOKCOMMA, NTPAR, NTPARST, 0 },
+  { NTPARST,   0 },
+  { NTPAR,     TOKINT, TOKNAM, 0 },
+  { NTBODY,    TOKLBRACE, NTVARS, NTSTM, NTSTMS, TOKRBRACE, 0 },
+  { NTVARS,    NTVAR, NTVARS, 0 },
+  { NTVARS,    0 },
+  { NTVAR,     TOKINT, TOKNAM, TOKSEMI, 0 },
+  { NTSTMS,    NTSTM, NTSTMS, 0 },
+  { NTSTMS,    0 },
+  { NTSTM,     NTIF, 0 },
+  { NTSTM,     NTASG, 0 },
+  { NTSTM,     NTRET, 0 },
+  { NTSTM,     NTWHILE, 0 },
+  { NTIF,      TOKIF, TOKLPAREN, NTEXP, TOKRPAREN, NTBLOCK, 0 },
+  { NTASG,     TOKNAM, TOKEQ, NTEOC, TOKSEMI, 0 },
+  { NTEOC,     NTEXP, 0 },
+  { NTEOC,     NTCALL, 0 },
+  { NTRET,     TOKRET, NTEXP, TOKSEMI, 0 },
+  { NTWHILE,   TOKWHILE, TOKLPAREN, NTEXP, TOKRPAREN, NTBLOCK, 0 },
+  { NTBLOCK,   TOKLBRACE, NTSTM, NTSTMS, TOKRBRACE, 0 },
+  { NTEXP,     NTNAMNUM, NTEXPT, 0 },
+  { NTEXPT,    NTBOP, NTNAMNUM, 0 },
+  { NTEXPT,    0 },
+  { NTNAMNUM,  TOKNAM, 0 },
+  { NTNAMNUM,  TOKNUM, 0 },
+  { NTBOP,     TOKADD, 0 }, { NTBOP, TOKSUB, 0 }, { NTBOP, TOKMUL, 0 },
+  { NTBOP,     TOKLT,  0 }, { NTBOP, TOKLE,  0 }, { NTBOP, TOKNE,  0 },
+  { NTBOP,     TOKEEQ, 0 }, { NTBOP, TOKGE,  0 }, { NTBOP, TOKGT,  0 },
+  { NTCALL,    TOKNAM, TOKLPAREN, NTARGS, TOKRPAREN, 0 },
+  { NTARGS,    NTARG, NTARGST, 0 },
+  { NTARGS,    0 },
+  { NTARGST,   TOKCOMMA, NTARG, NTARGST, 0 },
+  { NTARGST,   0 },
+  { NTARG,     TOKNAM, 0 },
+  { NTARG,     TOKNUM, 0 },
+  { NTARG,     TOKSTR, 0 },
+};
+
+#define PSENUMRULE ((int) (sizeof(pseRules) / sizeof(pseRules[0])))
+#define PSENUMNT   (NTEND - NTPROG)
+
+static TokSet pseFirstSet[PSENUMNT];      // FIRST set of each nonterminal
+static TokSet pseFollowSet[PSENUMNT];     // FOLLOW set of each nonterminal
+static int    pseNullable[PSENUMNT];      // can it derive the empty string?
+static int    pseReady = 0;               // have the sets been generated?
+
+// ============================================================================
+// Report a syntax error: the current Token in 'toks' is not one of those in
+// 'expect'.  The diagnostic text is built only here, on the failure path.
+// ============================================================================
+static void pseFail(Toks* toks, char* func, TokSet expect) {
+  char msg[300];
+  tokSetStr(expect, msg);
+  Tok tok = toksTok(toks, toks->tokNum);
+  utDieStrTokStr(func, &tok, msg);
+}
+
+// ============================================================================
+// Return the FIRST set of nonterminal 'nt': the Tokens that can start it
+// ============================================================================
+static TokSet pseFirst(NT nt) { return pseFirstSet[nt - NTPROG]; }
+
+// ============================================================================
+// Return the FOLLOW set of nonterminal 'nt': the Tokens that can come just
+// after it
+// ============================================================================
+static TokSet pseFollow(NT nt) { return pseFollowSet[nt - NTPROG]; }
+
+// ============================================================================
+// Check whether the current Token in 'toks' is a member of 'set'
+// ============================================================================
+static int pseIn(Toks* toks, TokSet set) {
+  return (set & TOKBIT(toksKind(toks))) != 0;
+}
+
+// ============================================================================
+// Append Ast 'a' onto the end of the chain being built in 'list', linked via
+// the 'next' pointer in the Ast struct.  The list remembers where its last
+// 'next' pointer lives, so each append is O(1), however long the chain.  A
+// NULL 'a' (eg: from a stray trailing comma) leaves the chain unchanged.
+// ============================================================================
+void pseAppend(PseList* list, Ast* a) {
+  if (a == NULL) return;
+  *list->tail = a;
+  list->tail = &a->next;
+}
+
+// ============================================================================
+// Start building a new, empty chain of Asts in 'list'
 // ============================================================================
-void pseAppend(Ast* as, Ast* a) {
-  Ast** p = &as->next;              // p is alias
-  while (*p) p = &((*p)->next);
-  *p = a;
+void pseListInit(PseList* list) {
+  list->head = NULL;
+  list->tail = &list->head;
 }
 
 // ============================================================================
@@ -17,18 +116,18 @@ void pseAppend(Ast* as, Ast* a) {
 // ============================================================================
 AstArg* pseArg(Toks* toks) {
 
-  Tok* tok = toksCurr(toks);
-  if (tok->kind == TOKRPAREN) return NULL;    // eg: sayl();
+  if (pseIn(toks, pseFollow(NTARGS))) return NULL;  // eg: sayl();
 
-  tok = pseMust(toks, 3, TOKNAM, TOKNUM, TOKSTR);
-  if (tok->kind == TOKNAM) {
-    AstNam* nam = astNewNam(tok->lex);
+  int t = pseMust(toks, pseFirst(NTARG));
+  TokKind k = toks->kind[t];
+  if (k == TOKNAM) {
+    AstNam* nam = astNewNam(toks->val[t]);
     return astNewArg((Ast*) nam);
-  } else if (tok->kind == TOKNUM) {
-    AstNum* num = astNewNum(tok->num);
+  } else if (k == TOKNUM) {
+    AstNum* num = astNewNum(toks->val[t]);
     return astNewArg((Ast*) num);
-  } else if (tok->kind == TOKSTR) {
-    AstStr* str = astNewStr(tok->lex);
+  } else if (k == TOKSTR) {
+    AstStr* str = astNewStr(&toks->text[toks->off[t]], toks->val[t]);
     return astNewArg((Ast*) str);
   } else {
     return astNewArg(NULL);
@@ -39,33 +138,32 @@ AstArg* pseArg(Toks* toks) {
 // Args => ( Arg ( "," Arg )* ) ?
 // ============================================================================
 AstArg* pseArgs(Toks* toks) {
-  AstArg* args = pseArg(toks);
-  if (args == NULL) return args;      // eg: sayl();
-
-  Tok* tok = toksCurr(toks);
-  while (tok->kind == TOKCOMMA) {
-    tok = toksNext(toks);             // eat TOKCOMMA
-    AstArg* arg = pseArg(toks);
-    pseAppend((Ast*) args, (Ast*) arg);
-    tok = toksCurr(toks);
+  AstArg* arg = pseArg(toks);
+  if (arg == NULL) return arg;        // eg: sayl();
+
+  PseList args; pseListInit(&args);
+  pseAppend(&args, (Ast*) arg);
+  while (pseIn(toks, pseFirst(NTARGST))) {
+    toksNext(toks);                   // eat TOKCOMMA
+    pseAppend(&args, (Ast*) pseArg(toks));
   }
-  return args;
+  return (AstArg*) args.head;
 }
 
 // ============================================================================
 // Asg => Nam "=" (Exp | Call) ";"
 // ============================================================================
 AstAsg* pseAsg(Toks* toks) {
-  Tok* tok = pseMust(toks, 1, TOKNAM);            // eg: x
-  pseMust(toks, 1, TOKEQ);                        // eg: =
+  int t = pseMust(toks, TOKBIT(TOKNAM));               // eg: x
+  pseMust(toks, TOKBIT(TOKEQ));                        // eg: =
   Ast* eoc = NULL;                                // Exp or Call
   if (pseIsCall(toks)) {
     eoc = (Ast*) pseCall(toks);
   } else {
     eoc = (Ast*) pseExp(toks);
   }
-  AstNam* nam = astNewNam(tok->lex);
-  pseMust(toks, 1, TOKSEMI);                      // ;
+  AstNam* nam = astNewNam(toks->val[t]);
+  pseMust(toks, TOKBIT(TOKSEMI));                      // ;
   return astNewAsg(nam, eoc);
 }
 
@@ -73,9 +171,9 @@ AstAsg* pseAsg(Toks* toks) {
 // Block => "{" Stm+ "}"
 // ============================================================================
 AstBlock* pseBlock(Toks* toks) {
-  pseMust(toks, 1, TOKLBRACE);
+  pseMust(toks, TOKBIT(TOKLBRACE));
   AstStm* stms = pseStms(toks);
-  pseMust(toks, 1, TOKRBRACE);
+  pseMust(toks, TOKBIT(TOKRBRACE));
   return astNewBlock(stms);
 }
 
@@ -83,10 +181,10 @@ AstBlock* pseBlock(Toks* toks) {
 // Body => "{" Var* Stm+ "}"
 // ============================================================================
 AstBody* pseBody(Toks* toks) {
-  pseMust(toks, 1, TOKLBRACE);
+  pseMust(toks, TOKBIT(TOKLBRACE));
   AstVar* vars = pseVars(toks);
   AstStm* stms = pseStms(toks);
-  pseMust(toks, 1, TOKRBRACE);
+  pseMust(toks, TOKBIT(TOKRBRACE));
   return astNewBody(vars, stms);
 }
 
@@ -96,11 +194,11 @@ AstBody* pseBody(Toks* toks) {
 // Eg: add3(x, 15, y)
 // ============================================================================
 AstCall* pseCall(Toks* toks) {
-  Tok* tok = pseMust(toks, 1, TOKNAM);      // eg: "add3"
-  AstNam* nam = astNewNam(tok->lex);
-  pseMust(toks, 1, TOKLPAREN);              // eg: "("
+  int t = pseMust(toks, TOKBIT(TOKNAM));         // eg: "add3"
+  AstNam* nam = astNewNam(toks->val[t]);
+  pseMust(toks, TOKBIT(TOKLPAREN));              // eg: "("
   AstArg* args = pseArgs(toks);             // eg: "x, 15, y"
-  pseMust(toks, 1, TOKRPAREN);              // eg: ")"
+  pseMust(toks, TOKBIT(TOKRPAREN));              // eg: ")"
   return astNewCall(nam, args);
 }
 
@@ -110,29 +208,13 @@ AstCall* pseCall(Toks* toks) {
 AstExp* pseExp(Toks* toks) {
   AstExp* exp = astNewExp(NULL, BOPNONE, NULL);
 
-  Tok* tok = toksCurr(toks);
+  exp->lhs = pseNamNum(toks);                 // eg: abc  or  42
 
-  if (tok->kind == TOKNUM) {                  // eg: 42
-    exp->lhs = (Ast*) pseNum(toks);
-  } else if (tok->kind == TOKNAM) {           // eg: abc
-    exp->lhs = (Ast*) pseNam(toks);
-  } else {
-    utDie2Str("pseExp", "Invalid expression");
-  }
-
-  tok = toksCurr(toks);
-  if (tok->kind == TOKSEMI) return exp;
-
-  if (pseIsBop(tok->kind)) {                  // eg: +
-    exp->bop = pseTOKtoBOP(tok->kind);
-    tok = toksNext(toks);
-    if (tok->kind == TOKNUM) {                // eg: 99
-      exp->rhs = (Ast*) pseNum(toks);
-    } else if (tok->kind == TOKNAM) {         // eg: xyz
-      exp->rhs = (Ast*) pseNam(toks);
-    } else {
-      utDie2Str("pseExp", "Invalid expression");
-    }
+  TokKind k = toksKind(toks);
+  if (pseIsBop(k)) {                          // eg: +
+    exp->bop = pseTOKtoBOP(k);
+    toksNext(toks);
+    exp->rhs = pseNamNum(toks);               // eg: xyz  or  99
   }
 
   return exp;
@@ -142,13 +224,13 @@ AstExp* pseExp(Toks* toks) {
 // Fun => "int" Nam "(" Pars ")" Body
 // ============================================================================
 AstFun* pseFun(Toks* toks) {
-  pseMust(toks, 1, TOKINT);                             // "int"
-  Tok* tok = pseMust(toks, 1, TOKNAM);                  // eg: cat
-  AstNam* astnam = astNewNam(tok->lex);
+  pseMust(toks, TOKBIT(TOKINT));                             // "int"
+  int t = pseMust(toks, TOKBIT(TOKNAM));                     // eg: cat
+  AstNam* astnam = astNewNam(toks->val[t]);
 
-  pseMust(toks, 1, TOKLPAREN);
+  pseMust(toks, TOKBIT(TOKLPAREN));
   AstPar* pars = psePars(toks);                         // eg: int a, int b
-  pseMust(toks, 1, TOKRPAREN);
+  pseMust(toks, TOKBIT(TOKRPAREN));
 
   AstBody* body = pseBody(toks);
 
@@ -159,10 +241,10 @@ AstFun* pseFun(Toks* toks) {
 // If => "if" "(" Exp ")" Block
 // ============================================================================
 AstIf* pseIf(Toks* toks) {
-  pseMust(toks, 1, TOKIF);
-  pseMust(toks, 1, TOKLPAREN);
+  pseMust(toks, TOKBIT(TOKIF));
+  pseMust(toks, TOKBIT(TOKLPAREN));
   AstExp* exp = pseExp(toks);
-  pseMust(toks, 1, TOKRPAREN);
+  pseMust(toks, TOKBIT(TOKRPAREN));
   AstBlock* block = pseBlock(toks);
   return astNewIf(exp, block);
 }
@@ -173,18 +255,14 @@ AstIf* pseIf(Toks* toks) {
 // (It might equally well be the start of a function call)
 // ============================================================================
 int pseIsAsg(Toks* toks) {
-  Tok* tok = toksPeek(toks);
-  return tok->kind == TOKEQ;
+  return toksPeek(toks) == TOKEQ;
 }
 
 // ============================================================================
 // Check whether the Token kind specified by 'k' is legal binary operator
 // ============================================================================
 int pseIsBop(TokKind k) {
-  return (k == TOKADD || k == TOKSUB || k == TOKMUL ||
-          k == TOKLE  || k == TOKLT  || k == TOKNE  || k == TOKEEQ ||
-          k == TOKGE  || k == TOKGT  || k == TOKLE  || k == TOKLT  ||
-          k == TOKNE  || k == TOKEEQ || k == TOKGE  || k == TOKGT);
+  return (pseFirst(NTBOP) & TOKBIT(k)) != 0;
 }
 
 // ============================================================================
@@ -192,87 +270,130 @@ int pseIsBop(TokKind k) {
 // call, such as "cmp(3, 4)"
 // ============================================================================
 int pseIsCall(Toks* toks) {
-  Tok* tok = toksPeek(toks);
-  return tok->kind == TOKLPAREN;
+  return toksPeek(toks) == TOKLPAREN;
 }
 
 // ============================================================================
-// Check that the current Token within 'toks' matches any of the 'numk'
-// kinds in the varargs list.  If yes, advance to the next Token in 'toks'.
-// If not, abort the program
-//
-// eg: pseMust(toks, 2, TOKNAM, TOKNUM)
-// In this example, if the current Token does not match TOKNAM or TOKNUM,
-// we build a diagnostic text in 'msg' and call dieStrTokStr to print a
-// message like:
-//    "ERROR: pseFun: Found TOKLET but expecting {TOKNAM, TOKNUM}"
-// ============================================================================
-Tok* pseMust(Toks* toks, int numk, ...) {
-
-  // Prepare a failure message, just in case
-
-  va_list argp;
-  va_start(argp, numk);
-  char msg[300] = "{";
-  TokKind k;
-
-  for (int i = 1; i <= numk - 1; ++i) {
-    k = va_arg(argp, TokKind);
-    strcat(msg, tokStr(k));   strcat(msg, ", ");
-  }
-  k = va_arg(argp, TokKind);
-  strcat(msg, tokStr(k));     strcat(msg, "}");
-  va_end(argp);
-
-  // Now process the actual request
-
-  if (toksAtEnd(toks)) {
-    Tok* tok = tokNew(TOKBAD, "No more tokens", 0, NULL, 999, 999);
-    utDieStrTokStr("pseMust", tok, msg);
+// Generate the FIRST and FOLLOW sets, and the nullable flags, of every
+// nonterminal, from pseRules.  Each is the usual fixed-point iteration: keep
+// sweeping the rules until nothing changes.  Only the first call does any
+// work.
+// ============================================================================
+void pseInit() {
+  if (pseReady) return;
+
+  int changed = 1;
+  while (changed) {                                   // FIRST and nullable
+    changed = 0;
+    for (int r = 0; r < PSENUMRULE; ++r) {
+      int    lhs   = pseRules[r][0] - NTPROG;
+      int*   rhs   = &pseRules[r][1];
+      TokSet first = pseFirstSet[lhs];
+      int    null  = 1;                               // rhs so far is nullable
+      for (int i = 0; rhs[i] && null; ++i) {
+        if (rhs[i] < NTPROG) {
+          first |= TOKBIT(rhs[i]);
+          null = 0;
+        } else {
+          first |= pseFirstSet[rhs[i] - NTPROG];
+          null = pseNullable[rhs[i] - NTPROG];
+        }
+      }
+      if (first != pseFirstSet[lhs] || (null && !pseNullable[lhs])) {
+        pseFirstSet[lhs] = first;
+        pseNullable[lhs] |= null;
+        changed = 1;
+      }
+    }
   }
 
-  Tok* tok = toksCurr(toks);
-
-  va_start(argp, numk);                   // number of TokKind's
-  for (int i = 1; i <= numk; ++i) {
-    k = va_arg(argp, TokKind);
-    if (tok->kind == k) {
-      toksNext(toks);
-      return tok;
+  pseFollowSet[NTPROG - NTPROG] = TOKBIT(TOKEOF);
+  changed = 1;
+  while (changed) {                                   // FOLLOW
+    changed = 0;
+    for (int r = 0; r < PSENUMRULE; ++r) {
+      int* rhs = &pseRules[r][1];
+      int  len = 0;
+      while (rhs[len]) ++len;
+
+      // Walk the rhs right to left.  'trailer' holds the Tokens that can
+      // follow the symbol about to be visited.
+
+      TokSet trailer = pseFollowSet[pseRules[r][0] - NTPROG];
+      for (int i = len - 1; i >= 0; --i) {
+        if (rhs[i] < NTPROG) {
+          trailer = TOKBIT(rhs[i]);
+          continue;
+        }
+        int nt = rhs[i] - NTPROG;
+        if ((pseFollowSet[nt] | trailer) != pseFollowSet[nt]) {
+          pseFollowSet[nt] |= trailer;
+          changed = 1;
+        }
+        trailer = pseNullable[nt] ? trailer | pseFirstSet[nt] : pseFirstSet[nt];
+      }
     }
   }
-  va_end(argp);
 
-  // Failed to find a match.  So emit the diagnostic
+  pseReady = 1;
+}
 
-  utDieStrTokStr("pseMust", tok, msg);
-  return NULL;
+// ============================================================================
+// Check that the current Token within 'toks' is a member of the set
+// 'expect'.  If yes, advance to the next Token in 'toks', and return the
+// number of the matched Token.  If not, abort the program.  The check is a
+// single bit test.
+//
+// eg: pseMust(toks, pseFirst(NTNAMNUM))
+// In this example, if the current Token does not match TOKNAM or TOKNUM,
+// pseFail builds a diagnostic and prints a message like:
+//    "ERROR: pseMust: Found TOKLET but expecting {TOKNAM, TOKNUM}"
+//
+// Running off the end of the tokens needs no special check: the TOKEOF
+// sentinel matches nothing.
+// ============================================================================
+int pseMust(Toks* toks, TokSet expect) {
+  int t = toks->tokNum;
+  if (expect & TOKBIT(toks->kind[t])) {
+    toksNext(toks);
+    return t;
+  }
+  pseFail(toks, "pseMust", expect);
+  return -1;
 }
 
 // ============================================================================
 // Nam => Alpha AlphaNum*
 // ============================================================================
 AstNam* pseNam(Toks* toks) {
-  Tok* tok = pseMust(toks, 1, TOKNAM);
-  return astNewNam(tok->lex);
+  int t = pseMust(toks, TOKBIT(TOKNAM));
+  return astNewNam(toks->val[t]);
+}
+
+// ============================================================================
+// NamNum => Nam | Num
+// ============================================================================
+Ast* pseNamNum(Toks* toks) {
+  int t = pseMust(toks, pseFirst(NTNAMNUM));
+  if (toks->kind[t] == TOKNAM) return (Ast*) astNewNam(toks->val[t]);
+  return (Ast*) astNewNum(toks->val[t]);
 }
 
 // ============================================================================
 // Num => [0-9]+
 // ============================================================================
 AstNum* pseNum(Toks* toks) {
-  Tok* tok = pseMust(toks, 1, TOKNUM);
-  return astNewNum(tok->num);
+  int t = pseMust(toks, TOKBIT(TOKNUM));
+  return astNewNum(toks->val[t]);
 }
 
 // ============================================================================
 // Par => "int" Nam
 // ============================================================================
 AstPar* psePar(Toks* toks) {
-  Tok* tok = toksCurr(toks);
-  if (tok->kind == TOKRPAREN) return NULL;     // no parameters
+  if (pseIn(toks, pseFollow(NTPARS))) return NULL;  // no parameters
 
-  pseMust(toks, 1, TOKINT);
+  pseMust(toks, TOKBIT(TOKINT));
   AstNam* astnam = pseNam(toks);
 
   return  astNewPar(astnam);
@@ -283,29 +404,29 @@ AstPar* psePar(Toks* toks) {
 // eg: ( int i , int j )
 // ============================================================================
 AstPar* psePars(Toks* toks) {
-  AstPar* pars = psePar(toks);
-  Tok* tok = toksCurr(toks);
-  while (tok->kind == TOKCOMMA) {
-    tok = toksNext(toks);                     // eat TOKCOMMA
-    AstPar* par = psePar(toks);
-    pseAppend((Ast*) pars, (Ast*) par);
-    tok = toksCurr(toks);
+  AstPar* par = psePar(toks);
+  if (par == NULL) return par;                // no parameters
+
+  PseList pars; pseListInit(&pars);
+  pseAppend(&pars, (Ast*) par);
+  while (pseIn(toks, pseFirst(NTPARST))) {
+    toksNext(toks);                           // eat TOKCOMMA
+    pseAppend(&pars, (Ast*) psePar(toks));
   }
-  return pars;
+  return (AstPar*) pars.head;
 }
 
 // ============================================================================
 // Prog => Fun+
 // ============================================================================
 AstProg* pseProg(Toks* toks) {
-  AstFun* fun = pseFun(toks);                 // first function
-  AstProg* prog = astNewProg(fun);
-  while (toks->tokNum <= toks->hiTokNum) {
-    AstFun* funNext = pseFun(toks);           // next function
-    pseAppend((Ast*) fun, (Ast*) funNext);    // append onto funs chain
-    fun = funNext;                            // move along chain
+  pseInit();
+  PseList funs; pseListInit(&funs);
+  pseAppend(&funs, (Ast*) pseFun(toks));      // first function
+  while (!toksAtEnd(toks)) {
+    pseAppend(&funs, (Ast*) pseFun(toks));    // next function
   }
-  return prog;
+  return astNewProg((AstFun*) funs.head);
 }
 
 // ============================================================================
@@ -313,17 +434,17 @@ AstProg* pseProg(Toks* toks) {
 // ============================================================================
 void pseRep(Toks* toks, char* s) {
   printf("%s", s);
-  Tok* tok = toksCurr(toks);
-  printf("%s %s \n", tokStr(tok->kind), tok->lex);
+  Tok tok = toksTok(toks, toks->tokNum);
+  printf("%s (%d, %d) \n", tokStr(tok.kind), tok.linNum, tok.colNum);
 }
 
 // ============================================================================
 // Ret => "return" Exp ";"
 // ============================================================================
 AstRet* pseRet(Toks* toks) {
-  pseMust(toks, 1, TOKRET);
+  pseMust(toks, TOKBIT(TOKRET));
   AstExp* exp = pseExp(toks);
-  pseMust(toks, 1, TOKSEMI);
+  pseMust(toks, TOKBIT(TOKSEMI));
   return astNewRet(exp);
 }
 
@@ -331,8 +452,7 @@ AstRet* pseRet(Toks* toks) {
 // Stm => If | Asg | Ret | While
 // ============================================================================
 AstStm* pseStm(Toks* toks) {
-  Tok* tok = toksCurr(toks);
-  TokKind k = tok->kind;
+  TokKind k = toksKind(toks);
   if (k == TOKIF) {
     return (AstStm*) pseIf(toks);
   } else if (k == TOKNAM) {
@@ -342,7 +462,7 @@ AstStm* pseStm(Toks* toks) {
   } else if (k == TOKWHILE) {
     return (AstStm*) pseWhile(toks);
   }
-  utDieStrTokStr("pseStm", tok, "a statement");
+  pseFail(toks, "pseStm", pseFirst(NTSTM));
   return NULL;
 }
 
@@ -350,36 +470,33 @@ AstStm* pseStm(Toks* toks) {
 // Stms => Stm+
 // ============================================================================
 AstStm* pseStms(Toks* toks) {
-  AstStm* stms = pseStm(toks);
+  PseList stms; pseListInit(&stms);
+  pseAppend(&stms, (Ast*) pseStm(toks));      // Stm+
 
-  Tok* tok = toksCurr(toks);
-  while (tok->kind != TOKRBRACE) {
-    AstStm* stm = pseStm(toks);
-    pseAppend((Ast*)stms, (Ast*)stm);
-    tok = toksCurr(toks);
+  while (!pseIn(toks, pseFollow(NTSTMS))) {
+    pseAppend(&stms, (Ast*) pseStm(toks));
   }
-  return stms;
+  return (AstStm*) stms.head;
 }
 
 // ============================================================================
 // Parse a string literal, such as "hello world"
 // ============================================================================
 AstStr* pseStr(Toks* toks) {
-  Tok* tok = pseMust(toks, 1, TOKSTR);
-  return astNewStr(tok->lex);
+  int t = pseMust(toks, TOKBIT(TOKSTR));
+  return astNewStr(&toks->text[toks->off[t]], toks->val[t]);
 }
 
 // ============================================================================
 // Var => "int" Nam ";"
 // ============================================================================
 AstVar* pseVar(Toks* toks) {
-  Tok* tok = toksCurr(toks);
-  if (tok->kind != TOKINT) return NULL;
+  if (!pseIn(toks, pseFirst(NTVAR))) return NULL;
 
-  pseMust(toks, 1, TOKINT);
-  Tok* tokNam = pseMust(toks, 1, TOKNAM);           // eg: count
-  pseMust(toks, 1, TOKSEMI);                        // ";"
-  AstNam* astnam = astNewNam(tokNam->lex);
+  pseMust(toks, TOKBIT(TOKINT));
+  int t = pseMust(toks, TOKBIT(TOKNAM));                 // eg: count
+  pseMust(toks, TOKBIT(TOKSEMI));                        // ";"
+  AstNam* astnam = astNewNam(toks->val[t]);
   return astNewVar(astnam);                         // eg: count, int
 }
 
@@ -388,15 +505,14 @@ AstVar* pseVar(Toks* toks) {
 // Vars => Var*
 // ============================================================================
 AstVar* pseVars(Toks* toks) {
-  AstVar* vars = pseVar(toks);
-  if (vars == NULL) return NULL;
+  PseList vars; pseListInit(&vars);
 
   AstVar* var = pseVar(toks);
   while (var != NULL) {
-    pseAppend((Ast*) vars, (Ast*) var);
+    pseAppend(&vars, (Ast*) var);
     var = pseVar(toks);
   }
-  return vars;
+  return (AstVar*) vars.head;
 }
 
 // ============================================================================
@@ -405,10 +521,10 @@ AstVar* pseVars(Toks* toks) {
 // eg: while (n < 10) { n = n + 1 ; }
 // ============================================================================
 AstWhile* pseWhile(Toks* toks) {
-  pseMust(toks, 1, TOKWHILE);
-  pseMust(toks, 1, TOKLPAREN);
+  pseMust(toks, TOKBIT(TOKWHILE));
+  pseMust(toks, TOKBIT(TOKLPAREN));
   AstExp* exp = pseExp(toks);
-  pseMust(toks, 1, TOKRPAREN);
+  pseMust(toks, TOKBIT(TOKRPAREN));
   AstBlock* block = pseBlock(toks);
   return astNewWhile(exp, block);
 }
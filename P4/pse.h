@@ -2,11 +2,29 @@
 
 #pragma once
 
-#include <stdarg.h>
-
 #include "ast.h"        // AstBody, etc
 #include "toks.h"       // Toks
 
+// Nonterminals of the SubC grammar (see pseRules).  They are numbered from
+// NTPROG, above every TokKind, so that a grammar symbol can be either.
+
+typedef enum {
+  NTPROG = 32, NTFUNS, NTFUN, NTPARS, NTPARST, NTPAR, NTBODY, NTVARS, NTVAR,
+  NTSTMS, NTSTM, NTIF, NTASG, NTEOC, NTRET, NTWHILE, NTBLOCK, NTEXP, NTEXPT,
+  NTNAMNUM, NTBOP, NTCALL, NTARGS, NTARGST, NTARG, NTEND
+} NT;
+
+#define PSEMAXRULE 8    // max symbols in a rule, counting lhs and final 0
+
+// A PseList builds a chain of Asts, linked through their 'next' fields, in
+// the order they are parsed.  'tail' points at the 'next' field of the last
+// Ast in the chain (or at 'head', while the chain is empty).
+
+typedef struct {
+  Ast*  head;           // first Ast in the chain
+  Ast** tail;           // where to link the next Ast
+} PseList;
+
 AstArg*    pseArg    (Toks* toks);
 AstArg*    pseArgs   (Toks* toks);
 AstAsg*    pseAsg    (Toks* toks);
@@ -19,8 +37,10 @@ AstIf*     pseIf     (Toks* toks);
 int        pseIsAsg  (Toks* toks);
 int        pseIsBop  (TokKind k);
 int        pseIsCall (Toks* toks);
-Tok*       pseMust   (Toks* toks, int numk, ...);
+void       pseInit   ();
+int        pseMust   (Toks* toks, TokSet expect);
 AstNam*    pseNam    (Toks* toks);
+Ast*       pseNamNum (Toks* toks);
 AstNum*    pseNum    (Toks* toks);
 AstPar*    psePar    (Toks* toks);
 AstPar*    psePars   (Toks* toks);
@@ -36,5 +56,6 @@ AstWhile*  pseWhile  (Toks* toks);
 
 BOP pseTOKtoBOP(TokKind k);
 
-void pseAppend(Ast* as, Ast* a);
+void pseAppend(PseList* list, Ast* a);
+void pseListInit(PseList* list);
 
@@ -0,0 +1,182 @@
+// ra.c - Register Allocator
+
+#include "ra.h"
+
+// ============================================================================
+// Order intervals by start position.  Ties are broken on the stack offset, so
+// that the allocation does not depend upon the hash order of the scope.
+// ============================================================================
+static int raCmpStart(const void* a, const void* b) {
+  const RaLive* x = *(RaLive* const*) a;
+  const RaLive* y = *(RaLive* const*) b;
+  if (x->start != y->start) return x->start < y->start ? -1 : 1;
+  if (x->sym->off != y->sym->off) return x->sym->off < y->sym->off ? -1 : 1;
+  return 0;
+}
+
+// ============================================================================
+// Give each frame-resident variable of 'scope' a fresh slot, packed from -4
+// downwards, in the order of their original offsets.  Variables that now live
+// in a register need no slot at all (off = 0).  Parameters are left alone:
+// they are where the caller pushed them.
+// ============================================================================
+static void raPack(LayScope* scope) {
+  int numvar = layCountVars(scope);
+  if (numvar == 0) return;
+
+  LaySym** bySlot = calloc(numvar, sizeof(LaySym*));    // original slot => sym
+  if (!bySlot) utDie2Str("raPack", "Out of memory");
+  for (int i = 0; i < scope->cap; ++i) {
+    LaySym* sym = &scope->sym[i];
+    if (sym->id == 0 || sym->role != ROLEVAR) continue;
+    int slot = -sym->off / 4 - 1;
+    assert(slot >= 0 && slot < numvar);
+    bySlot[slot] = sym;
+  }
+
+  int off = -4;
+  for (int slot = 0; slot < numvar; ++slot) {
+    LaySym* sym = bySlot[slot];
+    if (sym->reg) {
+      sym->off = 0;
+    } else {
+      sym->off = off;
+      off -= 4;
+    }
+  }
+  free(bySlot);
+}
+
+// ============================================================================
+// Record a reference, at 'pos', to the par/var with intern ID 'id'.  'loop'
+// is the outermost enclosing While (0 => none).  'weight' is added onto the
+// weight of the par/var.
+// ============================================================================
+static void raRef(RaLive* live, LayScope* scope, Flat* flat, int id, int pos,
+  int loop, int weight) {
+  LaySym* sym = layFind(scope, id);
+  if (sym == NULL || sym->role == ROLEFUN) return;    // cg reports the error
+  if (sym->role != ROLEPAR && sym->role != ROLEVAR) return;
+
+  RaLive* r = &live[sym - scope->sym];
+  if (r->sym == NULL) {
+    r->sym   = sym;
+    r->start = pos;
+    r->end   = pos;
+  }
+  if (pos < r->start) r->start = pos;
+  if (pos > r->end)   r->end = pos;
+
+  if (loop) {                                         // live around the loop
+    int loopend = 2 * (int) flat->node[loop].end - 1;
+    if (2 * loop < r->start) r->start = 2 * loop;
+    if (loopend > r->end)    r->end = loopend;
+  }
+
+  r->weight += weight;
+}
+
+// ============================================================================
+// The weight of one reference at loop-depth 'depth': RALOOPWEIGHT ^ depth
+// ============================================================================
+static int raWeight(int depth) {
+  if (depth > RAMAXDEPTH) depth = RAMAXDEPTH;
+  int weight = 1;
+  for (int i = 0; i < depth; ++i) weight *= RALOOPWEIGHT;
+  return weight;
+}
+
+// ============================================================================
+// Allocate registers for the function at node 'fun' of 'flat', whose Layout
+// has already been built into 'lay'.  Each par/var that wins a register has
+// its 'reg' set (eg: 3 for D3).  The rest stay in the stack frame, and the
+// ROLEVARs among them are packed into the smallest frame possible.
+//
+// Return the set of registers used, as a mask (bit 'n' <=> Dn), so that the
+// Prolog and Epilog can save and restore just those.
+// ============================================================================
+int raFun(Lay* lay, Flat* flat, int fun) {
+  FlatNode* node  = flat->node;                       // alias
+  LayScope* scope = layFindFun(lay, node[fun].val)->scope;
+  int       end   = (int) node[fun].end;
+
+  RaLive* live = calloc(scope->cap, sizeof(RaLive));  // one per hash slot
+  if (!live) utDie2Str("raFun", "Out of memory");
+
+  // Pass 1: build one live interval per referenced par/var
+
+  int* loops = calloc(end - fun, sizeof(int));        // enclosing Whiles
+  if (!loops) utDie2Str("raFun", "Out of memory");
+  int depth = 0;
+
+  for (int n = fun + 1; n < end; ++n) {
+    while (depth && n >= (int) node[loops[depth - 1]].end) --depth;
+    int loop = depth ? loops[0] : 0;
+
+    switch (node[n].tag) {
+      case ASTPAR:   raRef(live, scope, flat, node[n].val, 2 * fun, 0, 0);
+                     break;
+      case ASTNAM:   raRef(live, scope, flat, node[n].val, 2 * n, loop,
+                       raWeight(depth));
+                     break;
+      case ASTASG:   raRef(live, scope, flat, node[n].val,
+                       2 * (int) node[n].end - 1, loop, raWeight(depth));
+                     break;
+      case ASTWHILE: loops[depth++] = n;
+                     break;
+      default:       break;
+    }
+  }
+  free(loops);
+
+  // Pass 2: sort the intervals worth a register by start position
+
+  RaLive** order = calloc(scope->cap, sizeof(RaLive*));
+  if (!order) utDie2Str("raFun", "Out of memory");
+  int num = 0;
+  for (int i = 0; i < scope->cap; ++i) {
+    if (live[i].sym) live[i].sym->reg = 0;
+    if (live[i].sym && live[i].weight > 0) order[num++] = &live[i];
+  }
+  qsort(order, num, sizeof(RaLive*), raCmpStart);
+
+  // Pass 3: linear scan.  'active' holds the intervals currently occupying
+  // a register.
+
+  RaLive* active[RALASTREG + 1] = { NULL };           // indexed by register
+  int     used = 0;
+
+  for (int i = 0; i < num; ++i) {
+    RaLive* cur = order[i];
+
+    int reg = 0;
+    int victim = 0;                                   // lowest-weight holder
+    for (int r = RAFIRSTREG; r <= RALASTREG; ++r) {
+      if (active[r] && active[r]->end < cur->start) active[r] = NULL;
+      if (active[r] == NULL) {
+        if (reg == 0) reg = r;
+      } else if (victim == 0 || active[r]->weight < active[victim]->weight) {
+        victim = r;
+      }
+    }
+
+    if (reg == 0) {                                   // all registers taken
+      if (active[victim]->weight >= cur->weight) continue;   // cur spills
+      active[victim]->sym->reg = 0;                   // victim spills
+      reg = victim;
+    }
+
+    active[reg] = cur;
+    cur->sym->reg = reg;
+  }
+
+  for (int i = 0; i < num; ++i) {
+    if (order[i]->sym->reg) used |= 1 << order[i]->sym->reg;
+  }
+
+  free(order);
+  free(live);
+
+  raPack(scope);
+  return used;
+}
@@ -0,0 +1,42 @@
+// ra.h - Register Allocator
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdlib.h>         // calloc, qsort
+
+#include "flat.h"           // Flat
+#include "lay.h"            // Lay, LaySym
+#include "ut.h"             // ut*
+
+// raFun assigns the hottest parameters and local variables of one function
+// to the callee-saved data registers D2 thru D7, using linear scan.
+//
+// Positions are derived from the Flat: a read of a name at node 'n' happens
+// at position 2n; the write performed by an Asg at node 'n' happens at
+// 2 * node[n].end - 1, after every read in its right-hand side.  So, in
+// "a = b + c", 'a' may take over the register of 'b' or 'c' if that was their
+// last use.  Parameters are live from function entry.
+//
+// A While carries values around its back edge, so any par/var referenced
+// within a loop is kept live across the whole of its outermost enclosing
+// loop.  SubC has no goto, so otherwise code order is Flat order, and a
+// single [start, end] interval per par/var is safe.
+//
+// Each reference adds RALOOPWEIGHT ^ loop-depth to the weight of its par/var.
+// When all registers are taken, the interval with the lowest weight stays in
+// the stack frame.
+
+#define RAFIRSTREG   2      // D2
+#define RALASTREG    7      // D7
+#define RALOOPWEIGHT 8      // a loop is assumed to iterate this many times
+#define RAMAXDEPTH   9      // cap on loop-depth when computing weights
+
+typedef struct {
+  LaySym* sym;              // the par/var (NULL => never referenced)
+  int     start;            // first position at which it is live
+  int     end;              // last position at which it is live
+  int     weight;           // estimated number of dynamic references
+} RaLive;
+
+int  raFun(Lay* lay, Flat* flat, int fun);
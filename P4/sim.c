@@ -0,0 +1,642 @@
+// sim.c - Simulate 68000 code, counting cycles
+
+#include "sim.h"
+
+// ============================================================================
+// Report an error at run time, naming the function, and stop
+// ============================================================================
+static void simDie(Sim* sim, char* msg, uint32_t val) {
+  char text[64];
+  sprintf(text, "$%X in function", val);
+  int name = sim->as->fun[sim->cur].name;
+  utDie4Str("simRun", msg, text, name ? internStr(name) : "-");
+}
+
+// ============================================================================
+// Mask for, and sign bit of, a value of 'sz' bytes
+// ============================================================================
+static uint32_t simMask(int sz) { return sz == 4 ? 0xFFFFFFFF : sz == 2 ? 0xFFFF : 0xFF; }
+
+static uint32_t simMsb(int sz)  { return sz == 4 ? 0x80000000 : sz == 2 ? 0x8000 : 0x80; }
+
+// ============================================================================
+// Sign-extend the low 'sz' bytes of 'v' to 32 bits
+// ============================================================================
+static uint32_t simSext(uint32_t v, int sz) {
+  if (sz == 1) return (uint32_t) (int32_t) (int8_t) v;
+  if (sz == 2) return (uint32_t) (int32_t) (int16_t) v;
+  return v;
+}
+
+// ============================================================================
+// Read, or write, 'sz' bytes of memory at 'addr', big-endian.  As on the
+// 68000, only the low 24 bits of the address count, and a word or long at an
+// odd address is an address error.
+// ============================================================================
+static uint32_t simLoad(Sim* sim, uint32_t addr, int sz) {
+  addr &= ASMMEMSIZE - 1;
+  if ((sz > 1 && (addr & 1)) || addr > (uint32_t) ASMMEMSIZE - sz) simDie(sim, "Address error at", addr);
+  uint8_t* p = sim->as->mem + addr;
+  if (sz == 1) return p[0];
+  if (sz == 2) return (uint32_t) p[0] << 8 | p[1];
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static void simStore(Sim* sim, uint32_t addr, int sz, uint32_t v) {
+  addr &= ASMMEMSIZE - 1;
+  if ((sz > 1 && (addr & 1)) || addr > (uint32_t) ASMMEMSIZE - sz) simDie(sim, "Address error at", addr);
+  uint8_t* p = sim->as->mem + addr;
+  if (sz == 4) { *p++ = (uint8_t) (v >> 24); *p++ = (uint8_t) (v >> 16); }
+  if (sz >= 2) { *p++ = (uint8_t) (v >> 8); }
+  *p = (uint8_t) v;
+}
+
+// ============================================================================
+// A7 has just moved down.  Stop if the stack has grown into the program, or
+// wrapped below address 0, rather than let it overwrite the data.
+// ============================================================================
+static void simCheckStack(Sim* sim) {
+  uint32_t a7 = sim->a[7];
+  if (a7 < sim->stackLo || a7 > ASMMEMSIZE) simDie(sim, "Stack overflow at", a7);
+}
+
+// ============================================================================
+// The address named by memory operand 'o', for an access of 'sz' bytes.
+// (An)+ and -(An) step An - by 2, not 1, for a byte access through A7.
+// ============================================================================
+static uint32_t simAddr(Sim* sim, AsmOpnd* o, int sz) {
+  uint32_t* a = sim->a;
+  int step = sz == 1 && o->reg == 7 ? 2 : sz;
+  switch (o->kind) {
+    case ASMOPIND:     return a[o->reg];
+    case ASMOPPOSTINC: a[o->reg] += step; return a[o->reg] - step;
+    case ASMOPPREDEC:
+      a[o->reg] -= step;
+      if (o->reg == 7) simCheckStack(sim);
+      return a[o->reg];
+    case ASMOPDISP:    return a[o->reg] + (uint32_t) o->val;
+    default:           return (uint32_t) o->val;            // ASMOPABS
+  }
+}
+
+// ============================================================================
+// Read the 'sz'-byte value of operand 'o'
+// ============================================================================
+static uint32_t simRead(Sim* sim, AsmOpnd* o, int sz) {
+  switch (o->kind) {
+    case ASMOPDREG: return sim->d[o->reg] & simMask(sz);
+    case ASMOPAREG: return sim->a[o->reg] & simMask(sz);
+    case ASMOPIMM:  return (uint32_t) o->val & simMask(sz);
+    default:        return simLoad(sim, simAddr(sim, o, sz), sz);
+  }
+}
+
+// ============================================================================
+// Read operand 'o' ahead of writing it back with simPut: a memory operand's
+// address is found just once, and kept in '*addr'
+// ============================================================================
+static uint32_t simGet(Sim* sim, AsmOpnd* o, int sz, uint32_t* addr) {
+  if (o->kind == ASMOPDREG) return sim->d[o->reg] & simMask(sz);
+  *addr = simAddr(sim, o, sz);
+  return simLoad(sim, *addr, sz);
+}
+
+static void simPut(Sim* sim, AsmOpnd* o, int sz, uint32_t addr, uint32_t v) {
+  if (o->kind == ASMOPDREG) {                       // only the low 'sz' bytes
+    uint32_t mask = simMask(sz);
+    sim->d[o->reg] = (sim->d[o->reg] & ~mask) | (v & mask);
+  } else {
+    simStore(sim, addr, sz, v);
+  }
+}
+
+// ============================================================================
+// Write 'v' to operand 'o', which is a data register or memory
+// ============================================================================
+static void simWrite(Sim* sim, AsmOpnd* o, int sz, uint32_t v) {
+  uint32_t addr = 0;
+  if (o->kind != ASMOPDREG) addr = simAddr(sim, o, sz);
+  simPut(sim, o, sz, addr, v);
+}
+
+// ============================================================================
+// Set the condition codes for a move or logical result 'r': N and Z from
+// 'r'; V and C cleared; X unchanged
+// ============================================================================
+static void simFlags(Sim* sim, uint32_t r, int sz) {
+  sim->n = (r & simMsb(sz)) != 0;
+  sim->z = (r & simMask(sz)) == 0;
+  sim->v = sim->c = 0;
+}
+
+// ============================================================================
+// 'd' + 's', in 'sz' bytes, setting X N Z V C
+// ============================================================================
+static uint32_t simAdd(Sim* sim, uint32_t d, uint32_t s, int sz) {
+  uint32_t mask = simMask(sz), msb = simMsb(sz);
+  uint32_t r = (d + s) & mask;
+  sim->n = (r & msb) != 0;
+  sim->z = r == 0;
+  sim->v = ((s ^ r) & (d ^ r) & msb) != 0;
+  sim->c = sim->x = (uint64_t) (d & mask) + (s & mask) > mask;
+  return r;
+}
+
+// ============================================================================
+// 'd' - 's', in 'sz' bytes, setting N Z V C; and X, unless 'cmp'
+// ============================================================================
+static uint32_t simSub(Sim* sim, uint32_t d, uint32_t s, int sz, int cmp) {
+  uint32_t mask = simMask(sz), msb = simMsb(sz);
+  uint32_t r = (d - s) & mask;
+  sim->n = (r & msb) != 0;
+  sim->z = r == 0;
+  sim->v = ((s ^ d) & (r ^ d) & msb) != 0;
+  sim->c = (s & mask) > (d & mask);
+  if (!cmp) sim->x = sim->c;
+  return r;
+}
+
+// ============================================================================
+// Shift the 'sz'-byte value 'v' left by 'count', setting X N Z V C.  For ASL
+// ('arith'), V says whether the sign bit changed at any point.
+// ============================================================================
+static uint32_t simShift(Sim* sim, uint32_t v, int count, int sz, int arith) {
+  int bits = 8 * sz;
+  uint64_t w = v & simMask(sz);
+  uint32_t r = count >= bits ? 0 : (uint32_t) (w << count) & simMask(sz);
+  sim->n = (r & simMsb(sz)) != 0;
+  sim->z = r == 0;
+  sim->v = 0;
+  sim->c = 0;
+  if (count == 0) return r;
+
+  sim->c = sim->x = count <= bits ? (int) ((w >> (bits - count)) & 1) : 0;
+  if (arith) {                                      // top count+1 bits all alike?
+    uint64_t top = count >= bits ? w : w >> (bits - count - 1);
+    uint64_t ones = count >= bits ? simMask(sz) : ((uint64_t) 1 << (count + 1)) - 1;
+    sim->v = top != 0 && top != ones;
+  }
+  return r;
+}
+
+// ============================================================================
+// Does condition 'op' (a Bcc) hold?
+// ============================================================================
+static int simCond(Sim* sim, int op) {
+  int n = sim->n, z = sim->z, v = sim->v, c = sim->c;
+  switch (op) {
+    case ASMBCC: return !c;
+    case ASMBCS: return c;
+    case ASMBEQ: return z;
+    case ASMBGE: return n == v;
+    case ASMBGT: return !z && n == v;
+    case ASMBHI: return !c && !z;
+    case ASMBLE: return z || n != v;
+    case ASMBLS: return c || z;
+    case ASMBLT: return n != v;
+    case ASMBMI: return n;
+    case ASMBNE: return !z;
+    case ASMBPL: return !n;
+    case ASMBVC: return !v;
+    default:     return v;                          // ASMBVS
+  }
+}
+
+// ============================================================================
+// Charge the cycles and instructions since the last switch to the current
+// function, and make 'fun' current
+// ============================================================================
+static void simSwitch(Sim* sim, int fun, uint64_t cycles, uint64_t steps) {
+  sim->funCycles[sim->cur] += cycles - sim->markCycles;
+  sim->funSteps[sim->cur]  += steps  - sim->markSteps;
+  sim->markCycles = cycles;
+  sim->markSteps  = steps;
+  sim->cur = fun;
+}
+
+// ============================================================================
+// Read a line from stdin, for a TRAP #15 input task.  Drop the '\n'.
+// ============================================================================
+static void simInput(char* line) {
+  if (!fgets(line, SIMMAXINPUT, stdin)) line[0] = 0;
+  line[strcspn(line, "\r\n")] = 0;
+}
+
+// ============================================================================
+// Write the 'len' chars in memory at 'addr' to sim->out
+// ============================================================================
+static void simPrint(Sim* sim, uint32_t addr, uint32_t len) {
+  for (uint32_t k = 0; k < len; ++k) putc((int) simLoad(sim, addr + k, 1), sim->out);
+}
+
+// ============================================================================
+// Write the string in memory at 'addr', up to its 0 byte, to sim->out
+// ============================================================================
+static void simPrintz(Sim* sim, uint32_t addr) {
+  for (int ch; (ch = (int) simLoad(sim, addr, 1)) != 0; ++addr) putc(ch, sim->out);
+}
+
+// ============================================================================
+// Carry out Easy68K's TRAP #15 task number D0.B.  Return 1 if the task ends
+// the program.
+// ============================================================================
+static int simTrap(Sim* sim) {
+  uint32_t* d = sim->d;
+  uint32_t* a = sim->a;
+  char line[SIMMAXINPUT];
+
+  switch (d[0] & 0xFF) {
+    case 0:                                         // string (A1), D1.W chars; newline
+      simPrint(sim, a[1], d[1] & 0xFFFF);
+      putc('\n', sim->out);
+      break;
+    case 1:                                         // string (A1), D1.W chars
+      simPrint(sim, a[1], d[1] & 0xFFFF);
+      break;
+    case 2:                                         // read a string to (A1); D1.W = length
+      simInput(line);
+      for (uint32_t k = 0; k <= strlen(line); ++k) simStore(sim, a[1] + k, 1, (uint8_t) line[k]);
+      d[1] = (d[1] & 0xFFFF0000) | (uint32_t) strlen(line);
+      break;
+    case 3:                                         // D1.L as a signed number
+      fprintf(sim->out, "%d", (int32_t) d[1]);
+      break;
+    case 4:                                         // read a number to D1.L
+      simInput(line);
+      d[1] = (uint32_t) strtol(line, NULL, 10);
+      break;
+    case 5:                                         // read a char to D1.B
+      d[1] = (d[1] & 0xFFFFFF00) | (uint8_t) getchar();
+      break;
+    case 6:                                         // char D1.B
+      putc((int) (d[1] & 0xFF), sim->out);
+      break;
+    case 9:                                         // end the program
+      return 1;
+    case 13:                                        // string (A1), to its 0; newline
+      simPrintz(sim, a[1]);
+      putc('\n', sim->out);
+      break;
+    case 14:                                        // string (A1), to its 0
+      simPrintz(sim, a[1]);
+      break;
+    case 15: {                                      // D1.L, unsigned, in base D2.B
+      uint32_t base = d[2] & 0xFF, v = d[1];
+      char digits[40];
+      int  num = 0;
+      if (base < 2 || base > 36) simDie(sim, "Bad base for TRAP #15 task 15:", base);
+      do { digits[num++] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[v % base]; v /= base; } while (v);
+      while (num) putc(digits[--num], sim->out);
+      break;
+    }
+    case 17:                                        // string (A1), to its 0; then D1.L
+      simPrintz(sim, a[1]);
+      fprintf(sim->out, "%d", (int32_t) d[1]);
+      break;
+    default:
+      simDie(sim, "Unsupported TRAP #15 task", d[0] & 0xFF);
+  }
+  return 0;
+}
+
+// ============================================================================
+// Build a Sim to run the program 'as'
+// ============================================================================
+Sim* simNew(Asm* as) {
+  Sim* sim = calloc(1, sizeof(Sim));
+  if (!sim) utDie2Str("simNew", "Out of memory");
+  sim->as        = as;
+  sim->out       = stdout;
+  sim->stackLo   = as->hiAddr;
+  sim->calls     = calloc(as->numFun, sizeof(uint64_t));
+  sim->funSteps  = calloc(as->numFun, sizeof(uint64_t));
+  sim->funCycles = calloc(as->numFun, sizeof(uint64_t));
+  if (!sim->calls || !sim->funSteps || !sim->funCycles) utDie2Str("simNew", "Out of memory");
+  return sim;
+}
+
+#ifdef SIMTHREADED
+#define SIMCASE(op) L##op
+#define SIMNEXT     do { ins = &code[pc++]; cycles += ins->cycles; ++steps; goto *ins->go; } while (0)
+#else
+#define SIMCASE(op) case op
+#define SIMNEXT     continue
+#endif
+
+// ============================================================================
+// Run the program, from its start label, until SIMHALT, TRAP #15 task 9, or
+// a return from main.  Return D0.
+// ============================================================================
+uint32_t simRun(Sim* sim) {
+  Asm*      as   = sim->as;
+  AsmIns*   code = as->code;
+  uint32_t* d    = sim->d;
+  uint32_t* a    = sim->a;
+  AsmIns*   ins  = NULL;
+  uint64_t  cycles = 0, steps = 0;
+  uint32_t  addr = 0, s, v, r;
+  int       pc = as->start, sz;
+
+  a[7] = ASMMEMSIZE;                                // as Easy68K
+  a[7] -= 4;
+  simStore(sim, a[7], 4, code[as->num - 1].addr);   // main returns to ASMEXIT
+  sim->cur = code[pc].fun;
+  sim->calls[sim->cur] = 1;
+
+#ifdef SIMTHREADED
+  static void* go[ASMNUMOP] = {                     // in ASMOP order
+    &&LASMNOP,
+    &&LASMADD,  &&LASMADDA,  &&LASMADDI, &&LASMADDQ, &&LASMASL,   &&LASMBCC,
+    &&LASMBCS,  &&LASMBEQ,   &&LASMBGE,  &&LASMBGT,  &&LASMBHI,   &&LASMBLE,
+    &&LASMBLS,  &&LASMBLT,   &&LASMBMI,  &&LASMBNE,  &&LASMBPL,   &&LASMBRA,
+    &&LASMBSR,  &&LASMBVC,   &&LASMBVS,  &&LASMCLR,  &&LASMCMP,   &&LASMCMPA,
+    &&LASMCMPI, &&LASMEXT,   &&LASMJMP,  &&LASMJSR,  &&LASMLEA,   &&LASMLINK,
+    &&LASMLSL,  &&LASMMOVE,  &&LASMMOVEA, &&LASMMOVEM, &&LASMMOVEQ, &&LASMMULS,
+    &&LASMNEG,  &&LASMPEA,   &&LASMRTS,  &&LASMSIMHALT, &&LASMSUB, &&LASMSUBA,
+    &&LASMSUBI, &&LASMSUBQ,  &&LASMTRAP, &&LASMTST,  &&LASMUNLK,
+    &&LASMEXIT,
+  };
+  for (int i = 0; i < as->num; ++i) code[i].go = go[code[i].op];
+  SIMNEXT;
+#else
+  for (;;) {
+    ins = &code[pc++];
+    cycles += ins->cycles;
+    ++steps;
+    switch (ins->op) {
+#endif
+
+  SIMCASE(ASMNOP):
+    SIMNEXT;
+
+  SIMCASE(ASMMOVE):
+    sz = ins->sz;
+    v = simRead(sim, &ins->src, sz);
+    simWrite(sim, &ins->dst, sz, v);
+    simFlags(sim, v, sz);
+    SIMNEXT;
+
+  SIMCASE(ASMMOVEA):
+    a[ins->dst.reg] = simSext(simRead(sim, &ins->src, ins->sz), ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMMOVEQ):
+    d[ins->dst.reg] = (uint32_t) ins->src.val;
+    simFlags(sim, d[ins->dst.reg], 4);
+    SIMNEXT;
+
+  SIMCASE(ASMMOVEM): {
+    sz = ins->sz;
+    AsmOpnd* mem = ins->src.kind == ASMOPREGS ? &ins->dst : &ins->src;
+    int mask = ins->src.kind == ASMOPREGS ? ins->src.val : ins->dst.val;
+    if (ins->src.kind == ASMOPREGS && mem->kind == ASMOPPREDEC) {
+      for (int k = 15; k >= 0; --k) {               // A7 first, down to D0
+        if (!(mask & (1 << k))) continue;
+        a[mem->reg] -= sz;
+        if (mem->reg == 7) simCheckStack(sim);
+        simStore(sim, a[mem->reg], sz, k < 8 ? d[k] : a[k - 8]);
+      }
+    } else if (ins->src.kind == ASMOPREGS) {
+      addr = simAddr(sim, mem, sz);
+      for (int k = 0; k < 16; ++k) {
+        if (!(mask & (1 << k))) continue;
+        simStore(sim, addr, sz, k < 8 ? d[k] : a[k - 8]);
+        addr += sz;
+      }
+    } else {
+      addr = mem->kind == ASMOPPOSTINC ? a[mem->reg] : simAddr(sim, mem, sz);
+      for (int k = 0; k < 16; ++k) {                // D0 first, up to A7
+        if (!(mask & (1 << k))) continue;
+        v = simSext(simLoad(sim, addr, sz), sz);
+        if (k < 8) d[k] = v; else a[k - 8] = v;
+        addr += sz;
+      }
+      if (mem->kind == ASMOPPOSTINC) a[mem->reg] = addr;
+    }
+    SIMNEXT;
+  }
+
+  SIMCASE(ASMLEA):
+    a[ins->dst.reg] = simAddr(sim, &ins->src, 4);
+    SIMNEXT;
+
+  SIMCASE(ASMPEA):
+    v = simAddr(sim, &ins->src, 4);
+    a[7] -= 4;
+    simCheckStack(sim);
+    simStore(sim, a[7], 4, v);
+    SIMNEXT;
+
+  SIMCASE(ASMADD):
+    sz = ins->sz;
+    s = simRead(sim, &ins->src, sz);
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simAdd(sim, v, s, sz));
+    SIMNEXT;
+
+  SIMCASE(ASMADDI):
+  SIMCASE(ASMADDQ):
+    sz = ins->sz;
+    if (ins->dst.kind == ASMOPAREG) {               // ADDQ to An: all 32 bits, no flags
+      a[ins->dst.reg] += (uint32_t) ins->src.val;
+      SIMNEXT;
+    }
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simAdd(sim, v, (uint32_t) ins->src.val, sz));
+    SIMNEXT;
+
+  SIMCASE(ASMADDA):
+    a[ins->dst.reg] += simSext(simRead(sim, &ins->src, ins->sz), ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMSUB):
+    sz = ins->sz;
+    s = simRead(sim, &ins->src, sz);
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simSub(sim, v, s, sz, 0));
+    SIMNEXT;
+
+  SIMCASE(ASMSUBI):
+  SIMCASE(ASMSUBQ):
+    sz = ins->sz;
+    if (ins->dst.kind == ASMOPAREG) {               // SUBQ from An: all 32 bits, no flags
+      a[ins->dst.reg] -= (uint32_t) ins->src.val;
+      SIMNEXT;
+    }
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simSub(sim, v, (uint32_t) ins->src.val, sz, 0));
+    SIMNEXT;
+
+  SIMCASE(ASMSUBA):
+    a[ins->dst.reg] -= simSext(simRead(sim, &ins->src, ins->sz), ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMCMP):
+  SIMCASE(ASMCMPI):
+    sz = ins->sz;
+    s = simRead(sim, &ins->src, sz);
+    simSub(sim, simRead(sim, &ins->dst, sz), s, sz, 1);
+    SIMNEXT;
+
+  SIMCASE(ASMCMPA):
+    s = simSext(simRead(sim, &ins->src, ins->sz), ins->sz);
+    simSub(sim, a[ins->dst.reg], s, 4, 1);
+    SIMNEXT;
+
+  SIMCASE(ASMTST):
+    simFlags(sim, simRead(sim, &ins->src, ins->sz), ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMCLR):
+    simWrite(sim, &ins->dst, ins->sz, 0);
+    simFlags(sim, 0, ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMNEG):
+    sz = ins->sz;
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simSub(sim, 0, v, sz, 0));
+    SIMNEXT;
+
+  SIMCASE(ASMEXT):
+    r = d[ins->dst.reg];
+    if (ins->sz == 2) {                             // byte => word
+      d[ins->dst.reg] = (r & 0xFFFF0000) | (simSext(r, 1) & 0xFFFF);
+    } else {                                        // word => long
+      d[ins->dst.reg] = simSext(r, 2);
+    }
+    simFlags(sim, d[ins->dst.reg], ins->sz);
+    SIMNEXT;
+
+  SIMCASE(ASMASL):
+  SIMCASE(ASMLSL): {
+    int arith = ins->op == ASMASL;
+    if (ins->src.kind == ASMOPNONE) {               // memory word, by 1
+      v = simGet(sim, &ins->dst, 2, &addr);
+      simPut(sim, &ins->dst, 2, addr, simShift(sim, v, 1, 2, arith));
+      SIMNEXT;
+    }
+    int count = ins->src.val;
+    if (ins->src.kind == ASMOPDREG) {               // count in Dn: + 2 cycles per bit
+      count = d[ins->src.reg] & 63;
+      cycles += 2 * count;
+    }
+    sz = ins->sz;
+    v = simGet(sim, &ins->dst, sz, &addr);
+    simPut(sim, &ins->dst, sz, addr, simShift(sim, v, count, sz, arith));
+    SIMNEXT;
+  }
+
+  SIMCASE(ASMMULS):
+    s = simRead(sim, &ins->src, 2);
+    cycles += asmMulsExtra(s);
+    r = (uint32_t) ((int32_t) (int16_t) s * (int32_t) (int16_t) d[ins->dst.reg]);
+    d[ins->dst.reg] = r;
+    simFlags(sim, r, 4);
+    SIMNEXT;
+
+  SIMCASE(ASMBCC): SIMCASE(ASMBCS): SIMCASE(ASMBEQ): SIMCASE(ASMBGE):
+  SIMCASE(ASMBGT): SIMCASE(ASMBHI): SIMCASE(ASMBLE): SIMCASE(ASMBLS):
+  SIMCASE(ASMBLT): SIMCASE(ASMBMI): SIMCASE(ASMBNE): SIMCASE(ASMBPL):
+  SIMCASE(ASMBVC): SIMCASE(ASMBVS):
+    if (simCond(sim, ins->op)) {
+      pc = ins->target;
+      cycles += ins->taken - ins->cycles;
+    }
+    SIMNEXT;
+
+  SIMCASE(ASMBRA):
+    pc = ins->target;
+    SIMNEXT;
+
+  SIMCASE(ASMBSR):
+  SIMCASE(ASMJSR):
+    a[7] -= 4;
+    simCheckStack(sim);
+    simStore(sim, a[7], 4, code[pc].addr);          // return address
+    pc = ins->target;
+    simSwitch(sim, code[pc].fun, cycles, steps);
+    ++sim->calls[sim->cur];
+    SIMNEXT;
+
+  SIMCASE(ASMJMP):
+    pc = ins->target;
+    if (code[pc].fun != sim->cur) {                 // a tail call
+      simSwitch(sim, code[pc].fun, cycles, steps);
+      ++sim->calls[sim->cur];
+    }
+    SIMNEXT;
+
+  SIMCASE(ASMRTS):
+    v = simLoad(sim, a[7], 4);
+    a[7] += 4;
+    pc = asmAt(as, v & (ASMMEMSIZE - 1));
+    if (pc < 0) simDie(sim, "RTS to an address that holds no instruction:", v);
+    simSwitch(sim, code[pc].fun, cycles, steps);
+    SIMNEXT;
+
+  SIMCASE(ASMLINK):
+    a[7] -= 4;
+    simCheckStack(sim);
+    simStore(sim, a[7], 4, a[ins->src.reg]);
+    a[ins->src.reg] = a[7];
+    a[7] += (uint32_t) ins->dst.val;
+    simCheckStack(sim);
+    SIMNEXT;
+
+  SIMCASE(ASMUNLK):
+    a[7] = a[ins->src.reg];
+    a[ins->src.reg] = simLoad(sim, a[7], 4);
+    a[7] += 4;
+    SIMNEXT;
+
+  SIMCASE(ASMTRAP):
+    if (ins->src.val != 15) simDie(sim, "Unsupported TRAP", (uint32_t) ins->src.val);
+    if (simTrap(sim)) goto done;
+    SIMNEXT;
+
+  SIMCASE(ASMSIMHALT):
+  SIMCASE(ASMEXIT):
+    goto done;
+
+#ifndef SIMTHREADED
+    default:
+      simDie(sim, "Unknown opcode", ins->op);
+    }
+  }
+#endif
+
+done:
+  simSwitch(sim, sim->cur, cycles, steps);
+  sim->cycles = cycles;
+  sim->steps  = steps;
+  fflush(sim->out);
+  return d[0];
+}
+
+// ============================================================================
+// Print the instructions executed and cycles taken, in total and by function
+// ============================================================================
+void simReport(Sim* sim) {
+  Asm* as = sim->as;
+  printf("\n");
+  for (int f = 0; f < as->numFun; ++f) {
+    if (sim->funSteps[f] == 0) continue;
+    char* name = as->fun[f].name ? internStr(as->fun[f].name) : "-";
+    printf("Sim: %s %llu calls, %llu instructions, %llu cycles \n", name,
+      (unsigned long long) sim->calls[f], (unsigned long long) sim->funSteps[f],
+      (unsigned long long) sim->funCycles[f]);
+  }
+  printf("Sim: total %llu instructions, %llu cycles, D0 = %d \n",
+    (unsigned long long) sim->steps, (unsigned long long) sim->cycles, (int32_t) sim->d[0]);
+}
+
+// ============================================================================
+// Free 'sim'.  The Asm it ran is left to the caller.
+// ============================================================================
+void simFree(Sim* sim) {
+  free(sim->calls);
+  free(sim->funSteps);
+  free(sim->funCycles);
+  free(sim);
+}
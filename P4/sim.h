@@ -0,0 +1,65 @@
+// sim.h - Simulate 68000 code, counting cycles
+
+#pragma once
+
+#include <stdint.h>         // uint32_t, uint64_t
+#include <stdio.h>          // FILE, fgets, fprintf, putc
+#include <stdlib.h>         // calloc, free, strtol
+#include <string.h>         // strcspn, strlen
+
+#include "asm.h"            // Asm, AsmIns, asmAt
+#include "intern.h"         // internStr
+#include "ut.h"             // ut*
+
+// simRun executes a program assembled by asmFile, from its END label (main)
+// until it reaches SIMHALT, or main returns.  It needs no Easy68K: the
+// TRAP #15 tasks that io.X68 and Easy68K programs use - 0, 1, 2, 3, 4, 5, 6,
+// 9, 13, 14, 15 and 17 - are carried out on stdin and 'out' (stdout, unless
+// the caller sets it).
+//
+// Each instruction adds its cost, in 68000 clock cycles, to the total: the
+// fixed part was found by asmFile, and simRun adds the parts that depend on
+// data.  A TRAP #15 costs 34 cycles, for the trap itself; the time the task
+// would take on a real machine (eg: printing) is not counted.
+//
+// The stack starts at the top of memory, as in Easy68K, and grows down.  If a
+// push, BSR or LINK takes A7 below the end of the program, simRun stops with
+// "Stack overflow".
+//
+// The cycles and instructions are charged to the function that executes
+// them: the one whose label most closely precedes the instruction.  A BSR,
+// JSR, or JMP into a different function (a tail call) counts as a call.
+// simReport prints the totals, function by function.
+//
+// Instructions were decoded by asmFile into code[], so dispatch is cheap.
+// Compiled with GCC or Clang, simRun uses threaded code: each instruction
+// holds the address of its handler, and each handler ends with its own jump
+// to the next.  Elsewhere, it falls back to a switch.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMTHREADED 1
+#endif
+
+#define SIMMAXINPUT 256     // longest line read by TRAP #15 tasks 2 and 4
+
+typedef struct {
+  Asm*      as;             // the program
+  FILE*     out;            // where TRAP #15 writes (simNew: stdout)
+  uint32_t  d[8];           // D0-D7
+  uint32_t  a[8];           // A0-A7
+  uint32_t  stackLo;        // A7 may not drop below: the end of the program
+  int       x, n, z, v, c;  // condition codes
+  uint64_t  steps;          // instructions executed
+  uint64_t  cycles;         // clock cycles taken
+  int       cur;            // function executing, as an index in as->fun
+  uint64_t  markSteps;      // 'steps' when 'cur' was entered
+  uint64_t  markCycles;     // 'cycles' when 'cur' was entered
+  uint64_t* calls;          // per function: times called
+  uint64_t* funSteps;       // per function: instructions executed
+  uint64_t* funCycles;      // per function: cycles taken
+} Sim;
+
+void     simFree(Sim* sim);
+Sim*     simNew(Asm* as);
+void     simReport(Sim* sim);
+uint32_t simRun(Sim* sim);
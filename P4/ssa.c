@@ -0,0 +1,798 @@
+// ssa.c - Mid-level IR in SSA form
+
+#include "ssa.h"
+
+static int ssaExp(SsaFun* fun, int exp);
+static void ssaStms(SsaFun* fun, int first, int end);
+
+static char* ssaOpNames[SSANUMOP] = {
+  "nop", "const", "par", "undef", "str", "copy", "bin", "phi", "call",
+  "get", "set",
+};
+
+// ============================================================================
+// Make room in the int array 'arr', allocated from 'arena', for one more
+// entry beyond its 'num' entries in use.  Return the (maybe moved) array.
+// ============================================================================
+static int* ssaGrow(Arena* arena, int* arr, int num, int* cap) {
+  if (num < *cap) return arr;
+  int newcap = *cap ? 2 * *cap : SSAMINCAP;
+  int* bigger = arenaAlloc(arena, newcap * sizeof(int));
+  if (num) memcpy(bigger, arr, num * sizeof(int));
+  *cap = newcap;
+  return bigger;
+}
+
+// ============================================================================
+// Append a new, empty block, within 'depth' Whiles.  Return its number.
+// ============================================================================
+int ssaAddBlock(SsaFun* fun, int depth) {
+  if (fun->numBlk == fun->capBlk) {
+    fun->capBlk = fun->capBlk ? 2 * fun->capBlk : SSAMINCAP;
+    fun->blk = realloc(fun->blk, fun->capBlk * sizeof(SsaBlock));
+    if (!fun->blk) utDie2Str("ssaAddBlock", "Out of memory for blocks");
+  }
+  SsaBlock* blk = &fun->blk[fun->numBlk];
+  memset(blk, 0, sizeof(SsaBlock));
+  blk->depth  = depth;
+  blk->rpo    = -1;
+  blk->idom   = -1;
+  blk->domKid = -1;
+  blk->domSib = -1;
+  return fun->numBlk++;
+}
+
+// ============================================================================
+// Add a CFG edge from block 'from' to block 'to'
+// ============================================================================
+void ssaAddEdge(SsaFun* fun, int from, int to) {
+  SsaBlock* f = &fun->blk[from];
+  assert(f->numSucc < 2);
+  f->succ[f->numSucc++] = to;
+
+  SsaBlock* t = &fun->blk[to];
+  t->pred = ssaGrow(fun->arena, t->pred, t->numPred, &t->capPred);
+  t->pred[t->numPred++] = from;
+}
+
+// ============================================================================
+// Make a new instruction, with room for 'numArg' arguments, that belongs to
+// no block yet.  Return its value number.
+// ============================================================================
+int ssaNewIns(SsaFun* fun, SSAOP op, int val, int numArg) {
+  if (fun->numIns == fun->capIns) {
+    fun->capIns = fun->capIns ? 2 * fun->capIns : SSAMINCAP;
+    fun->ins = realloc(fun->ins, fun->capIns * sizeof(SsaIns));
+    if (!fun->ins) utDie2Str("ssaNewIns", "Out of memory for instructions");
+  }
+  SsaIns* ins = &fun->ins[fun->numIns];
+  ins->op     = op;
+  ins->bop    = 0;
+  ins->blk    = -1;
+  ins->val    = val;
+  ins->numArg = numArg;
+  ins->arg    = numArg ? arenaAlloc(fun->arena, numArg * sizeof(int)) : NULL;
+  return fun->numIns++;
+}
+
+// ============================================================================
+// Append a new instruction onto the end of block 'blk'.  Return its value
+// number.
+// ============================================================================
+int ssaAddIns(SsaFun* fun, int blk, SSAOP op, int val, int numArg) {
+  int v = ssaNewIns(fun, op, val, numArg);
+  SsaBlock* b = &fun->blk[blk];
+  b->ins = ssaGrow(fun->arena, b->ins, b->numIns, &b->capIns);
+  b->ins[b->numIns++] = v;
+  fun->ins[v].blk = blk;
+  return v;
+}
+
+// ============================================================================
+// The var slot of the par or var whose intern ID is 'id'
+// ============================================================================
+static int ssaSlot(SsaFun* fun, int id) {
+  LaySym* sym = layFindVarPar(fun->lay, fun->funid, id);
+  return (int) (sym - fun->scope->sym);
+}
+
+// ============================================================================
+// Append "slot = v" onto the current block
+// ============================================================================
+static void ssaSet(SsaFun* fun, int slot, int v) {
+  int i = ssaAddIns(fun, fun->cur, SSASET, slot, 1);
+  fun->ins[i].arg[0] = v;
+}
+
+// ============================================================================
+// Nam | Num | Str.  Return the value number of the leaf at node 'n'.
+// ============================================================================
+static int ssaLeaf(SsaFun* fun, int n) {
+  FlatNode* node = &fun->flat->node[n];
+  switch (node->tag) {
+    case ASTNAM: return ssaAddIns(fun, fun->cur, SSAGET, ssaSlot(fun, node->val), 0);
+    case ASTNUM: return ssaAddIns(fun, fun->cur, SSACONST, node->val, 0);
+    case ASTSTR: return ssaAddIns(fun, fun->cur, SSASTR, node->val, 0);
+    default:
+      utDie2StrInt("ssaLeaf", "Invalid leaf at node", n);
+      return 0;
+  }
+}
+
+// ============================================================================
+// Call => Nam "(" Args ")".  Return the value number of its result.
+// ============================================================================
+static int ssaCall(SsaFun* fun, int call) {
+  FlatNode* node = fun->flat->node;                         // alias
+  int numarg = node[call].end - call - 1;
+
+  int args[numarg + 1];
+  for (int k = 0; k < numarg; ++k) args[k] = ssaLeaf(fun, call + 1 + k);
+
+  int v = ssaAddIns(fun, fun->cur, SSACALL, node[call].val, numarg);
+  for (int k = 0; k < numarg; ++k) fun->ins[v].arg[k] = args[k];
+  return v;
+}
+
+// ============================================================================
+// Exp => NamNum | NamNum Bop NamNum.  Return the value number of its result.
+// ============================================================================
+static int ssaExp(SsaFun* fun, int exp) {
+  FlatNode* node = fun->flat->node;                         // alias
+  int end = node[exp].end;
+
+  int lhs = exp + 1;
+  if (lhs == end) return ssaAddIns(fun, fun->cur, SSAUNDEF, 0, 0);
+  int rhs = node[lhs].end;
+  if (rhs == end) return ssaLeaf(fun, lhs);
+
+  int a = ssaLeaf(fun, lhs);
+  int b = ssaLeaf(fun, rhs);
+  int v = ssaAddIns(fun, fun->cur, SSABIN, 0, 2);
+  fun->ins[v].bop    = node[exp].bop;
+  fun->ins[v].arg[0] = a;
+  fun->ins[v].arg[1] = b;
+  return v;
+}
+
+// ============================================================================
+// End the current block with a jump to block 'to'
+// ============================================================================
+static void ssaJump(SsaFun* fun, int to) {
+  fun->blk[fun->cur].term = SSAJMP;
+  ssaAddEdge(fun, fun->cur, to);
+}
+
+// ============================================================================
+// End the current block with a branch on the condition 'exp' of an If or
+// While: to block 't' if TRUE, else to block 'f'.  A comparison, such as
+// "a < b", becomes the branch itself; any other Exp is compared against 0.
+// ============================================================================
+static void ssaBranch(SsaFun* fun, int exp, int t, int f) {
+  FlatNode* node = fun->flat->node;                         // alias
+  int lhs = exp + 1;
+  int rhs = lhs < (int) node[exp].end ? (int) node[lhs].end : lhs;
+  BOP bop = node[exp].bop;
+  int a, b;
+
+  if (bop >= BOPLT && bop <= BOPGT && rhs < (int) node[exp].end) {
+    a = ssaLeaf(fun, lhs);
+    b = ssaLeaf(fun, rhs);
+  } else {
+    a   = ssaExp(fun, exp);
+    b   = ssaAddIns(fun, fun->cur, SSACONST, 0, 0);
+    bop = BOPNE;
+  }
+
+  SsaBlock* blk = &fun->blk[fun->cur];
+  blk->term = SSABR;
+  blk->bop  = bop;
+  blk->a    = a;
+  blk->b    = b;
+  ssaAddEdge(fun, fun->cur, t);
+  ssaAddEdge(fun, fun->cur, f);
+}
+
+// ============================================================================
+// Stm => If | Asg | Ret | While
+// ============================================================================
+static void ssaStm(SsaFun* fun, int n) {
+  FlatNode* node = fun->flat->node;                         // alias
+  int exp = n + 1;
+
+  switch (node[n].tag) {
+    case ASTASG: {
+      int v = node[exp].tag == ASTCALL ? ssaCall(fun, exp) : ssaExp(fun, exp);
+      ssaSet(fun, ssaSlot(fun, node[n].val), v);
+      break;
+    }
+    case ASTIF: {
+      int then = ssaAddBlock(fun, fun->depth);
+      int join = ssaAddBlock(fun, fun->depth);
+      ssaBranch(fun, exp, then, join);
+      fun->cur = then;
+      ssaStms(fun, node[exp].end, node[n].end);
+      ssaJump(fun, join);
+      fun->cur = join;
+      break;
+    }
+    case ASTWHILE: {
+      int head = ssaAddBlock(fun, fun->depth + 1);
+      int body = ssaAddBlock(fun, fun->depth + 1);
+      int exit = ssaAddBlock(fun, fun->depth);
+      ssaJump(fun, head);
+      fun->cur = head;
+      ssaBranch(fun, exp, body, exit);
+      fun->cur = body;
+      ++fun->depth;
+      ssaStms(fun, node[exp].end, node[n].end);
+      --fun->depth;
+      ssaJump(fun, head);
+      fun->cur = exit;
+      break;
+    }
+    case ASTRET: {
+      int v = ssaExp(fun, exp);
+      SsaBlock* blk = &fun->blk[fun->cur];
+      blk->term = SSARET;
+      blk->a    = v;
+      fun->cur  = ssaAddBlock(fun, fun->depth);         // unreachable
+      break;
+    }
+    default:
+      utDie2StrInt("ssaStm", "Invalid statement at node", n);
+  }
+}
+
+// ============================================================================
+// Build the statements in [first, end)
+// ============================================================================
+static void ssaStms(SsaFun* fun, int first, int end) {
+  FlatNode* node = fun->flat->node;                         // alias
+  for (int n = first; n < end; n = node[n].end) ssaStm(fun, n);
+}
+
+// ============================================================================
+// Remove block 'b', which the entry cannot reach: delete its instructions,
+// and its edges to its successors
+// ============================================================================
+static void ssaUnlink(SsaFun* fun, int b) {
+  SsaBlock* blk = &fun->blk[b];
+  for (int i = 0; i < blk->numIns; ++i) fun->ins[blk->ins[i]].op = SSANOP;
+  blk->numIns  = 0;
+  blk->numPred = 0;
+  blk->numSucc = 0;
+  blk->term    = SSANONE;
+}
+
+// ============================================================================
+// Walk up the dominator tree from 'b1' and 'b2' until they meet
+// ============================================================================
+static int ssaIntersect(SsaFun* fun, int* dom, int b1, int b2) {
+  while (b1 != b2) {
+    while (fun->blk[b1].rpo > fun->blk[b2].rpo) b1 = dom[b1];
+    while (fun->blk[b2].rpo > fun->blk[b1].rpo) b2 = dom[b2];
+  }
+  return b1;
+}
+
+// ============================================================================
+// Find the blocks reachable from the entry, in reverse postorder, and remove
+// the rest.  Then find the immediate dominator of each block (Cooper, Harvey
+// & Kennedy, "A Simple, Fast Dominance Algorithm"), and number the dominator
+// tree, so that ssaDominates is a pair of compares.
+//
+// The depth-first walk visits succ[1] before succ[0], so that succ[0] - the
+// Block of an If, or the body of a While - tends to follow its branch in
+// reverse postorder.  low.c lays out code in this order.
+// ============================================================================
+void ssaDomTree(SsaFun* fun) {
+  int  nb    = fun->numBlk;
+  int* post  = malloc(nb * sizeof(int));
+  int* stack = malloc(nb * sizeof(int));
+  int* next  = calloc(nb, sizeof(int));         // next succ to visit, plus 1
+  int* dom   = malloc(nb * sizeof(int));
+  if (!post || !stack || !next || !dom) {
+    utDie2Str("ssaDomTree", "Out of memory for dominators");
+  }
+
+  for (int b = 0; b < nb; ++b) {
+    fun->blk[b].rpo    = -1;
+    fun->blk[b].idom   = -1;
+    fun->blk[b].domKid = -1;
+    fun->blk[b].domSib = -1;
+  }
+
+  // Depth-first walk from the entry, for postorder
+
+  int numPost = 0, sp = 0;
+  stack[sp++] = 0;
+  fun->blk[0].rpo = 0;                          // visited
+  next[0] = fun->blk[0].numSucc;
+  while (sp) {
+    int b = stack[sp - 1];
+    if (next[b] == 0) { post[numPost++] = b; --sp; continue; }
+    int s = fun->blk[b].succ[--next[b]];
+    if (fun->blk[s].rpo >= 0) continue;
+    fun->blk[s].rpo = 0;
+    next[s] = fun->blk[s].numSucc;
+    stack[sp++] = s;
+  }
+
+  fun->rpo    = realloc(fun->rpo, (nb ? nb : 1) * sizeof(int));
+  fun->numRpo = numPost;
+  if (!fun->rpo) utDie2Str("ssaDomTree", "Out of memory for block order");
+  for (int k = 0; k < numPost; ++k) {
+    int b = post[numPost - 1 - k];
+    fun->rpo[k] = b;
+    fun->blk[b].rpo = k;
+  }
+
+  // Remove unreachable blocks, and the edges from them
+
+  for (int b = 0; b < nb; ++b) {
+    if (fun->blk[b].rpo < 0 && b != 0) { ssaUnlink(fun, b); continue; }
+  }
+  for (int b = 0; b < nb; ++b) {
+    SsaBlock* blk = &fun->blk[b];
+    int n = 0;
+    for (int p = 0; p < blk->numPred; ++p) {
+      if (fun->blk[blk->pred[p]].rpo >= 0) blk->pred[n++] = blk->pred[p];
+    }
+    blk->numPred = n;
+  }
+
+  // Immediate dominators, to a fixed point.  dom[0] is 0 while iterating.
+
+  for (int b = 0; b < nb; ++b) dom[b] = -1;
+  dom[0] = 0;
+  for (int changed = 1; changed; ) {
+    changed = 0;
+    for (int k = 1; k < numPost; ++k) {
+      int b = fun->rpo[k];
+      SsaBlock* blk = &fun->blk[b];
+      int idom = -1;
+      for (int p = 0; p < blk->numPred; ++p) {
+        int pred = blk->pred[p];
+        if (dom[pred] < 0) continue;
+        idom = idom < 0 ? pred : ssaIntersect(fun, dom, pred, idom);
+      }
+      if (dom[b] != idom) { dom[b] = idom; changed = 1; }
+    }
+  }
+
+  // Dominator tree: children in reverse postorder
+
+  for (int k = numPost - 1; k >= 1; --k) {
+    int b = fun->rpo[k];
+    int up = dom[b];
+    fun->blk[b].idom   = up;
+    fun->blk[b].domSib = fun->blk[up].domKid;
+    fun->blk[up].domKid = b;
+  }
+
+  // Preorder numbers: b dominates c iff pre(b) <= pre(c) <= post(b)
+
+  int num = 0;
+  sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    int b = stack[--sp];
+    if (b < 0) {                                // all of -b-1's subtree done
+      fun->blk[-b - 1].domPost = num - 1;
+      continue;
+    }
+    fun->blk[b].domPre = num++;
+    stack[sp++] = -b - 1;
+    for (int c = fun->blk[b].domKid; c >= 0; c = fun->blk[c].domSib) {
+      stack[sp++] = c;
+    }
+  }
+
+  free(post); free(stack); free(next); free(dom);
+}
+
+// ============================================================================
+// Does block 'a' dominate block 'b'?  Both must be reachable.
+// ============================================================================
+int ssaDominates(SsaFun* fun, int a, int b) {
+  SsaBlock* x = &fun->blk[a];
+  SsaBlock* y = &fun->blk[b];
+  return x->domPre <= y->domPre && y->domPre <= x->domPost;
+}
+
+// ============================================================================
+// Place phi instructions (Cytron et al).  A var assigned in block b needs a
+// phi in each block of the dominance frontier of b - where b's dominance
+// ends - and, since that phi is itself an assignment, in the frontier of
+// that block too.
+// ============================================================================
+static void ssaPlacePhis(SsaFun* fun) {
+  int nb = fun->numBlk;
+  int nv = fun->numVar;
+
+  // Dominance frontiers.  stamp[r] == b => b is in DF(r) already.
+
+  int** df    = calloc(nb, sizeof(int*));
+  int*  numDf = calloc(nb, sizeof(int));
+  int*  capDf = calloc(nb, sizeof(int));
+  int*  stamp = malloc(nb * sizeof(int));
+  if (!df || !numDf || !capDf || !stamp) {
+    utDie2Str("ssaPlacePhis", "Out of memory for dominance frontiers");
+  }
+  for (int b = 0; b < nb; ++b) stamp[b] = -1;
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    if (blk->numPred < 2) continue;
+    for (int p = 0; p < blk->numPred; ++p) {
+      for (int r = blk->pred[p]; r != blk->idom; r = fun->blk[r].idom) {
+        if (stamp[r] == b) break;
+        stamp[r] = b;
+        df[r] = ssaGrow(fun->arena, df[r], numDf[r], &capDf[r]);
+        df[r][numDf[r]++] = b;
+      }
+    }
+  }
+
+  // The blocks that assign each var slot, bucketed by slot
+
+  int* start = calloc(nv + 1, sizeof(int));
+  if (!start) utDie2Str("ssaPlacePhis", "Out of memory for def sites");
+  for (int k = 0; k < fun->numRpo; ++k) {
+    SsaBlock* blk = &fun->blk[fun->rpo[k]];
+    for (int i = 0; i < blk->numIns; ++i) {
+      SsaIns* ins = &fun->ins[blk->ins[i]];
+      if (ins->op == SSASET) ++start[ins->val + 1];
+    }
+  }
+  for (int s = 0; s < nv; ++s) start[s + 1] += start[s];
+  int* site = malloc((start[nv] + 1) * sizeof(int));
+  int* fill = malloc((nv + 1) * sizeof(int));
+  int* work = malloc((start[nv] + nb + 1) * sizeof(int));
+  int* inWork = malloc(nb * sizeof(int));
+  int* hasPhi = malloc(nb * sizeof(int));
+  if (!site || !fill || !work || !inWork || !hasPhi) {
+    utDie2Str("ssaPlacePhis", "Out of memory for def sites");
+  }
+  memcpy(fill, start, (nv + 1) * sizeof(int));
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    for (int i = 0; i < blk->numIns; ++i) {
+      SsaIns* ins = &fun->ins[blk->ins[i]];
+      if (ins->op == SSASET) site[fill[ins->val]++] = b;
+    }
+  }
+  for (int b = 0; b < nb; ++b) inWork[b] = hasPhi[b] = -1;
+
+  // Worklist, per slot, over the iterated dominance frontier
+
+  for (int s = 0; s < nv; ++s) {
+    int num = 0;
+    for (int k = start[s]; k < start[s + 1]; ++k) {
+      if (inWork[site[k]] == s) continue;
+      inWork[site[k]] = s;
+      work[num++] = site[k];
+    }
+    while (num) {
+      int b = work[--num];
+      for (int k = 0; k < numDf[b]; ++k) {
+        int d = df[b][k];
+        if (hasPhi[d] == s) continue;
+        hasPhi[d] = s;
+
+        SsaBlock* blk = &fun->blk[d];
+        int phi = ssaNewIns(fun, SSAPHI, s, blk->numPred);
+        fun->ins[phi].blk = d;
+        blk->ins = ssaGrow(fun->arena, blk->ins, blk->numIns, &blk->capIns);
+        memmove(&blk->ins[1], &blk->ins[0], blk->numIns * sizeof(int));
+        blk->ins[0] = phi;
+        ++blk->numIns;
+
+        if (inWork[d] != s) { inWork[d] = s; work[num++] = d; }
+      }
+    }
+  }
+
+  free(df); free(numDf); free(capDf); free(stamp);
+  free(start); free(site); free(fill); free(work); free(inWork); free(hasPhi);
+}
+
+// ============================================================================
+// Rename: walk the dominator tree, keeping, for each var slot, a stack of the
+// values assigned to it along the path from the entry.  An SSAGET reads the
+// top of its slot's stack.  An SSASET or phi pushes a new value, popped again
+// when the walk leaves the block that holds it.  Each phi in a successor
+// takes, as the argument for this edge, the top of its slot's stack.
+// ============================================================================
+static void ssaRename(SsaFun* fun) {
+  int nb = fun->numBlk;
+  int nv = fun->numVar;
+
+  int* repl  = calloc(fun->numIns, sizeof(int));    // GET => the value it reads
+  int* top   = malloc((nv ? nv : 1) * sizeof(int)); // slot => top entry
+  int* val   = malloc(fun->numIns * sizeof(int));   // entry => value
+  int* slot  = malloc(fun->numIns * sizeof(int));   // entry => its slot
+  int* prev  = malloc(fun->numIns * sizeof(int));   // entry => entry beneath
+  int* mark  = malloc(nb * sizeof(int));            // block => entries on entry
+  int* stack = malloc(2 * nb * sizeof(int));
+  if (!repl || !top || !val || !slot || !prev || !mark || !stack) {
+    utDie2Str("ssaRename", "Out of memory for renaming");
+  }
+  for (int s = 0; s < nv; ++s) top[s] = -1;
+
+  int num = 0, sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    int b = stack[--sp];
+    if (b < 0) {                                // leave block -b-1: pop
+      for (; num > mark[-b - 1]; --num) top[slot[num - 1]] = prev[num - 1];
+      continue;
+    }
+
+    mark[b] = num;
+    SsaBlock* blk = &fun->blk[b];
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      SsaIns* ins = &fun->ins[v];
+      if (ins->op == SSAGET) {
+        if (top[ins->val] < 0) utDie2Str("ssaRename", "Var read before any write");
+        repl[v] = val[top[ins->val]];
+      } else if (ins->op == SSASET || ins->op == SSAPHI) {
+        int w = v;
+        if (ins->op == SSASET) {
+          w = ins->arg[0];
+          if (fun->ins[w].op == SSAGET) w = repl[w];
+        }
+        val[num]  = w;
+        slot[num] = ins->val;
+        prev[num] = top[ins->val];
+        top[ins->val] = num++;
+      }
+    }
+
+    for (int k = 0; k < blk->numSucc; ++k) {
+      int s = blk->succ[k];
+      int j = ssaPredIndex(fun, s, b);
+      SsaBlock* succ = &fun->blk[s];
+      for (int i = 0; i < succ->numIns; ++i) {
+        SsaIns* phi = &fun->ins[succ->ins[i]];
+        if (phi->op != SSAPHI) break;
+        phi->arg[j] = val[top[phi->val]];
+      }
+    }
+
+    stack[sp++] = -b - 1;
+    for (int c = blk->domKid; c >= 0; c = fun->blk[c].domSib) stack[sp++] = c;
+  }
+
+  // Replace each use of a GET by the value it read; then delete GETs and SETs
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    SsaBlock* blk = &fun->blk[fun->rpo[k]];
+    for (int i = 0; i < blk->numIns; ++i) {
+      SsaIns* ins = &fun->ins[blk->ins[i]];
+      for (int a = 0; a < ins->numArg; ++a) {
+        if (fun->ins[ins->arg[a]].op == SSAGET) ins->arg[a] = repl[ins->arg[a]];
+      }
+    }
+    if (fun->ins[blk->a].op == SSAGET) blk->a = repl[blk->a];
+    if (fun->ins[blk->b].op == SSAGET) blk->b = repl[blk->b];
+  }
+  for (int v = 1; v < fun->numIns; ++v) {
+    SsaIns* ins = &fun->ins[v];
+    if (ins->op == SSAGET || ins->op == SSASET) ins->op = SSANOP;
+  }
+
+  free(repl); free(top); free(val); free(slot); free(prev); free(mark);
+  free(stack);
+}
+
+// ============================================================================
+// Build the SSA form of the function at node 'fun' of 'flat'.  layBuild must
+// have run on it already.
+// ============================================================================
+SsaFun* ssaBuild(Lay* lay, Flat* flat, int fn) {
+  FlatNode* node = flat->node;                              // alias
+  SsaFun* fun = calloc(1, sizeof(SsaFun));
+  if (!fun) utDie2Str("ssaBuild", "Out of memory for function");
+
+  fun->arena  = arenaNew(0);
+  fun->flat   = flat;
+  fun->funid  = node[fn].val;
+  fun->lay    = lay;
+  fun->scope  = layFindFun(lay, fun->funid)->scope;
+  fun->numVar = fun->scope->cap;
+  ssaNewIns(fun, SSANOP, 0, 0);                 // value 0 => none
+
+  // The entry block gives each par its incoming value, and each var an
+  // undefined one
+
+  fun->cur = ssaAddBlock(fun, 0);
+  int c = fn + 1;
+  for (int k = 0; node[c].tag == ASTPAR; ++c, ++k) {
+    ssaSet(fun, ssaSlot(fun, node[c].val), ssaAddIns(fun, fun->cur, SSAPAR, k, 0));
+  }
+  if (node[c].tag == ASTVAR) {
+    int undef = ssaAddIns(fun, fun->cur, SSAUNDEF, 0, 0);
+    for (; node[c].tag == ASTVAR; ++c) ssaSet(fun, ssaSlot(fun, node[c].val), undef);
+  }
+
+  ssaStms(fun, c, node[fn].end);
+  if (fun->blk[fun->cur].term == SSANONE) {     // falls off the end
+    int undef = ssaAddIns(fun, fun->cur, SSAUNDEF, 0, 0);
+    fun->blk[fun->cur].term = SSARET;
+    fun->blk[fun->cur].a    = undef;
+  }
+
+  ssaDomTree(fun);
+  ssaPlacePhis(fun);
+  ssaRename(fun);
+  ssaCompact(fun);
+  ssaVerify(fun, "ssaBuild");
+
+  fun->lay   = NULL;
+  fun->scope = NULL;
+  return fun;
+}
+
+// ============================================================================
+// Drop deleted instructions from the list of each block
+// ============================================================================
+void ssaCompact(SsaFun* fun) {
+  for (int b = 0; b < fun->numBlk; ++b) {
+    SsaBlock* blk = &fun->blk[b];
+    int n = 0;
+    for (int i = 0; i < blk->numIns; ++i) {
+      if (fun->ins[blk->ins[i]].op != SSANOP) blk->ins[n++] = blk->ins[i];
+    }
+    blk->numIns = n;
+  }
+}
+
+// ============================================================================
+// Print value 'v', for ssaDump
+// ============================================================================
+static void ssaDumpVal(SsaFun* fun, int v) {
+  SsaIns* ins = &fun->ins[v];
+  if (ins->op == SSACONST) printf(" #%d", ins->val);
+  else                     printf(" v%d", v);
+}
+
+// ============================================================================
+// Print 'fun' to the console (DEBUG)
+// ============================================================================
+void ssaDump(SsaFun* fun) {
+  printf("\nSSA for %s \n", internStr(fun->funid));
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    printf("B%d: depth %d, idom %d, preds", b, blk->depth, blk->idom);
+    for (int p = 0; p < blk->numPred; ++p) printf(" B%d", blk->pred[p]);
+    printf("\n");
+
+    for (int i = 0; i < blk->numIns; ++i) {
+      int v = blk->ins[i];
+      SsaIns* ins = &fun->ins[v];
+      printf("  v%d = %s", v, ssaOpNames[ins->op]);
+      if (ins->op == SSABIN)  printf(" %s", astBOPtoStr(ins->bop));
+      if (ins->op == SSACALL) printf(" %s", internStr(ins->val));
+      if (ins->op == SSACONST || ins->op == SSAPAR || ins->op == SSASTR) {
+        printf(" %d", ins->val);
+      }
+      for (int a = 0; a < ins->numArg; ++a) ssaDumpVal(fun, ins->arg[a]);
+      printf("\n");
+    }
+
+    if (blk->term == SSAJMP) {
+      printf("  jmp B%d \n", blk->succ[0]);
+    } else if (blk->term == SSABR) {
+      printf("  br %s", astBOPtoStr(blk->bop));
+      ssaDumpVal(fun, blk->a); ssaDumpVal(fun, blk->b);
+      printf(" B%d B%d \n", blk->succ[0], blk->succ[1]);
+    } else if (blk->term == SSARET) {
+      printf("  ret"); ssaDumpVal(fun, blk->a); printf("\n");
+    }
+  }
+}
+
+// ============================================================================
+// Release 'fun' and everything it holds
+// ============================================================================
+void ssaFree(SsaFun* fun) {
+  arenaFree(fun->arena);
+  free(fun->blk);
+  free(fun->ins);
+  free(fun->rpo);
+  free(fun);
+}
+
+// ============================================================================
+// Does 'a bop b' always equal 'b bop a'?
+// ============================================================================
+int ssaIsCommutative(BOP bop) {
+  return bop == BOPADD || bop == BOPMUL || bop == BOPNE || bop == BOPEEQ;
+}
+
+// ============================================================================
+// The index of 'pred' among the predecessors of block 'blk' (-1 => none)
+// ============================================================================
+int ssaPredIndex(SsaFun* fun, int blk, int pred) {
+  SsaBlock* b = &fun->blk[blk];
+  for (int p = 0; p < b->numPred; ++p) if (b->pred[p] == pred) return p;
+  return -1;
+}
+
+// ============================================================================
+// Is the use of value 'v', at position 'pos' of block 'b', dominated by its
+// definition?  pos = numIns stands for the terminator.
+// ============================================================================
+static int ssaDefReaches(SsaFun* fun, int* at, int v, int b, int pos) {
+  if (v <= 0 || v >= fun->numIns) return 0;
+  SsaIns* def = &fun->ins[v];
+  if (def->op == SSANOP || def->blk < 0 || fun->blk[def->blk].rpo < 0) return 0;
+  if (def->blk == b) return at[v] < pos;
+  return ssaDominates(fun, def->blk, b);
+}
+
+// ============================================================================
+// Check that 'fun' is in valid SSA form: each use is dominated by its
+// definition, phis come first in their block, and each phi has one argument
+// per predecessor.  'after' names the pass that ran last.  Abort if not.
+// ============================================================================
+void ssaVerify(SsaFun* fun, char* after) {
+  int* at = malloc(fun->numIns * sizeof(int));      // value => its position
+  if (!at) utDie2Str("ssaVerify", "Out of memory");
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    for (int i = 0; i < blk->numIns; ++i) at[blk->ins[i]] = i;
+  }
+
+  for (int k = 0; k < fun->numRpo; ++k) {
+    int b = fun->rpo[k];
+    SsaBlock* blk = &fun->blk[b];
+    int phis = 1;
+    for (int i = 0; i < blk->numIns; ++i) {
+      SsaIns* ins = &fun->ins[blk->ins[i]];
+      if (ins->op == SSANOP) continue;
+      if (ins->blk != b) utDie3Str("ssaVerify", "Misplaced instruction after", after);
+      if (ins->op == SSAPHI) {
+        if (!phis) utDie3Str("ssaVerify", "Phi after non-phi after", after);
+        if (ins->numArg != blk->numPred) {
+          utDie3Str("ssaVerify", "Phi arity differs from preds after", after);
+        }
+        for (int a = 0; a < ins->numArg; ++a) {
+          int p = blk->pred[a];
+          if (!ssaDefReaches(fun, at, ins->arg[a], p, fun->blk[p].numIns + 1)) {
+            utDie3Str("ssaVerify", "Phi argument does not reach after", after);
+          }
+        }
+        continue;
+      }
+      phis = 0;
+      if (ins->op == SSAGET || ins->op == SSASET) {
+        utDie3Str("ssaVerify", "Var access left after", after);
+      }
+      for (int a = 0; a < ins->numArg; ++a) {
+        if (!ssaDefReaches(fun, at, ins->arg[a], b, i)) {
+          utDie3Str("ssaVerify", "Use not dominated by its def after", after);
+        }
+      }
+    }
+
+    int end = blk->numIns;
+    int ok = 1;
+    if (blk->term == SSARET) ok = ssaDefReaches(fun, at, blk->a, b, end);
+    if (blk->term == SSABR) {
+      ok = ssaDefReaches(fun, at, blk->a, b, end) && ssaDefReaches(fun, at, blk->b, b, end);
+    }
+    if (blk->term == SSANONE) ok = 0;
+    if (!ok) utDie3Str("ssaVerify", "Bad terminator after", after);
+  }
+
+  free(at);
+}
@@ -0,0 +1,133 @@
+// ssa.h - Mid-level IR in SSA form
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // uint8_t
+#include <stdio.h>          // printf
+#include <stdlib.h>         // calloc, realloc, free
+#include <string.h>         // memcpy, memset
+
+#include "arena.h"          // Arena
+#include "ast.h"            // AST, BOP
+#include "flat.h"           // Flat, FlatNode
+#include "intern.h"         // internStr
+#include "lay.h"            // Lay, LaySym
+#include "ut.h"             // ut*
+
+// ssaBuild turns one function of the Flat into an SsaFun: a control flow
+// graph (CFG) of basic blocks, holding instructions in Static Single
+// Assignment form.  Each instruction defines at most one value, known by the
+// index of the instruction in fun->ins[].  Each value is defined exactly
+// once, and every use of it is dominated by that definition.  Where control
+// flow merges, a phi instruction picks the value that flows in along each
+// incoming edge.  Value 0 means "none".
+//
+// Building proceeds in four steps:
+//
+//    1. Walk the Flat, making blocks.  A read of a par/var is an SSAGET, and a
+//       write is an SSASET.  An If gives a branch and a join; a While gives a
+//       header (the test), a body, and an exit.
+//    2. Find the blocks reachable from the entry, their reverse postorder,
+//       and then the dominator tree (Cooper, Harvey & Kennedy).
+//    3. Place a phi for each var at the iterated dominance frontier of the
+//       blocks that assign it (Cytron et al).
+//    4. Walk the dominator tree, renaming: each SSAGET is replaced by the
+//       value that reaches it, and each SSASET is deleted.
+//
+// A block ends in a jump to one successor, a two-way branch, or a return.
+// The branch compares values 'a' and 'b' with 'bop', and goes to succ[0] if
+// TRUE, else to succ[1].  A condition that is not a comparison, such as
+// "while (n)", is compared against 0 with BOPNE.
+//
+// Passes (see pass.h) rewrite an SsaFun in place.  They may delete
+// instructions (op = SSANOP) and change arguments, but not the CFG.  low.c
+// then lowers the result to 68000 code.
+
+#define SSAMINCAP 8         // initial number of slots in each growable array
+
+typedef enum {
+  SSANOP = 0,               // deleted
+  SSACONST,                 // val = the number
+  SSAPAR,                   // val = par number: 0 => first
+  SSAUNDEF,                 // value of a var that is read before any write
+  SSASTR,                   // val = index into flat->str
+  SSACOPY,                  // arg[0]
+  SSABIN,                   // arg[0] bop arg[1]
+  SSAPHI,                   // arg[k] flows in from pred[k] of its block
+  SSACALL,                  // val = intern ID of callee; arg[] = arguments
+  SSAGET,                   // val = var slot.  Only while building
+  SSASET,                   // val = var slot; arg[0].  Only while building
+  SSANUMOP
+} SSAOP;
+
+typedef enum {
+  SSANONE = 0,              // not yet terminated
+  SSAJMP,                   // go to succ[0]
+  SSABR,                    // if (a bop b) go to succ[0], else to succ[1]
+  SSARET,                   // return a
+} SSATERM;
+
+typedef struct {
+  uint8_t op;               // SSAOP
+  uint8_t bop;              // for SSABIN: the operator
+  int     blk;              // block that holds it (-1 => none)
+  int     val;              // see SSAOP
+  int     numArg;
+  int*    arg;              // value numbers
+} SsaIns;
+
+typedef struct {
+  int     numIns;           // instructions, in order, phis first
+  int     capIns;
+  int*    ins;
+  int     numPred;          // predecessor blocks
+  int     capPred;
+  int*    pred;
+  int     numSucc;          // 0, 1 or 2
+  int     succ[2];
+  uint8_t term;             // SSATERM
+  uint8_t bop;              // for SSABR
+  int     a;                // for SSABR and SSARET
+  int     b;                // for SSABR
+  int     depth;            // number of enclosing Whiles
+  int     rpo;              // position in reverse postorder (-1 => unreachable)
+  int     idom;             // immediate dominator (-1 => entry, or unreachable)
+  int     domKid;           // first child in the dominator tree (-1 => none)
+  int     domSib;           // next sibling in the dominator tree (-1 => none)
+  int     domPre;           // dominator tree preorder number
+  int     domPost;          // ... and the last preorder number beneath it
+} SsaBlock;
+
+typedef struct {
+  Arena*    arena;          // arg[], ins[] and pred[] arrays
+  Flat*     flat;           // program the function came from
+  int       funid;          // intern ID of the function
+  int       numBlk;         // blocks: blk[0] is the entry
+  int       capBlk;
+  SsaBlock* blk;
+  int       numIns;         // instructions: ins[0] is unused (value 0)
+  int       capIns;
+  SsaIns*   ins;
+  int       numRpo;         // reachable blocks, in reverse postorder
+  int*      rpo;
+  int       numVar;         // var slots: one per slot of the function's LayScope
+  Lay*      lay;            // while building: layout of the function
+  LayScope* scope;          // while building: the function's pars and vars
+  int       cur;            // while building: block being filled
+  int       depth;          // while building: number of enclosing Whiles
+} SsaFun;
+
+int     ssaAddBlock(SsaFun* fun, int depth);
+void    ssaAddEdge(SsaFun* fun, int from, int to);
+int     ssaAddIns(SsaFun* fun, int blk, SSAOP op, int val, int numArg);
+SsaFun* ssaBuild(Lay* lay, Flat* flat, int fun);
+void    ssaCompact(SsaFun* fun);
+int     ssaDominates(SsaFun* fun, int a, int b);
+void    ssaDomTree(SsaFun* fun);
+void    ssaDump(SsaFun* fun);
+void    ssaFree(SsaFun* fun);
+int     ssaIsCommutative(BOP bop);
+int     ssaNewIns(SsaFun* fun, SSAOP op, int val, int numArg);
+int     ssaPredIndex(SsaFun* fun, int blk, int pred);
+void    ssaVerify(SsaFun* fun, char* after);
@@ -2,22 +2,25 @@
 
 #include "tok.h"
 
-Tok* tokNew(int kind, char* lex, int num, char* txt, int linNum, int colNum) {
-  Tok* tok = (Tok*) malloc(sizeof(Tok));
-  tok->kind   = kind;
-  tok->lex    = lex;
-  tok->num    = num;
-  tok->str    = txt;
-  tok->linNum = linNum;
-  tok->colNum = colNum;
-  return tok;
+// ============================================================================
+// Write the members of 'set' into 'buf' (which must be big enough), as
+// display strings - eg: "{TOKNAM, TOKNUM}".  Return 'buf'.
+// ============================================================================
+char* tokSetStr(TokSet set, char* buf) {
+  strcpy(buf, "{");
+  for (int k = TOKADD; k <= TOKWHILE; ++k) {
+    if ((set & TOKBIT(k)) == 0) continue;
+    if (buf[1]) strcat(buf, ", ");
+    strcat(buf, tokStr(k));
+  }
+  strcat(buf, "}");
+  return buf;
 }
 
 char* tokStr(TokKind kind) {
   switch(kind) {
     case TOKADD:      return "TOKADD";
     case TOKBAD:      return "TOKBAD";
-    case TOKCHARSTAR: return "TOKCHARSTAR";
     case TOKCOMMA:    return "TOKCOMMA";
     case TOKEEQ:      return "TOKEEQ";
     case TOKEOF:      return "TOKEOF";
@@ -2,27 +2,35 @@
 
 #pragma once
 
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
 #include <stdio.h>      // printf
-#include <stdlib.h>     // malloc
-#include <string.h>     // strlen
+#include <string.h>     // strcat
 
 typedef enum {
-  TOKADD = 1, TOKBAD, TOKCHARSTAR, TOKCOMMA, TOKEEQ, TOKEOF, TOKEQ,
-  TOKGE, TOKGT, TOKIF, TOKINT, TOKLBRACE, TOKLE, TOKLPAREN, TOKLT, TOKMUL,
+  TOKADD = 1, TOKBAD, TOKCOMMA, TOKEEQ, TOKEOF, TOKEQ, TOKGE,
+  TOKGT, TOKIF, TOKINT, TOKLBRACE, TOKLE, TOKLPAREN, TOKLT, TOKMUL,
   TOKNAM, TOKNE, TOKNUM, TOKRBRACE, TOKRET, TOKRPAREN, TOKSEMI, TOKSTR,
   TOKSUB, TOKWHILE
 } TokKind;
 
-char* tokStr(TokKind kind);
+// A TokSet is a set of TokKinds, one bit per kind, so that testing whether a
+// token is a member is a single AND.
+
+typedef uint32_t TokSet;
+#define TOKBIT(k) ((TokSet) 1 << (k))
+
+// Tokens are stored, not as Tok structs, but column-wise in a Toks
+// container (see toks.h).  A Tok is just a decoded view of one token,
+// assembled on demand for diagnostics and debug dumps.
 
 typedef struct _Tok {
   TokKind kind;       // eg: TOKNUM
-  char*   lex;        // eg: "123" for TOKNUM, "abc" for TOKNAM
-  int     num;        // eg: 123 for TOKNUM
-  char*   str;        // eg: "Abort, retry of fail" for TOKSTR
+  size_t  off;        // offset of lexeme in source text
+  int     val;        // number, intern ID or string length (see toks.h)
   int     linNum;     // eg: 14
   int     colNum;     // eg: 8
 } Tok;
 
-Tok*  tokNew(int kind, char* lex, int num, char* str, int linNum, int colNum);
-char* tokStr(TokKind kind);
\ No newline at end of file
+char* tokSetStr(TokSet set, char* buf);
+char* tokStr(TokKind kind);
@@ -1,40 +1,37 @@
 // toks.c - container of Tokens - Jim Hogg, 2020
 
-#include <stddef.h>       // offsetof
-#include <stdlib.h>       // malloc
+#include <stdlib.h>       // free, realloc
 #include "toks.h"
 
 // ============================================================================
-// Append 'tok' to the 'toks' array, checking for overflow
-// ============================================================================
-void toksAdd(Toks* toks, Tok* tok) {
-  if (toks->tokNum < MAXTOKNUM) {
-    ++toks->tokNum;
-    ++toks->hiTokNum;
-    toks->tok[toks->tokNum] = *tok;
-  } else {
-    utDie2Str("toksAdd", "Too many tokens!");
+// Append a token onto the end of 'toks', growing the arrays if they are full.
+// Adding TOKEOF seals the container: it becomes the end sentinel.
+// ============================================================================
+void toksAdd(Toks* toks, TokKind kind, size_t off, int val) {
+  int t = toks->hiTokNum + 1;
+  if (t == toks->cap) {
+    toks->cap *= 2;
+    toks->kind = realloc(toks->kind, toks->cap * sizeof(uint8_t));
+    toks->off  = realloc(toks->off,  toks->cap * sizeof(uint32_t));
+    toks->val  = realloc(toks->val,  toks->cap * sizeof(int));
+    if (!toks->kind || !toks->off || !toks->val) {
+      utDie2Str("toksAdd", "Out of memory for tokens");
+    }
   }
-}
+  if (off > UINT32_MAX) utDie2Str("toksAdd", "Source text exceeds 4 GB");
 
-// ============================================================================
-// Check whether we are "at the end" of the Toks array.  That's to say, we
-// have already processed all the Toks
-// ============================================================================
-int toksAtEnd(Toks* toks) {
-  return toks->tokNum > toks->hiTokNum;
+  toks->kind[t] = (uint8_t) kind;
+  toks->off[t]  = (uint32_t) off;
+  toks->val[t]  = val;
+  toks->hiTokNum = t;
 }
 
 // ============================================================================
-// Return the current Tok (ie, the one at the toks->tokNum 'cursor')
+// Check whether we are "at the end" of the Toks container.  That's to say,
+// the cursor has reached the TOKEOF sentinel
 // ============================================================================
-Tok* toksCurr(Toks* toks) {
-  if (toksAtEnd(toks)) {
-    return tokNew(TOKEOF, NULL, 0, NULL, 0, 0);
-  } else {
-    return &toks->tok[toks->tokNum];
-  }
-  return NULL;            // unreachable; pacify compiler
+int toksAtEnd(Toks* toks) {
+  return toks->kind[toks->tokNum] == TOKEOF;
 }
 
 // ============================================================================
@@ -43,56 +40,99 @@ Tok* toksCurr(Toks* toks) {
 void toksDump(Toks* toks) {
   FILE* f = fopen("ToksDump.txt", "w");
   for (int t = 0; t <= toks->hiTokNum; ++t) {
-    Tok* tok = &toks->tok[t];
-    fprintf(f,"[%3d] %3d  %10s %10s  %d (%d, %d) \n",
-      t, tok->kind, tokStr(tok->kind), tok->lex, tok->num,
-      tok->linNum, tok->colNum);
+    Tok tok = toksTok(toks, t);
+    fprintf(f, "[%3d] %3d  %10s ", t, tok.kind, tokStr(tok.kind));
+    if (tok.kind == TOKNAM) {
+      fprintf(f, "%10s ", internStr(tok.val));
+    } else if (tok.kind == TOKSTR) {
+      fprintf(f, "%10.*s ", tok.val, &toks->text[tok.off]);
+    } else {
+      fprintf(f, "%10d ", tok.val);
+    }
+    fprintf(f, " (%d, %d) \n", tok.linNum, tok.colNum);
   }
   fclose(f);
 }
 
 // ============================================================================
-// Create a new Toks container
+// Release 'toks', along with its arrays
 // ============================================================================
-Toks* toksNew() {
-  Toks* toks = malloc(sizeof(Toks));
-  toks->tokNum = toks->hiTokNum = -1;
-  return toks;
+void toksFree(Toks* toks) {
+  free(toks->kind);
+  free(toks->off);
+  free(toks->val);
+  free(toks);
 }
 
 // ============================================================================
-// Move the toks->tokNum 'cursor' forward one step.  But do not access the
-// entry: at the end of the program, the cursor will point just beyond the end
-// of the Toks array (ie, at entry toks->hiTokNum + 1)
+// Return the kind of the current token (ie, the one at the toks->tokNum
+// 'cursor')
+// ============================================================================
+TokKind toksKind(Toks* toks) {
+  return toks->kind[toks->tokNum];
+}
+
 // ============================================================================
-Tok* toksNext(Toks* toks) {
-  ++toks->tokNum;
-  if (toksAtEnd(toks)) {
-    return tokNew(TOKEOF, NULL, 0, NULL, 0, 0);
-  } else {
-    return toksCurr(toks);
+// Create a new, empty Toks container, for the tokens lexed from 'text'
+// ============================================================================
+Toks* toksNew(char* text) {
+  Toks* toks = malloc(sizeof(Toks));
+  toks->text = text;
+  toks->tokNum = 0;
+  toks->hiTokNum = -1;
+  toks->cap  = TOKSMINCAP;
+  toks->kind = malloc(TOKSMINCAP * sizeof(uint8_t));
+  toks->off  = malloc(TOKSMINCAP * sizeof(uint32_t));
+  toks->val  = malloc(TOKSMINCAP * sizeof(int));
+  if (!toks->kind || !toks->off || !toks->val) {
+    utDie2Str("toksNew", "Out of memory for tokens");
   }
+  return toks;
 }
 
 // ============================================================================
-// Return the next Tok (ie, the one just after the toks->tokNum 'cursor'), but
-// avoid making any permanent change to that cursor.
+// Move the toks->tokNum 'cursor' forward one step, and return the kind of the
+// token it then points at.  The cursor never moves beyond the TOKEOF sentinel.
 // ============================================================================
-Tok* toksPeek(Toks* toks) {
-  Tok* tok = toksNext(toks);
-  toksPrev(toks);
-  return tok;
+TokKind toksNext(Toks* toks) {
+  if (!toksAtEnd(toks)) ++toks->tokNum;
+  return toks->kind[toks->tokNum];
 }
 
 // ============================================================================
-// Return the previous Tok (ie, the one just before the toks->tokNum 'cursor')
+// Return the kind of the next token (ie, the one just after the toks->tokNum
+// 'cursor'), without moving that cursor
 // ============================================================================
-Tok* toksPrev(Toks* toks) {
-  --toks->tokNum;
-  return toksCurr(toks);
+TokKind toksPeek(Toks* toks) {
+  if (toksAtEnd(toks)) return TOKEOF;
+  return toks->kind[toks->tokNum + 1];
 }
 
 // ============================================================================
-// Rewind the Toks container so that 'toksCurr' will retrieve the first Tok
+// Rewind the Toks container so that 'toksKind' will retrieve the first token
 // ============================================================================
 void toksRewind(Toks* toks) { toks->tokNum = 0; }
+
+// ============================================================================
+// Decode token number 't' into a Tok.  Its line and column are found by
+// counting newlines from the start of the text - slow, but only used when
+// reporting errors, or dumping tokens.
+// ============================================================================
+Tok toksTok(Toks* toks, int t) {
+  Tok tok;
+  tok.kind = toks->kind[t];
+  tok.off  = toks->off[t];
+  tok.val  = toks->val[t];
+
+  size_t lexOff = tok.kind == TOKSTR ? tok.off - 1 : tok.off;  // open quote
+  size_t linPos = 0;
+  tok.linNum = 1;
+  for (size_t i = 0; i < lexOff; ++i) {
+    if (toks->text[i] == '\n') {
+      ++tok.linNum;
+      linPos = i + 1;
+    }
+  }
+  tok.colNum = (int) (lexOff - linPos + 1);
+  return tok;
+}
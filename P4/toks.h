@@ -2,23 +2,46 @@
 
 #pragma once
 
+#include <stdint.h>         // uint8_t, uint32_t
+
+#include "intern.h"         // internStr
 #include "tok.h"            // Tok
 #include "ut.h"             // ut*
 
+// Toks holds the tokens in struct-of-arrays form: token 't' is described by
+// kind[t], off[t] and val[t], 9 bytes in all.  The meaning of val[t] depends
+// upon the kind:
+//
+//    TOKNUM : the value of the number - eg: 123
+//    TOKNAM : the intern ID of the name
+//    TOKSTR : the length of the string (off[t] is just beyond the open quote)
+//    others : 0
+//
+// The arrays double in size whenever they fill up, so there is no limit on
+// the number of tokens.  The last token is always a single TOKEOF sentinel,
+// so the parser can never run off the end.  Line and column numbers are not
+// stored: toksTok recomputes them from the offset, on the rare occasions they
+// are needed.
+
+#define TOKSMINCAP 1024     // initial number of slots in each array
+
 typedef struct _Toks {
-  #define MAXTOKNUM 999
-  int tokNum;               // current Tok number (iterator)
-  int hiTokNum;             // hightest Tok number in current Toks object
-  Tok tok[MAXTOKNUM + 1];
+  char*     text;           // source text that each token's lexeme lies within
+  int       tokNum;         // current token number (cursor)
+  int       hiTokNum;       // number of the TOKEOF sentinel (once added)
+  int       cap;            // number of slots in each array
+  uint8_t*  kind;           // TokKind of each token
+  uint32_t* off;            // offset of each lexeme within 'text'
+  int*      val;            // number, intern ID or string length
 } Toks;
 
-
-void  toksAdd(Toks* toks, Tok* tok);
-int   toksAtEnd(Toks* toks);
-Tok*  toksCurr(Toks* toks);
-void  toksDump(Toks* toks);
-Toks* toksNew();
-Tok*  toksNext(Toks* toks);
-Tok*  toksPeek(Toks* toks);
-Tok*  toksPrev(Toks* toks);
-void  toksRewind(Toks* toks);
\ No newline at end of file
+void    toksAdd(Toks* toks, TokKind kind, size_t off, int val);
+int     toksAtEnd(Toks* toks);
+void    toksDump(Toks* toks);
+void    toksFree(Toks* toks);
+TokKind toksKind(Toks* toks);
+Toks*   toksNew(char* text);
+TokKind toksNext(Toks* toks);
+TokKind toksPeek(Toks* toks);
+void    toksRewind(Toks* toks);
+Tok     toksTok(Toks* toks, int t);
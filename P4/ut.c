@@ -2,41 +2,67 @@
 
 #include "ut.h"
 
+#ifdef _WIN32
+#include <windows.h>    // CreateFileMapping, MapViewOfFile, UnmapViewOfFile
+#else
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // close, sysconf
+#endif
+
+static int utDieStatus = 0;                     // 0 => utDie* waits for a key
+
+// ============================================================================
+// After an error, exit with utDieStatus, if set - so that a script can tell -
+// else wait for a key, as every run does
+// ============================================================================
+static void utDie() {
+  if (utDieStatus) exit(utDieStatus);
+  utPause();
+}
+
+// ============================================================================
+// Make each later utDie* exit at once, with 'status'.  subc -diff sets 2.
+// ============================================================================
+void utSetDieStatus(int status) { utDieStatus = status; }
+
 void utDie2Str(char* func, char* msg) {
   printf("\n\nERROR: %s: %s \n\n", func, msg);
-  utPause();
+  utDie();
 }
 
 void utDie2StrInt(char* func, char* msg, int num) {
   printf("\n\nERROR: %s: %s %d \n\n", func, msg, num);
-  utPause();
+  utDie();
 }
 
 void utDie3Str(char* func, char* msg1, char*msg2) {
   printf("\n\nERROR: %s: %s %s \n\n", func, msg1, msg2);
-  utPause();
+  utDie();
 }
 
 void utDie4Str(char* func, char* msg1, char* msg2, char* msg3) {
   printf("\n\nERROR: %s: %s %s %s \n\n", func, msg1, msg2, msg3);
-  utPause();
+  utDie();
 }
 
 void utDie5Str(char* func, char* msg1, char* msg2, char* msg3, char* msg4) {
   printf("\n\nERROR: %s: %s %s %s %s \n\n", func, msg1, msg2, msg3, msg4);
-  utPause();
+  utDie();
 }
 
 void utDie2StrCharLC(char* func, char* msg, char c, int linNum, int colNum) {
   printf("\n\nERROR: %s %s %c at (%d, %d) \n\n",
     func, msg, c, linNum, colNum);
-  utPause();
+  utDie();
 }
 
 void utDieStrTokStr(char* func, Tok* tok, char* msg) {
   printf("\n\nERROR: %s: Found %s but expecting %s at (%d, %d) \n\n",
     func, tokStr(tok->kind), msg, tok->linNum, tok->colNum);
-  utPause();
+  utDie();
 }
 
 void utPause() {
@@ -45,7 +71,101 @@ void utPause() {
   exit(0);
 }
 
-char* utReadFile(char* filePath) {
+#define UTMAXMAP 16     // views that utMapFile may hold mapped at once
+
+static char* utMapped[UTMAXMAP];                // views to unmap, not free
+
+// ============================================================================
+// Map the source file 'filePath' read-only into memory, and return a pointer
+// to its first char.  Set '*size' to the number of chars in the file.  No
+// copy of the file is made: the OS pages it in as the lexer reads it.
+//
+// The lexer relies on a NUL char just beyond the last char of the file.  The
+// OS zero-fills the tail of the last page of a mapping, so that NUL is there
+// for free - unless the file exactly fills its last page (or is empty), in
+// which case we fall back to utReadFile.  Either way, utUnmapFile releases
+// the text.
+// ============================================================================
+char* utMapFile(char* filePath, size_t* size) {
+  char* text = NULL;
+
+  int slot = 0;                             // where to note the view
+  while (slot < UTMAXMAP && utMapped[slot]) ++slot;
+  if (slot == UTMAXMAP) return utReadFile(filePath, size);
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    utDie2Str("utMapFile: Cannot open input source file: ", filePath);
+  }
+
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file, &fileSize);
+  SYSTEM_INFO sysInfo;
+  GetSystemInfo(&sysInfo);
+  size_t pageSize = sysInfo.dwPageSize;
+
+  if (fileSize.QuadPart == 0 || fileSize.QuadPart % pageSize == 0) {
+    CloseHandle(file);
+    return utReadFile(filePath, size);
+  }
+
+  HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (map) text = (char*) MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+  if (map) CloseHandle(map);                // the view keeps the mapping alive
+  CloseHandle(file);
+  *size = (size_t) fileSize.QuadPart;
+#else
+  int file = open(filePath, O_RDONLY);
+  if (file < 0) utDie2Str("utMapFile: Cannot open input source file: ", filePath);
+
+  struct stat st;
+  fstat(file, &st);
+  size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+
+  if (st.st_size == 0 || st.st_size % pageSize == 0) {
+    close(file);
+    return utReadFile(filePath, size);
+  }
+
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);                              // the mapping stays valid
+  if (p != MAP_FAILED) {
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    text = (char*) p;
+  }
+  *size = (size_t) st.st_size;
+#endif
+
+  if (text == NULL) return utReadFile(filePath, size);
+  utMapped[slot] = text;
+  return text;
+}
+
+// ============================================================================
+// Release 'text', of 'size' chars, as returned by utMapFile: unmap it if it
+// was mapped, or free it if it was read, by utReadFile, instead
+// ============================================================================
+void utUnmapFile(char* text, size_t size) {
+  for (int slot = 0; slot < UTMAXMAP; ++slot) {
+    if (utMapped[slot] != text) continue;
+    utMapped[slot] = NULL;
+#ifdef _WIN32
+    UnmapViewOfFile(text);
+#else
+    munmap(text, size);
+#endif
+    return;
+  }
+  free(text);
+}
+
+// ============================================================================
+// Read the source file 'filePath' into a freshly allocated buffer, with a
+// trailing NUL.  Set '*size' to the number of chars read.
+// ============================================================================
+char* utReadFile(char* filePath, size_t* size) {
   FILE* file = fopen(filePath, "r");
 
   if (!file) utDie2Str("readFile: Cannot open input source file: ", filePath);
@@ -54,19 +174,29 @@ char* utReadFile(char* filePath) {
   // by 2 chars - CR, LF.  'fileSize', calculated below, includes these chars.
   // However, the 'fread' call below silently replaces each (CR, LF) pair with a
   // single '\n' char.  So how do we find where 'prog' really ends?  We allocate
-  // it to be all-zeroes, ahead of populating it using 'fread'.
-
-  fseek(file, 0L, SEEK_END);
-  int fileSize = ftell(file);
-  fseek(file, 0L, SEEK_SET);
+  // it to be all-zeroes, ahead of populating it using 'fread', and use the
+  // count that 'fread' returns.  The size is 64 bits, so files larger than
+  // 2 GB are fine.
+
+#ifdef _WIN32
+  _fseeki64(file, 0L, SEEK_END);
+  size_t fileSize = (size_t) _ftelli64(file);
+  _fseeki64(file, 0L, SEEK_SET);
+#else
+  fseeko(file, 0L, SEEK_END);
+  size_t fileSize = (size_t) ftello(file);
+  fseeko(file, 0L, SEEK_SET);
+#endif
 
   // Allocate a buffer, zero-filled, to hold the file contents.
 
   char* prog = (char*) calloc(1 + fileSize, 1);
+  if (!prog) utDie2Str("readFile: Cannot allocate buffer for file: ", filePath);
 
   // Read the entire file
 
-  fread(prog, 1, fileSize, file);
+  *size = fread(prog, 1, fileSize, file);
+  fclose(file);
 
   return prog;
 
@@ -78,3 +208,20 @@ char* utStrndup(char* s, int len) {
   copy[len] = '\0';
   return copy;
 }
+
+// ============================================================================
+// Return the time, in seconds, on a monotonic clock.  Only differences
+// between two calls are meaningful - eg: to time each phase of the compiler
+// ============================================================================
+double utTime() {
+#ifdef _WIN32
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (double) now.QuadPart / (double) freq.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec + 1e-9 * (double) now.tv_nsec;
+#endif
+}
@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include <stddef.h>   // size_t
 #include <stdio.h>    // printf
-#include <stdlib.h>   // exit
+#include <stdlib.h>   // exit, free
 #include <string.h>   // strlen
 
 #include "tok.h"      // Tok
@@ -16,5 +17,9 @@ void  utDie5Str(char* func, char* msg1, char* msg2, char* msg3, char* msg4);
 void  utDie2StrCharLC(char* func, char* msg, char c, int linNum, int colNum);
 void  utDieStrTokStr(char* func, Tok* tok, char* msg);
 void  utPause();
-char* utReadFile(char* filePath);
-char* utStrndup(char* s, int len);
\ No newline at end of file
+void  utSetDieStatus(int status);
+char* utMapFile(char* filePath, size_t* size);
+char* utReadFile(char* filePath, size_t* size);
+void  utUnmapFile(char* text, size_t size);
+char* utStrndup(char* s, int len);
+double utTime();
\ No newline at end of file
@@ -0,0 +1,747 @@
+// vm.c - Register bytecode, and the VM that runs it
+
+#include "vm.h"
+
+// The operands of each opcode, in VMOP order: for each of 'a', 'b' and 'c',
+// 'r' register, 'i' immediate, 't' branch target, 'f' index in fun[], 'n'
+// number of args, 's' index in str[], '-' unused.  vmLoad checks a .SBC
+// file against it.
+
+static char* vmForms[VMNUMOP] = {
+  "---",
+  "rr-", "r-i",
+  "rrr", "rri", "rrr", "rri", "rri",
+  "rrr", "rri",
+  "rrr", "rri", "rrr", "rri", "rrr", "rri",
+  "rrr", "rri", "rrr", "rri", "rrr", "rri",
+  "trr", "tri", "trr", "tri", "trr", "tri",
+  "trr", "tri", "trr", "tri", "trr", "tri",
+  "tr-", "tr-", "t--",
+  "rfn",
+  "-r-", "--i",
+  "rs-", "rr-", "r-i", "r--",
+};
+
+// ============================================================================
+// The opcode, with both operands registers, for 'bop'.  Its I form (the
+// right operand an immediate) follows it.
+// ============================================================================
+static VMOP vmBopOp(BOP bop) {
+  switch (bop) {
+    case BOPADD: return VMADD;
+    case BOPSUB: return VMSUB;
+    case BOPMUL: return VMMUL;
+    case BOPLT:  return VMLT;
+    case BOPLE:  return VMLE;
+    case BOPNE:  return VMNE;
+    case BOPEEQ: return VMEQ;
+    case BOPGE:  return VMGE;
+    case BOPGT:  return VMGT;
+    default:     utDie2Str("vmBopOp", "Invalid operator"); return VMNOP;
+  }
+}
+
+// ============================================================================
+// The relational operator that holds when 'bop' fails - eg: < => >=
+// ============================================================================
+static BOP vmInverse(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return BOPGE;
+    case BOPLE:  return BOPGT;
+    case BOPNE:  return BOPEEQ;
+    case BOPEEQ: return BOPNE;
+    case BOPGE:  return BOPLT;
+    default:     return BOPLE;                          // BOPGT
+  }
+}
+
+// ============================================================================
+// The relational operator that holds with its operands swapped - eg: < => >
+// ============================================================================
+static BOP vmMirror(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return BOPGT;
+    case BOPLE:  return BOPGE;
+    case BOPGE:  return BOPLE;
+    case BOPGT:  return BOPLT;
+    default:     return bop;                            // ==, !=
+  }
+}
+
+static int vmIsRel(BOP bop) { return bop >= BOPLT && bop <= BOPGT; }
+
+// ============================================================================
+// Build an empty Vm
+// ============================================================================
+static Vm* vmNew() {
+  Vm* vm = calloc(1, sizeof(Vm));
+  if (!vm) utDie2Str("vmNew", "Out of memory");
+  vm->out  = stdout;
+  vm->main = -1;
+  return vm;
+}
+
+// ============================================================================
+// Append the instruction 'op a, b, c'.  Return its index in code[].
+// ============================================================================
+static int vmAdd(Vm* vm, VMOP op, int a, int b, int c) {
+  if (vm->num == vm->cap) {
+    vm->cap = vm->cap ? 2 * vm->cap : VMMINCAP;
+    vm->code = realloc(vm->code, vm->cap * sizeof(VmIns));
+    if (!vm->code) utDie2Str("vmAdd", "Out of memory");
+  }
+  VmIns* ins = &vm->code[vm->num];
+  ins->go = NULL;
+  ins->op = op; ins->a = a; ins->b = b; ins->c = c;
+  return vm->num++;
+}
+
+// ============================================================================
+// Append a function called 'name' to fun[].  Return its index.
+// ============================================================================
+static int vmAddFun(Vm* vm, char* name) {
+  if (vm->numFun == vm->capFun) {
+    vm->capFun = vm->capFun ? 2 * vm->capFun : VMMINCAP;
+    vm->fun = realloc(vm->fun, vm->capFun * sizeof(VmFun));
+    if (!vm->fun) utDie2Str("vmAddFun", "Out of memory");
+  }
+  VmFun* f = &vm->fun[vm->numFun];
+  memset(f, 0, sizeof(VmFun));
+  f->name = utStrndup(name, (int) strlen(name));
+  return vm->numFun++;
+}
+
+// ============================================================================
+// Append a copy of string literal 'txt' to str[].  Return its index.
+// ============================================================================
+static int vmAddStr(Vm* vm, char* txt, int len) {
+  if (vm->numStr == vm->capStr) {
+    vm->capStr = vm->capStr ? 2 * vm->capStr : VMMINCAP;
+    vm->str = realloc(vm->str, vm->capStr * sizeof(char*));
+    if (!vm->str) utDie2Str("vmAddStr", "Out of memory");
+  }
+  vm->str[vm->numStr] = utStrndup(txt, len);
+  return vm->numStr++;
+}
+
+// ============================================================================
+// Grow slotOf[] and funOf[] to hold intern ID 'id'
+// ============================================================================
+static void vmGrowId(Vm* vm, int id) {
+  if (id < vm->numId) return;
+  int num = vm->numId ? vm->numId : VMMINCAP;
+  while (num <= id) num *= 2;
+  vm->slotOf = realloc(vm->slotOf, num * sizeof(int));
+  vm->funOf  = realloc(vm->funOf,  num * sizeof(int));
+  if (!vm->slotOf || !vm->funOf) utDie2Str("vmGrowId", "Out of memory");
+  for (int i = vm->numId; i < num; ++i) { vm->slotOf[i] = -1; vm->funOf[i] = -1; }
+  vm->numId = num;
+}
+
+// ============================================================================
+// The register of par or var 'id' in the function being lowered
+// ============================================================================
+static int vmReg(Vm* vm, int id) {
+  vmGrowId(vm, id);
+  if (vm->slotOf[id] < 0) {
+    utDie5Str("vmReg", "Cannot find varpar", internStr(id),
+      "in function", vm->fun[vm->cur].name);
+  }
+  return vm->slotOf[id];
+}
+
+// ============================================================================
+// Describe operand node 'n' (a Nam, Num or Str): return 1 if it is an
+// immediate, with its value in '*val'; else 0, with its register in '*val'.
+// A Str is the immediate 0.
+// ============================================================================
+static int vmOpnd(Vm* vm, Flat* flat, int n, int* val) {
+  FlatNode* node = &flat->node[n];
+  if (node->tag == ASTNAM) { *val = vmReg(vm, node->val); return 0; }
+  *val = node->tag == ASTNUM ? node->val : 0;
+  return 1;
+}
+
+// ============================================================================
+// Lower Exp node 'exp', leaving its value in register 'dst'
+// ============================================================================
+static void vmLowExp(Vm* vm, Flat* flat, int exp, int dst) {
+  FlatNode* node = flat->node;                          // alias
+  int lhs = exp + 1;
+  int rhs = lhs < (int) node[exp].end ? (int) node[lhs].end : lhs;
+  int l, r;
+  int lImm = vmOpnd(vm, flat, lhs, &l);
+
+  if (rhs == (int) node[exp].end) {                     // x = y  or  x = 5
+    if (lImm)          vmAdd(vm, VMMOVI, dst, 0, l);
+    else if (l != dst) vmAdd(vm, VMMOV, dst, l, 0);
+    return;
+  }
+
+  BOP bop  = node[exp].bop;
+  int rImm = vmOpnd(vm, flat, rhs, &r);
+  if (lImm && rImm) {                                   // not folded: fold it now
+    vmAdd(vm, VMMOVI, dst, 0, foldBop(bop, l, r));
+  } else if (!lImm && !rImm) {
+    vmAdd(vm, vmBopOp(bop), dst, l, r);
+  } else if (rImm) {                                    // x = y op 5
+    vmAdd(vm, vmBopOp(bop) + 1, dst, l, r);
+  } else if (bop == BOPSUB) {                           // x = 5 - y
+    vmAdd(vm, VMRSUBI, dst, r, l);
+  } else {                                              // x = 5 op y  =>  x = y op' 5
+    vmAdd(vm, vmBopOp(vmMirror(bop)) + 1, dst, r, l);
+  }
+}
+
+// ============================================================================
+// Lower the test of Exp node 'exp': a branch, taken if the test's truth is
+// 'jumpif'.  Return its index in code[], for the caller to fill in its
+// target - or -1 if there is no branch: the test is a constant, and never
+// jumps.
+// ============================================================================
+static int vmLowCond(Vm* vm, Flat* flat, int exp, int jumpif) {
+  FlatNode* node = flat->node;                          // alias
+  int lhs = exp + 1;
+  int rhs = lhs < (int) node[exp].end ? (int) node[lhs].end : lhs;
+  BOP bop = node[exp].bop;
+  int l, r;
+
+  if (rhs == (int) node[exp].end || !vmIsRel(bop)) {    // test a value against 0
+    int tmp = vm->fun[vm->cur].regs - 1;
+    if (rhs == (int) node[exp].end) {
+      if (vmOpnd(vm, flat, lhs, &l)) {                  // constant
+        return (l != 0) == jumpif ? vmAdd(vm, VMJMP, -1, 0, 0) : -1;
+      }
+    } else {
+      vmLowExp(vm, flat, exp, tmp);
+      l = tmp;
+    }
+    return vmAdd(vm, jumpif ? VMBNZ : VMBZ, -1, l, 0);
+  }
+
+  if (!jumpif) bop = vmInverse(bop);
+  int lImm = vmOpnd(vm, flat, lhs, &l);
+  int rImm = vmOpnd(vm, flat, rhs, &r);
+  if (lImm && rImm) {                                   // constant
+    return foldBop(bop, l, r) ? vmAdd(vm, VMJMP, -1, 0, 0) : -1;
+  }
+  if (lImm) {                                           // 5 < y  =>  y > 5
+    int t = l; l = r; r = t;
+    bop = vmMirror(bop);
+    rImm = 1;
+  }
+  return vmAdd(vm, vmBopOp(bop) - VMLT + VMBLT + rImm, -1, l, r);
+}
+
+// ============================================================================
+// Set the target of branch code[at] to 'target'.  'at' of -1 is ignored.
+// ============================================================================
+static void vmPatch(Vm* vm, int at, int target) {
+  if (at >= 0) vm->code[at].a = target;
+}
+
+// ============================================================================
+// Lower Call node 'call', leaving its result in register 'dst'
+// ============================================================================
+static void vmLowCall(Vm* vm, Flat* flat, int call, int dst) {
+  FlatNode* node = flat->node;                          // alias
+  int id  = node[call].val;
+  int arg = call + 1;
+  int has = arg < (int) node[call].end;
+  int v;
+
+  if (id == intern("says")) {
+    if (!has || node[arg].tag != ASTSTR) utDie2Str("vmLowCall", "says needs a string");
+    char* txt = flat->str[node[arg].val];
+    vmAdd(vm, VMSAYS, dst, vmAddStr(vm, txt, (int) strlen(txt)), 0);
+    return;
+  }
+  if (id == intern("sayn")) {
+    if (has && !vmOpnd(vm, flat, arg, &v)) vmAdd(vm, VMSAYN, dst, v, 0);
+    else vmAdd(vm, VMSAYNI, dst, 0, has ? v : 0);
+    return;
+  }
+  if (id == intern("sayl")) {
+    vmAdd(vm, VMSAYL, dst, 0, 0);
+    return;
+  }
+
+  vmGrowId(vm, id);
+  int f = vm->funOf[id];
+  if (f < 0) {
+    utDie5Str("vmLowCall", "Cannot find function", internStr(id),
+      "called in function", vm->fun[vm->cur].name);
+  }
+
+  VmFun* caller = &vm->fun[vm->cur];
+  int nargs = 0;                                        // args beyond its pars are dropped
+  for (; arg < (int) node[call].end && nargs < vm->fun[f].numPars; arg = node[arg].end) {
+    int out = caller->regs + nargs++;                   // outgoing register
+    if (vmOpnd(vm, flat, arg, &v)) vmAdd(vm, VMMOVI, out, 0, v);
+    else vmAdd(vm, VMMOV, out, v, 0);
+  }
+  if (caller->regs + nargs > caller->size) caller->size = caller->regs + nargs;
+  vmAdd(vm, VMCALL, dst, f, nargs);
+}
+
+static void vmLowStms(Vm* vm, Flat* flat, int first, int end);
+
+// ============================================================================
+// Lower statement node 'n'
+// ============================================================================
+static void vmLowStm(Vm* vm, Flat* flat, int n) {
+  FlatNode* node = flat->node;                          // alias
+  int exp = n + 1;
+  switch (node[n].tag) {
+    case ASTASG: {
+      int dst = vmReg(vm, node[n].val);
+      if (node[exp].tag == ASTCALL) vmLowCall(vm, flat, exp, dst);
+      else vmLowExp(vm, flat, exp, dst);
+      break;
+    }
+    case ASTIF: {                                       // skip the Block unless true
+      int skip = vmLowCond(vm, flat, exp, 0);
+      vmLowStms(vm, flat, node[exp].end, node[n].end);
+      vmPatch(vm, skip, vm->num);
+      break;
+    }
+    case ASTWHILE: {                                    // test on entry, then at the bottom
+      int skip = vmLowCond(vm, flat, exp, 0);
+      int top  = vm->num;
+      vmLowStms(vm, flat, node[exp].end, node[n].end);
+      vmPatch(vm, vmLowCond(vm, flat, exp, 1), top);
+      vmPatch(vm, skip, vm->num);
+      break;
+    }
+    case ASTRET: {
+      int lhs = exp + 1, v;
+      if (node[lhs].end == node[exp].end) {             // return y  or  return 5
+        if (vmOpnd(vm, flat, lhs, &v)) vmAdd(vm, VMRETI, 0, 0, v);
+        else vmAdd(vm, VMRET, 0, v, 0);
+      } else {
+        int tmp = vm->fun[vm->cur].regs - 1;
+        vmLowExp(vm, flat, exp, tmp);
+        vmAdd(vm, VMRET, 0, tmp, 0);
+      }
+      break;
+    }
+    default:
+      utDie2Str("vmLowStm", "Invalid statement");
+  }
+}
+
+// ============================================================================
+// Lower the statements in nodes [first, end)
+// ============================================================================
+static void vmLowStms(Vm* vm, Flat* flat, int first, int end) {
+  for (int n = first; n < end; n = flat->node[n].end) vmLowStm(vm, flat, n);
+}
+
+// ============================================================================
+// Lower Fun node 'fn', which is fun[f]
+// ============================================================================
+static void vmLowFun(Vm* vm, Flat* flat, int fn, int f) {
+  FlatNode* node = flat->node;                          // alias
+  VmFun* fun = &vm->fun[f];
+  vm->cur = f;
+  fun->entry = vm->num;
+
+  int reg = 0, n = fn + 1;
+  for (; n < (int) node[fn].end && node[n].tag == ASTPAR; n = node[n].end) {
+    vmGrowId(vm, node[n].val);
+    vm->slotOf[node[n].val] = reg++;
+  }
+  for (; n < (int) node[fn].end && node[n].tag == ASTVAR; n = node[n].end) {
+    vmGrowId(vm, node[n].val);
+    vm->slotOf[node[n].val] = reg++;
+  }
+  fun->regs = reg + 1;                                  // and the temp
+  fun->size = fun->regs;
+
+  vmLowStms(vm, flat, n, node[fn].end);
+  vmAdd(vm, VMRETI, 0, 0, 0);                           // fell off the end
+
+  for (n = fn + 1; n < (int) node[fn].end; n = node[n].end) {
+    if (node[n].tag == ASTPAR || node[n].tag == ASTVAR) vm->slotOf[node[n].val] = -1;
+  }
+}
+
+// ============================================================================
+// Lower the program 'flat' to bytecode
+// ============================================================================
+Vm* vmLower(Flat* flat) {
+  FlatNode* node = flat->node;                          // alias
+  Vm* vm = vmNew();
+
+  for (int fn = 1; fn < (int) node[0].end; fn = node[fn].end) {
+    int f = vmAddFun(vm, internStr(node[fn].val));
+    vmGrowId(vm, node[fn].val);
+    vm->funOf[node[fn].val] = f;
+    for (int n = fn + 1; n < (int) node[fn].end && node[n].tag == ASTPAR; n = node[n].end) {
+      ++vm->fun[f].numPars;
+    }
+    if (node[fn].val == INTMAIN) vm->main = f;
+  }
+  if (vm->main < 0) utDie2Str("vmLower", "No function main");
+
+  int f = 0;
+  for (int fn = 1; fn < (int) node[0].end; fn = node[fn].end) vmLowFun(vm, flat, fn, f++);
+
+  free(vm->slotOf); vm->slotOf = NULL;
+  free(vm->funOf);  vm->funOf  = NULL;
+  vm->numId = 0;
+  return vm;
+}
+
+// ============================================================================
+// Write 'v' to 'file' as a little-endian 32-bit word
+// ============================================================================
+static void vmPut(FILE* file, int32_t v) {
+  uint32_t u = (uint32_t) v;
+  uint8_t b[4] = { (uint8_t) u, (uint8_t) (u >> 8), (uint8_t) (u >> 16), (uint8_t) (u >> 24) };
+  fwrite(b, 1, 4, file);
+}
+
+// ============================================================================
+// Write string 's' to 'file': its length, then its chars
+// ============================================================================
+static void vmPutStr(FILE* file, char* s) {
+  int32_t len = (int32_t) strlen(s);
+  vmPut(file, len);
+  fwrite(s, 1, len, file);
+}
+
+// ============================================================================
+// Save the bytecode in 'vm' to the .SBC file 'path'
+// ============================================================================
+void vmSave(Vm* vm, char* path) {
+  FILE* file = fopen(path, "wb");
+  if (!file) utDie2Str("vmSave: Cannot create bytecode file:", path);
+
+  fwrite(VMMAGIC, 1, 8, file);
+  vmPut(file, vm->numFun);
+  vmPut(file, vm->numStr);
+  vmPut(file, vm->num);
+  vmPut(file, vm->main);
+  for (int f = 0; f < vm->numFun; ++f) {
+    VmFun* fun = &vm->fun[f];
+    vmPut(file, fun->entry);
+    vmPut(file, fun->numPars);
+    vmPut(file, fun->regs);
+    vmPut(file, fun->size);
+    vmPutStr(file, fun->name);
+  }
+  for (int s = 0; s < vm->numStr; ++s) vmPutStr(file, vm->str[s]);
+  for (int i = 0; i < vm->num; ++i) {
+    VmIns* ins = &vm->code[i];
+    vmPut(file, ins->op);
+    vmPut(file, ins->a);
+    vmPut(file, ins->b);
+    vmPut(file, ins->c);
+  }
+
+  if (ferror(file)) utDie2Str("vmSave: Cannot write bytecode file:", path);
+  fclose(file);
+}
+
+// ============================================================================
+// Read a little-endian 32-bit word from 'file'
+// ============================================================================
+static int32_t vmGet(FILE* file) {
+  uint8_t b[4];
+  if (fread(b, 1, 4, file) != 4) utDie2Str("vmLoad", "Bytecode file is truncated");
+  return (int32_t) ((uint32_t) b[0] | (uint32_t) b[1] << 8 | (uint32_t) b[2] << 16
+    | (uint32_t) b[3] << 24);
+}
+
+// ============================================================================
+// Read a count from 'file', that must lie in 0 thru 'max'
+// ============================================================================
+static int vmGetNum(FILE* file, int max) {
+  int32_t v = vmGet(file);
+  if (v < 0 || v > max) utDie2Str("vmLoad", "Bad bytecode file");
+  return v;
+}
+
+// ============================================================================
+// Read a string, written by vmPutStr, from 'file'
+// ============================================================================
+static char* vmGetStr(FILE* file) {
+  int len = vmGetNum(file, 1 << 24);
+  char* s = malloc(len + 1);
+  if (!s) utDie2Str("vmLoad", "Out of memory");
+  if (fread(s, 1, len, file) != (size_t) len) utDie2Str("vmLoad", "Bytecode file is truncated");
+  s[len] = '\0';
+  return s;
+}
+
+// ============================================================================
+// Check that operand 'v', of kind 'form' (see vmForms), is valid in
+// function 'fun', whose code is [fun->entry, end).  A branch must stay within
+// its own function: code elsewhere would run on a frame sized for another.
+// ============================================================================
+static int vmValid(Vm* vm, VmFun* fun, int end, char form, int32_t v) {
+  switch (form) {
+    case 'r': return v >= 0 && v < fun->size;
+    case 't': return v >= fun->entry && v < end;
+    case 'f': return v >= 0 && v < vm->numFun;
+    case 's': return v >= 0 && v < vm->numStr;
+    default:  return 1;                                 // 'i', 'n', '-'
+  }
+}
+
+// ============================================================================
+// Load the bytecode in the .SBC file 'path', as written by vmSave.  Every
+// operand is checked, so that vmRun never strays outside its arrays.
+// ============================================================================
+Vm* vmLoad(char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) utDie2Str("vmLoad: Cannot open bytecode file:", path);
+
+  char magic[8];
+  if (fread(magic, 1, 8, file) != 8 || memcmp(magic, VMMAGIC, 8) != 0) {
+    utDie2Str("vmLoad: Not a SubC bytecode file:", path);
+  }
+
+  Vm* vm = vmNew();
+  int numFun = vmGetNum(file, 1 << 24);
+  int numStr = vmGetNum(file, 1 << 24);
+  int num    = vmGetNum(file, 1 << 28);
+  vm->main   = vmGetNum(file, numFun - 1);
+
+  for (int f = 0; f < numFun; ++f) {
+    int entry   = vmGetNum(file, num - 1);
+    int numPars = vmGetNum(file, 1 << 24);
+    int regs    = vmGetNum(file, 1 << 24);
+    int size    = vmGetNum(file, 1 << 24);
+    char* name  = vmGetStr(file);
+    int at      = vmAddFun(vm, name);
+    VmFun* fun  = &vm->fun[at];
+    free(name);
+    fun->entry = entry; fun->numPars = numPars; fun->regs = regs; fun->size = size;
+    if (numPars >= regs || regs > size) utDie2Str("vmLoad", "Bad bytecode file");
+    if (f > 0 && entry <= fun[-1].entry) utDie2Str("vmLoad", "Bad bytecode file");
+  }
+  for (int s = 0; s < numStr; ++s) {
+    char* txt = vmGetStr(file);
+    vmAddStr(vm, txt, (int) strlen(txt));
+    free(txt);
+  }
+  for (int i = 0; i < num; ++i) {
+    int32_t op = vmGet(file);
+    int32_t a  = vmGet(file);
+    int32_t b  = vmGet(file);
+    int32_t c  = vmGet(file);
+    if (op < 0 || op >= VMNUMOP) utDie2Str("vmLoad", "Bad opcode in bytecode file");
+    vmAdd(vm, op, a, b, c);
+  }
+  fclose(file);
+
+  for (int f = 0; f < vm->numFun; ++f) {                // every operand in range
+    VmFun* fun = &vm->fun[f];
+    int end = f + 1 < vm->numFun ? vm->fun[f + 1].entry : vm->num;
+    if (f == 0 && fun->entry != 0) utDie2Str("vmLoad", "Bad bytecode file");
+    if (end <= fun->entry || vm->code[end - 1].op != VMRETI) {
+      utDie2Str("vmLoad", "Bad bytecode file");
+    }
+    for (int i = fun->entry; i < end; ++i) {
+      VmIns* ins = &vm->code[i];
+      char* form = vmForms[ins->op];
+      int ok = vmValid(vm, fun, end, form[0], ins->a)
+        && vmValid(vm, fun, end, form[1], ins->b)
+        && vmValid(vm, fun, end, form[2], ins->c);
+      if (ok && ins->op == VMCALL) {                    // outgoing regs, callee's pars
+        VmFun* callee = &vm->fun[ins->b];
+        ok = ins->c >= 0 && ins->c <= callee->numPars && fun->regs + ins->c <= fun->size;
+      }
+      if (!ok) utDie2Str("vmLoad", "Bad operand in bytecode file");
+    }
+  }
+  return vm;
+}
+
+#ifdef VMTHREADED
+#define VMCASE(op) L##op
+#define VMNEXT     do { ins = &code[pc++]; ++steps; goto *ins->go; } while (0)
+#else
+#define VMCASE(op) case op
+#define VMNEXT     continue
+#endif
+
+#define VMREL(rel)      r[ins->a] = r[ins->b] rel r[ins->c]; VMNEXT
+#define VMRELI(rel)     r[ins->a] = r[ins->b] rel ins->c;    VMNEXT
+#define VMBRANCH(rel)   if (r[ins->b] rel r[ins->c]) pc = ins->a; VMNEXT
+#define VMBRANCHI(rel)  if (r[ins->b] rel ins->c) pc = ins->a;    VMNEXT
+
+// ============================================================================
+// Run the program, from main, until main returns.  Return its result.
+// ============================================================================
+int vmRun(Vm* vm) {
+  VmIns*   code = vm->code;
+  VmFun*   fun  = vm->fun;
+  VmIns*   ins  = NULL;
+  uint64_t steps = 0;
+  int      pc   = fun[vm->main].entry;
+  int      cur  = vm->main;
+  int      base = 0;
+  int32_t  v;
+
+  int      capReg = fun[cur].size > VMMINCAP ? fun[cur].size : VMMINCAP;
+  int32_t* reg  = calloc(capReg, sizeof(int32_t));      // every frame's registers
+  int      numFrame = 0;
+  int      capFrame = VMMINCAP;
+  VmFrame* frame = malloc(capFrame * sizeof(VmFrame));  // every caller
+  if (!reg || !frame) utDie2Str("vmRun", "Out of memory");
+  int32_t* r = reg;                                     // registers of the current call
+  fun[cur].calls = 1;
+
+#ifdef VMTHREADED
+  static void* go[VMNUMOP] = {                          // in VMOP order
+    &&LVMNOP,
+    &&LVMMOV,  &&LVMMOVI,
+    &&LVMADD,  &&LVMADDI, &&LVMSUB,  &&LVMSUBI, &&LVMRSUBI,
+    &&LVMMUL,  &&LVMMULI,
+    &&LVMLT,   &&LVMLTI,  &&LVMLE,   &&LVMLEI,  &&LVMNE,   &&LVMNEI,
+    &&LVMEQ,   &&LVMEQI,  &&LVMGE,   &&LVMGEI,  &&LVMGT,   &&LVMGTI,
+    &&LVMBLT,  &&LVMBLTI, &&LVMBLE,  &&LVMBLEI, &&LVMBNE,  &&LVMBNEI,
+    &&LVMBEQ,  &&LVMBEQI, &&LVMBGE,  &&LVMBGEI, &&LVMBGT,  &&LVMBGTI,
+    &&LVMBZ,   &&LVMBNZ,  &&LVMJMP,
+    &&LVMCALL,
+    &&LVMRET,  &&LVMRETI,
+    &&LVMSAYS, &&LVMSAYN, &&LVMSAYNI, &&LVMSAYL,
+  };
+  for (int i = 0; i < vm->num; ++i) code[i].go = go[code[i].op];
+  VMNEXT;
+#else
+  for (;;) {
+    ins = &code[pc++];
+    ++steps;
+    switch (ins->op) {
+#endif
+
+  VMCASE(VMNOP):   VMNEXT;
+  VMCASE(VMMOV):   r[ins->a] = r[ins->b]; VMNEXT;
+  VMCASE(VMMOVI):  r[ins->a] = ins->c;    VMNEXT;
+
+  VMCASE(VMADD):   r[ins->a] = (int32_t) ((uint32_t) r[ins->b] + (uint32_t) r[ins->c]); VMNEXT;
+  VMCASE(VMADDI):  r[ins->a] = (int32_t) ((uint32_t) r[ins->b] + (uint32_t) ins->c);    VMNEXT;
+  VMCASE(VMSUB):   r[ins->a] = (int32_t) ((uint32_t) r[ins->b] - (uint32_t) r[ins->c]); VMNEXT;
+  VMCASE(VMSUBI):  r[ins->a] = (int32_t) ((uint32_t) r[ins->b] - (uint32_t) ins->c);    VMNEXT;
+  VMCASE(VMRSUBI): r[ins->a] = (int32_t) ((uint32_t) ins->c - (uint32_t) r[ins->b]);    VMNEXT;
+  VMCASE(VMMUL):   r[ins->a] = (int32_t) (int16_t) r[ins->b] * (int16_t) r[ins->c];     VMNEXT;
+  VMCASE(VMMULI):  r[ins->a] = (int32_t) (int16_t) r[ins->b] * (int16_t) ins->c;        VMNEXT;
+
+  VMCASE(VMLT):    VMREL(<);
+  VMCASE(VMLTI):   VMRELI(<);
+  VMCASE(VMLE):    VMREL(<=);
+  VMCASE(VMLEI):   VMRELI(<=);
+  VMCASE(VMNE):    VMREL(!=);
+  VMCASE(VMNEI):   VMRELI(!=);
+  VMCASE(VMEQ):    VMREL(==);
+  VMCASE(VMEQI):   VMRELI(==);
+  VMCASE(VMGE):    VMREL(>=);
+  VMCASE(VMGEI):   VMRELI(>=);
+  VMCASE(VMGT):    VMREL(>);
+  VMCASE(VMGTI):   VMRELI(>);
+
+  VMCASE(VMBLT):   VMBRANCH(<);
+  VMCASE(VMBLTI):  VMBRANCHI(<);
+  VMCASE(VMBLE):   VMBRANCH(<=);
+  VMCASE(VMBLEI):  VMBRANCHI(<=);
+  VMCASE(VMBNE):   VMBRANCH(!=);
+  VMCASE(VMBNEI):  VMBRANCHI(!=);
+  VMCASE(VMBEQ):   VMBRANCH(==);
+  VMCASE(VMBEQI):  VMBRANCHI(==);
+  VMCASE(VMBGE):   VMBRANCH(>=);
+  VMCASE(VMBGEI):  VMBRANCHI(>=);
+  VMCASE(VMBGT):   VMBRANCH(>);
+  VMCASE(VMBGTI):  VMBRANCHI(>);
+  VMCASE(VMBZ):    if (r[ins->b] == 0) pc = ins->a; VMNEXT;
+  VMCASE(VMBNZ):   if (r[ins->b] != 0) pc = ins->a; VMNEXT;
+  VMCASE(VMJMP):   pc = ins->a; VMNEXT;
+
+  VMCASE(VMCALL): {
+    VmFun* callee = &fun[ins->b];
+    int nb = base + fun[cur].regs;                      // callee's frame: our outgoing regs
+    if (nb + callee->size > capReg) {
+      while (nb + callee->size > capReg) capReg *= 2;
+      reg = realloc(reg, capReg * sizeof(int32_t));
+      if (!reg) utDie2Str("vmRun", "Out of memory");
+    }
+    if (numFrame == capFrame) {
+      capFrame *= 2;
+      frame = realloc(frame, capFrame * sizeof(VmFrame));
+      if (!frame) utDie2Str("vmRun", "Out of memory");
+    }
+    frame[numFrame++] = (VmFrame) { pc, base, ins->a, cur };
+    memset(reg + nb + ins->c, 0, (callee->regs - ins->c) * sizeof(int32_t));
+    base = nb;
+    r = reg + base;
+    cur = ins->b;
+    pc = callee->entry;
+    ++callee->calls;
+    VMNEXT;
+  }
+
+  VMCASE(VMRET):
+    v = r[ins->b];
+    goto ret;
+  VMCASE(VMRETI):
+    v = ins->c;
+  ret:
+    if (numFrame == 0) goto done;
+    --numFrame;
+    pc   = frame[numFrame].ret;
+    base = frame[numFrame].base;
+    cur  = frame[numFrame].fun;
+    r = reg + base;
+    r[frame[numFrame].dst] = v;
+    VMNEXT;
+
+  VMCASE(VMSAYS):  fputs(vm->str[ins->b], vm->out);        r[ins->a] = 0; VMNEXT;
+  VMCASE(VMSAYN):  fprintf(vm->out, "%d", r[ins->b]);     r[ins->a] = 0; VMNEXT;
+  VMCASE(VMSAYNI): fprintf(vm->out, "%d", ins->c);        r[ins->a] = 0; VMNEXT;
+  VMCASE(VMSAYL):  fputs("\r\n", vm->out);                r[ins->a] = 0; VMNEXT;
+
+#ifndef VMTHREADED
+    default:
+      utDie2StrInt("vmRun", "Unknown opcode", ins->op);
+    }
+  }
+#endif
+
+done:
+  vm->steps  = steps;
+  vm->result = v;
+  fflush(vm->out);
+  free(reg);
+  free(frame);
+  return v;
+}
+
+// ============================================================================
+// Print the calls made to each function, and the instructions executed
+// ============================================================================
+void vmReport(Vm* vm) {
+  printf("\n");
+  for (int f = 0; f < vm->numFun; ++f) {
+    if (vm->fun[f].calls == 0) continue;
+    printf("Vm: %s %llu calls \n", vm->fun[f].name, (unsigned long long) vm->fun[f].calls);
+  }
+  printf("Vm: total %d instructions of bytecode, %llu executed, main = %d \n",
+    vm->num, (unsigned long long) vm->steps, vm->result);
+}
+
+// ============================================================================
+// Free 'vm', and all it holds
+// ============================================================================
+void vmFree(Vm* vm) {
+  for (int f = 0; f < vm->numFun; ++f) free(vm->fun[f].name);
+  for (int s = 0; s < vm->numStr; ++s) free(vm->str[s]);
+  free(vm->code);
+  free(vm->fun);
+  free(vm->str);
+  free(vm->slotOf);
+  free(vm->funOf);
+  free(vm);
+}
@@ -0,0 +1,120 @@
+// vm.h - Register bytecode, and the VM that runs it
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // int32_t, uint8_t, uint32_t, uint64_t
+#include <stdio.h>          // FILE, fopen, fread, fwrite, fprintf
+#include <stdlib.h>         // calloc, malloc, realloc, free
+#include <string.h>         // memcmp, memset, strlen
+
+#include "ast.h"            // AST, BOP
+#include "flat.h"           // Flat, FlatNode
+#include "fold.h"           // foldBop
+#include "intern.h"         // intern, internStr
+#include "ut.h"             // ut*
+
+// vmLower turns the Flat of a program - once inlined and folded - into
+// bytecode for a register machine.  Each function's pars, then its vars, are
+// its registers, r0 up.  One more, its temp, holds a condition that is not a
+// comparison.  Above those lie its outgoing registers: a call copies its args
+// there, and they become the pars of the callee, whose frame starts at that
+// point.  So a call copies nothing but its args.
+//
+// Each instruction is an opcode and three operands: 'a' is a register, or a
+// branch target (an index into code[]); 'b' and 'c' are registers, or, in
+// the I forms, an immediate in 'c'.  The Asg shapes that cgExp and cgAsg
+// generate each become a single instruction - a superinstruction, that does
+// the work of a load, an op and a store:
+//
+//    x = y             MOV   x, y          x = 5             MOVI  x, 5
+//    x = y + z         ADD   x, y, z       x = y + 5         ADDI  x, y, 5
+//    x = 5 - y         RSUBI x, y, 5       x = y < 5         LTI   x, y, 5
+//
+// and a test, in an If or While, fuses with its branch:
+//
+//    if (y < 5) {...}  BGEI  end, y, 5     jump past the Block unless y < 5
+//
+// A While is rotated, as cgWhile does, so that each trip takes one branch.
+// Values behave just as in the code cg.c generates (see foldBop).
+//
+// vmSave writes the bytecode to a .SBC file, and vmLoad reads it back, so a
+// program can be run again with no lexing, parsing or lowering: "subc -vm
+// prog.SBC".  All values are written as little-endian 32-bit words.
+//
+// Compiled with GCC or Clang, vmRun uses threaded code, as simRun does: each
+// instruction holds the address of its handler.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VMTHREADED 1
+#endif
+
+#define VMMAGIC   "SUBCBC01"        // first 8 bytes of a .SBC file
+#define VMMINCAP  256               // initial slots in each array
+
+typedef enum {
+  VMNOP = 0,
+  VMMOV, VMMOVI,                            // a = b;          a = c
+  VMADD, VMADDI, VMSUB, VMSUBI, VMRSUBI,    // a = b op c;     RSUBI: a = c - b
+  VMMUL, VMMULI,
+  VMLT,  VMLTI,  VMLE,  VMLEI,  VMNE,  VMNEI,       // a = b rel c, as 0 or 1
+  VMEQ,  VMEQI,  VMGE,  VMGEI,  VMGT,  VMGTI,
+  VMBLT, VMBLTI, VMBLE, VMBLEI, VMBNE, VMBNEI,      // if (b rel c) goto a
+  VMBEQ, VMBEQI, VMBGE, VMBGEI, VMBGT, VMBGTI,
+  VMBZ,  VMBNZ,  VMJMP,                     // if (b == 0) goto a ...; goto a
+  VMCALL,                                   // a = fun[b](c args)
+  VMRET, VMRETI,                            // return b;       return c
+  VMSAYS, VMSAYN, VMSAYNI, VMSAYL,          // a = 0, having written str[b], b, c or CR LF
+  VMNUMOP
+} VMOP;
+
+typedef struct {
+  void*   go;                       // handler, for threaded dispatch
+  int32_t op;                       // VMOP
+  int32_t a, b, c;
+} VmIns;
+
+typedef struct {
+  char*    name;
+  int      entry;                   // index in code[] of its first instruction
+  int      numPars;
+  int      regs;                    // pars, vars and the temp
+  int      size;                    // regs, plus the most outgoing args of any call
+  uint64_t calls;                   // times called
+} VmFun;
+
+typedef struct {
+  int32_t ret;                      // index in code[] to return to
+  int32_t base;                     // first register of the caller's frame
+  int32_t dst;                      // caller's register for the result
+  int32_t fun;                      // index in fun[] of the caller
+} VmFrame;
+
+typedef struct {
+  int      num;                     // instructions in use
+  int      cap;                     // slots in code[]
+  VmIns*   code;
+  int      numFun;                  // functions in use
+  int      capFun;                  // slots in fun[]
+  VmFun*   fun;
+  int      numStr;                  // string literals in use
+  int      capStr;                  // slots in str[]
+  char**   str;
+  int      main;                    // index in fun[] of main
+
+  int      numId;                   // vmLower: slots in slotOf[] and funOf[]
+  int*     slotOf;                  // vmLower: intern ID => register of the current function (-1 => none)
+  int*     funOf;                   // vmLower: intern ID => index in fun[] (-1 => none)
+  int      cur;                     // vmLower: index in fun[] of the function being lowered
+
+  FILE*    out;                     // where SAYS, SAYN and SAYL write (vmNew: stdout)
+  uint64_t steps;                   // instructions executed
+  int      result;                  // value returned by main
+} Vm;
+
+void vmFree(Vm* vm);
+Vm*  vmLoad(char* path);
+Vm*  vmLower(Flat* flat);
+void vmReport(Vm* vm);
+int  vmRun(Vm* vm);
+void vmSave(Vm* vm, char* path);
@@ -0,0 +1,108 @@
+#!/bin/bash
+
+# Bytecode loader checks
+#
+# Saves the bytecode for each program in ../Tests, and checks that it loads
+# and runs again from its .SBC file, with the same output.  Then hands vmLoad
+# hand-made .SBC files that are well-formed, but unsafe to run, and checks
+# that each is rejected rather than run.
+#
+# Usage: bash vmtest.sh          (run from the P4 folder)
+
+. ./build.sh
+build subc-vmtest || exit 1
+dir=$(mktemp -d)
+fail=0
+
+# Write each argument as a little-endian 32-bit word
+
+word() {
+  for v in "$@"; do
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $((v & 255)) $((v >> 8 & 255)) \
+      $((v >> 16 & 255)) $((v >> 24 & 255)))"
+  done
+}
+
+# Expect "subc -vm file" to stop with a message that holds 'want'
+
+reject() {
+  local name=$1 want=$2
+  out=$(./subc-vmtest -vm $dir/$name.SBC < /dev/null 2>&1)
+  if echo "$out" | grep -q "$want"; then
+    echo "ok    $name"
+  else
+    echo "FAIL  $name: $out" | head -3; fail=1
+  fi
+}
+
+# Round trip: lower, save and run; then load and run the .SBC.  The second
+# run's output - the program's, then the report - must end the first's.
+
+for src in ../Tests/test*.subc; do
+  b=$(basename $src .subc)
+  [ "$b" = testr ] && continue                    # no main
+  cp $src $dir/$b.subc
+  (cd $dir && $OLDPWD/subc-vmtest -vm $b.subc < /dev/null > $b.first)
+  (cd $dir && $OLDPWD/subc-vmtest -vm $b.SBC  < /dev/null > $b.again)
+  n=$(wc -l < $dir/$b.again)                      # less its unterminated last line
+  if [ -s $dir/$b.SBC ] && tail -n $((n + 1)) $dir/$b.first | cmp -s - $dir/$b.again; then
+    echo "ok    $b.SBC"
+  else
+    echo "FAIL  $b.SBC"; fail=1
+  fi
+done
+
+# The number of opcode VM<name>: its place in the VMOP enum in vm.h
+
+op() {
+  awk -v want=VM$1 '
+    /^typedef enum/ { inside = 1; n = 0; next }
+    inside && /} VMOP;/ { exit 1 }
+    inside {
+      sub(/\/\/.*/, "")
+      k = split($0, names, ",")
+      for (i = 1; i <= k; ++i) {
+        name = names[i]; gsub(/[ \t]/, "", name); sub(/=.*/, "", name)
+        if (name == "") continue
+        if (name == want) { print n; exit 0 }
+        ++n
+      }
+    }' vm.h || { echo "vmtest: no VM$1 in the VMOP enum of vm.h" >&2; exit 1; }
+}
+
+MOVI=$(op MOVI) && JMP=$(op JMP) && CALL=$(op CALL) && RETI=$(op RETI) || exit 1
+
+# main branches into g, whose frame is 16M registers, and g writes one of them
+# on the frame that main sized for 1 register
+
+{ printf "SUBCBC01"; word 2 0 4 0
+  word 0 0 1 1 4; printf "main"
+  word 2 0 1 16777216 1; printf "g"
+  word $JMP 2 0 0   $RETI 0 0 0
+  word $MOVI 10000000 0 42   $RETI 0 0 0
+} > $dir/jumpout.SBC
+reject jumpout "Bad operand"
+
+# The same, with the branch target before main's own code: g is first
+
+{ printf "SUBCBC01"; word 2 0 4 1
+  word 0 0 1 16777216 1; printf "g"
+  word 2 0 1 1 4; printf "main"
+  word $MOVI 10000000 0 42   $RETI 0 0 0
+  word $JMP 0 0 0   $RETI 0 0 0
+} > $dir/jumpback.SBC
+reject jumpback "Bad operand"
+
+# A call is fine: it enters g at its entry, on a frame of g's own size
+
+{ printf "SUBCBC01"; word 2 0 4 0
+  word 0 0 1 1 4; printf "main"
+  word 2 0 1 16 1; printf "g"
+  word $CALL 0 1 0   $RETI 0 0 0
+  word $MOVI 15 0 42   $RETI 0 0 0
+} > $dir/call.SBC
+out=$(./subc-vmtest -vm $dir/call.SBC < /dev/null 2>&1)
+if echo "$out" | grep -q "main = 0"; then echo "ok    call"; else echo "FAIL  call: $out"; fail=1; fi
+
+rm -rf $dir subc-vmtest
+exit $fail
@@ -0,0 +1,757 @@
+// x64.c - Code Generator for x86-64 Linux
+
+#include "x64.h"
+
+// Names of the registers that D2 thru D7 map onto, by width (see x64.h)
+
+static char* x64Reg16[] = { "", "", "%bx",  "%bp",  "%r12w", "%r13w", "%r14w", "%r15w" };
+static char* x64Reg32[] = { "", "", "%ebx", "%ebp", "%r12d", "%r13d", "%r14d", "%r15d" };
+static char* x64Reg64[] = { "", "", "%rbx", "%rbp", "%r12",  "%r13",  "%r14",  "%r15"  };
+
+static char* x64ArgReg[X64NUMARGREGS] = { "%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d" };
+
+// ============================================================================
+// The condition code for relational operator 'bop' - eg: BOPLT => "l", which
+// makes "jl" and "setl"
+// ============================================================================
+static char* x64Cc(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return "l";
+    case BOPLE:  return "le";
+    case BOPNE:  return "ne";
+    case BOPEEQ: return "e";
+    case BOPGE:  return "ge";
+    default:     return "g";                            // BOPGT
+  }
+}
+
+// ============================================================================
+// The relational operator that holds when 'bop' fails - eg: < => >=
+// ============================================================================
+static BOP x64Inverse(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return BOPGE;
+    case BOPLE:  return BOPGT;
+    case BOPNE:  return BOPEEQ;
+    case BOPEEQ: return BOPNE;
+    case BOPGE:  return BOPLT;
+    default:     return BOPLE;                          // BOPGT
+  }
+}
+
+// ============================================================================
+// The relational operator that holds with its operands swapped - eg: < => >
+// ============================================================================
+static BOP x64Mirror(BOP bop) {
+  switch (bop) {
+    case BOPLT:  return BOPGT;
+    case BOPLE:  return BOPGE;
+    case BOPGE:  return BOPLE;
+    case BOPGT:  return BOPLT;
+    default:     return bop;                            // ==, !=
+  }
+}
+
+// ============================================================================
+// Emit the instruction 'op', with up to two operands - eg: "addl $1, %ebx"
+// ============================================================================
+static void x64Ins(X64* x64, char* op, char* src, char* dst) {
+  char line[X64MAXLINE];
+  if (dst)      sprintf(line, "\t%s\t%s, %s", op, src, dst);
+  else if (src) sprintf(line, "\t%s\t%s", op, src);
+  else          sprintf(line, "\t%s", op);
+  emitCode(x64->emit, line);
+}
+
+// ============================================================================
+// Emit the label 'label' - eg: ".L20:"
+// ============================================================================
+static void x64Label(X64* x64, int label) {
+  char line[32];
+  sprintf(line, ".L%d:", label);
+  emitCode(x64->emit, line);
+}
+
+// ============================================================================
+// Emit a jump, "j<cc>" or "jmp", to 'label'
+// ============================================================================
+static void x64Jump(X64* x64, char* op, int label) {
+  char line[32];
+  sprintf(line, "\t%s\t.L%d", op, label);
+  emitCode(x64->emit, line);
+}
+
+// ============================================================================
+// Generate a fresh label number.  The sequence is 20, 30, 40, etc, as for
+// cgLabel.
+// ============================================================================
+static int x64NewLabel(X64* x64) {
+  x64->label += 10;
+  return x64->label;
+}
+
+// ============================================================================
+// Emit the string literal 'txt', under a fresh label, into the read-only data
+// section.  Return the label.  Eg:
+//
+//    .L50:
+//            .asciz  "hello"
+// ============================================================================
+static int x64DataString(X64* x64, char* txt) {
+  Emit* emit = x64->emit;                               // alias
+  if (emit->data.bytes == 0) emitData(emit, "\t.section\t.rodata");
+
+  int label = x64NewLabel(x64);
+  char line[32];
+  sprintf(line, ".L%d:", label);
+  emitData(emit, line);
+
+  // Text within quotes may not hold a quote or a backslash as it is, nor any
+  // char that is not printable: write each of those as an octal escape
+
+  size_t len = strlen(txt);
+  char* asciz = malloc(4 * len + 16);
+  if (!asciz) utDie2Str("x64DataString", "Out of memory");
+  char* p = asciz + sprintf(asciz, "\t.asciz\t\"");
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char c = (unsigned char) txt[i];
+    if (c < ' ' || c > '~' || c == '"' || c == '\\') p += sprintf(p, "\\%03o", c);
+    else *p++ = (char) c;
+  }
+  strcpy(p, "\"");
+  emitData(emit, asciz);
+  free(asciz);
+  return label;
+}
+
+// ============================================================================
+// The value of leaf 'n', if it is a Num; 0 for a Str
+// ============================================================================
+static int x64Val(X64* x64, int n) {
+  FlatNode* node = &x64->flat->node[n];
+  return node->tag == ASTNUM ? node->val : 0;
+}
+
+// ============================================================================
+// Write into 'buf' the operand for leaf 'n' (a Nam, Num or Str), 'size' bits
+// wide (16 or 32) - eg: "%ebx", "12(%rsp)", "$5".  A Str is "$0".  Return
+// what kind of operand it is.
+// ============================================================================
+static X64KIND x64Opnd(X64* x64, int n, int size, char* buf) {
+  FlatNode* node = &x64->flat->node[n];
+  if (node->tag != ASTNAM) {
+    int val = x64Val(x64, n);
+    sprintf(buf, "$%d", size == 16 ? (int) (int16_t) val : val);
+    return X64IMM;
+  }
+
+  LaySym* sym = layFindVarPar(x64->lay, x64->funid, node->val);
+  if (sym->reg) {
+    strcpy(buf, size == 16 ? x64Reg16[sym->reg] : x64Reg32[sym->reg]);
+    return X64REG;
+  }
+  sprintf(buf, "%d(%%rsp)", sym->off);
+  return X64MEM;
+}
+
+// ============================================================================
+// Copy 'src', of kind 'sk', to 'dst', of kind 'dk'.  Memory to memory goes
+// through EAX.
+// ============================================================================
+static void x64Move(X64* x64, char* src, X64KIND sk, char* dst, X64KIND dk) {
+  if (strcmp(src, dst) == 0) return;
+  if (sk == X64MEM && dk == X64MEM) {
+    x64Ins(x64, "movl", src, "%eax");
+    src = "%eax";
+  }
+  if (sk == X64IMM && dk == X64REG && strcmp(src, "$0") == 0) {
+    x64Ins(x64, "xorl", dst, dst);
+    return;
+  }
+  x64Ins(x64, "movl", src, dst);
+}
+
+// ============================================================================
+// Exp => NamNum | NamNum Bop NamNum
+//
+// Evaluate Exp node 'exp' into 'dst', of kind 'dk'.  Where 'dst' is a
+// register that no operand names, the work is done in place; otherwise in
+// EAX.  Eg: "x = y - 5", with 'x' in EBX, and 'y' in the frame, becomes:
+//
+//    movl    8(%rsp), %ebx
+//    subl    $5, %ebx
+//
+// A comparison yields 1 for TRUE and 0 for FALSE:
+//
+//    cmpl    $5, %r12d
+//    setl    %al
+//    movzbl  %al, %ebx
+// ============================================================================
+static void x64Exp(X64* x64, int exp, char* dst, X64KIND dk) {
+  FlatNode* node = x64->flat->node;                     // alias
+  int end = node[exp].end;
+  int lhs = exp + 1;
+  int rhs = lhs < end ? (int) node[lhs].end : lhs;
+  char l[X64MAXOPND], r[X64MAXOPND];
+
+  X64KIND lk = x64Opnd(x64, lhs, 32, l);
+  if (rhs == end) {                                     // x = y  or  x = 5
+    x64Move(x64, l, lk, dst, dk);
+    return;
+  }
+
+  BOP bop = node[exp].bop;
+  X64KIND rk = x64Opnd(x64, rhs, 32, r);
+  if (lk == X64IMM && rk == X64IMM) {                   // not folded: fold it now
+    sprintf(l, "$%d", foldBop(bop, x64Val(x64, lhs), x64Val(x64, rhs)));
+    x64Move(x64, l, X64IMM, dst, dk);
+    return;
+  }
+
+  // Swap the operands of + and *, if that lets the work be done in place, or
+  // puts a Num on the right
+
+  if ((bop == BOPADD || bop == BOPMUL) && (lk == X64IMM || strcmp(dst, r) == 0)) {
+    int t = lhs; lhs = rhs; rhs = t;
+    lk = x64Opnd(x64, lhs, 32, l);
+    rk = x64Opnd(x64, rhs, 32, r);
+  }
+  char* acc = dk == X64REG && strcmp(dst, r) != 0 ? dst : "%eax";
+  char* op  = bop == BOPADD ? "addl" : "subl";
+
+  if ((bop == BOPADD || bop == BOPSUB) && dk == X64MEM && rk != X64MEM
+    && strcmp(dst, l) == 0) {                           // x = x + 1: in memory
+    x64Ins(x64, op, r, dst);
+    return;
+  }
+  if (bop == BOPADD || bop == BOPSUB) {
+    x64Move(x64, l, lk, acc, X64REG);
+    x64Ins(x64, op, r, acc);
+  } else if (bop == BOPMUL) {                           // low 16 bits of each, as MULS
+    acc = dk == X64REG ? dst : "%eax";
+    x64Opnd(x64, lhs, 16, l);
+    x64Opnd(x64, rhs, 16, r);
+    if (rk == X64IMM) {
+      x64Ins(x64, "movswl", l, acc);
+      char three[2 * X64MAXOPND];
+      sprintf(three, "%s, %s", r, acc);
+      x64Ins(x64, "imull", three, acc);
+    } else {
+      x64Ins(x64, "movswl", r, "%ecx");
+      x64Ins(x64, "movswl", l, acc);
+      x64Ins(x64, "imull", "%ecx", acc);
+    }
+  } else {                                              // relational
+    if (lk == X64IMM) {                                 // 5 < y  =>  y > 5
+      char t[X64MAXOPND];
+      strcpy(t, l); strcpy(l, r); strcpy(r, t);
+      lk = rk;
+      bop = x64Mirror(bop);
+    }
+    if (lk == X64MEM && rk == X64MEM) {
+      x64Ins(x64, "movl", l, "%eax");
+      strcpy(l, "%eax");
+    }
+    char set[8];
+    sprintf(set, "set%s", x64Cc(bop));
+    x64Ins(x64, "cmpl", r, l);
+    x64Ins(x64, set, "%al", NULL);
+    acc = dk == X64REG ? dst : "%eax";
+    x64Ins(x64, "movzbl", "%al", acc);
+  }
+  x64Move(x64, acc, X64REG, dst, dk);
+}
+
+// ============================================================================
+// Emit code to test the condition 'exp' of an If or While, and to jump to
+// 'label' if its truth matches 'jumpif' (0 => jump if FALSE, 1 => jump if
+// TRUE).  As in cgCond, a comparison becomes a compare and a conditional
+// jump, and a constant needs no test at all.
+// ============================================================================
+static void x64Cond(X64* x64, int exp, int label, int jumpif) {
+  FlatNode* node = x64->flat->node;                     // alias
+  int end = node[exp].end;
+  int lhs = exp + 1;
+  int rhs = lhs < end ? (int) node[lhs].end : lhs;
+  BOP bop = node[exp].bop;
+  char l[X64MAXOPND], r[X64MAXOPND];
+
+  X64KIND lk = x64Opnd(x64, lhs, 32, l);
+  if (rhs == end) {                                     // test a value against 0
+    if (lk == X64IMM) {
+      if ((x64Val(x64, lhs) != 0) == jumpif) x64Jump(x64, "jmp", label);
+      return;
+    }
+    x64Ins(x64, "cmpl", "$0", l);
+    x64Jump(x64, jumpif ? "jne" : "je", label);
+    return;
+  }
+
+  if (bop < BOPLT) {                                    // arithmetic: test against 0
+    x64Exp(x64, exp, "%eax", X64REG);
+    x64Ins(x64, "testl", "%eax", "%eax");
+    x64Jump(x64, jumpif ? "jne" : "je", label);
+    return;
+  }
+
+  if (!jumpif) bop = x64Inverse(bop);
+  X64KIND rk = x64Opnd(x64, rhs, 32, r);
+  if (lk == X64IMM && rk == X64IMM) {
+    if (foldBop(bop, x64Val(x64, lhs), x64Val(x64, rhs))) x64Jump(x64, "jmp", label);
+    return;
+  }
+  if (lk == X64IMM) {                                   // 5 < y  =>  y > 5
+    char t[X64MAXOPND];
+    strcpy(t, l); strcpy(l, r); strcpy(r, t);
+    lk = rk;
+    bop = x64Mirror(bop);
+  }
+  if (lk == X64MEM && rk == X64MEM) {
+    x64Ins(x64, "movl", l, "%eax");
+    strcpy(l, "%eax");
+  }
+  char jcc[8];
+  sprintf(jcc, "j%s", x64Cc(bop));
+  x64Ins(x64, "cmpl", r, l);
+  x64Jump(x64, jcc, label);
+}
+
+// ============================================================================
+// Load the args of Call node 'call' where its callee expects them.  They are
+// all pars, vars or literals, none of them held in an arg register, so they
+// may be loaded in any order.  Args beyond the sixth are stored into the
+// outgoing slots at the bottom of the frame.
+// ============================================================================
+static void x64Args(X64* x64, int call) {
+  FlatNode* node = x64->flat->node;                     // alias
+  int id = node[call].val;
+  if (id >= x64->numId || x64->numPars[id] < 0) {
+    utDie5Str("x64Args", "Cannot find function", internStr(id),
+      "called in function", internStr(x64->funid));
+  }
+
+  int numpar = x64->numPars[id];
+  int arg = call + 1;
+  if (id == intern("says") && (arg == (int) node[call].end || node[arg].tag != ASTSTR)) {
+    utDie2Str("x64Args", "says needs a string");
+  }
+  char src[X64MAXOPND], slot[X64MAXOPND];
+  for (int k = 0; k < numpar; ++k) {
+    X64KIND sk = X64IMM;
+    strcpy(src, "$0");                                  // missing => 0
+    if (arg < (int) node[call].end) {
+      if (id == intern("says")) {
+        sprintf(src, ".L%d(%%rip)", x64DataString(x64, x64->flat->str[node[arg].val]));
+        x64Ins(x64, "leaq", src, "%rdi");
+        arg = node[arg].end;
+        continue;
+      }
+      sk = x64Opnd(x64, arg, 32, src);
+      arg = node[arg].end;
+    }
+    if (k < X64NUMARGREGS) {
+      x64Move(x64, src, sk, x64ArgReg[k], X64REG);
+    } else {
+      sprintf(slot, "%d(%%rsp)", 8 * (k - X64NUMARGREGS));
+      x64Move(x64, src, sk, slot, X64MEM);
+    }
+  }
+}
+
+// ============================================================================
+// Call => Nam "(" Args ")"
+//
+// Emit code to call the function named by Call node 'call', and to copy its
+// result, from EAX, to 'dst', of kind 'dk'.  Eg: "s = add3(a, 5, c)", with
+// 'a' in EBX and 'c' in the frame:
+//
+//    movl    %ebx, %edi
+//    movl    $5, %esi
+//    movl    4(%rsp), %edx
+//    call    add3
+//    movl    %eax, 8(%rsp)
+//
+// x64Args loads the args.
+// ============================================================================
+static void x64Call(X64* x64, int call, char* dst, X64KIND dk) {
+  x64Args(x64, call);
+  x64Ins(x64, "call", internStr(x64->flat->node[call].val), NULL);
+  x64Move(x64, "%eax", X64REG, dst, dk);
+}
+
+// ============================================================================
+// Emit the Epilog: free the frame, restore the registers that the Prolog
+// saved, and return - or, for a tail call, jump to 'tail' (NULL => return).
+// Eg:
+//
+//    addq    $24, %rsp
+//    popq    %r12
+//    popq    %rbx
+//    ret
+// ============================================================================
+static void x64Epilog(X64* x64, char* tail) {
+  char imm[16];
+  if (x64->frame) {
+    sprintf(imm, "$%d", x64->frame);
+    x64Ins(x64, "addq", imm, "%rsp");
+  }
+  for (int reg = RALASTREG; reg >= RAFIRSTREG; --reg) {
+    if (x64->regs & (1 << reg)) x64Ins(x64, "popq", x64Reg64[reg], NULL);
+  }
+  if (tail) x64Ins(x64, "jmp", tail, NULL);
+  else x64Ins(x64, "ret", NULL, NULL);
+}
+
+// ============================================================================
+// Is statement 'n' the first half of a tail call - "x = f(a, b); return x;" -
+// that x64Tail can compile?  'end' is the end of its list of statements.
+// Return the node of the Call if so, else 0.  As in cgTailCall, main is
+// excluded.  A call to another function must pass all of its args in
+// registers, since the stack args above our return address are our
+// caller's to pop; and says is excluded, since its arg is a string.
+// ============================================================================
+static int x64TailCall(X64* x64, int n, int end) {
+  FlatNode* node = x64->flat->node;                     // alias
+  if (x64->funid == INTMAIN) return 0;
+  if (node[n].tag != ASTASG || node[n + 1].tag != ASTCALL) return 0;
+
+  int ret = node[n].end;
+  if (ret >= end || node[ret].tag != ASTRET) return 0;
+  int exp = ret + 1;
+  if (node[exp].end != (uint32_t) exp + 2) return 0;                 // single leaf
+  if (node[exp + 1].tag != ASTNAM || node[exp + 1].val != node[n].val) return 0;
+
+  int call = n + 1;
+  int id   = node[call].val;
+  if (id >= x64->numId || x64->numPars[id] < 0 || id == intern("says")) return 0;
+  if (id != x64->funid && x64->numPars[id] > X64NUMARGREGS) return 0;
+  return call;
+}
+
+// ============================================================================
+// Emit the tail call at Call node 'call' (see x64TailCall), so that the stack
+// does not grow.  The args are loaded just as for x64Call.  For a call to the
+// current function, they then move to the homes of its pars, as the Prolog
+// moves them, and control loops back to the top of the body.  Eg: "r =
+// tr(m, b); return r;", with 'a' and 'b' its pars, in EBX and EBP, and 'm'
+// in the frame:
+//
+//    movl    0(%rsp), %edi
+//    movl    %ebp, %esi
+//    movl    %edi, %ebx
+//    movl    %esi, %ebp
+//    jmp     .L20
+//
+// For a call to another function, the Epilog frees our frame, and JMPs to
+// the callee, which returns straight to our caller.
+// ============================================================================
+static void x64Tail(X64* x64, int call) {
+  FlatNode* node = x64->flat->node;                     // alias
+  int id = node[call].val;
+  x64Args(x64, call);
+  if (id != x64->funid) {
+    x64Epilog(x64, internStr(id));
+    return;
+  }
+
+  LayScope* scope = layFindFun(x64->lay, x64->funid)->scope;
+  char home[X64MAXOPND], slot[X64MAXOPND];
+  int k = 0;
+  for (int c = x64->fun + 1; node[c].tag == ASTPAR; c = node[c].end, ++k) {
+    LaySym* sym = layFind(scope, node[c].val);
+    X64KIND hk = sym->reg ? X64REG : X64MEM;
+    if (sym->reg) strcpy(home, x64Reg32[sym->reg]);
+    else sprintf(home, "%d(%%rsp)", sym->off);
+    if (k < X64NUMARGREGS) {
+      x64Move(x64, x64ArgReg[k], X64REG, home, hk);
+    } else {
+      sprintf(slot, "%d(%%rsp)", 8 * (k - X64NUMARGREGS));
+      x64Move(x64, slot, X64MEM, home, hk);
+    }
+  }
+  x64Jump(x64, "jmp", x64->toplabel);
+}
+
+static void x64Stms(X64* x64, int first, int end);
+
+// ============================================================================
+// Stm => If | Asg | Ret | While
+//
+// A While is rotated, as in cgWhile, so that each trip takes just the one
+// conditional jump, back to the top.
+// ============================================================================
+static void x64Stm(X64* x64, int n) {
+  FlatNode* node = x64->flat->node;                     // alias
+  int exp = n + 1;
+  char dst[X64MAXOPND];
+
+  switch (node[n].tag) {
+    case ASTASG: {
+      LaySym* var = layFindVarPar(x64->lay, x64->funid, node[n].val);
+      X64KIND dk = var->reg ? X64REG : X64MEM;
+      if (var->reg) strcpy(dst, x64Reg32[var->reg]);
+      else sprintf(dst, "%d(%%rsp)", var->off);
+      if (node[exp].tag == ASTCALL) x64Call(x64, exp, dst, dk);
+      else x64Exp(x64, exp, dst, dk);
+      break;
+    }
+    case ASTIF: {
+      int exitlabel = x64NewLabel(x64);
+      x64Cond(x64, exp, exitlabel, 0);                  // FALSE => exit
+      x64Stms(x64, node[exp].end, node[n].end);
+      x64Label(x64, exitlabel);
+      break;
+    }
+    case ASTWHILE: {
+      int exitlabel = x64NewLabel(x64);
+      int toplabel  = x64NewLabel(x64);
+      x64Cond(x64, exp, exitlabel, 0);                  // guard: FALSE => exit
+      x64Label(x64, toplabel);
+      x64Stms(x64, node[exp].end, node[n].end);
+      x64Cond(x64, exp, toplabel, 1);                   // TRUE => loop
+      x64Label(x64, exitlabel);
+      break;
+    }
+    case ASTRET:
+      x64Exp(x64, exp, "%eax", X64REG);
+      x64Epilog(x64, NULL);
+      break;
+    default:
+      utDie2Str("x64Stm", "Invalid statement kind");
+  }
+}
+
+// ============================================================================
+// Emit code for the statements in nodes [first, end)
+// ============================================================================
+static void x64Stms(X64* x64, int first, int end) {
+  FlatNode* node = x64->flat->node;                     // alias
+  for (int n = first; n < end; n = node[n].end) {
+    int call = x64TailCall(x64, n, end);
+    if (call) {
+      x64Tail(x64, call);
+      n = node[n].end;                                  // skip Ret
+      continue;
+    }
+    x64Stm(x64, n);
+  }
+}
+
+// ============================================================================
+// Lay out the frame of the function at node 'fun' (see x64.h), and emit its
+// Prolog: save the registers it uses, reserve the frame, then move each par
+// to its home.  LaySym.off becomes the offset from
+// RSP of each par or var not held in a register.
+// ============================================================================
+static void x64Prolog(X64* x64, int fun) {
+  FlatNode* node = x64->flat->node;                     // alias
+  LayScope* scope = layFindFun(x64->lay, x64->funid)->scope;
+
+  int pushed = 0;
+  for (int reg = RAFIRSTREG; reg <= RALASTREG; ++reg) {
+    if (x64->regs & (1 << reg)) ++pushed;
+  }
+
+  int out = 0;                                          // outgoing arg slots
+  for (int n = fun + 1; n < (int) node[fun].end; ++n) {
+    if (node[n].tag != ASTCALL || node[n].val >= x64->numId) continue;
+    int over = x64->numPars[node[n].val] - X64NUMARGREGS;
+    if (over > out) out = over;
+  }
+
+  int off = 8 * out;                                    // pars and vars, above those
+  int k = 0;
+  for (int c = fun + 1; c < (int) node[fun].end; c = node[c].end, ++k) {
+    if (node[c].tag != ASTPAR && node[c].tag != ASTVAR) break;
+    LaySym* sym = layFind(scope, node[c].val);
+    if (sym->reg || (node[c].tag == ASTPAR && k >= X64NUMARGREGS)) continue;
+    sym->off = off;
+    off += 4;
+  }
+
+  // RSP is 8 beyond a multiple of 16 on entry, just after the call.  Keep it
+  // a multiple of 16 from the end of the Prolog onward.
+
+  x64->frame = (off + 15) & ~15;
+  if ((8 + 8 * pushed + x64->frame) % 16) x64->frame += 8;
+
+  char line[X64MAXLINE];
+  sprintf(line, "%s:", internStr(x64->funid));
+  emitCode(x64->emit, line);
+  for (int reg = RAFIRSTREG; reg <= RALASTREG; ++reg) {
+    if (x64->regs & (1 << reg)) x64Ins(x64, "pushq", x64Reg64[reg], NULL);
+  }
+  if (x64->frame) {
+    char imm[16];
+    sprintf(imm, "$%d", x64->frame);
+    x64Ins(x64, "subq", imm, "%rsp");
+  }
+
+  char home[X64MAXOPND];
+  k = 0;
+  for (int c = fun + 1; c < (int) node[fun].end; c = node[c].end, ++k) {
+    if (node[c].tag != ASTPAR && node[c].tag != ASTVAR) break;
+    LaySym* sym = layFind(scope, node[c].val);
+    X64KIND hk = sym->reg ? X64REG : X64MEM;
+    if (node[c].tag == ASTPAR && k >= X64NUMARGREGS) {  // arrived on the stack
+      sym->off = x64->frame + 8 * pushed + 8 + 8 * (k - X64NUMARGREGS);
+      if (sym->reg) {
+        sprintf(home, "%d(%%rsp)", sym->off);
+        x64Ins(x64, "movl", home, x64Reg32[sym->reg]);
+      }
+      continue;
+    }
+    if (node[c].tag == ASTVAR) continue;
+    if (sym->reg) strcpy(home, x64Reg32[sym->reg]);
+    else sprintf(home, "%d(%%rsp)", sym->off);
+    x64Move(x64, x64ArgReg[k], X64REG, home, hk);
+  }
+}
+
+// ============================================================================
+// Fun => "int"   Nam     "(" Pars ")" Body
+//      | "int"   "main"  "("      ")" Body
+// ============================================================================
+static void x64Fun(X64* x64, int fun) {
+  FlatNode* node = x64->flat->node;                     // alias
+  x64->funid = node[fun].val;
+  x64->fun   = fun;
+  if (strlen(internStr(x64->funid)) > X64MAXNAME) {
+    utDie3Str("x64Fun", "Name too long:", internStr(x64->funid));
+  }
+
+  layBuild(x64->lay, x64->flat, fun);                   // pars and vars
+  x64->regs = raFun(x64->lay, x64->flat, fun);          // hot ones in D2-D7
+  x64Prolog(x64, fun);
+
+  // A self tail call loops back to the top of the body (see x64Tail)
+
+  x64->toplabel = 0;
+  for (int n = fun + 1; n < (int) node[fun].end; ++n) {
+    if (node[n].tag == ASTCALL && node[n].val == x64->funid && !x64->toplabel) {
+      x64->toplabel = x64NewLabel(x64);
+    }
+  }
+  if (x64->toplabel) x64Label(x64, x64->toplabel);
+
+  int stm = fun + 1;
+  while (node[stm].tag == ASTPAR || node[stm].tag == ASTVAR) ++stm;
+  x64Stms(x64, stm, node[fun].end);
+
+  int last = stm;                                       // fell off the end => 0
+  while ((int) node[last].end < (int) node[fun].end) last = node[last].end;
+  if (node[last].tag != ASTRET) {
+    x64Ins(x64, "xorl", "%eax", "%eax");
+    x64Epilog(x64, NULL);
+  }
+  emitCode(x64->emit, "");
+}
+
+// ============================================================================
+// Free 'x64', and all it holds
+// ============================================================================
+void x64Free(X64* x64) {
+  free(x64->numPars);
+  free(x64);
+}
+
+// ============================================================================
+// Build a new X64 code generator
+// ============================================================================
+X64* x64New() {
+  X64* x64 = calloc(1, sizeof(X64));
+  if (!x64) utDie2Str("x64New", "Out of memory");
+  x64->lay   = layNew();
+  x64->emit  = emitNew();
+  x64->label = 10;
+  return x64;
+}
+
+// ============================================================================
+// Decide what to call the output assembler file.  So, if the input source
+// file is "Tests\test01.subc" then name the output file "test01.s"
+// ============================================================================
+char* x64NewName(char* sourcePath) {
+  char* path = emitNewName(sourcePath);                 // eg: "test01.X68"
+  strcpy(strrchr(path, '.') + 1, "s");
+  return path;
+}
+
+// ============================================================================
+// Find the runtime, Tests/io.s, for the program whose source is at
+// 'sourcePath', as asmInclude finds an INCLUDE file: first relative to the
+// current folder; then relative to the folder of 'sourcePath', and each of
+// its parents; then as just "io.s" in those same folders.  Return its path,
+// in a buffer the caller must free.  So "subc -target x64 ../Tests/test15.subc"
+// finds ../Tests/io.s, from any folder.
+// ============================================================================
+char* x64FindRuntime(char* sourcePath) {
+  if (strlen(sourcePath) + 3 * X64MAXUP + 16 >= X64MAXPATH) {
+    utDie3Str("x64FindRuntime", "Path too long:", sourcePath);
+  }
+  char* path = malloc(X64MAXPATH);
+  char dir[X64MAXPATH];
+  if (!path) utDie2Str("x64FindRuntime", "Out of memory");
+
+  strcpy(path, X64RUNTIME);
+  FILE* file = fopen(path, "r");
+  if (file) { fclose(file); return path; }
+
+  strcpy(dir, sourcePath);
+  for (char* p = dir; *p; ++p) if (*p == '\\') *p = '/';
+  char* slash = strrchr(dir, '/');
+  if (slash) slash[1] = 0; else strcpy(dir, "./");
+
+  char* base = strrchr(X64RUNTIME, '/') + 1;            // "io.s"
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t dlen = strlen(dir);
+    for (int up = 0; up <= X64MAXUP; ++up) {
+      sprintf(path, "%s%s", dir, pass == 0 ? X64RUNTIME : base);
+      file = fopen(path, "r");
+      if (file) { fclose(file); return path; }
+      strcat(dir, "../");
+    }
+    dir[dlen] = 0;
+  }
+  utDie3Str("x64FindRuntime", "Cannot find the runtime", X64RUNTIME);
+  return NULL;
+}
+
+// ============================================================================
+// Prog => Fun+
+//
+// Generate code for each function, in lexical order, then include the
+// runtime, from 'runtime' - eg: "../Tests/io.s" (see x64FindRuntime).
+// ============================================================================
+void x64Prog(X64* x64, Flat* flat, char* runtime) {
+  x64->flat = flat;
+  FlatNode* node = flat->node;                          // alias
+
+  // The pars of each function, so that every call passes just that many args
+
+  int says = intern("says"), sayn = intern("sayn"), sayl = intern("sayl");
+  int maxId = says > sayn ? says : sayn;
+  if (sayl > maxId) maxId = sayl;
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    if (node[fun].val > maxId) maxId = node[fun].val;
+  }
+  x64->numId = maxId + 1;
+  x64->numPars = malloc(x64->numId * sizeof(int));
+  if (!x64->numPars) utDie2Str("x64Prog", "Out of memory");
+  for (int id = 0; id < x64->numId; ++id) x64->numPars[id] = -1;
+  x64->numPars[says] = 1;
+  x64->numPars[sayn] = 1;
+  x64->numPars[sayl] = 0;
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) {
+    int numpar = 0;
+    while (node[fun + 1 + numpar].tag == ASTPAR) ++numpar;
+    x64->numPars[node[fun].val] = numpar;
+  }
+
+  emitCode(x64->emit, "\t.text");
+  for (int fun = 1; fun < (int) node[0].end; fun = node[fun].end) x64Fun(x64, fun);
+  if (strchr(runtime, '"')) utDie3Str("x64Prog", "Cannot include", runtime);
+  char line[X64MAXPATH + 16];
+  sprintf(line, "\t.include\t\"%s\"", runtime);
+  emitCode(x64->emit, line);
+}
@@ -0,0 +1,93 @@
+// x64.h - Code Generator for x86-64 Linux
+
+#pragma once
+
+#include <assert.h>         // assert
+#include <stdint.h>         // int16_t
+#include <stdio.h>          // FILE, fopen, sprintf
+#include <stdlib.h>         // calloc, free
+#include <string.h>         // strcat, strchr, strcmp, strcpy, strrchr
+
+#include "ast.h"            // AST, BOP
+#include "emit.h"           // Emit Buffer
+#include "flat.h"           // Flat
+#include "fold.h"           // foldBop
+#include "intern.h"         // intern, internStr
+#include "lay.h"            // Lay, LaySym
+#include "ra.h"             // raFun
+#include "ut.h"             // ut*
+
+// With "-target x64", x64Prog takes the role that cgProg plays for the
+// 68000: it walks the same inlined, folded Flat, and writes x86-64 assembler
+// text (GNU as, AT&T syntax) into an Emit buffer.  The program then runs
+// natively: "as" and "ld" build it, with the runtime in Tests/io.s, which
+// provides _start and the intrinsics, and needs no C library.  The program
+// includes the runtime by the path x64FindRuntime finds, so it builds from
+// any folder.
+//
+// Functions follow the System V calling convention, so that they may call,
+// and be called from, the runtime: the first six args arrive in EDI, ESI,
+// EDX, ECX, R8D and R9D, the rest on the stack; the result returns in EAX.
+// A call passes exactly as many args as the callee has pars: missing ones
+// are 0, extra ones are dropped.  A Str passed to a function other than says
+// is 0.  (So values behave just as in the interpreter; see interp.h.)
+//
+// raFun picks the hottest pars and vars of each function, just as for the
+// 68000, and each of D2 thru D7 maps onto one of the six registers that
+// System V has the callee preserve:
+//
+//    D2    D3    D4     D5     D6     D7
+//    EBX   EBP   R12D   R13D   R14D   R15D
+//
+// RBP is free for this because a frame is addressed from RSP, which stays
+// put, 16-byte aligned, between Prolog and Epilog.  A frame looks like:
+//
+//    |  stack args      |  pars 7 and up, from the caller
+//    |  return address  |
+//    |  saved registers |  those of EBX ... R15D that the function uses
+//    |  pars and vars   |  4 bytes each, for those not in a register
+//    |  outgoing args   |  8 bytes each, for calls with more than six
+//    |------------------|  <= RSP
+//
+// Values behave just as in the code cg.c generates: + and - wrap at 32 bits,
+// and * multiplies the low 16 bits of each operand, as MULS does.  Nor is a
+// var cleared: a var may share its register with a par, or another var, whose
+// life ended before its own began (see ra.h).  And unlike the interpreter
+// and the VM, a program recurses only as deeply as the native stack allows -
+// except through tail calls, which, as in cg.c, do not grow the stack: a
+// function that calls itself loops back to the top of its body, and any
+// other tail call frees the frame and jumps to the callee.
+
+#define X64NUMARGREGS 6     // args passed in registers
+#define X64MAXNAME    256   // longest function name x64Fun will format
+#define X64MAXLINE    (X64MAXNAME + 64) // longest line x64Ins will format
+#define X64MAXOPND    32    // longest operand - eg: "-2147483648(%rsp)"
+#define X64MAXPATH    1024  // longest path to the runtime, once found
+#define X64MAXUP      4     // parent folders searched for the runtime
+#define X64RUNTIME    "Tests/io.s"
+
+typedef enum {
+  X64IMM,                   // eg: "$5"
+  X64REG,                   // eg: "%ebx"
+  X64MEM                    // eg: "12(%rsp)"
+} X64KIND;
+
+typedef struct {
+  Lay*   lay;
+  Emit*  emit;
+  Flat*  flat;              // program being compiled
+  int    numId;             // slots in numPars[]
+  int*   numPars;           // intern ID => pars of that function (-1 => none)
+  int    fun;               // node of the current function
+  int    funid;             // intern ID of the current function
+  int    regs;              // D registers allocated in the current function (mask)
+  int    frame;             // bytes reserved below the saved registers
+  int    label;             // last label generated
+  int    toplabel;          // label at the top of the body (0 => none)
+} X64;
+
+void  x64Free(X64* x64);
+char* x64FindRuntime(char* sourcePath);
+X64*  x64New();
+char* x64NewName(char* sourcePath);
+void  x64Prog(X64* x64, Flat* flat, char* runtime);
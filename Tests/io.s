@@ -0,0 +1,152 @@
+# =============================================================================
+# io.s - Input/Output functions for the SubC language, on x86-64 Linux
+#
+# The compiler, with "-target x64", ends each program with:
+#
+#                   .include "Tests/io.s"
+#
+# with the path to this file, from wherever the compiler found it.
+#
+# Functions follow the System V calling convention: arguments arrive in RDI,
+# RSI, ...; the result returns in EAX; RBX, RBP and R12-R15 are preserved.
+# Nothing here needs the C library: output collects in io_buf, and goes out
+# with write(2) when the buffer fills, and when main returns.
+# =============================================================================
+
+        .equ    io_size, 4096       # bytes in io_buf
+
+        .bss
+io_buf: .skip   io_size
+
+        .data
+io_len: .quad   0                   # bytes held in io_buf
+io_crlf:
+        .byte   13, 10              # carriage-return, line-feed
+
+        .text
+
+# =============================================================================
+# _start - run main, flush the output, then exit with main's result as the
+# status.  The kernel enters with RSP aligned to 16 bytes.
+# =============================================================================
+
+        .globl  _start
+_start: xorl    %ebp, %ebp          # outermost frame
+        call    main
+        movl    %eax, %ebx          # result; survives io_flush
+        call    io_flush
+        movl    %ebx, %edi          # status
+        movl    $60, %eax           # exit
+        syscall
+
+# =============================================================================
+# io_flush - write the bytes held in io_buf to stdout, and empty it
+# =============================================================================
+
+io_flush:
+        leaq    io_buf(%rip), %rsi  # next byte to write
+        movq    io_len(%rip), %rdx  # bytes left
+.Lflush:
+        testq   %rdx, %rdx
+        jle     .Lflushed
+        movl    $1, %edi            # stdout
+        movl    $1, %eax            # write
+        syscall
+        testq   %rax, %rax
+        jle     .Lflushed           # error: drop the rest
+        addq    %rax, %rsi
+        subq    %rax, %rdx
+        jmp     .Lflush
+.Lflushed:
+        movq    $0, io_len(%rip)
+        ret
+
+# =============================================================================
+# io_write - copy the RSI bytes at (RDI) into io_buf, flushing as it fills
+# =============================================================================
+
+io_write:
+        movq    io_len(%rip), %rcx
+        leaq    io_buf(%rip), %r8
+.Lcopy: testq   %rsi, %rsi
+        jz      .Lcopied
+        cmpq    $io_size, %rcx
+        jb      .Lroom
+        movq    %rcx, io_len(%rip)  # full
+        pushq   %rdi
+        pushq   %rsi
+        pushq   %r8
+        call    io_flush
+        popq    %r8
+        popq    %rsi
+        popq    %rdi
+        xorl    %ecx, %ecx
+.Lroom: movb    (%rdi), %al
+        movb    %al, (%r8,%rcx)
+        incq    %rcx
+        incq    %rdi
+        decq    %rsi
+        jmp     .Lcopy
+.Lcopied:
+        movq    %rcx, io_len(%rip)
+        ret
+
+# =============================================================================
+# int says(char* s) - display 's' as a string.  Returns 0.
+# =============================================================================
+
+says:   movq    %rdi, %rsi          # find the 0 that ends 's'
+.Llen:  cmpb    $0, (%rsi)
+        je      .Lend
+        incq    %rsi
+        jmp     .Llen
+.Lend:  subq    %rdi, %rsi          # chars in 's'
+        call    io_write
+        xorl    %eax, %eax          # return value
+        ret
+
+# =============================================================================
+# int sayn(int n) - display 'n' as a decimal integer.  Returns 0.
+#
+# Digits are built backwards, from the end of a buffer on the stack.
+# =============================================================================
+
+sayn:   subq    $24, %rsp
+        movslq  %edi, %rax          # 'n', widened, so -2147483648 negates
+        movq    %rax, %r9           # its sign
+        leaq    24(%rsp), %r8       # just beyond the digits
+        testq   %rax, %rax
+        jns     .Ldigit
+        negq    %rax
+.Ldigit:
+        xorl    %edx, %edx
+        movl    $10, %ecx
+        divq    %rcx                # RAX = quotient, RDX = digit
+        addb    $'0', %dl
+        decq    %r8
+        movb    %dl, (%r8)
+        testq   %rax, %rax
+        jnz     .Ldigit
+        testq   %r9, %r9
+        jns     .Lsign
+        decq    %r8
+        movb    $'-', (%r8)
+.Lsign: movq    %r8, %rdi           # first char
+        leaq    24(%rsp), %rsi
+        subq    %r8, %rsi           # chars
+        call    io_write
+        addq    $24, %rsp
+        xorl    %eax, %eax          # return value
+        ret
+
+# =============================================================================
+# int sayl() - display a newline.  Returns 0.
+# =============================================================================
+
+sayl:   leaq    io_crlf(%rip), %rdi
+        movl    $2, %esi            # write 2 chars
+        call    io_write
+        xorl    %eax, %eax          # return value
+        ret
+
+        .section .note.GNU-stack, "", @progbits